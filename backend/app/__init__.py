@@ -1,16 +1,27 @@
 from flask import Flask
+from flask_sqlalchemy import SQLAlchemy
+from sqlalchemy import event
 # --- Uncomment extensions if you use them ---
-# from flask_sqlalchemy import SQLAlchemy
 # from flask_migrate import Migrate
 # from flask_marshmallow import Marshmallow
 
 from .config import config # Import the config dictionary
 
 # --- Instantiate extensions (globally accessible) ---
-# db = SQLAlchemy()
+db = SQLAlchemy()
 # migrate = Migrate()
 # ma = Marshmallow()
 
+
+def _sqlite_pragmas(dbapi_connection, connection_record):
+    """SQLite stand-in: WAL lets readers run alongside the single writer; writers wait instead of failing."""
+    cursor = dbapi_connection.cursor()
+    cursor.execute("PRAGMA journal_mode=WAL")
+    cursor.execute("PRAGMA synchronous=NORMAL") # Durable at checkpoints; fine for a stand-in
+    cursor.execute("PRAGMA busy_timeout=5000")
+    cursor.close()
+
+
 # --- Application Factory ---
 def create_app(config_name='default'):
     """Creates and configures the Flask application instance."""
@@ -21,7 +32,7 @@ def create_app(config_name='default'):
     config[config_name].init_app(app) # Optional: if config has an init_app method
 
     # --- Initialize Flask extensions ---
-    # db.init_app(app)
+    db.init_app(app)
     # migrate.init_app(app, db) # Requires db
     # ma.init_app(app)
     print(f"App created with config: {config_name}")
@@ -29,11 +40,33 @@ def create_app(config_name='default'):
          print(f"Database URI: {app.config['SQLALCHEMY_DATABASE_URI']}")
 
 
+    # --- Shared store ---
+    # All state (readings, rollups, health, commands) lives in the database, so
+    # any number of worker processes can serve the API (see wsgi.py).
+    from . import models # Registers the tables
+    with app.app_context():
+        if db.engine.dialect.name == 'sqlite':
+            event.listen(db.engine, 'connect', _sqlite_pragmas)
+        db.create_all()
+        if db.engine.url.database not in (None, '', ':memory:'): # In-memory DB lives in its one connection
+            # Close connections opened here: with `gunicorn --preload` workers are forked
+            # after this point and must each open their own.
+            db.engine.dispose()
+
     # --- Register Blueprints ---
     # API v1
     from .api.v1 import bp as api_v1_blueprint
     app.register_blueprint(api_v1_blueprint, url_prefix='/api/v1')
 
+    # --- MQTT ingest bridge (optional, alongside HTTP ingest) ---
+    from .services import mqtt_bridge
+    mqtt_bridge.init_app(app)
+
+    # --- Maintenance commands ---
+    from .services import recount, retention
+    recount.init_app(app) # flask recount
+    retention.init_app(app) # flask retention
+
     # --- Add a simple health check route ---
     @app.route('/health')
     def health_check():
@@ -42,7 +75,7 @@ def create_app(config_name='default'):
     # --- Shell Context Processor (optional, useful for `flask shell`) ---
     @app.shell_context_processor
     def make_shell_context():
-        return dict(app=app) # Add db, models here if using them: dict(app=app, db=db, Reading=Reading)
+        return dict(app=app, db=db, models=models)
 
 
     return app
@@ -1,9 +1,11 @@
-from flask import request, jsonify, current_app
+from flask import request, jsonify, current_app, Response, stream_with_context, url_for
 import datetime
+import time
 
 from . import bp # Import the blueprint instance from __init__.py
 # from .schemas import ReadingSchema # Uncomment if using Marshmallow schemas
 from ...services import data_handler # Import service functions
+from ...services import stream_broker
 
 # --- Schema Instance (if using Marshmallow) ---
 # reading_schema = ReadingSchema()
@@ -16,6 +18,7 @@ def receive_reading():
     Endpoint for scales to push data readings.
     Validates input JSON and passes it to the data handler service.
     """
+    received_ms = int(time.time() * 1000) # Latency trace 'received' stamp
     if not request.is_json:
         current_app.logger.warning("Received non-JSON request to /reading")
         return jsonify({"error": "Request must be JSON"}), 400
@@ -25,8 +28,7 @@ def receive_reading():
 
     # --- Validation ---
     # Option 1: Simple Manual Validation
-    required_fields = ["device_id", "weight_grams", "item_count", "is_stable", "is_overload", "mode"]
-    errors = {field: f"Missing required field: {field}" for field in required_fields if field not in data}
+    errors = data_handler.validate_reading(data)
     if errors:
         current_app.logger.warning(f"Validation failed: {errors}")
         return jsonify({"errors": errors}), 400
@@ -41,14 +43,18 @@ def receive_reading():
 
     # --- Process Data via Service Layer ---
     try:
-        success, message = data_handler.process_and_store_reading(data)
+        success, message = data_handler.process_and_store_reading(data, received_ms=received_ms)
         if success:
             current_app.logger.info(f"Reading processed successfully for device {data.get('device_id')}")
+            duplicate = message == data_handler.DUPLICATE_READING
             return jsonify({
                 "message": message or "Reading received successfully",
                 "device_id": data.get("device_id"),
-                "received_timestamp": datetime.datetime.utcnow().isoformat() + 'Z'
-            }), 201 # 201 Created
+                "received_timestamp": datetime.datetime.utcnow().isoformat() + 'Z',
+                "duplicate": duplicate,
+                # Downlink: pending commands ride on the upload response
+                "commands": data_handler.get_commands_for_device(data.get("device_id"))
+            }), 200 if duplicate else 201 # 201 Created; a retry of a stored reading changes nothing
         else:
              current_app.logger.error(f"Failed to process reading: {message}")
              return jsonify({"error": message or "Failed to process reading"}), 500
@@ -81,6 +87,286 @@ def get_readings(device_id):
          current_app.logger.exception(f"Error retrieving readings for device {device_id}")
          return jsonify({"error": "Internal server error"}), 500
 
+
+@bp.route('/export/<string:device_id>', methods=['GET'])
+def export_readings(device_id):
+    """
+    Streams a device's full reading history, oldest first, for bulk export.
+    Query args:
+      format: ndjson (default) | csv
+      start, end: ISO 8601 bounds on receive time (start inclusive, end exclusive)
+      limit:  rows per page; the X-Next-Cursor header (and Link rel="next") then
+              continues with ?cursor=<token> until it is absent
+      cursor: page token from a previous response (replaces start/end/after)
+      after:  reading id to resume after, e.g. the last "id" a broken download received
+    Sent gzip-encoded when the client accepts it (curl --compressed).
+    """
+    fmt = request.args.get('format', default='ndjson')
+    limit = request.args.get('limit', type=int)
+    if limit is not None and limit <= 0:
+        return jsonify({"error": "limit must be positive"}), 400
+    try:
+        if request.args.get('cursor'):
+            after_id, start, end = data_handler.decode_export_cursor(request.args['cursor'])
+        else:
+            start = _parse_iso_arg('start')
+            end = _parse_iso_arg('end')
+            after_id = request.args.get('after', default=0, type=int)
+    except (ValueError, TypeError, OverflowError, OSError) as e:
+        return jsonify({"error": f"Invalid export range: {e}"}), 400
+
+    compress = 'gzip' in request.accept_encodings
+    try:
+        next_cursor, chunks = data_handler.export_readings(device_id, fmt=fmt, start=start, end=end,
+                                                           after_id=after_id, limit=limit, compress=compress)
+    except ValueError as e:
+        return jsonify({"error": str(e)}), 400
+
+    headers = {
+        'Content-Disposition': f'attachment; filename="{device_id}_readings.{fmt}"',
+        'X-Accel-Buffering': 'no', # Let proxies pass chunks through
+        'Vary': 'Accept-Encoding',
+    }
+    if compress:
+        headers['Content-Encoding'] = 'gzip'
+    if next_cursor:
+        headers['X-Next-Cursor'] = next_cursor
+        next_args = {'format': fmt, 'limit': limit, 'cursor': next_cursor}
+        headers['Link'] = f'<{url_for(".export_readings", device_id=device_id, **next_args)}>; rel="next"'
+    current_app.logger.info(f"Exporting readings of {device_id} ({fmt}, after id {after_id}, limit {limit})")
+    return Response(stream_with_context(chunks), mimetype=data_handler.EXPORT_FORMATS[fmt], headers=headers)
+
+
+@bp.route('/latency', methods=['GET'])
+def get_fleet_latency():
+    """
+    Sample-to-storage latency distributions (ms) per stage, fleet-wide and per device.
+    Only readings from SNTP-synced firmware carry the trace stamps.
+    """
+    return jsonify(data_handler.get_latency_summary()), 200
+
+
+@bp.route('/latency/<string:device_id>', methods=['GET'])
+def get_device_latency(device_id):
+    """Latency distributions (ms) per stage for one device."""
+    return jsonify({"device_id": device_id, "stages": data_handler.get_latency_summary(device_id)}), 200
+
+
+@bp.route('/sequence', methods=['GET'])
+def get_fleet_sequence():
+    """
+    Per-device sequence accounting: readings received, duplicates dropped,
+    out-of-order arrivals and numbers lost (gaps).
+    """
+    return jsonify(data_handler.get_sequence_status()), 200
+
+
+@bp.route('/sequence/<string:device_id>', methods=['GET'])
+def get_device_sequence(device_id):
+    """Sequence accounting for one device, with its most recent gaps."""
+    status = data_handler.get_sequence_status(device_id)
+    if status is None:
+        return jsonify({"error": f"No sequenced readings from device {device_id}"}), 404
+    return jsonify(status), 200
+
+
+@bp.route('/alerts', methods=['GET'])
+def get_alerts():
+    """
+    Anomaly alerts raised on the ingest stream, newest first.
+    Query args: device_id (default: whole fleet), active=1 (ongoing only), limit (max 500).
+    """
+    limit = request.args.get('limit', default=100, type=int)
+    if limit <= 0:
+        return jsonify({"error": "limit must be positive"}), 400
+    limit = min(limit, 500)
+    active_only = request.args.get('active') in ('1', 'true')
+    return jsonify(data_handler.get_alerts(request.args.get('device_id'), active_only=active_only, limit=limit)), 200
+
+
+@bp.route('/anomaly/<string:device_id>', methods=['GET'])
+def get_device_anomaly_stats(device_id):
+    """Online statistics behind the alerts of one device, with its ongoing alert kinds."""
+    stats = data_handler.get_device_stats(device_id)
+    if stats is None:
+        return jsonify({"error": f"No readings from device {device_id}"}), 404
+    return jsonify(stats), 200
+
+
+def _parse_iso(value):
+    """
+    Optional ISO 8601 timestamp -> naive UTC datetime. Raises ValueError for
+    anything else: an epoch number must not silently drop the bound.
+    """
+    if value is None or value == '':
+        return None
+    if not isinstance(value, str):
+        raise ValueError(f"expected an ISO 8601 string, got {value!r}")
+    parsed = datetime.datetime.fromisoformat(value.replace('Z', '+00:00'))
+    if parsed.tzinfo is not None:
+        parsed = parsed.astimezone(datetime.timezone.utc).replace(tzinfo=None)
+    return parsed
+
+
+def _parse_iso_arg(name):
+    """Parses an optional ISO 8601 query argument. Raises ValueError if malformed."""
+    return _parse_iso(request.args.get(name))
+
+
+@bp.route('/rollups', methods=['GET'])
+def get_rollups():
+    """
+    Pre-aggregated reporting buckets maintained at ingest time.
+    Query args:
+      resolution: minute | hour | day (default: hour)
+      device_id:  repeatable or comma separated; omit for all devices
+      start, end: ISO 8601 bounds on bucket start (start inclusive, end exclusive)
+    """
+    resolution = request.args.get('resolution', default='hour')
+    device_ids = [d for arg in request.args.getlist('device_id') for d in arg.split(',') if d] or None
+
+    try:
+        start = _parse_iso_arg('start')
+        end = _parse_iso_arg('end')
+    except ValueError as e:
+        return jsonify({"error": f"Invalid start/end timestamp: {e}"}), 400
+
+    try:
+        buckets = data_handler.get_rollups(resolution, device_ids=device_ids, start=start, end=end)
+        return jsonify({"resolution": resolution, "buckets": buckets}), 200
+    except ValueError as e:
+        return jsonify({"error": str(e)}), 400
+    except Exception as e:
+        current_app.logger.exception("Error retrieving rollups")
+        return jsonify({"error": "Internal server error"}), 500
+
+
+@bp.route('/recount/<string:device_id>', methods=['POST'])
+def recount_readings(device_id):
+    """
+    Recomputes stored item counts after a piece weight correction, e.g.
+    {"item_weight_g": 2.47, "start": "2026-03-01T00:00:00Z", "end": "2026-03-08T00:00:00Z"}.
+    start/end (optional, ISO 8601) bound the receive time. Only history changes:
+    queue set_piece_weight to correct the scale itself. For very large histories
+    prefer `flask recount`, which is not bound by request timeouts.
+    """
+    if not request.is_json:
+        return jsonify({"error": "Request must be JSON"}), 400
+    data = request.get_json()
+    if data.get('item_weight_g') is None:
+        return jsonify({"errors": {"item_weight_g": "Missing required field: item_weight_g"}}), 400
+
+    try:
+        start = _parse_iso(data.get('start'))
+        end = _parse_iso(data.get('end'))
+    except ValueError as e:
+        return jsonify({"error": f"Invalid start/end timestamp: {e}"}), 400
+
+    try:
+        result = data_handler.recount_readings(device_id, data['item_weight_g'], start=start, end=end)
+    except (ValueError, TypeError) as e:
+        return jsonify({"error": str(e)}), 400
+    return jsonify(result), 200
+
+
+def _event_stream(device_id):
+    """Generator yielding SSE frames for one subscription until the client disconnects."""
+    keepalive = current_app.config.get('STREAM_KEEPALIVE_SECONDS', 15)
+    sub = stream_broker.subscribe(device_id, max_queue=current_app.config.get('STREAM_SUBSCRIBER_QUEUE_SIZE', 100))
+    current_app.logger.info(f"Stream subscriber added for {device_id or 'fleet'}")
+    try:
+        yield "retry: 3000\n\n" # Client reconnect delay (ms)
+        while True:
+            event = sub.next_event(timeout=keepalive)
+            # A comment frame keeps the connection alive and detects closed clients
+            yield event if event is not None else ": keepalive\n\n"
+    finally:
+        stream_broker.unsubscribe(sub)
+
+
+def _stream_response(device_id):
+    headers = {
+        'Cache-Control': 'no-cache',
+        'X-Accel-Buffering': 'no', # Disable proxy buffering (nginx)
+    }
+    return Response(stream_with_context(_event_stream(device_id)), mimetype='text/event-stream', headers=headers)
+
+
+@bp.route('/stream', methods=['GET'])
+def stream_fleet_readings():
+    """Server-Sent Events stream of every reading as it is ingested (fleet-wide)."""
+    return _stream_response(None)
+
+
+@bp.route('/stream/<string:device_id>', methods=['GET'])
+def stream_device_readings(device_id):
+    """Server-Sent Events stream of new readings for a single device."""
+    return _stream_response(device_id)
+
+
+@bp.route('/device_health', methods=['POST'])
+def receive_device_health():
+    """
+    Endpoint for scales to push periodic health records (CPU, stack, heap, Wi-Fi).
+    """
+    if not request.is_json:
+        return jsonify({"error": "Request must be JSON"}), 400
+    data = request.get_json()
+    required_fields = ["device_id", "fw", "up", "heap", "heap_min"]
+    errors = {field: f"Missing required field: {field}" for field in required_fields if field not in data}
+    if errors:
+        return jsonify({"errors": errors}), 400
+
+    success, message = data_handler.process_and_store_health(data)
+    if not success:
+        return jsonify({"error": message}), 400
+    return jsonify({"message": message, "device_id": data["device_id"]}), 201
+
+
+@bp.route('/device_health/<string:device_id>', methods=['GET'])
+def get_device_health(device_id):
+    """Recent health records for a device (newest first)."""
+    limit = request.args.get('limit', default=20, type=int)
+    if limit <= 0:
+        return jsonify({"error": "limit must be positive"}), 400
+    limit = min(limit, 100)
+    return jsonify(data_handler.get_device_health(device_id, limit=limit)), 200
+
+
+@bp.route('/device_health', methods=['GET'])
+def get_fleet_health():
+    """Fleet health summary grouped by firmware version (latest record per device)."""
+    return jsonify(data_handler.get_fleet_health_summary()), 200
+
+
+@bp.route('/lot', methods=['POST'])
+def receive_lot():
+    """Receives a closed accumulation lot from a scale (one record per lot)."""
+    if not request.is_json:
+        return jsonify({"error": "Request must be JSON"}), 400
+    data = request.get_json()
+    errors = {field: f"Missing required field: {field}" for field in data_handler.LOT_REQUIRED_FIELDS
+              if field not in data}
+    if errors:
+        return jsonify({"errors": errors}), 400
+
+    success, message = data_handler.process_and_store_lot(data)
+    if not success:
+        return jsonify({"error": message}), 400
+    status = 200 if message == data_handler.DUPLICATE_LOT else 201
+    return jsonify({"message": message, "device_id": data["device_id"]}), status
+
+
+@bp.route('/lots/<string:device_id>', methods=['GET'])
+def get_device_lots(device_id):
+    """Recent lots of a device (newest first)."""
+    limit = request.args.get('limit', default=20, type=int)
+    if limit <= 0:
+        return jsonify({"error": "limit must be positive"}), 400
+    limit = min(limit, 100)
+    return jsonify(data_handler.get_device_lots(device_id, limit=limit)), 200
+
+
 # --- Add more routes as needed ---
 # Example: Route to get device status
 # @bp.route('/status/<string:device_id>', methods=['GET'])
@@ -88,11 +374,39 @@ def get_readings(device_id):
 #     # ... call data_handler.get_status(device_id) ...
 #     pass
 
-# Example: Route to send a command (e.g., request tare)
-# @bp.route('/command/<string:device_id>', methods=['POST'])
-# def send_command(device_id):
-#     # ... get command from request json ...
-#     # ... call data_handler.queue_command(device_id, command) ...
-#     # This would likely involve an IoT platform or other mechanism
-#     # to send the command down to the device.
-#     pass
+@bp.route('/command/<string:device_id>', methods=['POST'])
+def send_command(device_id):
+    """
+    Queues a command for a device, e.g. {"command": "set_piece_weight", "args": {"grams": 2.5}}.
+    It is delivered in the response to the device's next reading upload.
+    """
+    if not request.is_json:
+        return jsonify({"error": "Request must be JSON"}), 400
+    data = request.get_json()
+    if not data.get('command'):
+        return jsonify({"errors": {"command": "Missing required field: command"}}), 400
+
+    try:
+        command = data_handler.queue_command(device_id, data['command'], data.get('args'))
+    except ValueError as e:
+        return jsonify({"error": str(e)}), 400
+    current_app.logger.info(f"Queued command {command['cmd']} (id {command['id']}) for device {device_id}")
+    return jsonify(command), 201
+
+
+@bp.route('/command/<string:device_id>', methods=['GET'])
+def poll_commands(device_id):
+    """
+    Optional device long-poll for pending commands.
+    Query args:
+      wait: seconds to block while nothing is pending (0-30, default 0)
+    """
+    wait = min(max(request.args.get('wait', default=0, type=int), 0), 30)
+    return jsonify({"device_id": device_id,
+                    "commands": data_handler.get_commands_for_device(device_id, wait_seconds=wait)}), 200
+
+
+@bp.route('/commands/<string:device_id>', methods=['GET'])
+def list_commands(device_id):
+    """Pending and recently completed commands for a device (operator view)."""
+    return jsonify(data_handler.list_device_commands(device_id)), 200
@@ -10,7 +10,7 @@ class ReadingSchema(Schema):
     is_stable = fields.Bool(required=True)
     is_overload = fields.Bool(required=True)
     average_item_weight = fields.Float(required=False, allow_none=True)
-    mode = fields.Str(required=True, validate=validate.OneOf(["WEIGHING", "COUNTING", "ERROR"]))
+    mode = fields.Str(required=True, validate=validate.OneOf(["WEIGHING", "COUNTING", "ACCUMULATE", "CHECKWEIGH", "ERROR"]))
 
     # Example custom validation
     # @validates_schema
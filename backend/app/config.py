@@ -14,6 +14,54 @@ class Config:
     SQLALCHEMY_TRACK_MODIFICATIONS = False # Suppress SQLAlchemy warning
     SQLALCHEMY_RECORD_QUERIES = True # Enable query recording (useful for debugging)
     SLOW_DB_QUERY_TIME = 0.5 # Threshold for logging slow queries (seconds)
+    # Per worker process: pool_size persistent connections, max_overflow more under bursts
+    SQLALCHEMY_ENGINE_OPTIONS = {
+        'pool_size': int(os.environ.get('DB_POOL_SIZE') or 5),
+        'max_overflow': int(os.environ.get('DB_MAX_OVERFLOW') or 10),
+        'pool_pre_ping': True, # Survive database restarts / idle connection drops
+        'pool_recycle': 1800,
+    }
+
+    # --- Live stream (Server-Sent Events) ---
+    STREAM_KEEPALIVE_SECONDS = 15 # Comment frame interval to keep proxies from closing idle streams
+    STREAM_SUBSCRIBER_QUEUE_SIZE = 100 # Events buffered per client before the oldest are dropped
+    STREAM_POLL_INTERVAL_SECONDS = 0.5 # Each worker checks the readings table for new rows this often
+    HEALTH_HISTORY_PER_DEVICE = 288 # Health records kept per device (24h at the 5 min device interval)
+    LATENCY_SAMPLES_PER_DEVICE = 1000 # Recent readings per device behind the /latency percentiles
+    SEQUENCE_REORDER_WINDOW = 32 # Readings that may arrive out of order before a missing one counts as lost (max 63)
+    SEQUENCE_GAP_HISTORY = 100 # Gap runs kept per device
+    ROLLUP_MAX_STABLE_GAP_SECONDS = 30 # Stable time credited per reading at most (2x the 15 s device report interval)
+    RECOUNT_BATCH_SIZE = 50000 # Readings per recount transaction (services/recount.py)
+    EXPORT_FETCH_SIZE = 1000 # Rows per server-side cursor fetch in /export (services/export.py)
+    EXPORT_CHUNK_BYTES = 65536 # Response chunk size of /export, before compression
+
+    # --- Anomaly detection on the ingest stream (services/anomaly.py) ---
+    ANOMALY_EWMA_ALPHA = 0.05 # Weight of the newest reading in the moving averages (~20 readings memory)
+    ANOMALY_WARMUP_READINGS = 20 # Readings per device before ratio / drift / count drop alerts may fire
+    ANOMALY_ZERO_BAND_G = 5.0 # Stable readings within this of zero, with no items, count as an empty pan
+    ANOMALY_ZERO_DRIFT_G = 1.0 # Empty-pan average beyond this raises zero_drift
+    ANOMALY_OVERLOAD_RATIO = 0.05 # Overload share above this raises overload
+    ANOMALY_UNSTABLE_RATIO = 0.5 # Unstable share above this raises unstable
+    ANOMALY_STUCK_READINGS = 360 # Identical loaded weights in a row that raise stuck_sensor
+    ANOMALY_COUNT_DROP_MIN = 5 # Smallest count drop (items) that can raise count_drop
+    ANOMALY_COUNT_DROP_FACTOR = 4.0 # ... and it must exceed this many times the device's typical step
+    ALERT_HISTORY_PER_DEVICE = 100 # Alerts kept per device
+
+    # --- Retention (services/retention.py, `flask retention`) ---
+    RETENTION_RAW_DAYS = int(os.environ.get('RETENTION_RAW_DAYS') or 30) # Whole days of raw rows kept in the readings table
+    # Unset = archived days are kept forever
+    ARCHIVE_RETENTION_DAYS = int(os.environ['ARCHIVE_RETENTION_DAYS']) if os.environ.get('ARCHIVE_RETENTION_DAYS') else None
+    # Columnar files of compacted device-days; shared by all workers (same path / network mount)
+    ARCHIVE_DIR = os.environ.get('ARCHIVE_DIR') or os.path.join(basedir, '..', 'instance', 'archive')
+
+    # --- MQTT ingest bridge (services/mqtt_bridge.py) ---
+    MQTT_BROKER_HOST = os.environ.get('MQTT_BROKER_HOST') # Unset = bridge disabled (HTTP ingest only)
+    MQTT_BROKER_PORT = int(os.environ.get('MQTT_BROKER_PORT') or 1883)
+    MQTT_TOPIC_PREFIX = os.environ.get('MQTT_TOPIC_PREFIX') or 'scales' # <prefix>/<device_id>/readings|health|cmd
+    MQTT_CLIENT_ID = os.environ.get('MQTT_CLIENT_ID') or 'scale-backend-bridge' # Stable id: the broker keeps our session
+    # Run the bridge inside the web process (single-process development). With several
+    # workers run it once, separately: `flask mqtt-bridge`.
+    MQTT_BRIDGE_EMBEDDED = (os.environ.get('MQTT_BRIDGE_EMBEDDED') or '1') == '1'
 
     # --- Other common settings ---
     # MAIL_SERVER = os.environ.get('MAIL_SERVER')
@@ -37,17 +85,25 @@ class DevelopmentConfig(Config):
         'sqlite:///' + os.path.join(basedir, '..', 'instance', 'dev_app.db')
     print(f"Using DEV DB: {SQLALCHEMY_DATABASE_URI}")
 
+    @staticmethod
+    def init_app(app):
+        Config.init_app(app)
+        os.makedirs(os.path.join(basedir, '..', 'instance'), exist_ok=True) # Default SQLite location
+
 class TestingConfig(Config):
     """Testing specific configuration."""
     TESTING = True
     SQLALCHEMY_DATABASE_URI = os.environ.get('TEST_DATABASE_URL') or \
         'sqlite://' # Use in-memory SQLite for tests by default
+    SQLALCHEMY_ENGINE_OPTIONS = {} # In-memory SQLite uses a single static connection (no pool)
     WTF_CSRF_ENABLED = False # Disable CSRF forms protection in tests
+    MQTT_BROKER_HOST = None # Tests drive the bridge directly (mqtt_bridge.handle_message)
 
 class ProductionConfig(Config):
     """Production specific configuration."""
     DEBUG = False
-    SQLALCHEMY_DATABASE_URI = os.environ.get('DATABASE_URL') # Must be set in environment
+    SQLALCHEMY_DATABASE_URI = os.environ.get('DATABASE_URL') # Must be set in environment (PostgreSQL)
+    MQTT_BRIDGE_EMBEDDED = os.environ.get('MQTT_BRIDGE_EMBEDDED') == '1' # One bridge per deployment, not per worker
     # Add other production hardening settings: logging, security headers, etc.
 
     @classmethod
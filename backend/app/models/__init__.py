@@ -0,0 +1,9 @@
+# Table models (Flask-SQLAlchemy); importing this package registers them with db
+from .anomaly import Alert, DeviceStats
+from .archive import ArchivePartition
+from .command import Command
+from .health import HealthRecord
+from .lot import Lot
+from .reading import Reading
+from .rollup import RollupBucket, RollupDeviceState
+from .sequence import DeviceSequence, SequenceGap
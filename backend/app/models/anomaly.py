@@ -0,0 +1,65 @@
+from .. import db
+from ..utils import iso_utc
+
+
+class DeviceStats(db.Model):
+    """Online per-device statistics of the ingest stream, O(1) per device (see services/anomaly.py)."""
+    __tablename__ = 'device_stats'
+
+    device_id = db.Column(db.String(64), primary_key=True)
+    readings = db.Column(db.BigInteger, nullable=False, default=0)
+    zero_ewma = db.Column(db.Float, nullable=False, default=0.0) # Weight shown while empty (g)
+    overload_ewma = db.Column(db.Float, nullable=False, default=0.0) # Share of readings in overload
+    unstable_ewma = db.Column(db.Float, nullable=False, default=0.0) # Share of readings not stable
+    step_ewma = db.Column(db.Float, nullable=False, default=0.0) # Typical count change between stable readings
+    last_count = db.Column(db.Integer, nullable=True) # Last stable counting-mode count, None after a piece weight change
+    last_weight = db.Column(db.Float, nullable=True)
+    same_weight_run = db.Column(db.Integer, nullable=False, default=0) # Consecutive loaded readings with an identical weight
+    item_weight = db.Column(db.Float, nullable=True) # Piece weight of the last counting reading
+    item_weight_changes = db.Column(db.Integer, nullable=False, default=0)
+    item_weight_changed_at = db.Column(db.DateTime, nullable=True)
+    active_alerts = db.Column(db.Integer, nullable=False, default=0) # Bit per ongoing alert kind
+    last_seen = db.Column(db.DateTime, nullable=True)
+
+    def to_dict(self):
+        return {
+            'device_id': self.device_id,
+            'readings': self.readings,
+            'zero_drift_g': round(self.zero_ewma, 3),
+            'overload_ratio': round(self.overload_ewma, 4),
+            'unstable_ratio': round(self.unstable_ewma, 4),
+            'typical_count_step': round(self.step_ewma, 2),
+            'same_weight_run': self.same_weight_run,
+            'item_weight': self.item_weight,
+            'item_weight_changes': self.item_weight_changes,
+            'item_weight_changed_at': iso_utc(self.item_weight_changed_at),
+            'last_seen': iso_utc(self.last_seen),
+        }
+
+
+class Alert(db.Model):
+    """An anomaly raised on the ingest stream; ongoing conditions are cleared when they end."""
+    __tablename__ = 'alerts'
+
+    id = db.Column(db.Integer, primary_key=True)
+    device_id = db.Column(db.String(64), nullable=False)
+    kind = db.Column(db.String(20), nullable=False)
+    message = db.Column(db.String(200), nullable=False)
+    value = db.Column(db.Float, nullable=True) # The statistic that crossed its threshold
+    raised_at = db.Column(db.DateTime, nullable=False)
+    cleared_at = db.Column(db.DateTime, nullable=True) # None while ongoing (events are never ongoing)
+
+    __table_args__ = (
+        db.Index('ix_alerts_device_id_id', 'device_id', 'id'),
+    )
+
+    def to_dict(self):
+        return {
+            'id': self.id,
+            'device_id': self.device_id,
+            'kind': self.kind,
+            'message': self.message,
+            'value': self.value,
+            'raised_at': iso_utc(self.raised_at),
+            'cleared_at': iso_utc(self.cleared_at),
+        }
@@ -0,0 +1,15 @@
+from .. import db
+
+
+class ArchivePartition(db.Model):
+    """One compacted device-day of readings in the archive tier (see services/archive.py)."""
+    __tablename__ = 'archive_partitions'
+
+    device_id = db.Column(db.String(64), primary_key=True)
+    day = db.Column(db.Date, primary_key=True) # UTC day of server_timestamp
+    path = db.Column(db.String(255), nullable=False) # Relative to ARCHIVE_DIR; a new name per rewrite
+    row_count = db.Column(db.Integer, nullable=False)
+    min_id = db.Column(db.Integer, nullable=False)
+    max_id = db.Column(db.Integer, nullable=False)
+    file_bytes = db.Column(db.Integer, nullable=False)
+    compacted_at = db.Column(db.DateTime, nullable=False)
@@ -0,0 +1,33 @@
+from .. import db
+from ..utils import iso_utc
+import datetime
+
+
+class Command(db.Model):
+    """A queued device command and its delivery state (see services/command_queue.py)."""
+    __tablename__ = 'commands'
+
+    id = db.Column(db.Integer, primary_key=True) # Also the id the device acknowledges
+    device_id = db.Column(db.String(64), nullable=False)
+    cmd = db.Column(db.String(32), nullable=False)
+    args = db.Column(db.JSON, nullable=False)
+    status = db.Column(db.String(16), nullable=False)
+    queued_at = db.Column(db.DateTime, nullable=False, default=datetime.datetime.utcnow)
+    delivered_count = db.Column(db.Integer, nullable=False, default=0)
+    completed_at = db.Column(db.DateTime, nullable=True)
+
+    __table_args__ = (
+        db.Index('ix_commands_device_id_status', 'device_id', 'status', 'id'),
+    )
+
+    def to_dict(self):
+        return {
+            'id': self.id,
+            'device_id': self.device_id,
+            'cmd': self.cmd,
+            'args': self.args,
+            'status': self.status,
+            'queued_at': iso_utc(self.queued_at),
+            'delivered_count': self.delivered_count,
+            'completed_at': iso_utc(self.completed_at),
+        }
@@ -0,0 +1,14 @@
+from .. import db
+
+
+class HealthRecord(db.Model):
+    __tablename__ = 'health_records'
+
+    id = db.Column(db.Integer, primary_key=True)
+    device_id = db.Column(db.String(64), nullable=False)
+    firmware_version = db.Column(db.String(32), nullable=False)
+    record = db.Column(db.JSON, nullable=False) # Expanded record as returned by the API
+
+    __table_args__ = (
+        db.Index('ix_health_records_device_id_id', 'device_id', 'id'),
+    )
@@ -0,0 +1,33 @@
+from .. import db
+from ..utils import iso_utc
+
+
+class Lot(db.Model):
+    """A closed accumulation lot reported by a scale (firmware MODE_ACCUMULATE)."""
+    __tablename__ = 'lots'
+
+    id = db.Column(db.Integer, primary_key=True)
+    device_id = db.Column(db.String(64), nullable=False)
+    lot_id = db.Column(db.BigInteger, nullable=False) # Device's lot number (restarts if its NVS is erased)
+    sku = db.Column(db.String(64), nullable=True)
+    item_weight = db.Column(db.Float, nullable=True)
+    total = db.Column(db.Integer, nullable=False) # Items
+    loads = db.Column(db.Integer, nullable=False)
+    closed_at = db.Column(db.DateTime, nullable=True) # Device clock; None if it was not synced
+    received_at = db.Column(db.DateTime, nullable=False)
+
+    __table_args__ = (
+        db.Index('ix_lots_device_id_lot_id', 'device_id', 'lot_id'),
+    )
+
+    def to_dict(self):
+        return {
+            'device_id': self.device_id,
+            'lot_id': self.lot_id,
+            'sku': self.sku,
+            'item_weight': self.item_weight,
+            'total': self.total,
+            'loads': self.loads,
+            'closed_at': iso_utc(self.closed_at),
+            'received_at': iso_utc(self.received_at),
+        }
@@ -1,47 +1,52 @@
-# from .. import db # Import db instance if created in app/__init__
+from .. import db # Import db instance created in app/__init__
+from ..utils import iso_utc
 from sqlalchemy.sql import func # For default timestamps
-import datetime
-
-# --- Example using SQLAlchemy (Requires Flask-SQLAlchemy setup) ---
-
-# class Reading(db.Model):
-#     __tablename__ = 'readings' # Explicit table name
-
-#     id = db.Column(db.Integer, primary_key=True)
-#     device_id = db.Column(db.String(64), index=True, nullable=False)
-
-#     # Timestamp from device (if provided), or when received by backend
-#     device_timestamp = db.Column(db.DateTime(timezone=True), nullable=True)
-#     server_timestamp = db.Column(db.DateTime(timezone=True), server_default=func.now(), index=True)
-
-#     # Core data
-#     weight_grams = db.Column(db.Float, nullable=False)
-#     item_count = db.Column(db.Integer, nullable=False)
-#     is_stable = db.Column(db.Boolean, default=False, nullable=False)
-#     is_overload = db.Column(db.Boolean, default=False, nullable=False)
-#     average_item_weight = db.Column(db.Float, nullable=True) # Null if not applicable/set
-#     mode = db.Column(db.String(20), nullable=False) # WEIGHING, COUNTING, ERROR
-
-#     def __repr__(self):
-#         return f'<Reading {self.id} from {self.device_id} at {self.server_timestamp}>'
-
-#     def to_dict(self):
-#         """Helper method to convert model instance to dictionary"""
-#         return {
-#             'id': self.id,
-#             'device_id': self.device_id,
-#             'device_timestamp': self.device_timestamp.isoformat() if self.device_timestamp else None,
-#             'server_timestamp': self.server_timestamp.isoformat() if self.server_timestamp else None,
-#             'weight_grams': self.weight_grams,
-#             'item_count': self.item_count,
-#             'is_stable': self.is_stable,
-#             'is_overload': self.is_overload,
-#             'average_item_weight': self.average_item_weight,
-#             'mode': self.mode
-#         }
-
-# --- Placeholder if not using SQLAlchemy ---
-class ReadingModelPlaceholder:
-    # This class is just a conceptual placeholder if you are not using an ORM like SQLAlchemy.
-    # Your data_handler would interact directly with your chosen database or data store.
-    pass
+
+
+class Reading(db.Model):
+    __tablename__ = 'readings' # Explicit table name
+
+    # Modes whose stable readings carry a count the scale computed from their weight
+    COUNTING_MODES = ('COUNTING', 'ACCUMULATE')
+
+    id = db.Column(db.Integer, primary_key=True)
+    device_id = db.Column(db.String(64), index=True, nullable=False)
+
+    # Timestamp from device (if provided), or when received by backend (naive UTC)
+    device_timestamp = db.Column(db.DateTime, nullable=True)
+    server_timestamp = db.Column(db.DateTime, server_default=func.now(), index=True)
+
+    # Core data
+    weight_grams = db.Column(db.Float, nullable=False)
+    item_count = db.Column(db.Integer, nullable=False)
+    is_stable = db.Column(db.Boolean, default=False, nullable=False)
+    is_overload = db.Column(db.Boolean, default=False, nullable=False)
+    average_item_weight = db.Column(db.Float, nullable=True) # Null if not applicable/set
+    mode = db.Column(db.String(20), nullable=False) # WEIGHING, COUNTING, ACCUMULATE, CHECKWEIGH, ERROR
+
+    # Latency trace stamps (epoch ms), only from SNTP-synced firmware (see services/latency.py)
+    trace = db.Column(db.JSON(none_as_null=True), nullable=True)
+
+    __table_args__ = (
+        db.Index('ix_readings_device_id_id', 'device_id', 'id'), # Newest-first per device
+    )
+
+    def __repr__(self):
+        return f'<Reading {self.id} from {self.device_id} at {self.server_timestamp}>'
+
+    def to_dict(self):
+        """Helper method to convert model instance to dictionary"""
+        result = {
+            'device_id': self.device_id,
+            'device_timestamp': iso_utc(self.device_timestamp),
+            'server_timestamp': iso_utc(self.server_timestamp),
+            'weight_grams': self.weight_grams,
+            'item_count': self.item_count,
+            'is_stable': self.is_stable,
+            'is_overload': self.is_overload,
+            'average_item_weight': self.average_item_weight,
+            'mode': self.mode,
+        }
+        if self.trace:
+            result['trace'] = self.trace
+        return result
@@ -0,0 +1,30 @@
+from .. import db
+
+
+class RollupBucket(db.Model):
+    """One pre-aggregated bucket (see services/rollups.py)."""
+    __tablename__ = 'rollup_buckets'
+
+    resolution = db.Column(db.String(8), primary_key=True)
+    device_id = db.Column(db.String(64), primary_key=True)
+    bucket_start = db.Column(db.Integer, primary_key=True) # Epoch seconds
+    reading_count = db.Column(db.Integer, nullable=False)
+    count_min = db.Column(db.Integer, nullable=False)
+    count_max = db.Column(db.Integer, nullable=False)
+    count_last = db.Column(db.Integer, nullable=False)
+    weight_min = db.Column(db.Float, nullable=False)
+    weight_max = db.Column(db.Float, nullable=False)
+    weight_last = db.Column(db.Float, nullable=False)
+    stable_seconds = db.Column(db.Float, nullable=False)
+    overload_events = db.Column(db.Integer, nullable=False)
+    last_timestamp = db.Column(db.Float, nullable=True) # Epoch seconds of the newest reading
+
+
+class RollupDeviceState(db.Model):
+    """Last reading seen per device, for stable time and overload edges."""
+    __tablename__ = 'rollup_device_state'
+
+    device_id = db.Column(db.String(64), primary_key=True)
+    last_epoch = db.Column(db.Float, nullable=False)
+    last_stable = db.Column(db.Boolean, nullable=False)
+    last_overload = db.Column(db.Boolean, nullable=False)
@@ -0,0 +1,42 @@
+from .. import db
+from ..utils import iso_utc
+import datetime
+
+
+class DeviceSequence(db.Model):
+    """Per-device sequence high-water mark and reorder window (see services/sequence_tracker.py)."""
+    __tablename__ = 'device_sequences'
+
+    device_id = db.Column(db.String(64), primary_key=True)
+    high_water = db.Column(db.BigInteger, nullable=True) # Highest sequence number seen, None until the first
+    window = db.Column(db.BigInteger, nullable=False, default=0) # Bit i set: high_water - i was received
+    boot_seq = db.Column(db.BigInteger, nullable=True) # First sequence number of the device's current boot
+    received = db.Column(db.BigInteger, nullable=False, default=0)
+    duplicates = db.Column(db.BigInteger, nullable=False, default=0)
+    out_of_order = db.Column(db.BigInteger, nullable=False, default=0) # Stored, but arrived after a later one
+    stale = db.Column(db.BigInteger, nullable=False, default=0) # Older than the window: dropped
+    lost = db.Column(db.BigInteger, nullable=False, default=0) # Left the window without arriving
+    resets = db.Column(db.Integer, nullable=False, default=0) # Device counter went backwards (NVS erased)
+
+
+class SequenceGap(db.Model):
+    """A run of sequence numbers that left the reorder window without arriving."""
+    __tablename__ = 'sequence_gaps'
+
+    id = db.Column(db.Integer, primary_key=True)
+    device_id = db.Column(db.String(64), nullable=False)
+    first_seq = db.Column(db.BigInteger, nullable=False)
+    last_seq = db.Column(db.BigInteger, nullable=False)
+    detected_at = db.Column(db.DateTime, nullable=False, default=datetime.datetime.utcnow)
+
+    __table_args__ = (
+        db.Index('ix_sequence_gaps_device_id_id', 'device_id', 'id'),
+    )
+
+    def to_dict(self):
+        return {
+            'first_seq': self.first_seq,
+            'last_seq': self.last_seq,
+            'count': self.last_seq - self.first_seq + 1,
+            'detected_at': iso_utc(self.detected_at),
+        }
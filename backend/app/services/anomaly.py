@@ -0,0 +1,152 @@
+from flask import current_app
+
+from sqlalchemy import select
+from sqlalchemy.dialects import postgresql, sqlite
+
+from .. import db
+from ..models import Alert, DeviceStats, Reading
+
+# --- Streaming Anomaly Detection ---
+# Every stored reading updates one fixed-size statistics row of its device,
+# inside the ingest transaction: exponentially weighted moving averages
+# (EWMA, weight ANOMALY_EWMA_ALPHA for the newest reading) of the empty-pan
+# weight, the overload and instability ratios and the typical count step,
+# plus a few last-value fields. Nothing re-reads history, so the cost per
+# reading and the state per device are constant.
+# Alerts:
+#   zero_drift    empty-pan weight average beyond ANOMALY_ZERO_DRIFT_G (tare or load cell drift)
+#   overload      overload ratio above ANOMALY_OVERLOAD_RATIO
+#   unstable      instability ratio above ANOMALY_UNSTABLE_RATIO (vibration, mounting)
+#   stuck_sensor  a loaded pan reporting the very same weight ANOMALY_STUCK_READINGS times in a row;
+#                 a working load cell always shows some noise at 0.01 g
+#   count_drop    a count drop of at least ANOMALY_COUNT_DROP_MIN items and ANOMALY_COUNT_DROP_FACTOR
+#                 times the device's typical step (possible shrinkage); an event, never ongoing
+# Ongoing conditions raise one alert when they start and clear it once they
+# are back under half their threshold. Runs inside the caller's transaction.
+
+# Bit in DeviceStats.active_alerts per ongoing alert kind
+ONGOING_ALERTS = {'zero_drift': 1, 'overload': 2, 'unstable': 4, 'stuck_sensor': 8}
+
+ITEM_WEIGHT_TOLERANCE = 0.001 # Relative change that counts as a new piece weight
+
+
+def _insert(model):
+    """INSERT ... ON CONFLICT for the configured backend (SQLite stand-in or PostgreSQL)."""
+    dialect = postgresql if db.engine.dialect.name == 'postgresql' else sqlite
+    return dialect.insert(model)
+
+
+def _ewma(average, value, alpha):
+    return average + alpha * (value - average)
+
+
+def _raise(stats, kind, message, value, now, keep):
+    db.session.add(Alert(device_id=stats.device_id, kind=kind, message=message, value=value, raised_at=now))
+    current_app.logger.warning(f"Alert {kind} on {stats.device_id}: {message}")
+    db.session.flush()
+    # Keep only the newest `keep` alerts of this device
+    cutoff = db.session.scalar(select(Alert.id).where(Alert.device_id == stats.device_id)
+                               .order_by(Alert.id.desc()).offset(keep).limit(1))
+    if cutoff is not None:
+        db.session.execute(db.delete(Alert).where(Alert.device_id == stats.device_id, Alert.id <= cutoff))
+
+
+def _track(stats, kind, value, threshold, message, now, keep):
+    """Raises an ongoing alert when value exceeds threshold, clears it below half the threshold."""
+    bit = ONGOING_ALERTS[kind]
+    if not stats.active_alerts & bit and value > threshold:
+        stats.active_alerts |= bit
+        _raise(stats, kind, message, value, now, keep)
+    elif stats.active_alerts & bit and value < threshold / 2:
+        stats.active_alerts &= ~bit
+        db.session.execute(db.update(Alert)
+                           .where(Alert.device_id == stats.device_id, Alert.kind == kind, Alert.cleared_at.is_(None))
+                           .values(cleared_at=now))
+
+
+def observe(reading, now):
+    """Folds one stored reading (Reading.to_dict()) into its device's statistics; raises/clears alerts."""
+    config = current_app.config
+    alpha = config.get('ANOMALY_EWMA_ALPHA', 0.05)
+    zero_band = config.get('ANOMALY_ZERO_BAND_G', 5.0)
+    keep = config.get('ALERT_HISTORY_PER_DEVICE', 100)
+    device_id = reading['device_id']
+
+    # The insert takes the SQLite write lock up front; the row lock serializes a device's uploads on PostgreSQL
+    db.session.execute(_insert(DeviceStats)
+                       .values(device_id=device_id, readings=0, zero_ewma=0.0, overload_ewma=0.0,
+                               unstable_ewma=0.0, step_ewma=0.0, same_weight_run=0,
+                               item_weight_changes=0, active_alerts=0)
+                       .on_conflict_do_nothing(index_elements=['device_id']))
+    stats = db.session.get(DeviceStats, device_id, with_for_update=True, populate_existing=True)
+
+    weight = reading['weight_grams']
+    stable = reading['is_stable'] and not reading['is_overload']
+    warmed_up = stats.readings >= config.get('ANOMALY_WARMUP_READINGS', 20)
+    stats.readings += 1
+    stats.last_seen = now
+
+    stats.overload_ewma = _ewma(stats.overload_ewma, float(bool(reading['is_overload'])), alpha)
+    stats.unstable_ewma = _ewma(stats.unstable_ewma, float(not reading['is_stable']), alpha)
+    if stable and reading['item_count'] == 0 and abs(weight) <= zero_band:
+        stats.zero_ewma = _ewma(stats.zero_ewma, weight, alpha) # Empty pan: what it shows is drift
+
+    # Stuck sensor: bit-identical weights while something is on the pan
+    if abs(weight) > zero_band and weight == stats.last_weight:
+        stats.same_weight_run += 1
+    else:
+        stats.same_weight_run = 0
+    stats.last_weight = weight
+
+    # Piece weight changes make counts incomparable across the change
+    item_weight = reading.get('average_item_weight')
+    if reading['mode'] in Reading.COUNTING_MODES and item_weight:
+        if stats.item_weight is None or abs(item_weight - stats.item_weight) > ITEM_WEIGHT_TOLERANCE * stats.item_weight:
+            if stats.item_weight is not None:
+                stats.item_weight_changes += 1
+                stats.item_weight_changed_at = now
+                stats.last_count = None
+            stats.item_weight = item_weight
+
+    # Count drops against the device's own typical step between stable counting readings
+    if stable and reading['mode'] in Reading.COUNTING_MODES:
+        count = reading['item_count']
+        if stats.last_count is not None:
+            step = count - stats.last_count
+            drop_min = config.get('ANOMALY_COUNT_DROP_MIN', 5)
+            if warmed_up and -step >= drop_min and -step > config.get('ANOMALY_COUNT_DROP_FACTOR', 4.0) * stats.step_ewma:
+                _raise(stats, 'count_drop', f"Count fell from {stats.last_count} to {count} "
+                       f"(typical change {stats.step_ewma:.1f})", float(-step), now, keep)
+            stats.step_ewma = _ewma(stats.step_ewma, float(abs(step)), alpha)
+        stats.last_count = count
+
+    if warmed_up:
+        _track(stats, 'zero_drift', abs(stats.zero_ewma), config.get('ANOMALY_ZERO_DRIFT_G', 1.0),
+               f"Empty pan reads {stats.zero_ewma:+.2f} g on average", now, keep)
+        _track(stats, 'overload', stats.overload_ewma, config.get('ANOMALY_OVERLOAD_RATIO', 0.05),
+               f"{stats.overload_ewma:.0%} of readings in overload", now, keep)
+        _track(stats, 'unstable', stats.unstable_ewma, config.get('ANOMALY_UNSTABLE_RATIO', 0.5),
+               f"{stats.unstable_ewma:.0%} of readings unstable", now, keep)
+    stuck_after = config.get('ANOMALY_STUCK_READINGS', 360)
+    _track(stats, 'stuck_sensor', stats.same_weight_run + 1, stuck_after - 1,
+           f"Weight stuck at {weight:.2f} g for {stats.same_weight_run + 1} readings", now, keep)
+
+
+def get_stats(device_id):
+    """Current statistics of one device, or None if it has sent nothing yet."""
+    stats = db.session.get(DeviceStats, device_id)
+    if stats is None:
+        return None
+    result = stats.to_dict()
+    result['active_alerts'] = [kind for kind, bit in ONGOING_ALERTS.items() if stats.active_alerts & bit]
+    return result
+
+
+def get_alerts(device_id=None, active_only=False, limit=100):
+    """Recent alerts, newest first, for one device or the whole fleet."""
+    query = select(Alert)
+    if device_id is not None:
+        query = query.where(Alert.device_id == device_id)
+    if active_only:
+        query = query.where(Alert.cleared_at.is_(None), Alert.kind.in_(list(ONGOING_ALERTS)))
+    return [alert.to_dict() for alert in db.session.scalars(query.order_by(Alert.id.desc()).limit(limit))]
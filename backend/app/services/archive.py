@@ -0,0 +1,241 @@
+import bisect
+import datetime
+import itertools
+import json
+import os
+import struct
+import sys
+import zlib
+from array import array
+from urllib.parse import quote
+
+from flask import current_app
+from sqlalchemy import select
+
+from .. import db
+from ..models import ArchivePartition
+
+# --- Archive Tier ---
+# Readings older than the raw retention period (services/retention.py) live
+# in one compressed columnar file per device and UTC day, listed in the
+# archive_partitions table. A file is a magic, a JSON header and one zlib
+# block per column: ids, receive times and counts as deltas, floats
+# byte-shuffled (all first bytes, then all second bytes, ...) so the slowly
+# changing sign/exponent bytes compress away, flags and modes as single
+# bytes. Decoding is lossless, and a reader only inflates the columns it
+# asks for: paging through an export touches just the id and time columns.
+# Files are never modified; a rewrite gets a new name and the table row is
+# switched in the same transaction that deletes the raw rows, so readers
+# see every reading in exactly one tier.
+
+MAGIC = b'RCA1'
+FILE_VERSION = 1
+
+# Row tuples in this order, as export rows (services/export.py) plus the trace
+ARCHIVE_FIELDS = ('id', 'device_id', 'device_timestamp', 'server_timestamp', 'weight_grams', 'item_count',
+                  'is_stable', 'is_overload', 'average_item_weight', 'mode', 'trace')
+
+_EPOCH = datetime.datetime(1970, 1, 1)
+_MICROSECOND = datetime.timedelta(microseconds=1)
+_DAY = datetime.timedelta(days=1)
+_NO_TIMESTAMP = -2 ** 63 # device_offset_us of readings without a device timestamp
+
+# Bits of the flags column
+_STABLE = 1
+_OVERLOAD = 2
+_HAS_ITEM_WEIGHT = 4
+
+
+def _micros(ts):
+    return (ts - _EPOCH) // _MICROSECOND
+
+
+def _pack(typecode, values):
+    data = array(typecode, values)
+    if sys.byteorder == 'big':
+        data.byteswap() # Files are little-endian
+    return data.tobytes()
+
+
+def _unpack(typecode, raw):
+    data = array(typecode)
+    data.frombytes(raw)
+    if sys.byteorder == 'big':
+        data.byteswap()
+    return data
+
+
+def _deltas(values):
+    return [value - previous for previous, value in zip(itertools.chain((0,), values), values)]
+
+
+def _shuffle(raw, width):
+    return b''.join(raw[i::width] for i in range(width))
+
+
+def _unshuffle(raw, width):
+    count = len(raw) // width
+    out = bytearray(len(raw))
+    for i in range(width):
+        out[i::width] = raw[i * count:(i + 1) * count]
+    return bytes(out)
+
+
+def encode_partition(device_id, day, rows):
+    """File contents for one device-day; rows are tuples in ARCHIVE_FIELDS order, ascending id."""
+    (ids, _, device_ts, server_ts, weights, counts, stable, overload,
+     item_weights, modes, traces) = zip(*rows)
+    server_us = [_micros(ts) for ts in server_ts]
+    mode_names = sorted(set(modes))
+    mode_index = {mode: i for i, mode in enumerate(mode_names)}
+    flags = [(_STABLE if s else 0) | (_OVERLOAD if o else 0) | (_HAS_ITEM_WEIGHT if w is not None else 0)
+             for s, o, w in zip(stable, overload, item_weights)]
+    columns = (
+        ('id', 'delta', 'q', _pack('q', _deltas(ids))),
+        ('server_us', 'delta', 'q', _pack('q', _deltas(server_us))),
+        ('device_offset_us', 'plain', 'q', _pack('q', [_micros(d) - s if d else _NO_TIMESTAMP
+                                                       for d, s in zip(device_ts, server_us)])),
+        ('weight_grams', 'shuffle', 'd', _shuffle(_pack('d', weights), 8)),
+        ('item_count', 'delta', 'q', _pack('q', _deltas(counts))),
+        ('flags', 'plain', 'B', _pack('B', flags)),
+        ('average_item_weight', 'shuffle', 'd', _shuffle(_pack('d', [w if w is not None else 0.0
+                                                                     for w in item_weights]), 8)),
+        ('mode', 'plain', 'B', _pack('B', [mode_index[mode] for mode in modes])),
+        ('trace', 'json', None, json.dumps(traces, separators=(',', ':')).encode()),
+    )
+    header = {'version': FILE_VERSION, 'device_id': device_id, 'day': day.isoformat(),
+              'rows': len(ids), 'modes': mode_names, 'columns': []}
+    blocks = []
+    for name, codec, typecode, raw in columns:
+        block = zlib.compress(raw, 9)
+        header['columns'].append([name, codec, typecode, len(block)])
+        blocks.append(block)
+    head = json.dumps(header, separators=(',', ':')).encode()
+    return MAGIC + struct.pack('<I', len(head)) + head + b''.join(blocks)
+
+
+def decode_columns(data, names=None):
+    """(header, {column: values}) of a partition file, inflating only `names` (None: all)."""
+    if data[:4] != MAGIC:
+        raise ValueError("Not a readings archive file")
+    (head_length,) = struct.unpack_from('<I', data, 4)
+    header = json.loads(data[8:8 + head_length])
+    if header['version'] != FILE_VERSION:
+        raise ValueError(f"Unsupported archive version {header['version']}")
+    columns = {}
+    position = 8 + head_length
+    for name, codec, typecode, length in header['columns']:
+        if names is None or name in names:
+            raw = zlib.decompress(data[position:position + length])
+            if codec == 'json':
+                values = json.loads(raw)
+            else:
+                if codec == 'shuffle':
+                    raw = _unshuffle(raw, array(typecode).itemsize)
+                values = _unpack(typecode, raw)
+                if codec == 'delta':
+                    values = list(itertools.accumulate(values))
+            columns[name] = values
+        position += length
+    return header, columns
+
+
+def _archive_dir():
+    return current_app.config['ARCHIVE_DIR']
+
+
+def _read(partition, names=None):
+    with open(os.path.join(_archive_dir(), partition.path), 'rb') as f:
+        return decode_columns(f.read(), names)
+
+
+def _device_dir(device_id):
+    """Directory name for a device id; quote() keeps '.', so '.' and '..' are escaped too."""
+    name = quote(device_id, safe='')
+    if name and not name.strip('.'):
+        name = name.replace('.', '%2E') # Cannot collide: quote() escapes '%' itself
+    return name
+
+
+def write_partition(device_id, day, rows):
+    """Writes a new partition file (atomically, never over an existing one). Returns (relative path, bytes)."""
+    data = encode_partition(device_id, day, rows)
+    # A new name per rewrite (last id), so the file a committed table row points at never changes
+    relative = os.path.join(_device_dir(device_id), f'{day:%Y}', f'{day.isoformat()}.{rows[-1][0]}.rca')
+    path = os.path.join(_archive_dir(), relative)
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path + '.tmp', 'wb') as f:
+        f.write(data)
+        f.flush()
+        os.fsync(f.fileno())
+    os.replace(path + '.tmp', path)
+    return relative, len(data)
+
+
+def remove_file(relative):
+    """Deletes a partition file no table row points at (any more); a missing file is fine."""
+    try:
+        os.remove(os.path.join(_archive_dir(), relative))
+    except FileNotFoundError:
+        pass
+
+
+def partitions(device_id, after_id=0, start=None, end=None, newest_first=False):
+    """Archive partitions of a device that may hold readings with id > after_id received in [start, end)."""
+    query = select(ArchivePartition).where(ArchivePartition.device_id == device_id,
+                                           ArchivePartition.max_id > after_id)
+    if start:
+        query = query.where(ArchivePartition.day >= start.date())
+    if end:
+        query = query.where(ArchivePartition.day <= (end - _MICROSECOND).date())
+    order = ArchivePartition.day.desc() if newest_first else ArchivePartition.day
+    return db.session.scalars(query.order_by(order)).all()
+
+
+def covers_whole(partition, after_id=0, start=None, end=None):
+    """True if every reading of the partition passes the filters (its row_count can be used as is)."""
+    day_start = datetime.datetime.combine(partition.day, datetime.time())
+    return (partition.min_id > after_id and (not start or day_start >= start)
+            and (not end or day_start + _DAY <= end))
+
+
+def _time_filter(server_us, start, end):
+    start_us = _micros(start) if start else None
+    end_us = _micros(end) if end else None
+    return lambda i: ((start_us is None or server_us[i] >= start_us)
+                      and (end_us is None or server_us[i] < end_us))
+
+
+def read_ids(partition, after_id=0, start=None, end=None):
+    """Ids of the partition's readings that pass the filters, ascending; inflates two columns."""
+    _, columns = _read(partition, ('id', 'server_us'))
+    ids = columns['id']
+    keep = _time_filter(columns['server_us'], start, end)
+    return [ids[i] for i in range(bisect.bisect_right(ids, after_id), len(ids)) if keep(i)]
+
+
+def read_rows(partition, after_id=0, start=None, end=None, until_id=None):
+    """The partition's readings that pass the filters as ARCHIVE_FIELDS tuples, ascending id."""
+    header, columns = _read(partition)
+    ids = columns['id']
+    server_us = columns['server_us']
+    keep = _time_filter(server_us, start, end)
+    first = bisect.bisect_right(ids, after_id)
+    last = len(ids) if until_id is None else bisect.bisect_right(ids, until_id)
+    modes = header['modes']
+    rows = []
+    for i in range(first, last):
+        if not keep(i):
+            continue
+        offset = columns['device_offset_us'][i]
+        flags = columns['flags'][i]
+        rows.append((
+            ids[i], header['device_id'],
+            _EPOCH + (server_us[i] + offset) * _MICROSECOND if offset != _NO_TIMESTAMP else None,
+            _EPOCH + server_us[i] * _MICROSECOND,
+            columns['weight_grams'][i], columns['item_count'][i],
+            bool(flags & _STABLE), bool(flags & _OVERLOAD),
+            columns['average_item_weight'][i] if flags & _HAS_ITEM_WEIGHT else None,
+            modes[columns['mode'][i]], columns['trace'][i],
+        ))
+    return rows
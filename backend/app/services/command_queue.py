@@ -0,0 +1,243 @@
+import datetime
+import ipaddress
+import json
+import math
+import re
+import threading
+import time
+
+from sqlalchemy import select
+
+from .. import db
+from ..models import Command
+
+# --- Per-device Command Downlink ---
+# Commands are queued here and piggybacked on the response to the device's
+# next reading upload (or returned by the optional long-poll). They stay
+# pending, and are re-delivered, until the device acknowledges them in a
+# later upload. The queue is the commands table, so a command queued through
+# one worker is delivered by whichever worker the device reaches next.
+
+# Supported commands and their required argument names
+COMMAND_ARGS = {
+    'tare': (),
+    'set_piece_weight': ('grams',),
+    'set_sku': ('sku', 'grams'),
+    'set_report_interval': ('seconds',),
+    'start_trace': ('seconds',),
+    'calibrate_point': ('grams',), # Capture the reference weight now on the platform
+    'calibrate_save': (),
+    'calibrate_clear': (),
+    'set_check_target': ('sku', 'target', 'under', 'over'), # Check-weighing band of a product
+    'calibrate_corner': ('corner',), # Capture the test weight now on this corner (load cell channel)
+    'calibrate_corner_save': (),
+}
+
+# Arguments a command may carry in addition to the required ones
+OPTIONAL_ARGS = {
+    'start_trace': ('host', 'port'), # Raw stream collector (IPv4); device default if omitted
+    'set_check_target': ('unit',),   # 'g' (default) or 'count' (items of the piece weight)
+}
+
+MAX_COMMANDS_PER_RESPONSE = 4 # Keep replies within the device's response buffer
+DEVICE_REPLY_BUFFER_BYTES = 512 # Device API_RESPONSE_BUFFER_SIZE (HTTP reply and MQTT command message)
+REPLY_ENVELOPE_BYTES = 224      # Rest of the /reading reply (message, device id, timestamps) or the MQTT wrapper
+MAX_SKU_LENGTH = 15           # Matches the device-side SKU field
+# The device puts the SKU into its JSON payloads unescaped; same set it accepts
+SKU_PATTERN = re.compile(r'[A-Za-z0-9._-]+')
+DEVICE_CAPACITY_G = 5000.0    # Device MAX_WEIGHT_CAPACITY_G: upper bound of gram arguments
+MAX_CHECK_COUNT = 100000      # Upper bound of item-count check targets
+MAX_DELIVERIES = 20           # A command never acked after this many deliveries expires (unblocks the queue)
+
+STATUS_PENDING = 'pending'
+STATUS_ACKED = 'acked'
+STATUS_REJECTED = 'rejected'
+STATUS_EXPIRED = 'expired'
+
+COMPLETED_HISTORY = 50      # Acked/rejected commands kept per device
+LONG_POLL_RECHECK_SECONDS = 0.5 # Long-poll re-reads the table this often (commands queued by other workers)
+
+# Wakes long-polls in this process early when a command is queued here
+_condition = threading.Condition()
+
+
+def _number(args, name, upper):
+    """float(args[name]), rejecting NaN/infinity (not valid JSON for the device) and values above upper."""
+    value = float(args[name])
+    if not math.isfinite(value) or value > upper:
+        raise ValueError(f"'{name}' must be a finite number up to {upper:g}")
+    return value
+
+
+def _normalize(command, args):
+    """Validates arguments and returns them with device-friendly types."""
+    if not isinstance(args, dict):
+        raise ValueError("'args' must be an object")
+    if command not in COMMAND_ARGS:
+        raise ValueError(f"Unknown command '{command}'. Supported: {', '.join(COMMAND_ARGS)}")
+    missing = [name for name in COMMAND_ARGS[command] if name not in args]
+    if missing:
+        raise ValueError(f"Command '{command}' is missing argument(s): {', '.join(missing)}")
+
+    normalized = {}
+    try:
+        if 'grams' in COMMAND_ARGS[command]:
+            normalized['grams'] = _number(args, 'grams', DEVICE_CAPACITY_G)
+            if not normalized['grams'] > 0:
+                raise ValueError("'grams' must be positive")
+        if 'target' in COMMAND_ARGS[command]:
+            upper = MAX_CHECK_COUNT if args.get('unit') == 'count' else DEVICE_CAPACITY_G
+            for name in ('target', 'under', 'over'):
+                normalized[name] = _number(args, name, upper)
+            if not 0 <= normalized['under'] < normalized['target'] or not normalized['over'] >= 0:
+                raise ValueError("'target' must be positive and 'under'/'over' non-negative, 'under' below 'target'")
+        if 'corner' in COMMAND_ARGS[command]:
+            normalized['corner'] = int(args['corner'])
+            if normalized['corner'] < 0:
+                raise ValueError("'corner' must be a channel number (0 or more)")
+        if 'seconds' in COMMAND_ARGS[command]:
+            normalized['seconds'] = int(args['seconds'])
+            if not 0 < normalized['seconds'] <= 86400:
+                raise ValueError("'seconds' must be between 1 and 86400")
+    except TypeError as e:
+        raise ValueError(f"Invalid argument type: {e}")
+    if 'sku' in COMMAND_ARGS[command]:
+        normalized['sku'] = str(args['sku'])
+        if not 0 < len(normalized['sku']) <= MAX_SKU_LENGTH:
+            raise ValueError(f"'sku' must be 1-{MAX_SKU_LENGTH} characters")
+        if not SKU_PATTERN.fullmatch(normalized['sku']):
+            raise ValueError("'sku' may only contain letters, digits, '.', '_' and '-'")
+
+    optional = OPTIONAL_ARGS.get(command, ())
+    if 'host' in optional and args.get('host') is not None:
+        try:
+            normalized['host'] = str(ipaddress.IPv4Address(str(args['host'])))
+        except ValueError:
+            raise ValueError("'host' must be an IPv4 address")
+    if 'unit' in optional and args.get('unit') is not None:
+        normalized['unit'] = str(args['unit'])
+        if normalized['unit'] not in ('g', 'count'):
+            raise ValueError("'unit' must be 'g' or 'count'")
+    if 'port' in optional and args.get('port') is not None:
+        try:
+            normalized['port'] = int(args['port'])
+        except (TypeError, ValueError):
+            raise ValueError("'port' must be an integer")
+        if not 0 < normalized['port'] <= 65535:
+            raise ValueError("'port' must be between 1 and 65535")
+    return normalized
+
+
+def queue_command(device_id, command, args=None):
+    """Validates and queues a command. Raises ValueError on bad input."""
+    args = _normalize(command, {} if args is None else args)
+    entry = Command(device_id=device_id, cmd=command, args=args, status=STATUS_PENDING,
+                    queued_at=datetime.datetime.utcnow(), delivered_count=0)
+    db.session.add(entry)
+    db.session.commit()
+    with _condition:
+        _condition.notify_all() # Wake any long-poll waiting in this process
+    return entry.to_dict()
+
+
+def _pending(device_id, limit=MAX_COMMANDS_PER_RESPONSE):
+    return db.session.scalars(select(Command)
+                              .where(Command.device_id == device_id, Command.status == STATUS_PENDING)
+                              .order_by(Command.id).limit(limit)).all()
+
+
+def _wire_format(command):
+    """Compact form sent to the device."""
+    return {'id': command.id, 'cmd': command.cmd, 'args': command.args}
+
+
+def _fit_reply(batch):
+    """
+    Leading commands of batch whose serialized list fits the device's reply
+    buffer. A reply that does not fit is truncated on the device, fails to
+    parse and is never acked, so the rest waits for the next reply. The first
+    command always goes (any single command is far below the budget).
+    """
+    budget = DEVICE_REPLY_BUFFER_BYTES - 1 - REPLY_ENVELOPE_BYTES # Terminator
+    size = 2 # []
+    for count, command in enumerate(batch):
+        size += len(json.dumps(_wire_format(command), separators=(',', ':'))) + (1 if count else 0)
+        if count and size > budget:
+            return batch[:count]
+    return batch
+
+
+def _expire_undelivered(device_id):
+    """
+    Gives up on commands the device was sent MAX_DELIVERIES times without an
+    ack (e.g. a reply it cannot parse); delivery is in id order, so one such
+    command would otherwise hold back every later one.
+    """
+    result = db.session.execute(db.update(Command)
+                                .where(Command.device_id == device_id, Command.status == STATUS_PENDING,
+                                       Command.delivered_count >= MAX_DELIVERIES)
+                                .values(status=STATUS_EXPIRED, completed_at=datetime.datetime.utcnow()))
+    if result.rowcount:
+        db.session.commit()
+
+
+def take_pending_for_delivery(device_id, wait_seconds=0):
+    """
+    Returns up to MAX_COMMANDS_PER_RESPONSE pending commands in wire format,
+    as many as fit the device's reply buffer.
+    If wait_seconds > 0 and nothing is pending, blocks until a command is queued
+    or the timeout expires (long-poll).
+    """
+    deadline = time.monotonic() + wait_seconds
+    _expire_undelivered(device_id)
+    batch = _pending(device_id)
+    while not batch and time.monotonic() < deadline:
+        db.session.rollback() # End the read transaction so the next query sees new rows
+        with _condition:
+            _condition.wait(timeout=min(LONG_POLL_RECHECK_SECONDS, max(0.0, deadline - time.monotonic())))
+        batch = _pending(device_id)
+    if not batch:
+        db.session.rollback()
+        return []
+    batch = _fit_reply(batch)
+    db.session.execute(db.update(Command).where(Command.id.in_([c.id for c in batch]))
+                       .values(delivered_count=Command.delivered_count + 1))
+    db.session.commit()
+    return [_wire_format(c) for c in batch]
+
+
+def acknowledge(device_id, acked_ids=(), rejected_ids=()):
+    """
+    Marks commands completed by the device. Unknown ids are ignored.
+    Runs in the caller's transaction (the reading that carried the acks).
+    """
+    outcomes = {int(i): STATUS_ACKED for i in acked_ids}
+    outcomes.update({int(i): STATUS_REJECTED for i in rejected_ids})
+    if not outcomes:
+        return 0
+    now = datetime.datetime.utcnow()
+    updated = 0
+    for status in (STATUS_ACKED, STATUS_REJECTED):
+        ids = [command_id for command_id, outcome in outcomes.items() if outcome == status]
+        if ids:
+            result = db.session.execute(db.update(Command)
+                                        .where(Command.device_id == device_id, Command.id.in_(ids),
+                                               Command.status == STATUS_PENDING)
+                                        .values(status=status, completed_at=now))
+            updated += result.rowcount
+
+    if updated:
+        # Completed commands are kept only as a short history
+        cutoff = db.session.scalar(select(Command.id)
+                                   .where(Command.device_id == device_id, Command.status != STATUS_PENDING)
+                                   .order_by(Command.id.desc()).offset(COMPLETED_HISTORY).limit(1))
+        if cutoff is not None:
+            db.session.execute(db.delete(Command).where(Command.device_id == device_id,
+                                                        Command.status != STATUS_PENDING, Command.id <= cutoff))
+    return updated
+
+
+def list_commands(device_id):
+    """All known commands for a device (pending and recent history)."""
+    return [c.to_dict() for c in db.session.scalars(select(Command).where(Command.device_id == device_id)
+                                                    .order_by(Command.id))]
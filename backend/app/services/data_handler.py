@@ -1,33 +1,438 @@
 from flask import current_app
 import datetime
-import json
+import time
 
-# --- Uncomment if using SQLAlchemy models ---
-# from .. import db
-# from ..models.reading import Reading
-# from sqlalchemy.exc import SQLAlchemyError
+from sqlalchemy import func, select, update
+from sqlalchemy.exc import SQLAlchemyError
 
+from .. import db
+from ..models import HealthRecord, Lot, Reading
+from ..utils import iso_utc
+from . import anomaly, archive, command_queue, export, latency, recount, rollups, sequence_tracker
 
-# --- Placeholder Data Store (Replace with actual DB logic) ---
-# WARNING: This in-memory store is NOT persistent and NOT suitable for production!
-IN_MEMORY_READINGS_STORE = {} # Dictionary where keys are device_ids
+# --- Shared Store ---
+# Every request reads and writes the database only; nothing is kept in
+# process memory between requests, so any number of workers (and the MQTT
+# bridge process) can ingest side by side. Each reading is one transaction
+# whose first statement is a write (sequence state or the row insert), so on
+# SQLite it takes the write lock up front instead of upgrading a read
+# snapshot later. Traced readings get one more statement once committed
+# (the 'stored' latency stamp must come after the commit).
 
-def process_and_store_reading(data):
+# Order of the per-task arrays in device health records (firmware AppTaskId_t)
+HEALTH_TASKS = ('sensor', 'ui', 'comms')
+# Order of the check-weighing array ("chk"); latencies are pack arrival -> decision
+HEALTH_CHECKWEIGH = ('decisions', 'rejects', 'early', 'latency_mean_ms', 'latency_max_ms')
+
+# Fields every reading must carry, whichever transport (HTTP, MQTT) delivered it
+READING_REQUIRED_FIELDS = ("device_id", "weight_grams", "item_count", "is_stable", "is_overload", "mode")
+
+# process_and_store_reading message for a retransmitted reading (already stored, nothing written)
+DUPLICATE_READING = "Duplicate reading ignored"
+
+# Fields of a closed accumulation lot (firmware CommsManager_SendLot)
+LOT_REQUIRED_FIELDS = ("device_id", "lot_id", "total", "loads")
+
+# process_and_store_lot message for a lot already stored (retransmission)
+DUPLICATE_LOT = "Duplicate lot ignored"
+
+# Bulk export formats and their media types
+EXPORT_FORMATS = export.EXPORT_FORMATS
+
+def validate_reading(data):
+    """
+    Checks an incoming reading for required fields.
+    Returns a {field: message} dict, empty if the reading is valid.
+    """
+    return {field: f"Missing required field: {field}" for field in READING_REQUIRED_FIELDS if field not in data}
+
+
+# Numeric device timestamps below this are uptime ticks from firmware without SNTP, not epoch ms
+MIN_EPOCH_MS = 1577836800000 # 2020-01-01T00:00:00Z
+
+
+def parse_device_timestamp(value):
+    """
+    Device timestamp -> naive UTC datetime, or None if absent / not wall-clock.
+    SNTP-synced firmware sends epoch milliseconds as a number; older firmware
+    sent uptime ticks as a string, which cannot be placed in time.
+    """
+    if value is None or value == '' or isinstance(value, bool):
+        return None
+    if isinstance(value, str) and value.isdigit():
+        value = int(value)
+    if isinstance(value, (int, float)):
+        if value < MIN_EPOCH_MS:
+            return None
+        return datetime.datetime.utcfromtimestamp(value / 1000.0)
+    parsed = datetime.datetime.fromisoformat(str(value).replace('Z', '+00:00'))
+    if parsed.tzinfo is not None:
+        parsed = parsed.astimezone(datetime.timezone.utc).replace(tzinfo=None)
+    return parsed
+
+
+def process_and_store_reading(data, received_ms=None):
     """
     Processes incoming reading data and stores it.
+    received_ms: arrival time (epoch ms) taken by the transport, for latency tracing.
+    Readings carrying a device sequence number ("seq") are stored at most once;
+    a retransmission returns (True, DUPLICATE_READING).
     Returns (True, "Success message") or (False, "Error message").
     """
     device_id = data.get("device_id")
     current_app.logger.debug(f"Processing reading for device: {device_id}")
+    if received_ms is None:
+        received_ms = int(time.time() * 1000)
 
     try:
+        # --- Duplicate suppression (services/sequence_tracker.py) ---
+        if data.get('seq') is not None:
+            config = current_app.config
+            is_new = sequence_tracker.accept(device_id, data['seq'], boot_seq=data.get('boot_seq'),
+                                             window_size=config.get('SEQUENCE_REORDER_WINDOW', 32),
+                                             gap_history=config.get('SEQUENCE_GAP_HISTORY', 100))
+            if not is_new:
+                # Nothing to store, but the retransmission may carry acks the original lost
+                command_queue.acknowledge(device_id,
+                                          acked_ids=data.get('acked_commands') or (),
+                                          rejected_ids=data.get('rejected_commands') or ())
+                db.session.commit()
+                current_app.logger.debug(f"Duplicate reading {data['seq']} from device {device_id} ignored")
+                return True, DUPLICATE_READING
+
         # --- Data Cleaning/Transformation (Example) ---
-        # Attempt to parse timestamp if provided
-        device_ts = None
-        if data.get('timestamp'):
-            try:
-                # Handle different potential timestamp formats (e.g., ticks or ISO)
-                if isinstance(data['timestamp'], (int, float)): # Assume ticks if numeric
-                     device_ts = datetime.datetime.utcfromtimestamp(data['timestamp'] / 1000.0) # Assuming ms ticks
-                else: # Assume ISO format string
-                     device_ts = datetime.datetime.fromisoformat(str(data['timestamp']).replace('Z
+        try:
+            device_ts = parse_device_timestamp(data.get('timestamp'))
+        except (ValueError, TypeError, OverflowError, OSError) as e:
+            current_app.logger.warning(f"Could not parse device timestamp '{data['timestamp']}': {e}")
+            device_ts = None
+
+        # Latency trace: device stamps plus our own receive / store times
+        trace = latency.parse_trace(data.get('trace'), sent=data.get('sent'))
+        if trace:
+            trace['received'] = received_ms
+
+        server_ts = datetime.datetime.utcnow()
+        row = Reading(
+            device_id=device_id,
+            device_timestamp=device_ts,
+            server_timestamp=server_ts,
+            weight_grams=float(data['weight_grams']),
+            item_count=int(data['item_count']),
+            is_stable=bool(data['is_stable']),
+            is_overload=bool(data['is_overload']),
+            average_item_weight=data.get('average_item_weight'),
+            mode=data['mode'],
+        )
+        if trace:
+            row.trace = trace # 'stored' is stamped once the row is committed
+
+        # --- Store ---
+        db.session.add(row)
+        db.session.flush()
+
+        # --- Maintain pre-aggregated rollups at ingest time ---
+        # Bucketed on server receive time, which is always present and monotonic per device.
+        rollups.update_rollups(row.to_dict(), server_ts)
+
+        # --- Online per-device statistics and alerts (services/anomaly.py) ---
+        anomaly.observe(row.to_dict(), server_ts)
+
+        # --- Device acknowledgements for previously delivered commands ---
+        command_queue.acknowledge(device_id,
+                                  acked_ids=data.get('acked_commands') or (),
+                                  rejected_ids=data.get('rejected_commands') or ())
+
+        # Live stream subscribers pick the row up from the table (services/stream_broker.py)
+        row_id = row.id
+        db.session.commit()
+    except (KeyError, ValueError, TypeError) as e:
+        db.session.rollback()
+        current_app.logger.warning(f"Invalid reading data for device {device_id}: {e}")
+        return False, f"Invalid reading data: {e}"
+    except Exception as e:
+        db.session.rollback()
+        current_app.logger.exception(f"Error storing reading for device {device_id}")
+        return False, "Error storing reading"
+
+    if trace:
+        # The reading is stored either way: losing the stamp only drops it from the ingest stages
+        trace['stored'] = int(time.time() * 1000)
+        try:
+            db.session.execute(update(Reading).where(Reading.id == row_id).values(trace=trace))
+            db.session.commit()
+        except SQLAlchemyError:
+            db.session.rollback()
+            current_app.logger.warning(f"Could not stamp the storage time of reading {row_id}")
+    return True, "Reading stored successfully"
+
+
+def get_device_readings(device_id, limit=20):
+    """
+    Returns the most recent readings (newest first) for a device, continuing
+    into the archive tier when the raw table holds fewer than `limit`.
+    """
+    if limit <= 0:
+        return []
+    rows = db.session.scalars(select(Reading).where(Reading.device_id == device_id)
+                              .order_by(Reading.id.desc()).limit(limit))
+    readings = [row.to_dict() for row in rows]
+    for partition in archive.partitions(device_id, newest_first=True) if len(readings) < limit else ():
+        for row in reversed(archive.read_rows(partition)):
+            readings.append(_archived_reading(row))
+            if len(readings) == limit:
+                return readings
+    return readings
+
+
+def _archived_reading(row):
+    """An archive.ARCHIVE_FIELDS tuple in Reading.to_dict() form."""
+    record = dict(zip(archive.ARCHIVE_FIELDS[1:], row[1:]))
+    record['device_timestamp'] = iso_utc(record['device_timestamp'])
+    record['server_timestamp'] = iso_utc(record['server_timestamp'])
+    if not record['trace']:
+        del record['trace']
+    return record
+
+
+def export_readings(device_id, fmt='ndjson', start=None, end=None, after_id=0, limit=None, compress=False):
+    """
+    Streams a device's readings in id order (see services/export.py).
+    start/end: naive UTC datetimes bounding server_timestamp; after_id: resume
+    after this reading id; limit: rows in this page (None: everything).
+    Returns (next_cursor or None, iterator of byte chunks, gzip if compress).
+    Raises ValueError for an unknown format.
+    """
+    if fmt not in EXPORT_FORMATS:
+        raise ValueError(f"Unknown format '{fmt}'. Use one of: {', '.join(EXPORT_FORMATS)}")
+    config = current_app.config
+    until_id = export.page_end(device_id, after_id, start, end, limit)
+    next_cursor = export.encode_cursor(until_id, start, end) if until_id is not None else None
+    rows = export.iter_rows(device_id, after_id, start, end, until_id=until_id,
+                            fetch_size=config.get('EXPORT_FETCH_SIZE', 1000))
+    chunks = export.format_rows(rows, fmt, chunk_bytes=config.get('EXPORT_CHUNK_BYTES', 65536))
+    if compress:
+        return next_cursor, export.gzip_chunks(chunks)
+    return next_cursor, (chunk.encode() for chunk in chunks)
+
+
+def decode_export_cursor(token):
+    """Export page token -> (after_id, start, end). Raises ValueError if malformed."""
+    return export.decode_cursor(token)
+
+
+def get_latency_summary(device_id=None):
+    """
+    Sample-to-storage latency distributions per stage (see services/latency.py),
+    for one device or for the whole fleet.
+    """
+    return latency.get_summary(device_id, window=current_app.config.get('LATENCY_SAMPLES_PER_DEVICE', 1000))
+
+
+def get_sequence_status(device_id=None):
+    """
+    Sequence number accounting (duplicates dropped, gaps detected) for one
+    device, or for every device if device_id is None. None if the device is unknown.
+    """
+    return sequence_tracker.get_status(device_id, window_size=current_app.config.get('SEQUENCE_REORDER_WINDOW', 32))
+
+
+def get_alerts(device_id=None, active_only=False, limit=100):
+    """
+    Returns recent anomaly alerts (newest first) for one device or the whole
+    fleet; active_only keeps ongoing conditions that have not cleared.
+    """
+    return anomaly.get_alerts(device_id, active_only=active_only, limit=limit)
+
+
+def get_device_stats(device_id):
+    """Online ingest statistics of a device (see services/anomaly.py), None if unknown."""
+    return anomaly.get_stats(device_id)
+
+
+def get_rollups(resolution, device_ids=None, start=None, end=None):
+    """
+    Returns pre-aggregated per-device buckets (see services/rollups.py).
+    """
+    return rollups.get_rollups(resolution, device_ids=device_ids, start=start, end=end)
+
+
+def recount_readings(device_id, item_weight_g, start=None, end=None):
+    """
+    Recomputes stored counts of a device for a corrected item weight, with the
+    scale's own counting code (see services/recount.py). Returns a summary dict.
+    Raises ValueError for an invalid item weight.
+    """
+    return recount.recount_readings(device_id, item_weight_g, start=start, end=end)
+
+
+def queue_command(device_id, command, args=None):
+    """
+    Queues a command for delivery in the response to the device's next upload.
+    Raises ValueError for unknown commands or invalid arguments.
+    """
+    return command_queue.queue_command(device_id, command, args)
+
+
+def get_commands_for_device(device_id, wait_seconds=0):
+    """
+    Returns pending commands (compact wire format) to hand to the device.
+    wait_seconds > 0 turns this into a long-poll.
+    """
+    return command_queue.take_pending_for_delivery(device_id, wait_seconds=wait_seconds)
+
+
+def acknowledge_commands(device_id, acked_ids=None, rejected_ids=None):
+    """
+    Records command acks that arrived on their own (once per MQTT batch, not
+    with a reading). Returns the number of commands completed.
+    """
+    try:
+        updated = command_queue.acknowledge(device_id, acked_ids=acked_ids or (), rejected_ids=rejected_ids or ())
+        db.session.commit()
+        return updated
+    except (ValueError, TypeError) as e:
+        db.session.rollback()
+        current_app.logger.warning(f"Invalid command acks from device {device_id}: {e}")
+    except SQLAlchemyError:
+        db.session.rollback()
+        current_app.logger.exception(f"Error storing command acks for device {device_id}")
+    return 0
+
+
+def list_device_commands(device_id):
+    """Returns pending and recently completed commands for a device."""
+    return command_queue.list_commands(device_id)
+
+
+def _per_task(values):
+    """Maps a compact per-task array onto HEALTH_TASKS names."""
+    return {name: int(value) for name, value in zip(HEALTH_TASKS, values or ())}
+
+
+def process_and_store_health(data):
+    """
+    Expands a compact device health record and stores it.
+    Returns (True, "Success message") or (False, "Error message").
+    """
+    device_id = data.get("device_id")
+    try:
+        record = {
+            'device_id': device_id,
+            'server_timestamp': datetime.datetime.utcnow().isoformat() + 'Z',
+            'firmware_version': str(data['fw']),
+            'uptime_s': int(data['up']),
+            'task_cpu_pct': _per_task(data.get('cpu')),
+            'core_idle_pct': [int(v) for v in data.get('idle') or ()],
+            'stack_min_free': _per_task(data.get('stk')),
+            'heap_free': int(data['heap']),
+            'heap_min_free': int(data['heap_min']),
+            'heap_fragmentation_pct': int(data.get('frag', 0)),
+            'sensor_deadline_misses': int(data.get('miss', 0)),
+            'sensor_jitter_max_us': int(data.get('jit', 0)),
+            'wifi_rssi': int(data.get('rssi', 0)),
+            'wifi_reconnects': int(data.get('recon', 0)),
+            'checkweigh': {name: int(value) for name, value in zip(HEALTH_CHECKWEIGH, data.get('chk') or ())},
+        }
+    except (KeyError, ValueError, TypeError) as e:
+        current_app.logger.warning(f"Invalid health data for device {device_id}: {e}")
+        return False, f"Invalid health data: {e}"
+
+    keep = current_app.config.get('HEALTH_HISTORY_PER_DEVICE', 288)
+    try:
+        db.session.add(HealthRecord(device_id=device_id, firmware_version=record['firmware_version'], record=record))
+        db.session.flush()
+        # Keep only the newest HEALTH_HISTORY_PER_DEVICE records of this device
+        cutoff = db.session.scalar(select(HealthRecord.id).where(HealthRecord.device_id == device_id)
+                                   .order_by(HealthRecord.id.desc()).offset(keep).limit(1))
+        if cutoff is not None:
+            db.session.execute(db.delete(HealthRecord).where(HealthRecord.device_id == device_id,
+                                                             HealthRecord.id <= cutoff))
+        db.session.commit()
+    except SQLAlchemyError:
+        db.session.rollback()
+        current_app.logger.exception(f"Database error storing health record for device {device_id}")
+        return False, "Error storing health record"
+    return True, "Health record stored successfully"
+
+
+def process_and_store_lot(data):
+    """
+    Stores a closed accumulation lot. A resend of a stored lot (same lot_id
+    and contents) returns (True, DUPLICATE_LOT); the same lot_id with other
+    contents is kept as a new lot (the device's numbering restarted).
+    Returns (True, "Success message") or (False, "Error message").
+    """
+    device_id = data.get("device_id")
+    try:
+        lot = Lot(
+            device_id=device_id,
+            lot_id=int(data['lot_id']),
+            sku=str(data.get('sku') or '') or None,
+            item_weight=float(data['item_weight']) if data.get('item_weight') else None,
+            total=int(data['total']),
+            loads=int(data['loads']),
+            closed_at=parse_device_timestamp(data.get('closed')),
+            received_at=datetime.datetime.utcnow(),
+        )
+    except (KeyError, ValueError, TypeError, OverflowError, OSError) as e:
+        current_app.logger.warning(f"Invalid lot data for device {device_id}: {e}")
+        return False, f"Invalid lot data: {e}"
+
+    try:
+        stored = db.session.execute(select(Lot.total, Lot.loads, Lot.closed_at)
+                                    .where(Lot.device_id == device_id, Lot.lot_id == lot.lot_id)).all()
+        if (lot.total, lot.loads, lot.closed_at) in [tuple(row) for row in stored]:
+            return True, DUPLICATE_LOT
+        if stored:
+            current_app.logger.warning(f"Device {device_id} reused lot number {lot.lot_id}; stored as a new lot")
+        db.session.add(lot)
+        db.session.commit()
+    except SQLAlchemyError:
+        db.session.rollback()
+        current_app.logger.exception(f"Database error storing lot for device {device_id}")
+        return False, "Error storing lot"
+    current_app.logger.info(f"Lot {lot.lot_id} from {device_id}: {lot.total} items in {lot.loads} loads")
+    return True, "Lot stored successfully"
+
+
+def get_device_lots(device_id, limit=20):
+    """Returns the most recently received lots (newest first) for a device."""
+    if limit <= 0:
+        return []
+    rows = db.session.scalars(select(Lot).where(Lot.device_id == device_id).order_by(Lot.id.desc()).limit(limit))
+    return [row.to_dict() for row in rows]
+
+
+def get_device_health(device_id, limit=20):
+    """Returns the most recent health records (newest first) for a device."""
+    if limit <= 0:
+        return []
+    rows = db.session.scalars(select(HealthRecord.record).where(HealthRecord.device_id == device_id)
+                              .order_by(HealthRecord.id.desc()).limit(limit))
+    return list(rows)
+
+
+def get_fleet_health_summary():
+    """
+    Groups the latest health record of every device by firmware version,
+    so regressions introduced by a release stand out.
+    """
+    latest_ids = select(func.max(HealthRecord.id)).group_by(HealthRecord.device_id)
+    summary = {}
+    for latest in db.session.scalars(select(HealthRecord.record).where(HealthRecord.id.in_(latest_ids))
+                                     .order_by(HealthRecord.device_id)):
+        device_id = latest['device_id']
+        group = summary.setdefault(latest['firmware_version'], {
+            'device_count': 0, 'heap_min_free_min': None,
+            'sensor_deadline_misses_total': 0, 'sensor_jitter_max_us': 0,
+            'wifi_reconnects_total': 0, 'devices': [],
+        })
+        group['device_count'] += 1
+        group['devices'].append(device_id)
+        if group['heap_min_free_min'] is None or latest['heap_min_free'] < group['heap_min_free_min']:
+            group['heap_min_free_min'] = latest['heap_min_free']
+        group['sensor_deadline_misses_total'] += latest['sensor_deadline_misses']
+        group['sensor_jitter_max_us'] = max(group['sensor_jitter_max_us'], latest['sensor_jitter_max_us'])
+        group['wifi_reconnects_total'] += latest['wifi_reconnects']
+    return summary
@@ -0,0 +1,157 @@
+import base64
+import csv
+import datetime
+import io
+import json
+import zlib
+
+from sqlalchemy import select
+
+from .. import db
+from ..models import Reading
+from ..utils import iso_utc
+from . import archive
+
+# --- Streaming Export ---
+# Bulk export of a device's readings (ERP reconciliation) as NDJSON or CSV.
+# Rows come from a server-side cursor (yield_per: a named cursor on
+# PostgreSQL, incremental fetches on SQLite) and leave as ~64 KB chunks,
+# optionally gzip-compressed on the fly, so memory stays constant whatever
+# the row count. Rows are in id order and carry their id: a page limit
+# gives a keyset cursor token for the next page, and a broken download
+# resumes with after=<last id received>.
+# Compacted history comes first from the archive tier (services/archive.py,
+# one device-day file at a time; with a monotonic server clock their ids
+# all precede the raw rows).
+
+EXPORT_FORMATS = {
+    'ndjson': 'application/x-ndjson',
+    'csv': 'text/csv',
+}
+
+EXPORT_COLUMNS = (Reading.id, Reading.device_id, Reading.device_timestamp, Reading.server_timestamp,
+                  Reading.weight_grams, Reading.item_count, Reading.is_stable, Reading.is_overload,
+                  Reading.average_item_weight, Reading.mode)
+EXPORT_FIELDS = tuple(column.key for column in EXPORT_COLUMNS)
+
+
+def encode_cursor(after_id, start=None, end=None):
+    """Opaque page token: the last exported id plus the time range it applies to."""
+    state = {'after': after_id, 'start': iso_utc(start), 'end': iso_utc(end)}
+    return base64.urlsafe_b64encode(json.dumps(state, separators=(',', ':')).encode()).decode().rstrip('=')
+
+
+def _parse_utc(value):
+    """iso_utc() output back to a naive UTC datetime (None stays None)."""
+    return datetime.datetime.fromisoformat(value.rstrip('Z')) if value else None
+
+
+def decode_cursor(token):
+    """Returns (after_id, start, end). Raises ValueError for a malformed token."""
+    try:
+        state = json.loads(base64.urlsafe_b64decode(token + '=' * (-len(token) % 4)))
+        return int(state['after']), _parse_utc(state.get('start')), _parse_utc(state.get('end'))
+    except (ValueError, TypeError, KeyError, AttributeError) as e:
+        raise ValueError(f"Invalid cursor: {e}")
+
+
+def _filters(device_id, after_id, start, end):
+    filters = [Reading.device_id == device_id, Reading.id > after_id]
+    if start:
+        filters.append(Reading.server_timestamp >= start)
+    if end:
+        filters.append(Reading.server_timestamp < end)
+    return filters
+
+
+def page_end(device_id, after_id=0, start=None, end=None, limit=None):
+    """
+    Last id of a page of `limit` rows if more rows follow it, else None (the
+    page runs to the end). Index-only lookups (archive partitions wholly in
+    range count by their row_count), so the next-page token can be sent in
+    the headers before any row is streamed.
+    """
+    if not limit:
+        return None
+    skip = limit - 1 # Rows before the page's last one
+    last = None # Found the page's last row; is there anything after it?
+    for partition in archive.partitions(device_id, after_id, start, end):
+        if archive.covers_whole(partition, after_id, start, end):
+            if last is not None:
+                return last
+            if partition.row_count <= skip:
+                skip -= partition.row_count
+                continue
+        ids = archive.read_ids(partition, after_id, start, end)
+        if last is not None:
+            if ids:
+                return last
+        elif len(ids) > skip + 1:
+            return ids[skip]
+        elif len(ids) == skip + 1:
+            last = ids[skip]
+        else:
+            skip -= len(ids)
+
+    if last is not None:
+        following = db.session.scalar(select(Reading.id).where(*_filters(device_id, after_id, start, end)).limit(1))
+        return last if following is not None else None
+    ids = db.session.scalars(select(Reading.id).where(*_filters(device_id, after_id, start, end))
+                             .order_by(Reading.id).offset(skip).limit(2)).all()
+    return ids[0] if len(ids) == 2 else None
+
+
+def iter_rows(device_id, after_id=0, start=None, end=None, until_id=None, fetch_size=1000):
+    """Yields export rows (tuples in EXPORT_FIELDS order), oldest first: archive tier, then a server-side cursor."""
+    for partition in archive.partitions(device_id, after_id, start, end):
+        if until_id is not None and partition.min_id > until_id:
+            return
+        for row in archive.read_rows(partition, after_id, start, end, until_id):
+            yield row[:-1] # Without the trace
+
+    filters = _filters(device_id, after_id, start, end)
+    if until_id is not None:
+        filters.append(Reading.id <= until_id)
+    result = db.session.execute(select(*EXPORT_COLUMNS).where(*filters).order_by(Reading.id)
+                                .execution_options(yield_per=fetch_size))
+    try:
+        for partition in result.partitions():
+            yield from partition
+    finally:
+        result.close()
+
+
+def _ndjson_line(row):
+    record = dict(zip(EXPORT_FIELDS, row))
+    record['device_timestamp'] = iso_utc(record['device_timestamp'])
+    record['server_timestamp'] = iso_utc(record['server_timestamp'])
+    return json.dumps(record, separators=(',', ':')) + '\n'
+
+
+def format_rows(rows, fmt, chunk_bytes=65536):
+    """Serializes rows as NDJSON or CSV (with header), yielding text chunks of about chunk_bytes."""
+    buffer = io.StringIO()
+    writer = csv.writer(buffer, lineterminator='\n') if fmt == 'csv' else None
+    if writer:
+        writer.writerow(EXPORT_FIELDS)
+    for row in rows:
+        if writer:
+            writer.writerow((row[0], row[1], iso_utc(row[2]), iso_utc(row[3])) + tuple(row[4:]))
+        else:
+            buffer.write(_ndjson_line(row))
+        if buffer.tell() >= chunk_bytes:
+            yield buffer.getvalue()
+            buffer.seek(0)
+            buffer.truncate()
+    if buffer.tell():
+        yield buffer.getvalue()
+
+
+def gzip_chunks(chunks, level=6):
+    """gzip stream of text chunks; the compressor's window is the only state kept."""
+    compressor = zlib.compressobj(level, zlib.DEFLATED, 31) # wbits 31: gzip container
+    for chunk in chunks:
+        data = compressor.compress(chunk.encode())
+        if data:
+            yield data
+    yield compressor.flush()
@@ -0,0 +1,107 @@
+import math
+
+from sqlalchemy import func, select
+
+from .. import db
+from ..models import Reading
+
+# --- End-to-End Latency Statistics ---
+# Readings from SNTP-synced firmware carry wall-clock trace stamps (epoch ms):
+#   sampled   ADC conversion behind the reported values
+#   stable    weight declared stable (first upload after settling only)
+#   enqueued  reading formatted for upload (HTTP payload / MQTT batch)
+#   sent      upload started (HTTP POST / batch handed to the MQTT outbox);
+#             stamped once per upload, next to the reading(s) rather than in them
+# and the backend adds 'received' (request / message arrival) and 'stored'.
+# Each stage below is the difference of two stamps. Device and server
+# clocks are both NTP-disciplined, so cross-clock stages (network) can be
+# off by the sync error, including slightly negative; values are kept as is.
+# The stamps are stored with each reading; summaries cover the newest
+# `window` traced readings per device and are computed on request.
+
+TRACE_STAMPS = ('sampled', 'stable', 'enqueued', 'sent', 'received', 'stored')
+
+STAGES = (
+    ('device_queue', 'sampled', 'enqueued'), # Waiting for the next report interval
+    ('batching', 'enqueued', 'sent'),        # MQTT batch hold time (~0 for HTTP)
+    ('network', 'sent', 'received'),         # Transport, broker and retransmissions
+    ('ingest', 'received', 'stored'),        # Backend processing
+    ('end_to_end', 'sampled', 'stored'),     # Sample-to-database (the SLA figure)
+    ('settle_to_stored', 'stable', 'stored'), # New stable weight until it is in the database
+)
+
+PERCENTILES = (50, 90, 99)
+
+
+def parse_trace(trace, sent=None):
+    """
+    Keeps the known stamps of a device trace object as int epoch ms (drops anything malformed).
+    sent: the upload-level stamp. Returns {} for readings without a trace (clock not synced).
+    """
+    if not isinstance(trace, dict):
+        return {}
+    stamps = {}
+    for name in TRACE_STAMPS:
+        value = sent if name == 'sent' else trace.get(name)
+        if isinstance(value, (int, float)) and not isinstance(value, bool) and value > 0:
+            stamps[name] = int(value)
+    return stamps
+
+
+def stage_latencies(trace):
+    """Returns {stage: ms} for every stage whose two stamps are present."""
+    return {stage: trace[end] - trace[start]
+            for stage, start, end in STAGES if start in trace and end in trace}
+
+
+def _recent_traces(device_id, window):
+    """{device_id: [trace, ...]} for the newest `window` traced readings of each device."""
+    rank = func.row_number().over(partition_by=Reading.device_id, order_by=Reading.id.desc()).label('rank')
+    recent = select(Reading.device_id, Reading.trace, rank).where(Reading.trace.is_not(None))
+    if device_id is not None:
+        recent = recent.where(Reading.device_id == device_id)
+    recent = recent.subquery()
+    traces = {}
+    for dev, trace in db.session.execute(select(recent.c.device_id, recent.c.trace).where(recent.c.rank <= window)):
+        traces.setdefault(dev, []).append(trace)
+    return traces
+
+
+def _summarise(values):
+    ordered = sorted(values)
+    summary = {
+        'count': len(ordered),
+        'min_ms': ordered[0],
+        'mean_ms': round(sum(ordered) / len(ordered), 1),
+        'max_ms': ordered[-1],
+    }
+    for p in PERCENTILES:
+        # Nearest-rank percentile
+        summary[f'p{p}_ms'] = ordered[max(0, math.ceil(p / 100 * len(ordered)) - 1)]
+    return summary
+
+
+def get_summary(device_id=None, window=1000):
+    """
+    Latency distribution per stage over the newest `window` traced readings per device.
+    For one device: {stage: summary}. For the fleet: {'fleet': {stage: summary}, 'devices': {id: {...}}}.
+    """
+    per_device = {}
+    for dev, traces in _recent_traces(device_id, window).items():
+        stages = per_device.setdefault(dev, {})
+        for trace in traces:
+            for stage, value in stage_latencies(trace).items():
+                stages.setdefault(stage, []).append(value)
+
+    if device_id is not None:
+        return {stage: _summarise(values) for stage, values in per_device.get(device_id, {}).items()}
+
+    fleet = {}
+    for stages in per_device.values():
+        for stage, values in stages.items():
+            fleet.setdefault(stage, []).extend(values)
+    return {
+        'fleet': {stage: _summarise(values) for stage, values in fleet.items()},
+        'devices': {dev: {stage: _summarise(values) for stage, values in stages.items()}
+                    for dev, stages in per_device.items()},
+    }
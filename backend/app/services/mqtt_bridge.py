@@ -0,0 +1,169 @@
+import json
+import os
+import time
+
+import click
+from flask import current_app
+from flask.cli import with_appcontext
+
+from . import data_handler
+
+# --- MQTT Ingest Bridge ---
+# Scales configured for the MQTT transport publish to the broker instead of
+# POSTing to /reading. This bridge subscribes on their behalf and feeds every
+# message into the same ingest path as the HTTP endpoint, so storage, rollups,
+# live streams and command acks behave identically for both transports.
+#   <prefix>/<device_id>/readings  QoS 1  {"readings":[{...}, ...], "sent":<epoch ms>, "acked_commands":[...], ...}
+#   <prefix>/<device_id>/health    QoS 0  compact health record (see /device_health)
+#   <prefix>/<device_id>/lots      QoS 1  closed accumulation lot (see /lot)
+#   <prefix>/<device_id>/cmd       QoS 1  {"commands":[...]} published back after each batch
+# The bridge uses a persistent session (clean_session=False), so readings the
+# broker receives while the backend restarts are delivered when it reconnects.
+# QoS 1 is at-least-once: redelivered readings are dropped by their "seq".
+# All state is in the database, so the bridge can run in its own process
+# (`flask mqtt-bridge`) next to any number of web workers. Exactly one bridge
+# should hold the persistent session; MQTT_BRIDGE_EMBEDDED starts it inside
+# the web process instead, for single-process development.
+#
+# Local test: run `mosquitto -v`, start the app with MQTT_BROKER_HOST=localhost
+# and publish a batch with mosquitto_pub -q 1 -t scales/SCALE_1/readings -m '...'.
+
+
+def _parse_topic(topic, prefix):
+    """Splits '<prefix>/<device_id>/<kind>'. Returns (device_id, kind) or (None, None)."""
+    parts = topic.split('/')
+    if len(parts) != 3 or parts[0] != prefix or not parts[1]:
+        return None, None
+    return parts[1], parts[2]
+
+
+def handle_message(app, topic, payload, prefix='scales'):
+    """
+    Processes one MQTT message from a scale.
+    Returns a list of (topic, payload) messages to publish in reply.
+    """
+    received_ms = int(time.time() * 1000) # Latency trace 'received' stamp
+    device_id, kind = _parse_topic(topic, prefix)
+    if device_id is None:
+        app.logger.warning(f"MQTT message on unexpected topic '{topic}' ignored")
+        return []
+
+    try:
+        message = json.loads(payload)
+    except (ValueError, UnicodeDecodeError) as e:
+        app.logger.warning(f"MQTT message on '{topic}' is not valid JSON: {e}")
+        return []
+    if not isinstance(message, dict):
+        app.logger.warning(f"MQTT message on '{topic}' is not a JSON object")
+        return []
+
+    with app.app_context():
+        if kind == 'health':
+            message['device_id'] = device_id # The topic is authoritative
+            data_handler.process_and_store_health(message)
+            return []
+        if kind == 'lots':
+            message['device_id'] = device_id
+            if not all(field in message for field in data_handler.LOT_REQUIRED_FIELDS):
+                app.logger.warning(f"MQTT lot from {device_id} is missing fields")
+                return []
+            data_handler.process_and_store_lot(message)
+            return []
+        if kind != 'readings':
+            return []
+
+        readings = message.get('readings')
+        if not isinstance(readings, list):
+            app.logger.warning(f"MQTT batch from {device_id} has no 'readings' list")
+            return []
+
+        # Command acks travel once per batch, independent of whether its readings are valid
+        data_handler.acknowledge_commands(device_id, acked_ids=message.get('acked_commands'),
+                                          rejected_ids=message.get('rejected_commands'))
+
+        stored = 0
+        for reading in readings:
+            if not isinstance(reading, dict):
+                continue
+            data = dict(reading, device_id=device_id)
+            # The batch is handed to the outbox as a whole: one 'sent' stamp for all its readings
+            data['sent'] = message.get('sent')
+            data['boot_seq'] = message.get('boot_seq')
+            errors = data_handler.validate_reading(data)
+            if errors:
+                app.logger.warning(f"MQTT reading from {device_id} failed validation: {errors}")
+                continue
+            success, _ = data_handler.process_and_store_reading(data, received_ms=received_ms)
+            stored += success
+        app.logger.debug(f"MQTT batch from {device_id}: {stored}/{len(readings)} readings accepted")
+
+        # Downlink: same re-delivery contract as the HTTP reply, on the command topic
+        commands = data_handler.get_commands_for_device(device_id)
+        if not commands:
+            return []
+        return [(f"{prefix}/{device_id}/cmd", json.dumps({"commands": commands}, separators=(',', ':')))]
+
+
+@click.command('mqtt-bridge')
+@with_appcontext
+def run_bridge_command():
+    """Runs the MQTT ingest bridge in the foreground (one per deployment)."""
+    app = current_app._get_current_object()
+    if not app.config.get('MQTT_BROKER_HOST'):
+        raise click.ClickException("MQTT_BROKER_HOST is not set")
+    bridge = MqttBridge(app)
+    click.echo(f"MQTT bridge: {app.config['MQTT_BROKER_HOST']}:{app.config['MQTT_BROKER_PORT']}")
+    bridge.client.connect(app.config['MQTT_BROKER_HOST'], app.config['MQTT_BROKER_PORT'])
+    bridge.client.loop_forever(retry_first_connection=True)
+
+
+class MqttBridge:
+    """Owns the paho client; messages are handled on paho's network thread."""
+
+    def __init__(self, app):
+        import paho.mqtt.client as mqtt # Only needed when the bridge is enabled
+
+        self.app = app
+        self.prefix = app.config['MQTT_TOPIC_PREFIX']
+        self.client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2,
+                                  client_id=app.config['MQTT_CLIENT_ID'], clean_session=False)
+        self.client.on_connect = self._on_connect
+        self.client.on_message = self._on_message
+
+    def _on_connect(self, client, userdata, flags, reason_code, properties):
+        if reason_code.is_failure:
+            self.app.logger.error(f"MQTT bridge connection refused: {reason_code}")
+            return
+        self.app.logger.info(f"MQTT bridge connected (session present: {flags.session_present})")
+        client.subscribe([(f"{self.prefix}/+/readings", 1), (f"{self.prefix}/+/health", 0),
+                          (f"{self.prefix}/+/lots", 1)])
+
+    def _on_message(self, client, userdata, msg):
+        try:
+            for topic, payload in handle_message(self.app, msg.topic, msg.payload, self.prefix):
+                client.publish(topic, payload, qos=1)
+        except Exception:
+            self.app.logger.exception(f"Unhandled exception processing MQTT message on '{msg.topic}'")
+
+    def start(self):
+        # connect_async + loop_start: paho reconnects on its own with backoff
+        self.client.connect_async(self.app.config['MQTT_BROKER_HOST'], self.app.config['MQTT_BROKER_PORT'])
+        self.client.loop_start()
+
+    def stop(self):
+        self.client.disconnect()
+        self.client.loop_stop()
+
+
+def init_app(app):
+    """Registers `flask mqtt-bridge`; starts the bridge in-process if MQTT_BROKER_HOST and MQTT_BRIDGE_EMBEDDED are set."""
+    app.cli.add_command(run_bridge_command)
+    if not app.config.get('MQTT_BROKER_HOST') or not app.config.get('MQTT_BRIDGE_EMBEDDED'):
+        return None
+    if app.debug and os.environ.get('WERKZEUG_RUN_MAIN') != 'true':
+        return None # Reloader parent process: only the serving child subscribes
+    bridge = MqttBridge(app)
+    bridge.start()
+    app.extensions['mqtt_bridge'] = bridge
+    print(f"MQTT bridge: {app.config['MQTT_BROKER_HOST']}:{app.config['MQTT_BROKER_PORT']}")
+    return bridge
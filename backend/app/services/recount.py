@@ -0,0 +1,216 @@
+import array
+import datetime
+import math
+import struct
+import time
+
+import click
+from flask import current_app
+from flask.cli import with_appcontext
+from sqlalchemy import Integer, bindparam, case, cast, func, select, update
+
+from .. import db
+from ..models import Reading, RollupBucket
+from .rollups import ROLLUP_RESOLUTIONS, _to_epoch
+
+try:
+    import scale_core as _native # backend/native: the firmware's counting library
+except ImportError:
+    _native = None
+
+# --- Server-side Recount ---
+# When a piece weight turns out to be wrong, the counts of stored readings
+# are recomputed from their stored weights with the scale's own counting code
+# (firmware/lib/scale_core, built as the scale_core extension in
+# backend/native). Readings go in id-keyset batches: one narrow column scan,
+# one float32 array counted in C, and only changed rows written back. Every
+# batch commits on its own, so a recount never holds the write lock for long
+# and an interrupted one can simply be run again. Afterwards the count
+# fields of the affected rollup buckets are rebuilt from the readings.
+# Only stable counting-mode readings (Reading.COUNTING_MODES, which includes
+# accumulation) are recounted: those are the ones whose count the scale
+# computed from their own weight.
+# Readings already compacted into the archive tier (services/retention.py)
+# are not recounted; their rollup buckets keep their counts.
+
+MIN_ITEM_WEIGHT_G = 0.001 # SCALE_CORE_MIN_ITEM_WEIGHT_G
+
+_HALF_BELOW = 0.49999997 # As float32: the largest value below 0.5 (see scale_core.c)
+_COUNT_MAX = 2147483520.0
+
+
+def _f32(value):
+    """Rounds a Python float to the nearest float32 value."""
+    try:
+        return struct.unpack('f', struct.pack('f', value))[0]
+    except OverflowError:
+        return math.copysign(math.inf, value)
+
+
+def _count_items_python(weights, item_weight_g, counts):
+    """Pure Python port of ScaleCore_CountItemsBatch (identical results, some 30x slower)."""
+    item = _f32(item_weight_g)
+    if not item > _f32(MIN_ITEM_WEIGHT_G):
+        return # counts stay 0
+    half = item / 2.0
+    half_below = _f32(_HALF_BELOW)
+    for i, weight in enumerate(weights):
+        # Each operation rounded to float32, as on the scale (double holds the exact result first)
+        q = _f32(weight / item)
+        q = min(q if q > 0.0 else 0.0, _COUNT_MAX)
+        counts[i] = int(_f32(q + half_below)) if weight >= half else 0
+
+
+def count_items(weights_g, item_weight_g):
+    """
+    Item counts for a sequence of weights at one item weight, computed exactly
+    as on the scale (float32). Returns an array('i').
+    """
+    weights = array.array('f', weights_g)
+    counts = array.array('i', bytes(4 * len(weights)))
+    if _native is not None:
+        _native.count_items(weights, item_weight_g, counts)
+    else:
+        _count_items_python(weights, item_weight_g, counts)
+    return counts
+
+
+def _epoch_seconds(column):
+    """Whole epoch seconds of a naive UTC timestamp column, in SQL."""
+    if db.engine.dialect.name == 'postgresql':
+        return cast(func.floor(func.extract('epoch', column)), Integer)
+    return cast(func.strftime('%s', column), Integer)
+
+
+def _refresh_rollup_counts(device_id, first_ts, last_ts):
+    """Rebuilds count_min/max/last of the device's rollup buckets between two receive times."""
+    day = ROLLUP_RESOLUTIONS['day']
+    # Whole days, so every minute/hour bucket in range sees all of its readings
+    start_epoch = int(_to_epoch(first_ts) // day) * day
+    end_epoch = (int(_to_epoch(last_ts) // day) + 1) * day
+    start = datetime.datetime.utcfromtimestamp(start_epoch)
+    end = datetime.datetime.utcfromtimestamp(end_epoch)
+
+    refreshed = 0
+    seconds = _epoch_seconds(Reading.server_timestamp)
+    for resolution, width in ROLLUP_RESOLUTIONS.items():
+        bucket = (seconds // width * width).label('bucket')
+        # Newest reading of a bucket by receive time, as the ingest path tracks count_last
+        ranked = (select(bucket, Reading.item_count,
+                         func.row_number().over(partition_by=bucket,
+                                                order_by=(Reading.server_timestamp.desc(), Reading.id.desc()))
+                         .label('newest'))
+                  .where(Reading.device_id == device_id,
+                         Reading.server_timestamp >= start, Reading.server_timestamp < end)
+                  .subquery())
+        fresh = {row.bucket: (row.count_min, row.count_max, row.count_last) for row in db.session.execute(
+            select(ranked.c.bucket,
+                   func.min(ranked.c.item_count).label('count_min'),
+                   func.max(ranked.c.item_count).label('count_max'),
+                   func.max(case((ranked.c.newest == 1, ranked.c.item_count))).label('count_last'))
+            .group_by(ranked.c.bucket))}
+
+        stored = db.session.execute(
+            select(RollupBucket.bucket_start, RollupBucket.count_min, RollupBucket.count_max, RollupBucket.count_last)
+            .where(RollupBucket.resolution == resolution, RollupBucket.device_id == device_id,
+                   RollupBucket.bucket_start >= start_epoch, RollupBucket.bucket_start < end_epoch))
+        changed = [{'resolution': resolution, 'device_id': device_id, 'bucket_start': row.bucket_start,
+                    'count_min': counts[0], 'count_max': counts[1], 'count_last': counts[2]}
+                   for row in stored
+                   if (counts := fresh.get(row.bucket_start)) and counts != tuple(row)[1:]]
+        if changed:
+            db.session.execute(update(RollupBucket), changed)
+        refreshed += len(changed)
+    db.session.commit()
+    return refreshed
+
+
+_SET_COUNT = (update(Reading.__table__)
+              .where(Reading.__table__.c.id == bindparam('row_id'))
+              .values(item_count=bindparam('count')))
+
+
+def recount_readings(device_id, item_weight_g, start=None, end=None, batch_size=None):
+    """
+    Recomputes item_count (and sets average_item_weight) of the device's stable
+    counting readings for a corrected item weight.
+    start/end: optional naive UTC datetimes bounding server_timestamp (start inclusive, end exclusive).
+    Returns a summary dict. Raises ValueError for an invalid item weight.
+    """
+    item_weight_g = float(item_weight_g)
+    if not item_weight_g > MIN_ITEM_WEIGHT_G:
+        raise ValueError(f"Invalid item weight: {item_weight_g!r}")
+    batch_size = batch_size or current_app.config.get('RECOUNT_BATCH_SIZE', 50000)
+
+    eligible = [Reading.device_id == device_id, Reading.mode.in_(Reading.COUNTING_MODES), Reading.is_stable.is_(True)]
+    if start:
+        eligible.append(Reading.server_timestamp >= start)
+    if end:
+        eligible.append(Reading.server_timestamp < end)
+
+    began = time.monotonic()
+    recounted = changed_total = 0
+    first_changed = last_changed = None
+    last_id = 0
+    while True:
+        rows = db.session.execute(select(Reading.id, Reading.weight_grams, Reading.item_count, Reading.server_timestamp)
+                                  .where(*eligible, Reading.id > last_id)
+                                  .order_by(Reading.id).limit(batch_size)).all()
+        if not rows:
+            break
+        ids, weights, old_counts, timestamps = zip(*rows)
+        counts = count_items(weights, item_weight_g)
+
+        changed = [{'row_id': row_id, 'count': count}
+                   for row_id, count, old in zip(ids, counts, old_counts) if count != old]
+        if changed:
+            db.session.execute(_SET_COUNT, changed) # executemany, no ORM bookkeeping per row
+            changed_ts = [ts for ts, count, old in zip(timestamps, counts, old_counts) if count != old]
+            first_changed = min(changed_ts + ([first_changed] if first_changed else []))
+            last_changed = max(changed_ts + ([last_changed] if last_changed else []))
+        db.session.execute(update(Reading)
+                           .where(*eligible, Reading.id.between(ids[0], ids[-1]))
+                           .values(average_item_weight=item_weight_g)
+                           .execution_options(synchronize_session=False))
+        db.session.commit()
+
+        recounted += len(rows)
+        changed_total += len(changed)
+        last_id = ids[-1]
+
+    buckets = _refresh_rollup_counts(device_id, first_changed, last_changed) if first_changed else 0
+    seconds = time.monotonic() - began
+    current_app.logger.info(f"Recounted {recounted} readings of {device_id} at {item_weight_g} g: "
+                            f"{changed_total} changed, {buckets} rollup buckets updated ({seconds:.1f} s)")
+    return {
+        'device_id': device_id,
+        'item_weight_g': item_weight_g,
+        'recounted': recounted,
+        'changed': changed_total,
+        'rollup_buckets_updated': buckets,
+        'native': _native is not None,
+        'seconds': round(seconds, 3),
+    }
+
+
+@click.command('recount')
+@click.argument('device_id')
+@click.argument('item_weight_g', type=float)
+@click.option('--start', type=click.DateTime(), help='Only readings received at or after this UTC time')
+@click.option('--end', type=click.DateTime(), help='Only readings received before this UTC time')
+@with_appcontext
+def recount_command(device_id, item_weight_g, start, end):
+    """Recounts stored readings of DEVICE_ID for a corrected ITEM_WEIGHT_G."""
+    if _native is None:
+        click.echo("scale_core extension not built (pip install ./native): using the slow Python fallback", err=True)
+    try:
+        result = recount_readings(device_id, item_weight_g, start=start, end=end)
+    except ValueError as e:
+        raise click.ClickException(str(e))
+    click.echo(f"{result['recounted']} readings recounted, {result['changed']} changed, "
+               f"{result['rollup_buckets_updated']} rollup buckets updated in {result['seconds']} s")
+
+
+def init_app(app):
+    """Registers `flask recount`."""
+    app.cli.add_command(recount_command)
@@ -0,0 +1,144 @@
+import datetime
+import time
+
+import click
+from flask import current_app
+from flask.cli import with_appcontext
+from sqlalchemy import func, select
+
+from .. import db
+from ..models import ArchivePartition, Reading
+from . import archive
+
+# --- Tiered Retention ---
+# Raw readings are kept for RETENTION_RAW_DAYS whole UTC days (by receive
+# time); older ones are compacted one device-day at a time into the archive
+# tier (services/archive.py) and their rows deleted, so the readings table
+# and its indexes only ever hold the retention window. Rollups stay in the
+# database for all time. With ARCHIVE_RETENTION_DAYS set, partitions older
+# than that are dropped as well.
+# Run `flask retention` once at a time (cron, daily). Every device-day is its
+# own transaction: an interrupted run leaves at most an unreferenced file
+# behind and is simply run again. Rows of an already compacted day (late
+# arrivals, a shortened retention) are merged into a new version of its file.
+
+_RAW_COLUMNS = (Reading.id, Reading.device_id, Reading.device_timestamp, Reading.server_timestamp,
+                Reading.weight_grams, Reading.item_count, Reading.is_stable, Reading.is_overload,
+                Reading.average_item_weight, Reading.mode, Reading.trace) # archive.ARCHIVE_FIELDS order
+
+
+def _day_start(day):
+    return datetime.datetime.combine(day, datetime.time())
+
+
+def _compact_day(device_id, day):
+    """Moves one device-day into the archive tier. Returns (rows archived, partition file bytes)."""
+    start = _day_start(day)
+    in_day = (Reading.device_id == device_id, Reading.server_timestamp >= start,
+              Reading.server_timestamp < start + datetime.timedelta(days=1))
+    rows = db.session.execute(select(*_RAW_COLUMNS).where(*in_day).order_by(Reading.id)).all()
+    if not rows:
+        return 0, 0
+    last_raw_id = rows[-1][0]
+
+    partition = db.session.get(ArchivePartition, (device_id, day))
+    old_path = partition.path if partition else None
+    if partition:
+        merged = {row[0]: row for row in archive.read_rows(partition)}
+        merged.update((row[0], tuple(row)) for row in rows)
+        rows = [merged[row_id] for row_id in sorted(merged)]
+    else:
+        partition = ArchivePartition(device_id=device_id, day=day)
+        db.session.add(partition)
+
+    path, size = archive.write_partition(device_id, day, rows)
+    try:
+        partition.path = path
+        partition.row_count = len(rows)
+        partition.min_id = rows[0][0]
+        partition.max_id = rows[-1][0]
+        partition.file_bytes = size
+        partition.compacted_at = datetime.datetime.utcnow()
+        # Only the rows just read: anything inserted meanwhile stays raw until the next run
+        db.session.execute(db.delete(Reading).where(*in_day, Reading.id <= last_raw_id))
+        db.session.commit()
+    except Exception:
+        db.session.rollback()
+        archive.remove_file(path)
+        raise
+    if old_path and old_path != path:
+        archive.remove_file(old_path)
+    return len(rows), size
+
+
+def _drop_partitions(before_day):
+    """Deletes archive partitions (rows and files) of days before before_day. Returns how many."""
+    expired = db.session.scalars(select(ArchivePartition).where(ArchivePartition.day < before_day)).all()
+    paths = [partition.path for partition in expired]
+    for partition in expired:
+        db.session.delete(partition)
+    db.session.commit()
+    for path in paths:
+        archive.remove_file(path)
+    return len(paths)
+
+
+def apply_retention(raw_days=None, archive_days=None, now=None):
+    """
+    Compacts raw readings received before the retention window into the
+    archive tier, then drops expired partitions. raw_days / archive_days
+    default to RETENTION_RAW_DAYS / ARCHIVE_RETENTION_DAYS (None: keep forever).
+    Returns a summary dict.
+    """
+    config = current_app.config
+    raw_days = config.get('RETENTION_RAW_DAYS', 30) if raw_days is None else raw_days
+    archive_days = config.get('ARCHIVE_RETENTION_DAYS') if archive_days is None else archive_days
+    today = (now or datetime.datetime.utcnow()).date()
+    cutoff = _day_start(today - datetime.timedelta(days=raw_days))
+
+    began = time.monotonic()
+    partitions = rows_archived = file_bytes = 0
+    devices = db.session.scalars(select(Reading.device_id).where(Reading.server_timestamp < cutoff).distinct()).all()
+    for device_id in devices:
+        pending = [Reading.device_id == device_id, Reading.server_timestamp < cutoff]
+        while (oldest := db.session.scalar(select(func.min(Reading.server_timestamp)).where(*pending))) is not None:
+            rows, size = _compact_day(device_id, oldest.date())
+            partitions += 1
+            rows_archived += rows
+            file_bytes += size
+            pending = [Reading.device_id == device_id, Reading.server_timestamp < cutoff,
+                       Reading.server_timestamp >= _day_start(oldest.date() + datetime.timedelta(days=1))]
+
+    dropped = 0
+    if archive_days is not None:
+        dropped = _drop_partitions(today - datetime.timedelta(days=raw_days + archive_days))
+
+    seconds = time.monotonic() - began
+    current_app.logger.info(f"Retention: {rows_archived} readings compacted into {partitions} partitions "
+                            f"({file_bytes} bytes), {dropped} expired partitions dropped ({seconds:.1f} s)")
+    return {
+        'cutoff': cutoff,
+        'partitions_written': partitions,
+        'readings_archived': rows_archived,
+        'archive_bytes_written': file_bytes,
+        'partitions_dropped': dropped,
+        'seconds': round(seconds, 3),
+    }
+
+
+@click.command('retention')
+@click.option('--raw-days', type=int, help='Keep raw readings for this many days (default RETENTION_RAW_DAYS)')
+@click.option('--archive-days', type=int,
+              help='Drop archived days older than raw + this many days (default ARCHIVE_RETENTION_DAYS: keep)')
+@with_appcontext
+def retention_command(raw_days, archive_days):
+    """Compacts readings past the raw retention period into the archive tier."""
+    result = apply_retention(raw_days=raw_days, archive_days=archive_days)
+    click.echo(f"{result['readings_archived']} readings before {result['cutoff']:%Y-%m-%d} compacted into "
+               f"{result['partitions_written']} partitions ({result['archive_bytes_written']} bytes), "
+               f"{result['partitions_dropped']} expired partitions dropped in {result['seconds']} s")
+
+
+def init_app(app):
+    """Registers `flask retention`."""
+    app.cli.add_command(retention_command)
@@ -0,0 +1,148 @@
+from flask import current_app
+import datetime
+
+from sqlalchemy import case, select
+from sqlalchemy.dialects import postgresql, sqlite
+
+from .. import db
+from ..models import RollupBucket, RollupDeviceState
+
+# --- Incremental Rollups (maintained at ingest time) ---
+# Each incoming reading updates one bucket per resolution, so a dashboard
+# query only touches (devices x buckets) pre-aggregated rows instead of
+# scanning every raw reading. Buckets are upserted with the aggregation done
+# in SQL (count + 1, min/max against the stored row), so ingest workers
+# never overwrite each other's updates. Runs inside the caller's transaction.
+
+ROLLUP_RESOLUTIONS = {
+    'minute': 60,
+    'hour': 3600,
+    'day': 86400,
+}
+
+
+def _to_epoch(ts):
+    """Converts a (naive UTC or aware) datetime to epoch seconds."""
+    if ts.tzinfo is None:
+        ts = ts.replace(tzinfo=datetime.timezone.utc)
+    return ts.timestamp()
+
+
+def _epoch_to_iso(epoch):
+    return datetime.datetime.fromtimestamp(epoch, tz=datetime.timezone.utc).isoformat().replace('+00:00', 'Z')
+
+
+def _insert(model):
+    """INSERT ... ON CONFLICT for the configured backend (SQLite stand-in or PostgreSQL)."""
+    dialect = postgresql if db.engine.dialect.name == 'postgresql' else sqlite
+    return dialect.insert(model)
+
+
+def _smaller(a, b):
+    return case((a < b, a), else_=b)
+
+
+def _larger(a, b):
+    return case((a > b, a), else_=b)
+
+
+def update_rollups(reading, received_ts):
+    """
+    Folds one stored reading into the minute/hour/day buckets of its device.
+    O(1) per resolution, independent of history length.
+    """
+    device_id = reading['device_id']
+    now_epoch = _to_epoch(received_ts)
+
+    # Stable time is credited for the interval since the previous reading
+    # if the scale was stable over it, up to ROLLUP_MAX_STABLE_GAP_SECONDS:
+    # a longer silence (device offline) is not known to be stable time.
+    # Overload events count rising edges.
+    # The device row is locked (PostgreSQL) so concurrent uploads of one device serialize here.
+    stable_delta = 0.0
+    overload_edge = bool(reading['is_overload'])
+    previous = db.session.get(RollupDeviceState, device_id, with_for_update=True)
+    if previous is not None:
+        if previous.last_stable and reading['is_stable'] and now_epoch > previous.last_epoch:
+            stable_delta = min(now_epoch - previous.last_epoch,
+                               current_app.config.get('ROLLUP_MAX_STABLE_GAP_SECONDS', 30))
+        overload_edge = bool(reading['is_overload']) and not previous.last_overload
+        previous.last_epoch = now_epoch
+        previous.last_stable = bool(reading['is_stable'])
+        previous.last_overload = bool(reading['is_overload'])
+    else:
+        db.session.add(RollupDeviceState(device_id=device_id, last_epoch=now_epoch,
+                                         last_stable=bool(reading['is_stable']),
+                                         last_overload=bool(reading['is_overload'])))
+
+    table = RollupBucket.__table__
+    for resolution, width in ROLLUP_RESOLUTIONS.items():
+        stmt = _insert(RollupBucket).values(
+            resolution=resolution, device_id=device_id, bucket_start=int(now_epoch // width) * width,
+            reading_count=1,
+            count_min=reading['item_count'], count_max=reading['item_count'], count_last=reading['item_count'],
+            weight_min=reading['weight_grams'], weight_max=reading['weight_grams'], weight_last=reading['weight_grams'],
+            stable_seconds=stable_delta, overload_events=int(overload_edge), last_timestamp=now_epoch,
+        )
+        new = stmt.excluded
+        # 'last' values follow the newest receive time, not arrival order at the database
+        is_newer = (table.c.last_timestamp.is_(None)) | (new.last_timestamp >= table.c.last_timestamp)
+        stmt = stmt.on_conflict_do_update(
+            index_elements=[table.c.resolution, table.c.device_id, table.c.bucket_start],
+            set_={
+                'reading_count': table.c.reading_count + 1,
+                'count_min': _smaller(table.c.count_min, new.count_min),
+                'count_max': _larger(table.c.count_max, new.count_max),
+                'weight_min': _smaller(table.c.weight_min, new.weight_min),
+                'weight_max': _larger(table.c.weight_max, new.weight_max),
+                'count_last': case((is_newer, new.count_last), else_=table.c.count_last),
+                'weight_last': case((is_newer, new.weight_last), else_=table.c.weight_last),
+                'last_timestamp': case((is_newer, new.last_timestamp), else_=table.c.last_timestamp),
+                'stable_seconds': table.c.stable_seconds + new.stable_seconds,
+                'overload_events': table.c.overload_events + new.overload_events,
+            },
+        )
+        db.session.execute(stmt)
+
+
+def _serialize_bucket(bucket):
+    return {
+        'device_id': bucket.device_id,
+        'resolution': bucket.resolution,
+        'bucket_start': _epoch_to_iso(bucket.bucket_start),
+        'reading_count': bucket.reading_count,
+        'count_min': bucket.count_min,
+        'count_max': bucket.count_max,
+        'count_last': bucket.count_last,
+        'weight_min': bucket.weight_min,
+        'weight_max': bucket.weight_max,
+        'weight_last': bucket.weight_last,
+        'stable_seconds': round(bucket.stable_seconds, 3),
+        'overload_events': bucket.overload_events,
+        'last_timestamp': _epoch_to_iso(bucket.last_timestamp) if bucket.last_timestamp else None,
+    }
+
+
+def get_rollups(resolution, device_ids=None, start=None, end=None):
+    """
+    Returns pre-aggregated buckets for the given resolution.
+    device_ids: iterable of device ids, or None for every device.
+    start/end: datetimes bounding bucket_start (start inclusive, end exclusive).
+    """
+    if resolution not in ROLLUP_RESOLUTIONS:
+        raise ValueError(f"Unknown resolution '{resolution}'. Use one of: {', '.join(ROLLUP_RESOLUTIONS)}")
+
+    query = select(RollupBucket).where(RollupBucket.resolution == resolution)
+    if device_ids is not None:
+        query = query.where(RollupBucket.device_id.in_(list(device_ids)))
+    if start:
+        # Include the bucket that contains 'start'
+        width = ROLLUP_RESOLUTIONS[resolution]
+        query = query.where(RollupBucket.bucket_start >= int(_to_epoch(start) // width) * width)
+    if end:
+        query = query.where(RollupBucket.bucket_start < _to_epoch(end))
+    # Primary key order: one index range scan per device
+    buckets = db.session.scalars(query.order_by(RollupBucket.device_id, RollupBucket.bucket_start)).all()
+
+    current_app.logger.debug(f"Rollup query ({resolution}) returned {len(buckets)} buckets")
+    return [_serialize_bucket(b) for b in buckets]
@@ -0,0 +1,169 @@
+import datetime
+
+from sqlalchemy import select
+from sqlalchemy.dialects import postgresql, sqlite
+
+from .. import db
+from ..models import DeviceSequence, SequenceGap
+
+# --- Idempotent Ingest (device sequence numbers) ---
+# Firmware numbers every reading with a per-device counter that survives
+# reboots, so a retransmission (HTTP retry after a timeout, QoS 1 redelivery)
+# carries the number of the original. Per device we keep only the highest
+# number seen and a bitmap of the window_size numbers below it: a duplicate
+# is one bit test, a reading that overtook an earlier one fills its bit in
+# later, and numbers that drop off the bottom of the window unreceived are
+# recorded as gaps. Uploads also carry the first number of the current boot
+# ("boot_seq"): numbers a reboot skipped were never used and are not gaps.
+# Runs inside the caller's transaction.
+
+MAX_WINDOW_SIZE = 63 # Bitmap is stored in a signed 64-bit column
+
+
+def _insert(model):
+    """INSERT ... ON CONFLICT for the configured backend (SQLite stand-in or PostgreSQL)."""
+    dialect = postgresql if db.engine.dialect.name == 'postgresql' else sqlite
+    return dialect.insert(model)
+
+
+def _add_missing(gaps, first, last):
+    """Appends first..last to the gap runs, merging with the previous run if adjacent."""
+    if gaps and gaps[-1][1] == first - 1:
+        gaps[-1][1] = last
+    else:
+        gaps.append([first, last])
+
+
+def _advance(state, new_high, size, fill):
+    """
+    Moves the window top to new_high. Returns the runs of numbers pushed out
+    of the window without having arrived; fill marks the numbers above the
+    old top as received (skipped by the device) instead of pending.
+    """
+    old_high = state.high_water
+    gaps = []
+    # Bounded by the window size: only the old window's numbers can be pushed out bit by bit
+    for seq in range(old_high - size + 1, min(new_high - size, old_high) + 1):
+        if not (state.window >> (old_high - seq)) & 1:
+            _add_missing(gaps, seq, seq)
+    if not fill and new_high - size > old_high:
+        _add_missing(gaps, old_high + 1, new_high - size) # Jump past a whole window
+
+    shift = new_high - old_high
+    window = (state.window << shift) & ((1 << size) - 1) if shift < size else 0
+    if fill:
+        window |= (1 << min(shift, size)) - 1
+    state.window = window
+    state.high_water = new_high
+    return gaps
+
+
+def _restart(state, seq, boot_seq, size):
+    """Starts tracking at seq; anything older counts as already handled."""
+    state.high_water = seq
+    state.window = (1 << size) - 1
+    state.boot_seq = boot_seq
+
+
+def accept(device_id, seq, boot_seq=None, window_size=32, gap_history=100):
+    """
+    Records sequence number seq of device_id.
+    Returns True if the reading is new and should be stored, False if it is a
+    duplicate (or older than the window, which cannot be told apart from one).
+    Raises ValueError for invalid numbers.
+    """
+    if isinstance(seq, bool) or int(seq) < 0:
+        raise ValueError(f"Invalid sequence number: {seq!r}")
+    seq = int(seq)
+    if boot_seq is not None:
+        if isinstance(boot_seq, bool) or not 0 <= int(boot_seq) <= seq:
+            raise ValueError(f"Invalid boot_seq: {boot_seq!r}")
+        boot_seq = int(boot_seq)
+    size = max(1, min(int(window_size), MAX_WINDOW_SIZE))
+
+    # The insert takes the SQLite write lock up front; the row lock serializes
+    # concurrent uploads of one device on PostgreSQL.
+    db.session.execute(_insert(DeviceSequence)
+                       .values(device_id=device_id, window=0, received=0, duplicates=0,
+                               out_of_order=0, stale=0, lost=0, resets=0)
+                       .on_conflict_do_nothing(index_elements=['device_id']))
+    state = db.session.get(DeviceSequence, device_id, with_for_update=True, populate_existing=True)
+    state.window &= (1 << size) - 1 # Window size may have been reduced since
+
+    gaps = []
+    if state.high_water is None:
+        _restart(state, seq, boot_seq, size)
+    elif boot_seq is not None and state.boot_seq is not None and boot_seq < state.boot_seq:
+        # The device counter went backwards (NVS erased, board replaced): start over
+        state.resets += 1
+        _restart(state, seq, boot_seq, size)
+    else:
+        if boot_seq is not None and boot_seq != state.boot_seq:
+            state.boot_seq = boot_seq
+            if boot_seq - 1 > state.high_water:
+                gaps = _advance(state, boot_seq - 1, size, fill=True)
+
+        if seq > state.high_water:
+            gaps += _advance(state, seq, size, fill=False)
+            state.window |= 1
+        else:
+            offset = state.high_water - seq
+            if offset >= size:
+                state.stale += 1
+                return False
+            if (state.window >> offset) & 1:
+                state.duplicates += 1
+                return False
+            state.window |= 1 << offset
+            state.out_of_order += 1
+    state.received += 1
+
+    if gaps:
+        now = datetime.datetime.utcnow()
+        for first, last in gaps:
+            db.session.add(SequenceGap(device_id=device_id, first_seq=first, last_seq=last, detected_at=now))
+            state.lost += last - first + 1
+        db.session.flush()
+        # Keep only the newest gap_history runs of this device
+        cutoff = db.session.scalar(select(SequenceGap.id).where(SequenceGap.device_id == device_id)
+                                   .order_by(SequenceGap.id.desc()).offset(gap_history).limit(1))
+        if cutoff is not None:
+            db.session.execute(db.delete(SequenceGap).where(SequenceGap.device_id == device_id,
+                                                            SequenceGap.id <= cutoff))
+    return True
+
+
+def _serialize_state(state, size):
+    window = state.window & ((1 << size) - 1)
+    return {
+        'device_id': state.device_id,
+        'high_water': state.high_water,
+        'boot_seq': state.boot_seq,
+        'received': state.received,
+        'duplicates': state.duplicates,
+        'out_of_order': state.out_of_order,
+        'stale': state.stale,
+        'lost': state.lost,
+        'pending': size - bin(window).count('1') if state.high_water is not None else 0, # Missing, still in the window
+        'resets': state.resets,
+    }
+
+
+def get_status(device_id=None, window_size=32, gap_limit=20):
+    """
+    Sequence counters per device (every device if device_id is None).
+    For a single device the newest gap runs are included; None if unknown.
+    """
+    size = max(1, min(int(window_size), MAX_WINDOW_SIZE))
+    if device_id is None:
+        states = db.session.scalars(select(DeviceSequence).order_by(DeviceSequence.device_id))
+        return [_serialize_state(state, size) for state in states]
+
+    state = db.session.get(DeviceSequence, device_id)
+    if state is None:
+        return None
+    status = _serialize_state(state, size)
+    gaps = db.session.scalars(select(SequenceGap).where(SequenceGap.device_id == device_id)
+                              .order_by(SequenceGap.id.desc()).limit(gap_limit))
+    status['gaps'] = [gap.to_dict() for gap in gaps]
+    return status
@@ -0,0 +1,153 @@
+from flask import current_app
+import json
+import queue
+import threading
+import time
+
+from sqlalchemy import select
+from sqlalchemy.orm import Session
+
+from .. import db
+from ..models import Reading
+
+# --- Live Reading Fan-out (Server-Sent Events) ---
+# Readings may be ingested by any worker, so each process follows the
+# readings table instead of being told about new rows: whichever local
+# subscriber is waiting runs one "id > cursor" query per poll interval for
+# the whole process. Each new row is serialized a single time and the same
+# encoded event is handed to every matching subscriber. The reading id is
+# the SSE event id.
+# Ids are assigned at insert but become visible at commit, so a slow
+# transaction can land below the cursor after higher ids were published.
+# Each poll therefore re-scans a trailing window of ids under the cursor
+# and publishes whatever it has not sent yet.
+
+FLEET_TOPIC = '*' # Subscription key for fleet-wide streams
+POLL_BATCH = 500  # Rows fetched per poll at most; the next poll continues
+GAP_WINDOW = 100  # Ids below the cursor re-scanned for late commits
+
+_lock = threading.Lock()
+_subscribers = {} # {topic: set(Subscription)}
+_poll_lock = threading.Lock()
+_cursor = 0       # Highest reading id already fanned out by this process
+_published = set() # Ids within GAP_WINDOW of the cursor already fanned out
+_last_poll = 0.0
+
+
+class Subscription:
+    """A bounded per-client queue of pre-encoded SSE events."""
+
+    def __init__(self, topic, max_queue, engine, poll_interval):
+        self.topic = topic
+        self.engine = engine # Polling needs no app context (the stream generator may outlive it)
+        self.poll_interval = poll_interval
+        self.events = queue.Queue(maxsize=max_queue)
+        self.dropped = 0
+
+    def offer(self, event):
+        # Never block the ingest path on a slow dashboard: drop the oldest event instead.
+        while True:
+            try:
+                self.events.put_nowait(event)
+                return
+            except queue.Full:
+                try:
+                    self.events.get_nowait()
+                    self.dropped += 1
+                except queue.Empty:
+                    pass
+
+    def next_event(self, timeout):
+        """Returns the next encoded event, or None on timeout."""
+        interval = self.poll_interval
+        deadline = time.monotonic() + timeout
+        while True:
+            poll(self.engine, interval)
+            remaining = deadline - time.monotonic()
+            try:
+                return self.events.get(timeout=max(0.0, min(interval, remaining)))
+            except queue.Empty:
+                if remaining <= interval:
+                    return None
+
+
+def subscribe(device_id=None, max_queue=100):
+    """
+    Registers a subscriber for one device, or the whole fleet if device_id is None.
+    Call within an app context (binds the subscription to the app's database).
+    """
+    global _cursor, _published
+    sub = Subscription(device_id or FLEET_TOPIC, max_queue, db.engine,
+                       current_app.config.get('STREAM_POLL_INTERVAL_SECONDS', 0.5))
+    with _lock:
+        if not _subscribers:
+            # First local subscriber: stream from now on, not the table's history
+            with Session(sub.engine) as session:
+                _cursor = session.scalar(select(db.func.max(Reading.id))) or 0
+                _published = set(session.scalars(select(Reading.id).where(Reading.id > _cursor - GAP_WINDOW)))
+        _subscribers.setdefault(sub.topic, set()).add(sub)
+    return sub
+
+
+def unsubscribe(sub):
+    with _lock:
+        topic_subs = _subscribers.get(sub.topic)
+        if topic_subs:
+            topic_subs.discard(sub)
+            if not topic_subs:
+                del _subscribers[sub.topic]
+
+
+def subscriber_count():
+    with _lock:
+        return sum(len(subs) for subs in _subscribers.values())
+
+
+def encode_event(event_type, payload, event_id=None):
+    """Formats one SSE frame."""
+    lines = []
+    if event_id is not None:
+        lines.append(f"id: {event_id}")
+    lines.append(f"event: {event_type}")
+    lines.append(f"data: {json.dumps(payload, separators=(',', ':'))}")
+    return "\n".join(lines) + "\n\n"
+
+
+def publish_reading(reading, event_id=None):
+    """Fans a stored reading out to its device subscribers and fleet-wide subscribers."""
+    with _lock:
+        targets = list(_subscribers.get(reading['device_id'], ())) + list(_subscribers.get(FLEET_TOPIC, ()))
+    if not targets:
+        return 0
+
+    event = encode_event('reading', reading, event_id=event_id)
+    for sub in targets:
+        sub.offer(event)
+    return len(targets)
+
+
+def poll(engine, interval):
+    """
+    Publishes readings stored (by any process) since the last poll.
+    At most one query per interval per process; concurrent callers skip.
+    """
+    global _cursor, _published, _last_poll
+    if not _poll_lock.acquire(blocking=False):
+        return 0
+    try:
+        if time.monotonic() - _last_poll < interval or not subscriber_count():
+            return 0
+        _last_poll = time.monotonic()
+        # Own short session: the stream request must not hold a transaction open between polls
+        with Session(engine) as session:
+            rows = session.scalars(select(Reading).where(Reading.id > _cursor - GAP_WINDOW,
+                                                         Reading.id.not_in(_published))
+                                   .order_by(Reading.id).limit(POLL_BATCH)).all()
+            for row in rows:
+                publish_reading(row.to_dict(), event_id=row.id)
+        if rows:
+            _cursor = max(_cursor, rows[-1].id)
+            _published = {i for i in _published.union(row.id for row in rows) if i > _cursor - GAP_WINDOW}
+        return len(rows)
+    finally:
+        _poll_lock.release()
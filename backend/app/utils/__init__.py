@@ -0,0 +1,3 @@
+def iso_utc(ts):
+    """Naive UTC datetime -> ISO 8601 with 'Z' (None stays None)."""
+    return ts.isoformat() + 'Z' if ts else None
@@ -0,0 +1,89 @@
+// CPython binding of the firmware's counting library (firmware/lib/scale_core),
+// so the backend recounts stored readings with the scale's own code.
+//   import scale_core
+//   scale_core.count_items(weights, item_weight_g, counts)  # array('f') in, array('i') out
+//   scale_core.count(weight_g, item_weight_g) -> int
+// Build: pip install ./native (from backend/), see setup.py.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "scale_core.h"
+#include "scale_core.c" // The library itself: one translation unit keeps build output inside native/
+
+// Typed, contiguous view of obj (array('f'), array('i'), numpy arrays, memoryviews)
+static int get_buffer(PyObject *obj, Py_buffer *view, const char *name, const char *format, size_t itemsize, int flags) {
+    if (PyObject_GetBuffer(obj, view, flags | PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) {
+        return -1;
+    }
+    const char *actual = view->format ? view->format : "B";
+    if (actual[0] == '@' || actual[0] == '=') actual++; // Native byte order
+    if (view->itemsize != (Py_ssize_t)itemsize || strcmp(actual, format) != 0) {
+        PyErr_Format(PyExc_TypeError, "%s must hold '%s' items (e.g. array('%s'))", name, format, format);
+        PyBuffer_Release(view);
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *py_count_items(PyObject *self, PyObject *args) {
+    PyObject *weights_obj, *counts_obj;
+    float item_weight_g;
+    if (!PyArg_ParseTuple(args, "OfO:count_items", &weights_obj, &item_weight_g, &counts_obj)) {
+        return NULL;
+    }
+
+    Py_buffer weights, counts;
+    if (get_buffer(weights_obj, &weights, "weights", "f", sizeof(float), PyBUF_SIMPLE) < 0) {
+        return NULL;
+    }
+    if (get_buffer(counts_obj, &counts, "counts", "i", sizeof(int32_t), PyBUF_WRITABLE) < 0) {
+        PyBuffer_Release(&weights);
+        return NULL;
+    }
+
+    PyObject *result = NULL;
+    Py_ssize_t n = weights.len / (Py_ssize_t)sizeof(float);
+    if (counts.len / (Py_ssize_t)sizeof(int32_t) < n) {
+        PyErr_SetString(PyExc_ValueError, "counts is shorter than weights");
+    } else {
+        // Plain arithmetic on buffers we hold: other threads may run meanwhile
+        Py_BEGIN_ALLOW_THREADS
+        ScaleCore_CountItemsBatch((const float *)weights.buf, (size_t)n, item_weight_g, (int32_t *)counts.buf);
+        Py_END_ALLOW_THREADS
+        result = PyLong_FromSsize_t(n);
+    }
+    PyBuffer_Release(&weights);
+    PyBuffer_Release(&counts);
+    return result;
+}
+
+static PyObject *py_count(PyObject *self, PyObject *args) {
+    float weight_g, item_weight_g;
+    if (!PyArg_ParseTuple(args, "ff:count", &weight_g, &item_weight_g)) {
+        return NULL;
+    }
+    return PyLong_FromLong((long)ScaleCore_CountItems(weight_g, item_weight_g));
+}
+
+static PyMethodDef methods[] = {
+    {"count_items", py_count_items, METH_VARARGS,
+     "count_items(weights, item_weight_g, counts) -> n\n"
+     "Writes the item count of every float32 weight into the int32 buffer counts; returns how many."},
+    {"count", py_count, METH_VARARGS,
+     "count(weight_g, item_weight_g) -> int\nItem count of one weight, as on the scale."},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "scale_core", "Scale counting math shared with the firmware.", -1, methods
+};
+
+PyMODINIT_FUNC PyInit_scale_core(void) {
+    PyObject *m = PyModule_Create(&module);
+    if (m && PyModule_AddObject(m, "MIN_ITEM_WEIGHT_G", PyFloat_FromDouble(SCALE_CORE_MIN_ITEM_WEIGHT_G)) < 0) {
+        Py_DECREF(m);
+        return NULL;
+    }
+    return m;
+}
@@ -0,0 +1,26 @@
+"""
+Builds the scale_core extension: the firmware's counting library
+(firmware/lib/scale_core) compiled for the backend, used by
+app/services/recount.py. From backend/:
+    pip install ./native
+Without it the backend falls back to a pure Python port (same results, far slower).
+"""
+import os
+
+from setuptools import Extension, setup
+
+here = os.path.dirname(os.path.abspath(__file__))
+library = os.path.relpath(os.path.join(here, '..', '..', 'firmware', 'lib', 'scale_core'), here)
+
+setup(
+    name='scale-core',
+    version='1.0.0',
+    ext_modules=[Extension(
+        'scale_core',
+        sources=['scale_core_module.c'], # Includes the library source
+        include_dirs=[library],
+        # -O3 vectorizes the batch loop; without trapping math the compiler may evaluate
+        # both sides of its selects (only floating-point exception flags could tell)
+        extra_compile_args=['-O3', '-fno-trapping-math'],
+    )],
+)
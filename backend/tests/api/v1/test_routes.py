@@ -0,0 +1,512 @@
+import datetime
+import gzip
+import json
+import os
+import time
+from array import array
+
+import pytest
+from sqlalchemy.orm import make_transient
+
+from app import create_app, db
+from app.models import ArchivePartition, Reading, RollupDeviceState
+from app.services import command_queue, data_handler, mqtt_bridge, recount, retention, stream_broker
+
+
+@pytest.fixture
+def client():
+    app = create_app('testing') # Fresh in-memory database per test
+    with app.test_client() as client:
+        yield client
+
+
+def make_reading(device_id='SCALE_1', **overrides):
+    reading = {
+        "device_id": device_id,
+        "weight_grams": 105.0,
+        "item_count": 10,
+        "is_stable": True,
+        "is_overload": False,
+        "average_item_weight": 10.5,
+        "mode": "COUNTING",
+    }
+    reading.update(overrides)
+    return reading
+
+
+def test_receive_reading_missing_fields(client):
+    resp = client.post('/api/v1/reading', json={"device_id": "SCALE_1"})
+    assert resp.status_code == 400
+    assert "weight_grams" in resp.get_json()["errors"]
+
+
+def test_receive_and_get_readings(client):
+    assert client.post('/api/v1/reading', json=make_reading()).status_code == 201
+    resp = client.get('/api/v1/readings/SCALE_1')
+    assert resp.status_code == 200
+    assert resp.get_json()[0]["item_count"] == 10
+
+
+def test_rollups_aggregate_per_device(client):
+    client.post('/api/v1/reading', json=make_reading(item_count=10, weight_grams=105.0))
+    client.post('/api/v1/reading', json=make_reading(item_count=12, weight_grams=126.0))
+    client.post('/api/v1/reading', json=make_reading(is_overload=True, is_stable=False, item_count=0))
+    client.post('/api/v1/reading', json=make_reading('SCALE_2', item_count=3))
+
+    resp = client.get('/api/v1/rollups?resolution=day&device_id=SCALE_1')
+    assert resp.status_code == 200
+    buckets = resp.get_json()["buckets"]
+    assert len(buckets) == 1
+    bucket = buckets[0]
+    assert bucket["reading_count"] == 3
+    assert bucket["count_min"] == 0
+    assert bucket["count_max"] == 12
+    assert bucket["count_last"] == 0
+    assert bucket["overload_events"] == 1
+
+    resp = client.get('/api/v1/rollups?resolution=minute')
+    assert {b["device_id"] for b in resp.get_json()["buckets"]} == {"SCALE_1", "SCALE_2"}
+
+    # Stable again after an hour offline: only the capped gap counts as stable time
+    client.post('/api/v1/reading', json=make_reading('SCALE_3'))
+    with client.application.app_context():
+        db.session.get(RollupDeviceState, 'SCALE_3').last_epoch -= 3600
+        db.session.commit()
+    client.post('/api/v1/reading', json=make_reading('SCALE_3'))
+    bucket = client.get('/api/v1/rollups?resolution=day&device_id=SCALE_3').get_json()["buckets"][0]
+    assert bucket["stable_seconds"] == 30
+
+
+def test_rollups_rejects_unknown_resolution(client):
+    assert client.get('/api/v1/rollups?resolution=week').status_code == 400
+
+
+def test_export_streams_pages_and_gzip(client):
+    for count in range(5):
+        client.post('/api/v1/reading', json=make_reading(item_count=count))
+    client.post('/api/v1/reading', json=make_reading('SCALE_2'))
+
+    resp = client.get('/api/v1/export/SCALE_1')
+    assert resp.status_code == 200 and resp.mimetype == 'application/x-ndjson'
+    rows = [json.loads(line) for line in resp.get_data(as_text=True).splitlines()]
+    assert [r["item_count"] for r in rows] == [0, 1, 2, 3, 4] # Oldest first
+    assert "X-Next-Cursor" not in resp.headers
+
+    # Pages of two: follow the cursor until it runs out
+    counts, url = [], '/api/v1/export/SCALE_1?format=csv&limit=2'
+    while url:
+        resp = client.get(url)
+        lines = resp.get_data(as_text=True).splitlines()
+        assert lines[0].startswith("id,device_id,")
+        counts += [int(line.split(',')[5]) for line in lines[1:]]
+        url = resp.headers.get("Link", "").partition(">")[0].lstrip("<") or None
+        assert bool(url) == ("X-Next-Cursor" in resp.headers)
+    assert counts == [0, 1, 2, 3, 4]
+
+    # Resume after the last id received; gzip when accepted
+    resp = client.get(f'/api/v1/export/SCALE_1?after={rows[2]["id"]}', headers={"Accept-Encoding": "gzip"})
+    assert resp.headers["Content-Encoding"] == "gzip"
+    resumed = gzip.decompress(resp.get_data()).decode().splitlines()
+    assert [json.loads(line)["item_count"] for line in resumed] == [3, 4]
+
+    assert client.get('/api/v1/export/SCALE_1?format=xml').status_code == 400
+    assert client.get('/api/v1/export/SCALE_1?cursor=bogus').status_code == 400
+    assert client.get('/api/v1/export/SCALE_1?limit=0').status_code == 400
+
+
+def test_retention_compacts_into_archive_tier(client, tmp_path):
+    app = client.application
+    app.config['ARCHIVE_DIR'] = str(tmp_path)
+    now = datetime.datetime.utcnow()
+    day_a = now - datetime.timedelta(days=40)
+    day_b = now - datetime.timedelta(days=35)
+
+    def post(received=None, **fields):
+        client.post('/api/v1/reading', json=make_reading(**fields))
+        if received:
+            with app.app_context():
+                newest = db.session.scalar(db.select(db.func.max(Reading.id)))
+                db.session.execute(db.update(Reading).where(Reading.id == newest).values(server_timestamp=received))
+                db.session.commit()
+
+    post(day_a, item_count=1, weight_grams=10.5, timestamp=1700000000123)
+    post(day_a + datetime.timedelta(seconds=1), item_count=2, average_item_weight=None)
+    post(day_b, item_count=3, mode="WEIGHING", is_stable=False)
+    post(day_a, device_id='SCALE_2')
+    for count in (4, 5, 6):
+        post(item_count=count)
+
+    def export(query=''):
+        rows, url = [], f'/api/v1/export/SCALE_1?{query}'
+        while url:
+            resp = client.get(url)
+            rows += [json.loads(line) for line in resp.get_data(as_text=True).splitlines()]
+            url = resp.headers.get("Link", "").partition(">")[0].lstrip("<") or None
+        return rows
+
+    raw_readings = client.get('/api/v1/readings/SCALE_1?limit=100').get_json()
+    raw_export = export()
+    with app.app_context():
+        result = retention.apply_retention(raw_days=30)
+        assert (result["partitions_written"], result["readings_archived"]) == (3, 4)
+        assert db.session.scalar(db.select(db.func.count(Reading.id))) == 3 # Only the retention window stays raw
+
+    # Both tiers read as one, lossless
+    assert client.get('/api/v1/readings/SCALE_1?limit=100').get_json() == raw_readings
+    assert client.get('/api/v1/readings/SCALE_1?limit=4').get_json() == raw_readings[:4]
+    assert export() == raw_export
+    assert export('limit=2') == raw_export # Pages across the tier boundary
+    assert export(f'start={day_b.date()}T00:00:00Z') == raw_export[2:]
+    for bound in ('start=1700000000', 'end=2026'): # Not ISO 8601: refused rather than exporting everything
+        assert client.get(f'/api/v1/export/SCALE_1?{bound}').status_code == 400
+    assert export(f'after={raw_export[0]["id"]}&limit=1') == raw_export[1:]
+
+    # A late reading for an archived day is merged into a new version of its file
+    post(day_a + datetime.timedelta(seconds=2), item_count=7)
+    with app.app_context():
+        assert retention.apply_retention(raw_days=30)["readings_archived"] == 3
+        partition = db.session.get(ArchivePartition, ('SCALE_1', day_a.date()))
+        assert partition.row_count == 3
+    assert len(list(tmp_path.rglob('*.rca'))) == 3
+    assert sorted(r["item_count"] for r in export()) == [1, 2, 3, 4, 5, 6, 7]
+
+    with app.app_context():
+        assert retention.apply_retention(raw_days=30, archive_days=7)["partitions_dropped"] == 2 # Day A, both devices
+    assert [r["item_count"] for r in export()] == [3, 4, 5, 6]
+    assert len(list(tmp_path.rglob('*.rca'))) == 1
+
+
+def test_archive_keeps_dot_device_ids_inside_archive_dir(client, tmp_path):
+    app = client.application
+    app.config['ARCHIVE_DIR'] = str(tmp_path / 'archive')
+    received = datetime.datetime.utcnow() - datetime.timedelta(days=40)
+    for device_id in ('..', '.', 'a.b'):
+        client.post('/api/v1/reading', json=make_reading(device_id))
+    with app.app_context():
+        db.session.execute(db.update(Reading).values(server_timestamp=received))
+        db.session.commit()
+        assert retention.apply_retention(raw_days=30)["partitions_written"] == 3
+        assert db.session.get(ArchivePartition, ('..', received.date())).row_count == 1
+    archive_dir = tmp_path / 'archive'
+    assert sorted(p.relative_to(archive_dir).parts[0] for p in archive_dir.rglob('*.rca')) == ['%2E', '%2E%2E', 'a.b']
+    assert list(tmp_path.iterdir()) == [archive_dir]
+
+
+def test_stream_fanout_per_device_and_fleet(client):
+    client.post('/api/v1/reading', json=make_reading('SCALE_1')) # Before subscribing: not streamed
+    with client.application.app_context():
+        device_sub = stream_broker.subscribe('SCALE_1')
+        fleet_sub = stream_broker.subscribe()
+    try:
+        client.post('/api/v1/reading', json=make_reading('SCALE_1', item_count=11))
+        client.post('/api/v1/reading', json=make_reading('SCALE_2'))
+
+        event = device_sub.next_event(timeout=1) # Picked up from the table, as from another worker
+        assert '"device_id":"SCALE_1"' in event and '"item_count":11' in event
+        assert event.startswith("id: 2\n")
+        assert device_sub.next_event(timeout=0.01) is None
+        assert '"SCALE_1"' in fleet_sub.next_event(timeout=1)
+        assert '"SCALE_2"' in fleet_sub.next_event(timeout=1)
+    finally:
+        stream_broker.unsubscribe(device_sub)
+        stream_broker.unsubscribe(fleet_sub)
+    assert stream_broker.subscriber_count() == 0
+
+
+def test_stream_picks_up_late_commits_below_cursor(client):
+    with client.application.app_context():
+        sub = stream_broker.subscribe('SCALE_1')
+    try:
+        client.post('/api/v1/reading', json=make_reading(item_count=1)) # id 1, committed late below
+        client.post('/api/v1/reading', json=make_reading(item_count=2)) # id 2
+        with client.application.app_context():
+            late = db.session.get(Reading, 1)
+            db.session.delete(late)
+            db.session.commit()
+            make_transient(late)
+        assert sub.next_event(timeout=1).startswith("id: 2\n")
+
+        with client.application.app_context():
+            db.session.add(late)
+            db.session.commit()
+        assert sub.next_event(timeout=1).startswith("id: 1\n")
+        assert sub.next_event(timeout=0.6) is None # Re-scanned window does not repeat events
+    finally:
+        stream_broker.unsubscribe(sub)
+
+
+def test_accumulation_lots_stored_once(client):
+    lot = {"device_id": "SCALE_1", "lot_id": 7, "sku": "SKU-7", "item_weight": 2.5,
+           "total": 1234, "loads": 9, "closed": 1700000000000}
+    assert client.post('/api/v1/lot', json=lot).status_code == 201
+    assert client.post('/api/v1/lot', json=lot).status_code == 200 # Resend after a lost reply
+    mqtt_bridge.handle_message(client.application, 'scales/SCALE_1/lots',
+                               json.dumps(dict(lot, lot_id=8, total=40, loads=1, closed=0)))
+    assert client.post('/api/v1/lot', json={"device_id": "SCALE_1", "lot_id": 9}).status_code == 400
+
+    lots = client.get('/api/v1/lots/SCALE_1').get_json()
+    assert [(l["lot_id"], l["total"], l["loads"]) for l in lots] == [(8, 40, 1), (7, 1234, 9)]
+    assert lots[1]["closed_at"] == "2023-11-14T22:13:20Z" and lots[0]["closed_at"] is None
+    assert client.get('/api/v1/lots/SCALE_1?limit=-5').status_code == 400
+
+
+def test_command_piggybacked_until_acked(client):
+    resp = client.post('/api/v1/command/SCALE_1', json={"command": "set_piece_weight", "args": {"grams": "2.5"}})
+    assert resp.status_code == 201
+    command_id = resp.get_json()["id"]
+
+    commands = client.post('/api/v1/reading', json=make_reading()).get_json()["commands"]
+    assert commands == [{"id": command_id, "cmd": "set_piece_weight", "args": {"grams": 2.5}}]
+
+    # Not acknowledged yet: delivered again
+    assert client.post('/api/v1/reading', json=make_reading()).get_json()["commands"][0]["id"] == command_id
+
+    resp = client.post('/api/v1/reading', json=make_reading(acked_commands=[command_id]))
+    assert resp.get_json()["commands"] == []
+    assert client.get('/api/v1/commands/SCALE_1').get_json()[0]["status"] == "acked"
+
+
+def test_command_never_acked_expires(client):
+    stuck = client.post('/api/v1/command/SCALE_1', json={"command": "tare"}).get_json()["id"]
+    later = client.post('/api/v1/command/SCALE_1', json={"command": "calibrate_save"}).get_json()["id"]
+    for _ in range(command_queue.MAX_DELIVERIES):
+        ids = [c["id"] for c in client.post('/api/v1/reading', json=make_reading()).get_json()["commands"]]
+        assert ids == [stuck, later]
+
+    # The device never acked either: both give up, the queue is free for new commands
+    assert client.post('/api/v1/reading', json=make_reading()).get_json()["commands"] == []
+    assert [c["status"] for c in client.get('/api/v1/commands/SCALE_1').get_json()] == ["expired", "expired"]
+    fresh = client.post('/api/v1/command/SCALE_1', json={"command": "tare"}).get_json()["id"]
+    assert [c["id"] for c in client.post('/api/v1/reading', json=make_reading()).get_json()["commands"]] == [fresh]
+
+
+def test_command_replies_fit_device_buffer(client):
+    device_id = 'SCALE_' + 'X' * 58 # Longest device id
+    band = {"command": "set_check_target",
+            "args": {"sku": "S" * 15, "target": 4999.123456, "under": 99.123456, "over": 99.123456, "unit": "count"}}
+    queued = [client.post(f'/api/v1/command/{device_id}', json=band).get_json()["id"] for _ in range(4)]
+
+    delivered = []
+    while len(delivered) < len(queued):
+        resp = client.post('/api/v1/reading', json=make_reading(device_id, acked_commands=delivered))
+        assert len(resp.data) < command_queue.DEVICE_REPLY_BUFFER_BYTES
+        commands = resp.get_json()["commands"]
+        assert commands
+        delivered += [command["id"] for command in commands]
+    assert delivered == queued
+
+    mqtt_reply = json.dumps({"commands": command_queue.take_pending_for_delivery(device_id)}, separators=(',', ':'))
+    assert len(mqtt_reply) < command_queue.DEVICE_REPLY_BUFFER_BYTES
+
+
+def test_command_validation(client):
+    assert client.post('/api/v1/command/SCALE_1', json={"command": "explode"}).status_code == 400
+    assert client.post('/api/v1/command/SCALE_1', json={"command": "set_sku", "args": {"sku": "A1"}}).status_code == 400
+    for sku in ('A"1', 'A\\1', 'A 1'):
+        assert client.post('/api/v1/command/SCALE_1', json={"command": "set_sku", "args": {"sku": sku, "grams": 2}}).status_code == 400
+    for grams in ("inf", "nan", "-inf", 1e9):
+        assert client.post('/api/v1/command/SCALE_1', json={"command": "set_piece_weight", "args": {"grams": grams}}).status_code == 400
+    assert client.post('/api/v1/command/SCALE_1', json={"command": "tare", "args": [1]}).status_code == 400
+    assert client.get('/api/v1/command/SCALE_1?wait=0').get_json()["commands"] == []
+    trace = {"command": "start_trace", "args": {"seconds": 30, "host": "10.0.0.5", "port": "5005"}}
+    assert client.post('/api/v1/command/SCALE_1', json=trace).get_json()["args"] == {"seconds": 30, "host": "10.0.0.5", "port": 5005}
+    trace["args"]["host"] = "collector.local"
+    assert client.post('/api/v1/command/SCALE_1', json=trace).status_code == 400
+    band = {"command": "set_check_target", "args": {"sku": "A1", "target": "10", "under": 0, "over": 1, "unit": "count"}}
+    assert client.post('/api/v1/command/SCALE_1', json=band).get_json()["args"] == \
+        {"sku": "A1", "target": 10.0, "under": 0.0, "over": 1.0, "unit": "count"}
+    band["args"]["under"] = 12
+    assert client.post('/api/v1/command/SCALE_1', json=band).status_code == 400
+
+
+def test_device_health_fleet_summary(client):
+    record = {"device_id": "SCALE_1", "fw": "1.1.0", "up": 600, "cpu": [12, 3, 5], "idle": [70, 85],
+              "stk": [1800, 900, 1500], "heap": 150000, "heap_min": 120000, "frag": 10,
+              "miss": 2, "jit": 800, "rssi": -61, "recon": 1, "chk": [40, 3, 36, 210, 650]}
+    assert client.post('/api/v1/device_health', json=record).status_code == 201
+    assert client.post('/api/v1/device_health', json=dict(record, device_id="SCALE_2", heap_min=90000, miss=0)).status_code == 201
+    assert client.post('/api/v1/device_health', json=dict(record, device_id="SCALE_3", fw="1.0.0")).status_code == 201
+    assert client.post('/api/v1/device_health', json={"device_id": "SCALE_1"}).status_code == 400
+
+    history = client.get('/api/v1/device_health/SCALE_1').get_json()
+    assert history[0]["task_cpu_pct"] == {"sensor": 12, "ui": 3, "comms": 5}
+    assert history[0]["checkweigh"]["latency_max_ms"] == 650
+    assert client.get('/api/v1/device_health/SCALE_1?limit=0').status_code == 400
+
+    summary = client.get('/api/v1/device_health').get_json()
+    assert summary["1.1.0"]["device_count"] == 2
+    assert summary["1.1.0"]["heap_min_free_min"] == 90000
+    assert summary["1.1.0"]["sensor_deadline_misses_total"] == 2
+    assert summary["1.0.0"]["devices"] == ["SCALE_3"]
+
+
+def test_latency_trace_stages(client):
+    now = int(time.time() * 1000)
+    trace = {"sampled": now - 500, "stable": now - 800, "enqueued": now - 300}
+    client.post('/api/v1/reading', json=make_reading(timestamp=now - 500, trace=trace, sent=now - 300))
+    client.post('/api/v1/reading', json=make_reading(timestamp="123456")) # Pre-SNTP firmware: uptime ticks
+    client.post('/api/v1/reading', json=make_reading('SCALE_2', trace={"sampled": now - 100, "enqueued": now - 50}))
+
+    readings = client.get('/api/v1/readings/SCALE_1').get_json()
+    assert readings[0]["device_timestamp"] is None and "trace" not in readings[0]
+    assert readings[1]["device_timestamp"].endswith("Z")
+    assert readings[1]["trace"]["stored"] >= readings[1]["trace"]["received"] >= now
+
+    stages = client.get('/api/v1/latency/SCALE_1').get_json()["stages"]
+    assert stages["device_queue"]["p50_ms"] == 200
+    assert stages["batching"]["max_ms"] == 0
+    assert stages["end_to_end"]["count"] == 1 and stages["end_to_end"]["min_ms"] >= 500
+    assert stages["settle_to_stored"]["min_ms"] >= 800
+
+    fleet = client.get('/api/v1/latency').get_json()
+    assert fleet["fleet"]["device_queue"]["count"] == 2
+    assert "settle_to_stored" not in fleet["devices"]["SCALE_2"]
+
+
+def test_sequence_duplicates_and_gaps(client):
+    client.application.config['SEQUENCE_REORDER_WINDOW'] = 4
+
+    def post(seq, **fields):
+        return client.post('/api/v1/reading', json=make_reading(seq=seq, **fields))
+
+    assert post(1).status_code == 201
+    retry = post(1) # Retransmission after a lost reply
+    assert retry.status_code == 200 and retry.get_json()["duplicate"] is True
+    assert [post(seq).status_code for seq in (3, 2, 5, 10)] == [201] * 4 # 2 overtaken by 3, 4 and 6..9 missing
+    assert post(4).status_code == 200 # Older than the window: cannot be told from a duplicate
+    assert post(20, boot_seq=20).status_code == 201 # Reboot skipped 11..19: not lost
+    assert post(0, boot_seq=0).status_code == 201 # Counter went backwards (NVS erased): start over
+
+    status = client.get('/api/v1/sequence/SCALE_1').get_json()
+    assert len(client.get('/api/v1/readings/SCALE_1?limit=100').get_json()) == status["received"] == 7
+    assert (status["duplicates"], status["stale"], status["out_of_order"], status["resets"]) == (1, 1, 1, 1)
+    assert status["lost"] == 5
+    assert [(g["first_seq"], g["last_seq"]) for g in status["gaps"]] == [(7, 9), (6, 6), (4, 4)]
+    assert client.get('/api/v1/rollups?resolution=day').get_json()["buckets"][0]["reading_count"] == 7
+
+    # QoS 1 redelivery of a whole batch stores nothing twice
+    batch = json.dumps({"readings": [make_reading(seq=7), make_reading(seq=8)], "boot_seq": 7})
+    for _ in range(2):
+        mqtt_bridge.handle_message(client.application, 'scales/SCALE_2/readings', batch)
+    assert len(client.get('/api/v1/readings/SCALE_2').get_json()) == 2
+    fleet = client.get('/api/v1/sequence').get_json()
+    assert [(d["device_id"], d["duplicates"], d["lost"]) for d in fleet] == [("SCALE_1", 1, 5), ("SCALE_2", 2, 0)]
+    assert client.get('/api/v1/sequence/UNKNOWN').status_code == 404
+
+
+def test_anomaly_alerts_on_ingest(client):
+    client.application.config.update(ANOMALY_EWMA_ALPHA=0.5, ANOMALY_WARMUP_READINGS=3, ANOMALY_STUCK_READINGS=4)
+
+    def post(**fields):
+        assert client.post('/api/v1/reading', json=make_reading(**fields)).status_code == 201
+
+    for _ in range(5): # Empty pan reading +2 g: tare drifted
+        post(weight_grams=2.0, item_count=0, mode="WEIGHING")
+    for count in (10, 11, 12, 13, 2): # Small steps, then a sudden drop (accumulating counts too)
+        post(weight_grams=count * 10.5, item_count=count, mode="ACCUMULATE")
+    for _ in range(4): # Loaded pan, bit-identical weight
+        post(weight_grams=300.0, item_count=28)
+    post(weight_grams=301.0, item_count=28)
+    post(weight_grams=330.0, item_count=30, average_item_weight=11.0) # New piece weight
+
+    alerts = client.get('/api/v1/alerts?device_id=SCALE_1').get_json()
+    assert [(a["kind"], a["cleared_at"] is None) for a in alerts] == [
+        ("stuck_sensor", False), ("count_drop", True), ("zero_drift", True)]
+    assert alerts[1]["value"] == 11
+    assert [a["kind"] for a in client.get('/api/v1/alerts?active=1').get_json()] == ["zero_drift"]
+    assert client.get('/api/v1/alerts?limit=-1').status_code == 400
+
+    stats = client.get('/api/v1/anomaly/SCALE_1').get_json()
+    assert stats["readings"] == 16 and stats["active_alerts"] == ["zero_drift"]
+    assert stats["zero_drift_g"] > 1.0 and stats["item_weight_changes"] == 1
+    assert client.get('/api/v1/anomaly/UNKNOWN').status_code == 404
+
+
+def test_recount_after_piece_weight_correction(client):
+    client.post('/api/v1/reading', json=make_reading(weight_grams=105.0, item_count=10))
+    client.post('/api/v1/reading', json=make_reading(weight_grams=126.0, item_count=12, mode="ACCUMULATE"))
+    client.post('/api/v1/reading', json=make_reading(weight_grams=130.0, item_count=12, is_stable=False)) # Held count
+    client.post('/api/v1/reading', json=make_reading(weight_grams=50.0, item_count=0, mode="WEIGHING"))
+    client.post('/api/v1/reading', json=make_reading('SCALE_2'))
+
+    resp = client.post('/api/v1/recount/SCALE_1', json={"item_weight_g": 10.0})
+    assert resp.status_code == 200
+    result = resp.get_json()
+    assert (result["recounted"], result["changed"]) == (2, 2)
+
+    readings = client.get('/api/v1/readings/SCALE_1').get_json()
+    assert [r["item_count"] for r in readings] == [0, 12, 13, 11] # 10.5 pieces round up, as on the scale
+    assert [r["average_item_weight"] for r in readings] == [10.5, 10.5, 10.0, 10.0]
+    bucket = client.get('/api/v1/rollups?resolution=day&device_id=SCALE_1').get_json()["buckets"][0]
+    assert (bucket["count_min"], bucket["count_max"], bucket["count_last"]) == (0, 13, 0)
+    assert client.get('/api/v1/readings/SCALE_2').get_json()[0]["item_count"] == 10
+
+    assert client.post('/api/v1/recount/SCALE_1', json={"item_weight_g": 0}).status_code == 400
+    assert client.post('/api/v1/recount/SCALE_1', json={}).status_code == 400
+    for bound in (1700000000, "1700000000", "2026", True):
+        # Not ISO 8601: refused rather than recounting the whole history
+        assert client.post('/api/v1/recount/SCALE_1', json={"item_weight_g": 9.0, "start": bound}).status_code == 400
+    assert [r["average_item_weight"] for r in client.get('/api/v1/readings/SCALE_1').get_json()] == [10.5, 10.5, 10.0, 10.0]
+
+
+def _python_counts(weights, item_weight_g):
+    counts = array('i', bytes(4 * len(weights)))
+    recount._count_items_python(array('f', weights), item_weight_g, counts)
+    return counts
+
+
+def test_recount_counting_matches_firmware():
+    # Python fallback: float32 arithmetic like the scale (8.75 / 2.5 is 3.5: away from zero)
+    weights = [52.6, 1.25, 1.2499999, 8.75, -3.0, float('nan'), 1e30]
+    assert list(_python_counts(weights, 2.5)) == [21, 1, 0, 4, 0, 0, 2147483520]
+    assert list(_python_counts(weights, 0.0)) == [0] * len(weights)
+
+    if recount._native is None:
+        pytest.skip("scale_core extension not built (pip install ./native)")
+    sweep = [i * 0.0625 + 0.01 * (i % 7) for i in range(-100, 20000)]
+    for item_weight in (2.5, 0.37, 12.5):
+        assert recount.count_items(sweep, item_weight) == _python_counts(sweep, item_weight)
+
+
+def test_mqtt_bridge_batch_uses_reading_ingest(client):
+    app = client.application
+    command_id = client.post('/api/v1/command/SCALE_1', json={"command": "tare"}).get_json()["id"]
+
+    batch = {"readings": [make_reading(device_id='SPOOFED'), make_reading(weight_grams=210.0), {"mode": "COUNTING"}]}
+    replies = mqtt_bridge.handle_message(app, 'scales/SCALE_1/readings', json.dumps(batch).encode())
+    readings = client.get('/api/v1/readings/SCALE_1').get_json()
+    assert [r["weight_grams"] for r in readings] == [210.0, 105.0] # Invalid entry skipped, topic wins
+    assert replies == [('scales/SCALE_1/cmd', json.dumps({"commands": [{"id": command_id, "cmd": "tare", "args": {}}]},
+                                                         separators=(',', ':')))]
+
+    batch = {"readings": [{"mode": "COUNTING"}, make_reading()], "acked_commands": [command_id]} # Acks survive an invalid first reading
+    assert mqtt_bridge.handle_message(app, 'scales/SCALE_1/readings', json.dumps(batch)) == []
+    assert client.get('/api/v1/commands/SCALE_1').get_json()[0]["status"] == "acked"
+    assert mqtt_bridge.handle_message(app, 'other/SCALE_1/readings', b'{}') == []
+    assert mqtt_bridge.handle_message(app, 'scales/SCALE_1/readings', b'not json') == []
+
+
+@pytest.mark.skipif(not os.environ.get('MQTT_TEST_BROKER'), reason="set MQTT_TEST_BROKER=host to run against a local broker")
+def test_mqtt_bridge_local_broker(client):
+    import paho.mqtt.client as mqtt
+    app = client.application
+    app.config.update(MQTT_BROKER_HOST=os.environ['MQTT_TEST_BROKER'], MQTT_CLIENT_ID='scale-backend-test')
+    bridge = mqtt_bridge.MqttBridge(app)
+    bridge.start()
+    try:
+        scale = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id='SCALE_MQTT_TEST')
+        scale.connect(app.config['MQTT_BROKER_HOST'], app.config['MQTT_BROKER_PORT'])
+        scale.loop_start()
+        time.sleep(1) # Let the bridge subscribe
+        scale.publish('scales/SCALE_MQTT_TEST/readings', json.dumps({"readings": [make_reading()]}), qos=1).wait_for_publish(5)
+        with app.app_context():
+            for _ in range(50):
+                if data_handler.get_device_readings('SCALE_MQTT_TEST'):
+                    break
+                db.session.rollback() # New snapshot
+                time.sleep(0.1)
+            assert len(data_handler.get_device_readings('SCALE_MQTT_TEST')) == 1
+        scale.loop_stop()
+        scale.disconnect()
+    finally:
+        bridge.stop()
@@ -7,3 +7,13 @@ application = create_app(os.getenv('FLASK_CONFIG') or 'default')
 
 # You might add more production-specific setup here if needed,
 # but usually Gunicorn/uWSGI handles the server aspects.
+#
+# The app keeps no state in process memory (everything is in the database
+# at SQLALCHEMY_DATABASE_URI), so it scales by adding workers:
+#   FLASK_CONFIG=production DATABASE_URL=postgresql://... \
+#       gunicorn -w 8 --preload -b 0.0.0.0:5000 wsgi:application
+#   FLASK_CONFIG=production DATABASE_URL=... flask mqtt-bridge  # once, if scales use MQTT
+# Each worker has its own connection pool (DB_POOL_SIZE / DB_MAX_OVERFLOW).
+# Live streams (/api/v1/stream) hold a worker each; use a threaded or gevent
+# worker class when serving many dashboards. tools/ingest_benchmark.py
+# measures ingest throughput against the worker count.
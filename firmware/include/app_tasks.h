@@ -0,0 +1,76 @@
+#ifndef APP_TASKS_H
+#define APP_TASKS_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// --- Task Placement Plan (dual-core ESP32) ---
+// Core 1 (APP_CPU) is reserved for acquisition: the sensor/filter pipeline runs
+// there at the highest application priority and nothing else is pinned to it.
+// Core 0 (PRO_CPU) carries Wi-Fi, lwIP/TCP, HTTP, the display and buttons.
+// The Wi-Fi/lwIP side of the split is set in sdkconfig.defaults.
+#define APP_CORE_ACQUISITION 1
+#define APP_CORE_NETWORK_UI  0
+
+// Task stacks are statically allocated (bytes). Check headroom with the
+// memory report (mem_report.h) before shrinking any of these.
+#define SENSOR_TASK_STACK_BYTES 4096
+#define UI_TASK_STACK_BYTES     2048
+#define COMMS_TASK_STACK_BYTES  4096
+#define TRACE_TASK_STACK_BYTES  3072 // Created on first start_trace (diag_trace.c), not in app_task_table
+#define TRACE_TASK_PRIORITY     3    // Below comms; pinned to APP_CORE_NETWORK_UI
+#define DLOG_TASK_STACK_BYTES   3072 // Deferred log formatter (dlog.c), not in app_task_table
+#define DLOG_TASK_PRIORITY      1    // Just above idle; pinned to APP_CORE_NETWORK_UI
+
+typedef enum {
+    APP_TASK_SENSOR = 0,
+    APP_TASK_UI,
+    APP_TASK_COMMS,
+    APP_TASK_COUNT
+} AppTaskId_t;
+
+typedef struct {
+    TaskFunction_t function;
+    const char *name;
+    uint32_t stack_size;  // Bytes (ESP-IDF convention)
+    UBaseType_t priority; // Higher number = higher priority
+    BaseType_t core;      // Core affinity, or tskNO_AFFINITY
+    StackType_t *stack;   // Static stack of stack_size bytes
+    StaticTask_t *tcb;    // Static task control block
+} AppTaskConfig_t;
+
+// Single source of truth for task name, stack, priority and core (defined in main.c)
+extern const AppTaskConfig_t app_task_table[APP_TASK_COUNT];
+// Handles of the created tasks (NULL until app_main has created them)
+extern TaskHandle_t app_task_handles[APP_TASK_COUNT];
+
+// Task entry points (src/tasks/)
+void sensor_task(void *pvParameters);
+void ui_task(void *pvParameters);
+void comms_task(void *pvParameters);
+
+// --- Sensor Period Instrumentation ---
+// Measured between successive releases of the sensor loop (esp_timer, us).
+typedef struct {
+    uint32_t periods;          // Number of measured periods
+    uint32_t period_min_us;
+    uint32_t period_max_us;
+    uint64_t period_sum_us;    // For the mean: period_sum_us / periods
+    uint32_t jitter_max_us;    // Max |period - nominal|
+    uint32_t deadline_misses;  // Periods longer than nominal + SENSOR_DEADLINE_SLACK_US
+
+    // Check-weighing decision latency: pack arrival -> decision (ms)
+    uint32_t decisions;
+    uint32_t decisions_rejected;       // Under, over and undecided (gate fired)
+    uint32_t decisions_early;          // Made before the generic stability window settled
+    uint32_t decision_latency_min_ms;
+    uint32_t decision_latency_max_ms;
+    uint64_t decision_latency_sum_ms;  // For the mean: decision_latency_sum_ms / decisions
+} SensorTimingStats_t;
+
+void SensorTask_GetTimingStats(SensorTimingStats_t *out);
+void SensorTask_ResetTimingStats(void);
+void SensorTask_LogTimingStats(void);
+
+#endif // APP_TASKS_H
@@ -0,0 +1,26 @@
+#ifndef BOOT_TIMING_H
+#define BOOT_TIMING_H
+
+#include <stdint.h>
+
+// Boot-phase timestamps (us since the app started), each recorded once
+// by whichever task reaches the phase. Logged once Wi-Fi is up.
+typedef enum {
+    BOOT_PHASE_APP_START,       // app_main entered
+    BOOT_PHASE_STORAGE,         // NVS ready
+    BOOT_PHASE_LOADCELL,        // Load cell HAL ready
+    BOOT_PHASE_CONFIG,          // Config snapshot restored
+    BOOT_PHASE_TASKS,           // All tasks created
+    BOOT_PHASE_FIRST_READING,   // First load cell conversion processed
+    BOOT_PHASE_FIRST_STABLE,    // First stable weight (count can be shown)
+    BOOT_PHASE_DISPLAY,         // Display initialized (UI task)
+    BOOT_PHASE_WIFI_INIT,       // Wi-Fi stack initialized (comms task)
+    BOOT_PHASE_WIFI_CONNECTED,  // Backend reachable
+    BOOT_PHASE_COUNT
+} BootPhase_t;
+
+void BootTiming_Mark(BootPhase_t phase); // First mark per phase wins; safe from any task
+uint32_t BootTiming_GetUs(BootPhase_t phase); // 0 if not reached yet
+void BootTiming_Log(void);
+
+#endif // BOOT_TIMING_H
@@ -0,0 +1,27 @@
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include <stdbool.h>
+#include "scale_config.h"
+
+// Multi-point calibration. Reference weights are captured against the
+// scalar-calibrated weight, stored in NVS and compiled into the load cell
+// HAL's linearization table, so the per-sample cost is a table lookup no
+// matter how many points were taken. Between the captured points the
+// correction is piecewise linear through (0, 0) and every point; beyond
+// the last point the last segment is extrapolated.
+void Calibration_Init(void);                  // Load stored points and install the table (after hal_LoadCell_Init)
+bool Calibration_AddPoint(float reference_g); // Capture the current load as a reference weight (caller checks stability)
+bool Calibration_Save(void);                  // Validate, persist and activate the captured points
+void Calibration_Clear(void);                 // Drop the correction (scalar factor only) and erase it from NVS
+int Calibration_GetPointCount(void);          // Points in the active calibration
+
+// Corner calibration (multi-cell platforms). The same test weight is put
+// on each corner of the tared platform in turn; the per-channel corrections
+// that make every corner read the same are solved from the captures and
+// stored in NVS. Do this before taking the points above, which are
+// captured through the corrected sum.
+bool Calibration_AddCorner(int corner);       // Capture every channel's response to the weight on this corner
+bool Calibration_SaveCorners(void);           // Solve, persist and apply the corrections (needs every corner)
+
+#endif // CALIBRATION_H
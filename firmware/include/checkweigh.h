@@ -0,0 +1,86 @@
+#ifndef CHECKWEIGH_H
+#define CHECKWEIGH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "scale_config.h"
+
+// Check-weighing (MODE_CHECKWEIGH): one pass/under/over decision per pack
+// against the active SKU's target band. Decisions are made on a filtered
+// signal as soon as the result is unambiguous: the weight the filter is
+// heading for must lie inside one zone by at least CHECK_HYSTERESIS_G plus
+// a guard for how fast it is still moving, for CHECK_CONFIRM_SAMPLES in a
+// row. Clear passes and rejects are therefore decided while the generic
+// stability window is still filling; only packs near a limit wait for it.
+// A pack is judged once and must leave the pan (presence hysteresis)
+// before the next one is armed.
+
+typedef enum {
+    CHECK_RESULT_NONE = 0,  // No decision (yet)
+    CHECK_RESULT_PASS,
+    CHECK_RESULT_UNDER,
+    CHECK_RESULT_OVER,
+    CHECK_RESULT_UNDECIDED, // Pack left before the result was clear (rejected, fail-safe)
+    CHECK_RESULT_COUNT
+} CheckResult_t;
+
+typedef enum {
+    CHECK_UNIT_GRAMS,
+    CHECK_UNIT_COUNT // Target and tolerances in items of the product's piece weight
+} CheckUnit_t;
+
+// Target band of one product, stored per SKU
+typedef struct {
+    char sku[SKU_MAX_LEN];
+    float target;
+    float under;  // Tolerance below target (same unit)
+    float over;   // Tolerance above target
+    uint8_t unit; // CheckUnit_t
+} CheckTarget_t;
+
+typedef enum {
+    CHECK_PHASE_EMPTY,     // Armed: the next pack on the pan is judged
+    CHECK_PHASE_MEASURING, // Pack arrived, result not clear yet
+    CHECK_PHASE_CLEARING   // Judged (or not to be judged): waiting for the pan to empty
+} CheckPhase_t;
+
+// Decision engine state (part of ScaleState_t, run by the sensor task)
+typedef struct {
+    bool enabled;         // MODE_CHECKWEIGH selected (kept through an overload)
+    float lower_g;        // Pass band, inclusive
+    float upper_g;
+    float present_g;      // Pack arrival threshold
+    float clear_g;        // Pack removal threshold (below present_g)
+    CheckPhase_t phase;
+    float filtered_g;     // Decision filter output
+    float slope_g;        // Filter change over the last sample
+    float projected_g;    // Where the filter settles if the input holds still
+    CheckResult_t candidate;
+    uint8_t candidate_samples;
+    uint32_t arrived_ms;  // Uptime of the first sample above present_g
+
+    // Last decision (the sensor task reports it when decisions changes)
+    CheckResult_t last_result;
+    float last_weight_g;
+    uint32_t last_latency_ms; // Pack arrival -> decision
+    bool last_early;          // Made before the generic stability window settled
+    uint32_t decisions;
+    uint32_t results[CHECK_RESULT_COUNT]; // Decisions per result since boot
+} CheckweighState_t;
+
+// Pass band in grams for a target. Count targets need the piece weight and
+// cover every weight that counts to an accepted number of items.
+bool Checkweigh_ResolveBand(const CheckTarget_t *target, float item_weight_g, float *lower_g, float *upper_g);
+void Checkweigh_Arm(CheckweighState_t *check, float lower_g, float upper_g); // New band; what is on the pan is not judged
+// One sample. Returns the decision made on it, CHECK_RESULT_NONE otherwise.
+CheckResult_t Checkweigh_Process(CheckweighState_t *check, float weight_g, bool is_overload, bool is_stable, uint32_t now_ms);
+const char *Checkweigh_ResultName(CheckResult_t result);
+
+// Per-SKU targets, kept in NVS. Set and looked up outside the sensor task.
+void Checkweigh_LoadTargets(void);                            // Once at boot, before ScaleLogic_LoadCheckweigh
+bool Checkweigh_SetTarget(const CheckTarget_t *target);       // Adds or replaces the SKU's band and persists it
+bool Checkweigh_FindTarget(const char *sku, CheckTarget_t *target);
+void Checkweigh_SaveActive(bool active);                      // Resume MODE_CHECKWEIGH after boot
+bool Checkweigh_WasActive(void);
+
+#endif // CHECKWEIGH_H
@@ -2,6 +2,7 @@
 #define COMMS_MANAGER_H
 
 #include "scale_logic.h" // Include for ScaleState_t
+#include "health_monitor.h" // Include for HealthRecord_t
 #include <stdbool.h>
 
 typedef enum {
@@ -16,6 +17,10 @@ void CommsManager_Init(void);
 CommsState_t CommsManager_GetCurrentState(void);
 void CommsManager_Connect(void); // Non-blocking request to connect
 void CommsManager_SendData(const ScaleState_t *state); // Formats and sends data if connected
+void CommsManager_SendHealth(const HealthRecord_t *record); // Sends a compact health record if connected
+bool CommsManager_SendLot(const LotRecord_t *lot); // Reports a closed lot; true once handed over
 void CommsManager_RunPeriodic(void); // Handles state machine logic (call this periodically from task)
+void CommsManager_ApplyPendingCommands(ScaleState_t *state); // Applies commands received in upload replies
+uint32_t CommsManager_GetReportIntervalMs(void); // Current upload interval (remotely adjustable)
 
 #endif // COMMS_MANAGER_H
@@ -0,0 +1,54 @@
+#ifndef DIAG_TRACE_H
+#define DIAG_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "scale_config.h"
+
+// On-demand raw diagnostic stream (remote start_trace command). Every
+// conversion the sensor task consumes is copied into a RAM ring by the load
+// cell sample hook; a low-priority task on the network core encodes the ring
+// into blocks and sends one UDP datagram per block, within
+// TRACE_MAX_BYTES_PER_S. If the network or the cap falls behind, the ring
+// overflows and samples are dropped (and counted), never the sensor period.
+//
+// Block layout (little endian), decoded by tools/trace_receiver.py:
+//   0  u16 magic DIAG_TRACE_MAGIC     12 u32 dropped: samples lost on the device so far
+//   2  u8  version                    16 u32 t0_ms: uptime of the first sample
+//   3  u8  channels                   20 u16 count: samples in the block
+//   4  u32 seq: gaps = lost blocks    22 u16 length: payload bytes
+//   8  u32 first_sample: index since the trace started
+// Payload, per sample: varint(ms since the previous sample), then per channel
+// varint(zigzag(raw - previous raw)). Both "previous" values start at 0 in
+// every block, so a lost datagram never corrupts the next one.
+#define DIAG_TRACE_MAGIC        0x5354 // "ST"
+#define DIAG_TRACE_VERSION      1
+#define DIAG_TRACE_HEADER_BYTES 24
+#define DIAG_TRACE_SAMPLE_MAX_BYTES (5 * (1 + LOADCELL_NUM_CHANNELS)) // Worst-case varints per sample
+
+typedef struct {
+    uint32_t t_ms;
+    int32_t raw[LOADCELL_NUM_CHANNELS];
+} DiagTraceSample_t;
+
+// Block encoder (used by the trace task; exposed for tests)
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    uint16_t count;
+    uint32_t prev_t_ms;
+    int32_t prev_raw[LOADCELL_NUM_CHANNELS];
+} DiagTraceBlock_t;
+
+void DiagTrace_BlockBegin(DiagTraceBlock_t *block, uint8_t *buf, size_t size,
+                          uint32_t seq, uint32_t first_sample, uint32_t dropped);
+bool DiagTrace_BlockAdd(DiagTraceBlock_t *block, const DiagTraceSample_t *sample); // false = block full
+size_t DiagTrace_BlockEnd(DiagTraceBlock_t *block); // Completes the header; returns the datagram length
+
+bool DiagTrace_Start(const char *host, uint16_t port, uint32_t seconds); // Extends a running trace
+void DiagTrace_Stop(void);
+bool DiagTrace_IsActive(void);
+
+#endif // DIAG_TRACE_H
@@ -0,0 +1,78 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "scale_config.h"
+#include "dlog_formats.h"
+
+// Deferred binary logging for hot paths. A call site records only a format
+// id, a timestamp and up to DLOG_MAX_ARGS raw 32-bit arguments into a
+// lock-free RAM ring (any task, either core); a task just above idle
+// formats the records later, or with DLOG_OUTPUT_BINARY prints them as hex
+// for tools/dlog_decode.py. Text output goes through esp_log_write, so the
+// usual per-tag runtime levels (esp_log_level_set) still apply.
+//   DLOG(DLOG_LC_OVERLOAD, weight_g);
+// When the ring is full new records are dropped and counted, never waited on.
+
+// Levels match esp_log_level_t
+#define DLOG_ERROR   1
+#define DLOG_WARN    2
+#define DLOG_INFO    3
+#define DLOG_DEBUG   4
+#define DLOG_VERBOSE 5
+
+#define DLOG_MAX_ARGS 4
+
+typedef enum {
+#define DLOG_ID_ENUM(id, level, tag, format) id,
+    DLOG_FORMATS(DLOG_ID_ENUM)
+#undef DLOG_ID_ENUM
+    DLOG_FORMAT_COUNT
+} DLogId_t;
+
+// <id>_LEVEL constants, so call sites below DLOG_RECORD_LEVEL compile away
+enum {
+#define DLOG_LEVEL_ENUM(id, level, tag, format) id##_LEVEL = level,
+    DLOG_FORMATS(DLOG_LEVEL_ENUM)
+#undef DLOG_LEVEL_ENUM
+};
+
+typedef struct {
+    uint32_t seq;          // Ring position + 1, written last (commit marker)
+    uint32_t timestamp_ms; // Uptime, as in ESP_LOG output
+    uint16_t id;           // DLogId_t
+    uint8_t nargs;
+    uint8_t reserved;
+    uint32_t args[DLOG_MAX_ARGS];
+} DLogRecord_t;
+
+void DLog_Init(void); // Starts the log task (call once, early in app_main)
+void DLog_Write(DLogId_t id, int nargs, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+bool DLog_Read(DLogRecord_t *record); // Oldest committed record (log task side); false if none
+int DLog_Format(const DLogRecord_t *record, char *buf, size_t size); // Message text without prefix
+uint32_t DLog_GetDropped(void);
+
+static inline uint32_t dlog_arg_float(double value) {
+    union { float f; uint32_t u; } bits = { .f = (float)value };
+    return bits.u;
+}
+
+static inline uint32_t dlog_arg_int(long long value) {
+    return (uint32_t)value;
+}
+
+#define DLOG_ARG(v) _Generic((v), float: dlog_arg_float, double: dlog_arg_float, default: dlog_arg_int)(v)
+
+#define DLOG_EMIT(id, n, a, b, c, d) \
+    do { if (id##_LEVEL <= DLOG_RECORD_LEVEL) DLog_Write((id), (n), (a), (b), (c), (d)); } while (0)
+#define DLOG0(id)             DLOG_EMIT(id, 0, 0, 0, 0, 0)
+#define DLOG1(id, a)          DLOG_EMIT(id, 1, DLOG_ARG(a), 0, 0, 0)
+#define DLOG2(id, a, b)       DLOG_EMIT(id, 2, DLOG_ARG(a), DLOG_ARG(b), 0, 0)
+#define DLOG3(id, a, b, c)    DLOG_EMIT(id, 3, DLOG_ARG(a), DLOG_ARG(b), DLOG_ARG(c), 0)
+#define DLOG4(id, a, b, c, d) DLOG_EMIT(id, 4, DLOG_ARG(a), DLOG_ARG(b), DLOG_ARG(c), DLOG_ARG(d))
+#define DLOG_SELECT(_0, _1, _2, _3, _4, name, ...) name
+#define DLOG(...) DLOG_SELECT(__VA_ARGS__, DLOG4, DLOG3, DLOG2, DLOG1, DLOG0, unused)(__VA_ARGS__)
+
+#endif // DLOG_H
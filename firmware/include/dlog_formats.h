@@ -0,0 +1,19 @@
+#ifndef DLOG_FORMATS_H
+#define DLOG_FORMATS_H
+
+// Deferred log format table (see dlog.h): X(id, level, tag, format)
+// Arguments are recorded as 32-bit values: integer conversions (%d %i %u %x %c,
+// length modifiers are ignored) and floating point (%f %e %g, recorded as
+// float). No %s: strings are not captured.
+// Record ids are positions in this table and tools/dlog_decode.py reads this
+// file to decode binary dumps, so append new entries at the end.
+#define DLOG_FORMATS(X) \
+    X(DLOG_LC_OVERLOAD,      DLOG_WARN,  "HAL_LOADCELL",  "Overload detected: %.2f g") \
+    X(DLOG_SENSOR_SAMPLE,    DLOG_DEBUG, "SENSOR_TASK",   "Raw Sensor: %ld, Weight: %.2fg, Stable: %d") \
+    X(DLOG_COMMS_SEND,       DLOG_INFO,  "COMMS_MANAGER", "Sending reading: %d bytes, %.2f g, %ld items, acks %d") \
+    X(DLOG_COMMS_SENT,       DLOG_INFO,  "COMMS_MANAGER", "Data sent successfully. Status: %d, reply %u bytes") \
+    X(DLOG_COMMS_MQTT_BATCH, DLOG_INFO,  "COMMS_MANAGER", "Queued batch of %d reading(s), %u bytes (msg %d).") \
+    X(DLOG_HTTP_STATUS,      DLOG_DEBUG, "HAL_WIFI",      "HTTP POST Status = %d, content_length = %ld") \
+    X(DLOG_CHECK_DECISION,   DLOG_INFO,  "SENSOR_TASK",   "Check result %d at %.2f g, %lu ms after arrival (early %d)")
+
+#endif // DLOG_FORMATS_H
@@ -11,6 +11,7 @@ typedef struct {
     bool is_stable;
     bool is_overload; // Based on raw reading potentially
     long raw_value;    // Raw ADC value (for diagnostics/calibration)
+    bool is_fresh;     // From a new conversion (false: the previous reading, repeated)
 } LoadCellReading_t;
 
 void hal_LoadCell_Init(float calibration_factor);
@@ -18,7 +19,36 @@ LoadCellReading_t hal_LoadCell_Read(float max_weight, float stable_threshold, in
 void hal_LoadCell_Tare(void); // Sets the zero offset
 void hal_LoadCell_SetCalibrationFactor(float factor);
 float hal_LoadCell_GetCalibrationFactor(void);
-long hal_LoadCell_GetOffset(void); // Get current tare offset value
+long hal_LoadCell_GetOffset(void); // Get current zero offset value (sum over channels)
+void hal_LoadCell_GetChannelOffsets(float *offsets, int max_channels); // For the config snapshot
+void hal_LoadCell_SetChannelOffsets(const float *offsets, int count);  // Restore instead of taring at boot
+float hal_LoadCell_GetTareWeight(void); // Container tared off above the zero (grams), for the config snapshot
+void hal_LoadCell_SetTareWeight(float weight_g);
+uint32_t hal_LoadCell_GetTareCount(void); // Increments each time a tare is applied
+void hal_LoadCell_SetZeroTrackingLimit(float band_g); // Narrows the auto-zero band (e.g. to half a piece); 0 = default band
+int hal_LoadCell_GetChannelCount(void);
+// Corner correction: relative gain of one cell (1.0 = nominal), applied before summation
+bool hal_LoadCell_SetChannelCorrection(int channel, float correction);
+float hal_LoadCell_GetChannelCorrection(int channel);
+// Copies the last raw conversion of each channel (for corner calibration). Returns channels copied.
+int hal_LoadCell_GetChannelRaw(long *raw, int max_channels);
+
+// Linearization: piecewise-linear correction applied to the scalar-calibrated weight.
+// Segment i covers [i, i+1) / inv_step_g grams; outside the table the end segments extrapolate.
+typedef struct {
+    float inv_step_g;   // 1 / segment width (grams)
+    int segments;
+    const float *base;  // Corrected weight at the start of each segment
+    const float *delta; // Corrected weight change across each segment
+} LoadCellLinearization_t;
+
+void hal_LoadCell_SetLinearization(const LoadCellLinearization_t *table); // NULL = scalar only; table must stay valid
+float hal_LoadCell_GetLinearWeight(void); // Last gross weight above the zero, before linearization (for calibration)
+
+// Called from the sensor task with every fresh conversion (raw counts, one per channel).
+// Runs in the acquisition loop: copy the data and return.
+typedef void (*hal_LoadCell_SampleHook_t)(const int32_t *raw, int channels);
+void hal_LoadCell_SetSampleHook(hal_LoadCell_SampleHook_t hook); // NULL removes the hook
 
 // --- Display Interface ---
 void hal_Display_Init(void);
@@ -30,38 +60,93 @@ void hal_Display_DrawLine(int x0, int y0, int x1, int y1); // Example graphics
 void hal_Display_Update(void); // Send buffer to display (if needed)
 
 // --- Button Interface ---
+// PRESS/RELEASE are the debounced edges. Act on SHORT (released before
+// BUTTON_HOLD_MS) and HOLD: every press ends in exactly one of the two,
+// so a hold gesture never runs the short-press action first.
 typedef enum {
     BUTTON_NONE = 0,
     BUTTON_TARE_PRESS,
-    BUTTON_TARE_HOLD, // Optional
+    BUTTON_TARE_HOLD,    // Held for BUTTON_HOLD_MS
     BUTTON_SAMPLE_PRESS,
-    BUTTON_SAMPLE_HOLD, // Optional
+    BUTTON_SAMPLE_HOLD,
     BUTTON_MODE_PRESS,
+    BUTTON_MODE_HOLD,
+    BUTTON_TARE_RELEASE,
+    BUTTON_SAMPLE_RELEASE,
+    BUTTON_MODE_RELEASE,
+    BUTTON_TARE_SHORT,   // Released before BUTTON_HOLD_MS (timestamp: the press)
+    BUTTON_SAMPLE_SHORT,
+    BUTTON_MODE_SHORT,
     // Add more as needed
 } ButtonEvent_t;
 
+typedef struct {
+    ButtonEvent_t event;
+    uint32_t timestamp_ms; // Time of the (first) edge, ms since boot
+} ButtonEventRecord_t;
+
 void hal_Buttons_Init(void);
-ButtonEvent_t hal_Buttons_Read(void); // Returns the current button event (non-blocking check)
+bool hal_Buttons_WaitEvent(ButtonEventRecord_t *record, uint32_t timeout_ms); // Blocks on the event queue; false on timeout
+ButtonEvent_t hal_Buttons_Read(void); // Returns the next queued button event (non-blocking check)
+
+// --- Reject Gate Output (check-weighing) ---
+void hal_RejectGate_Init(void);
+// Drives REJECT_GATE_PIN active for duration_ms without blocking (safe from the sensor task).
+// A pulse while one is active restarts it, so back-to-back rejects keep the gate open.
+void hal_RejectGate_Pulse(uint32_t duration_ms);
 
 // --- WiFi Interface ---
 void hal_Wifi_Init(void);
-bool hal_Wifi_Connect(const char* ssid, const char* password, uint32_t timeout_ms);
-bool hal_Wifi_IsConnected(void);
+void hal_Wifi_Connect(const char* ssid, const char* password); // Non-blocking; reconnects automatically until Disconnect
+bool hal_Wifi_IsConnected(void); // Associated and has an IP
 void hal_Wifi_Disconnect(void);
+int8_t hal_Wifi_GetRssi(void); // dBm of the current AP, 0 if not associated
+uint32_t hal_Wifi_GetReconnectCount(void); // Successful re-associations since boot
 // Returns HTTP status code, response stored in buffer. Returns < 0 on connection error.
 int hal_Wifi_HttpPost(const char* url, const char* payload, char* response_buffer, size_t buffer_size, uint32_t timeout_ms);
+// Connected UDP socket for diagnostic streams. host is an IPv4 literal. Returns a handle, < 0 on error.
+int hal_Wifi_UdpOpen(const char* host, uint16_t port);
+int hal_Wifi_UdpSend(int handle, const void* data, size_t length); // Bytes sent, < 0 on error (e.g. no buffers)
+void hal_Wifi_UdpClose(int handle);
+
+// --- MQTT Interface (alternative uplink/downlink transport) ---
+// Called from the MQTT client task; copy the data out, don't process it there.
+typedef void (*hal_Mqtt_MessageHandler_t)(const char* topic, int topic_len, const char* data, int data_len);
+
+// Non-blocking; persistent session (client_id must be stable), reconnects automatically.
+// subscribe_topic is subscribed at QoS 1 whenever the broker has no stored session.
+bool hal_Mqtt_Start(const char* broker_uri, const char* client_id, const char* subscribe_topic, hal_Mqtt_MessageHandler_t handler);
+bool hal_Mqtt_IsConnected(void);
+// Queues the message in the client outbox (QoS 1 is retransmitted until PUBACK).
+// Returns the message id (0 for QoS 0), < 0 if the outbox is full or the client is not started.
+int hal_Mqtt_Publish(const char* topic, const char* payload, size_t length, int qos);
 
 // --- Storage Interface (Example using NVS - Non-Volatile Storage) ---
 void hal_Storage_Init(void);
 bool hal_Storage_Save_Float(const char* namespace, const char* key, float value);
 bool hal_Storage_Load_Float(const char* namespace, const char* key, float* value);
-// Add Save/Load functions for other types (int, string, blob) as needed
+bool hal_Storage_Save_U32(const char* namespace, const char* key, uint32_t value);
+bool hal_Storage_Load_U32(const char* namespace, const char* key, uint32_t* value);
+bool hal_Storage_Save_String(const char* namespace, const char* key, const char* value);
+bool hal_Storage_Load_String(const char* namespace, const char* key, char* buffer, size_t buffer_size);
+bool hal_Storage_Save_Blob(const char* namespace, const char* key, const void* data, size_t size);
+bool hal_Storage_Load_Blob(const char* namespace, const char* key, void* data, size_t* size); // In: capacity, Out: bytes read
+// Add Save/Load functions for other types as needed
 bool hal_Storage_Erase_Key(const char* namespace, const char* key);
 bool hal_Storage_Erase_Namespace(const char* namespace);
 
 // --- System Interface ---
 void hal_System_DelayMs(uint32_t ms);
 uint64_t hal_System_GetTickMs(void); // Get system uptime in ms
+uint64_t hal_System_GetTimeUs(void); // High resolution uptime in us (for instrumentation)
 void hal_System_Reboot(void);
 
+// --- Wall Clock Interface (SNTP) ---
+// Started once Wi-Fi is initialized; lwIP re-syncs periodically in the background.
+void hal_Time_Init(const char* server);
+bool hal_Time_IsSynced(void); // True once the first SNTP response set the clock
+// Converts an uptime stamp (hal_System_GetTickMs) to epoch ms; 0 until synced.
+// Stamps taken before the first sync convert correctly once it has happened.
+uint64_t hal_Time_UptimeToEpochMs(uint64_t uptime_ms);
+
 #endif // HAL_INTERFACES_H
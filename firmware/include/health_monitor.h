@@ -0,0 +1,34 @@
+#ifndef HEALTH_MONITOR_H
+#define HEALTH_MONITOR_H
+
+#include <stdint.h>
+#include "app_tasks.h"
+
+#define HEALTH_NUM_CORES 2
+
+// Compact periodic health snapshot, sent to the backend by the comms manager.
+// Counters (deadline misses, reconnects) are cumulative since boot so the
+// backend can difference them; loads cover the interval since the last sample.
+typedef struct {
+    uint32_t uptime_s;
+    uint8_t task_cpu_pct[APP_TASK_COUNT];      // Share of total CPU time (both cores)
+    uint8_t core_idle_pct[HEALTH_NUM_CORES];   // Idle time per core
+    uint32_t stack_min_free[APP_TASK_COUNT];   // Bytes
+    uint32_t heap_free;
+    uint32_t heap_min_free;                    // Low-water mark since boot
+    uint8_t heap_fragmentation_pct;
+    uint32_t sensor_deadline_misses;
+    uint32_t sensor_jitter_max_us;
+    uint32_t check_decisions;                  // Check-weighing packs judged
+    uint32_t check_rejects;
+    uint32_t check_early;                      // Decided before the generic stability window
+    uint32_t check_latency_mean_ms;            // Pack arrival -> decision, since boot
+    uint32_t check_latency_max_ms;
+    int8_t wifi_rssi;                          // dBm, 0 if not associated
+    uint32_t wifi_reconnects;
+} HealthRecord_t;
+
+// Takes a snapshot. CPU loads are computed against the previous call.
+void HealthMonitor_Sample(HealthRecord_t *record);
+
+#endif // HEALTH_MONITOR_H
@@ -0,0 +1,23 @@
+#ifndef MEM_REPORT_H
+#define MEM_REPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "app_tasks.h"
+
+// Runtime memory budget. Static RAM per module is reported at build time by
+// tools/mem_budget.py (from the linker map); this covers what only the
+// running system knows: stack headroom per task and heap health.
+typedef struct {
+    uint32_t stack_size[APP_TASK_COUNT];        // Bytes allocated
+    uint32_t stack_min_free[APP_TASK_COUNT];    // Bytes never touched (high-water mark)
+    uint32_t heap_free;                         // Current free heap (bytes)
+    uint32_t heap_min_free;                     // Lowest free heap since boot (low-water mark)
+    uint32_t heap_largest_block;                // Largest allocatable block
+    uint8_t heap_fragmentation_pct;             // 100 * (1 - largest_block / free)
+} MemReport_t;
+
+void MemReport_Get(MemReport_t *report);
+void MemReport_Log(void);
+
+#endif // MEM_REPORT_H
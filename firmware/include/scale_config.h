@@ -3,47 +3,135 @@
 
 // --- Hardware Pins (Example for ESP32 - REPLACE with actual pins) ---
 #define LOADCELL_DOUT_PIN   GPIO_NUM_19
-#define LOADCELL_SCK_PIN    GPIO_NUM_18
+#define LOADCELL_SCK_PIN    GPIO_NUM_18 // Shared by all HX711 channels (clocked simultaneously)
 #define DISPLAY_SDA_PIN     GPIO_NUM_21
 #define DISPLAY_SCL_PIN     GPIO_NUM_22
 #define DISPLAY_RST_PIN     GPIO_NUM_17 // Optional Reset Pin for some displays
 #define BUTTON_TARE_PIN     GPIO_NUM_15
 #define BUTTON_SAMPLE_PIN   GPIO_NUM_4
 #define BUTTON_MODE_PIN     GPIO_NUM_5  // Example extra button
+#define REJECT_GATE_PIN     GPIO_NUM_27 // Check-weighing reject gate (solenoid driver / PLC input)
 
 // --- Load Cell Configuration ---
 #define LOADCELL_CALIBRATION_FACTOR 425.0f // IMPORTANT: Calibrate this value!
 #define LOADCELL_OFFSET             0L     // Will be determined by tare()
+// Multi-cell platforms: one HX711 per cell, all on LOADCELL_SCK_PIN, one DOUT each.
+// DOUT pins must be GPIO 0-31 so a single input register read samples every channel.
+// Four-corner pallet platform example:
+//   #define LOADCELL_NUM_CHANNELS 4
+//   #define LOADCELL_DOUT_PINS    { GPIO_NUM_19, GPIO_NUM_23, GPIO_NUM_25, GPIO_NUM_26 }
+#define LOADCELL_NUM_CHANNELS       1
+#define LOADCELL_DOUT_PINS          { LOADCELL_DOUT_PIN }
+#define LOADCELL_TARE_SAMPLES       10     // Most recent buffered conversions averaged per channel for tare
+#define LOADCELL_ZERO_RANGE_G       (MAX_WEIGHT_CAPACITY_G * 0.02f) // Tare within +/- this of the zero re-zeroes; heavier loads are containers
+#define LOADCELL_AZT_BAND_D         0.5f   // Auto-zero tracking acts on stable readings within +/- this many divisions (still shown as zero)
+#define LOADCELL_AZT_RATE_D_PER_S   0.5f   // Fastest the zero may be moved by tracking, divisions per second (0 disables tracking)
+#define LOADCELL_READY_TIMEOUT_MS   200    // Give up waiting for conversions (HX711 10 SPS = 100 ms)
+#define LOADCELL_SIMULATED          1      // 1 = synthesize raw counts (no HX711 fitted)
+#define CAL_MAX_POINTS              8      // Reference weights in a multi-point calibration
+#define CAL_LUT_SEGMENTS            64     // Linearization table resolution over 0..OVERLOAD_THRESHOLD_G
 
 // --- Operational Parameters ---
+#define SCALE_DIVISION_G            0.1f // One display division (d): weight is shown to 0.1 g
 #define STABLE_READING_THRESHOLD_G  0.5f // Max weight deviation in grams for stability
 #define STABLE_READING_COUNT        5    // How many consecutive readings must be within threshold
 #define DEFAULT_SENSITIVITY         1.0f // Future use?
 #define MAX_WEIGHT_CAPACITY_G       5000.0f // Max weight in grams
 #define OVERLOAD_THRESHOLD_G        (MAX_WEIGHT_CAPACITY_G * 1.05f) // 5% overload margin
 #define MIN_SAMPLE_WEIGHT_G         1.0f // Minimum weight to set as a sample
+#define LOT_UNSENT_MAX              4    // Closed accumulation lots kept (in NVS) until the backend has them
+
+// --- Check-Weighing (MODE_CHECKWEIGH, see checkweigh.h) ---
+#define CHECK_MAX_TARGETS        8     // Per-SKU target bands kept in NVS (least recently set is dropped)
+#define CHECK_FILTER_ALPHA       0.5f  // Decision filter: weight of the newest sample
+#define CHECK_HYSTERESIS_G       0.5f  // Decisions need the settling weight this far inside one zone
+#define CHECK_SLOPE_GUARD        0.25f // Extra margin per gram the filter still moved over the last sample
+#define CHECK_CONFIRM_SAMPLES    2     // Consecutive unambiguous samples before deciding
+#define CHECK_PRESENT_FRACTION   0.5f  // Pack arrived above this fraction of the lower limit
+#define CHECK_CLEAR_FRACTION     0.5f  // Pack gone below this fraction of the arrival threshold
+#define REJECT_GATE_PULSE_MS     200   // Gate actuation per rejected pack
+#define REJECT_GATE_ACTIVE_LEVEL 1
 
 // --- Communication ---
 // WARNING: Avoid hardcoding credentials in production. Use secure provisioning.
 #define WIFI_SSID           "YourNetworkSSID"
 #define WIFI_PASSWORD       "YourNetworkPassword"
-#define WIFI_CONNECT_TIMEOUT_MS 30000 // 30 seconds
+#define WIFI_BACKOFF_MIN_MS     250   // First retry delay after a failed attempt (doubles per failure)
+#define WIFI_BACKOFF_MAX_MS     30000 // Retry delay cap (+/-50% jitter is applied)
+#define WIFI_CACHED_ATTEMPTS    2     // Attempts on the cached BSSID/channel before a full scan
 #define API_ENDPOINT_URL    "http://your_backend_ip_or_domain:5000/api/v1/reading"
+#define HEALTH_ENDPOINT_URL "http://your_backend_ip_or_domain:5000/api/v1/device_health"
+#define LOT_ENDPOINT_URL    "http://your_backend_ip_or_domain:5000/api/v1/lot"
 #define API_REQUEST_TIMEOUT_MS 5000 // 5 seconds
+#ifndef DEVICE_ID // May be set per unit by the build (the fleet simulator sets one per virtual scale)
 #define DEVICE_ID           "SCALE_SN_12345" // Unique ID for this scale
+#endif
+#define FIRMWARE_VERSION    "1.1.0"          // Reported with health records
+#define API_RESPONSE_BUFFER_SIZE 512 // Upload replies carry queued commands (backend sizes batches to fit)
+#define COMMS_MAX_PENDING_COMMANDS 4 // Commands accepted per upload reply (matches backend)
+#define COMMS_MIN_REPORT_INTERVAL_MS 1000 // Lower bound for remote reporting interval changes
+#define COMMS_SEND_RETRIES   2   // Immediate re-sends of a failed HTTP upload (same seq, backend drops duplicates)
+#define COMMS_RETRY_DELAY_MS 200
+// Transport for readings, health and commands. MQTT keeps one broker session open
+// instead of a request per upload; the backend bridge (services/mqtt_bridge.py) feeds
+// the same ingest path as API_ENDPOINT_URL.
+#define COMMS_TRANSPORT_HTTP 0
+#define COMMS_TRANSPORT_MQTT 1
+#define COMMS_TRANSPORT      COMMS_TRANSPORT_HTTP
+#define MQTT_BROKER_URI      "mqtt://your_backend_ip_or_domain:1883"
+#define MQTT_TOPIC_PREFIX    "scales" // <prefix>/<device_id>/readings | health | lots | cmd
+#define MQTT_KEEPALIVE_S     60
+#define MQTT_OUTBOX_LIMIT_BYTES 8192  // Unacknowledged QoS 1 data held for retransmission
+#define MQTT_BATCH_MAX_READINGS 8     // Readings per published batch
+#define MQTT_BATCH_MAX_AGE_MS   10000 // Publish before the oldest reading in a batch gets older than this
+#define MQTT_BATCH_BUFFER_SIZE  3072  // 8 readings with latency trace stamps
+#define SNTP_SERVER          "pool.ntp.org" // Wall-clock timestamps and latency trace stamps
 
 // --- Timing ---
 #define SENSOR_TASK_INTERVAL_MS 50   // Read sensor this often
-#define UI_TASK_INTERVAL_MS     100  // Update UI and check buttons this often
+#define UI_TASK_INTERVAL_MS     100  // Refresh the display this often (buttons are event-driven)
 #define COMMS_TASK_INTERVAL_MS  15000 // Send data to backend this often (15s)
+#define SENSOR_DEADLINE_SLACK_US 5000 // Sensor period longer than interval + slack counts as a missed deadline
+#define JITTER_STRESS_TEST      0     // 1 = upload back-to-back to measure sensor jitter under network load
+#define MEM_REPORT_INTERVAL_MS  600000 // Log stack headroom / heap low-water mark this often (10 min)
+#define HEALTH_REPORT_INTERVAL_MS 300000 // Send a health record to the backend this often (5 min)
+
+// --- Diagnostics (raw sample stream, see diag_trace.h) ---
+#define TRACE_COLLECTOR_HOST    "192.168.1.100" // Default receiver (IPv4); start_trace may override host/port
+#define TRACE_COLLECTOR_PORT    5005
+#define TRACE_MAX_SECONDS       600    // Longest trace a single start_trace may request
+#define TRACE_RING_SAMPLES      256    // Sensor -> trace task buffer (power of two)
+#define TRACE_BLOCK_MAX_BYTES   1024   // One UDP datagram (below the 1472-byte payload of a 1500 MTU)
+#define TRACE_FLUSH_INTERVAL_MS 250    // Trace task wake-up period (block latency)
+#define TRACE_MAX_BYTES_PER_S   16384  // Bandwidth cap; samples that back up past the ring are dropped and counted
+
+// --- Deferred Logging (dlog.h) ---
+#define DLOG_RECORD_LEVEL       DLOG_DEBUG // Call sites above this level compile away
+#define DLOG_RING_RECORDS       128  // Power of two, 28 bytes each
+#define DLOG_FLUSH_INTERVAL_MS  100  // Log task drains the ring this often
+#define DLOG_LINE_MAX           160  // Longest formatted message
+#define DLOG_OUTPUT_BINARY      0    // 1 = print records as hex (decode with tools/dlog_decode.py)
 
 // --- UI ---
 #define DISPLAY_WIDTH        128 // Example for OLED
 #define DISPLAY_HEIGHT       64  // Example for OLED
 #define DISPLAY_ADDRESS      0x3C // Example I2C address
+#define BUTTON_DEBOUNCE_MS   20   // Edges ignored for this long after a press/release is reported
+#define BUTTON_HOLD_MS       1000 // Press duration that produces a HOLD event
+#define BUTTON_EVENT_QUEUE_LEN 8
 
 // --- Storage ---
 #define NVS_NAMESPACE "scale_cfg" // Non-Volatile Storage namespace
-#define NVS_KEY_SAMPLE_WT "sample_wt" // Key for storing average item weight
+#define NVS_KEY_SAMPLE_WT "sample_wt" // Legacy key for average item weight (read once, then migrated)
+#define NVS_KEY_SKU       "sku"       // Legacy key for the active product SKU (read once, then migrated)
+#define NVS_KEY_CONFIG_SNAPSHOT "cfg_snap" // Piece weight, SKU and tare offsets in one blob
+#define NVS_KEY_WIFI_CACHE "wifi_ap"  // BSSID and channel of the last AP (fast reconnect)
+#define SKU_MAX_LEN       16          // Including null terminator
+#define NVS_KEY_CAL_POINTS "cal_pts"  // Key for the multi-point calibration blob
+#define NVS_KEY_CAL_CORNERS "cal_crn" // Per-channel corner corrections
+#define NVS_KEY_SEQ_NEXT   "seq_next" // First reading sequence number not yet reserved
+#define SEQ_RESERVE_BLOCK  256        // Sequence numbers reserved per NVS write (a reboot skips at most this many)
+#define NVS_KEY_LOT        "lot"      // Open accumulation lot and closed lots not yet uploaded
+#define NVS_KEY_CHECK_TARGETS "chk_tgt" // Check-weighing bands per SKU
 
 #endif // SCALE_CONFIG_H
@@ -2,6 +2,8 @@
 #define SCALE_LOGIC_H
 
 #include "hal_interfaces.h" // Include HAL for types like LoadCellReading_t
+#include "scale_config.h"   // For STABLE_READING_COUNT, SKU_MAX_LEN
+#include "checkweigh.h"     // For CheckweighState_t
 #include <stdbool.h>
 #include <stdint.h>
 // If using FreeRTOS:
@@ -12,9 +14,29 @@ typedef enum {
     MODE_WEIGHING,
     MODE_COUNTING,
     MODE_SET_SAMPLE, // Intermediate state while setting sample
+    MODE_ACCUMULATE, // Counting, each settled load added to a lot total
+    MODE_CHECKWEIGH, // Pass/under/over per pack against the SKU's target band
     MODE_ERROR
 } ScaleMode_t;
 
+// Accumulation cycle (MODE_ACCUMULATE)
+typedef enum {
+    LOT_PHASE_OFF,    // Not accumulating
+    LOT_PHASE_EMPTY,  // Pan empty: the next settled load is added
+    LOT_PHASE_LOADED, // Load added; it follows re-settles until the pan is emptied
+    LOT_PHASE_HOLD    // Load on the pan that must not be added (after undo, boot, mode entry)
+} LotPhase_t;
+
+// An accumulation lot, reported to the backend as one record once closed
+typedef struct {
+    uint32_t lot_id;          // Per device, keeps increasing across reboots
+    int32_t total;            // Items
+    uint16_t loads;           // Loads added
+    float item_weight_g;      // Piece weight of the lot's first load
+    char sku[SKU_MAX_LEN];
+    uint64_t closed_epoch_ms; // 0 while open, or if the clock was not synced
+} LotRecord_t;
+
 // Structure to hold the overall state of the scale
 // This can be passed between tasks or accessed via mutex
 typedef struct {
@@ -25,6 +47,22 @@ typedef struct {
     bool is_overload;
     ScaleMode_t current_mode;
     char status_message[32]; // For short status strings on UI
+    char sku[SKU_MAX_LEN];   // Active product code (set remotely), empty if none
+
+    // Latency trace stamps (uptime ms, written by the sensor task)
+    uint32_t sampled_ms;      // Load cell read behind the current values
+    uint32_t stable_since_ms; // Last unstable -> stable transition
+
+    // Lot accumulation (MODE_ACCUMULATE)
+    LotRecord_t lot;                        // Open lot
+    int32_t lot_last_added;                 // Count of the newest load, 0 once undone
+    LotPhase_t lot_phase;
+    LotRecord_t lots_unsent[LOT_UNSENT_MAX]; // Closed lots not yet uploaded, oldest first
+    uint8_t lots_unsent_count;
+    uint32_t lot_changes;                   // Bumped on every lot change, persisted by ScaleLogic_SaveLotIfChanged
+
+    // Check-weighing (MODE_CHECKWEIGH)
+    CheckweighState_t check;
 
     // RTOS synchronization (if needed)
     // SemaphoreHandle_t mutex; // To protect access to this struct from multiple tasks
@@ -42,7 +80,20 @@ void ScaleLogic_Update(ScaleState_t *state, const LoadCellReading_t* reading);
 void ScaleLogic_RequestTare(ScaleState_t *state);
 void ScaleLogic_RequestSetSample(ScaleState_t *state);
 void ScaleLogic_RequestToggleMode(ScaleState_t *state);
-void ScaleLogic_LoadConfig(ScaleState_t *state); // Load avg weight from storage
-void ScaleLogic_SaveConfig(const ScaleState_t *state); // Save avg weight to storage
+void ScaleLogic_RequestClearSample(ScaleState_t *state); // Forget the piece weight, back to weighing
+bool ScaleLogic_SetItemWeight(ScaleState_t *state, float item_weight_g); // Remote piece weight, no sample needed
+bool ScaleLogic_SetProduct(ScaleState_t *state, const char *sku, float item_weight_g); // Remote product switch; SKU is 1-15 of [A-Za-z0-9._-]
+void ScaleLogic_LoadConfig(ScaleState_t *state); // Restore piece weight, SKU and tare offsets from storage
+void ScaleLogic_SaveConfig(const ScaleState_t *state); // Save them as one config snapshot
+void ScaleLogic_SaveConfigIfTareChanged(const ScaleState_t *state); // Call from a low-priority task
+void ScaleLogic_RequestUndoLoad(ScaleState_t *state); // Take the newest load back out of the lot
+bool ScaleLogic_RequestCloseLot(ScaleState_t *state); // Queue the lot for upload and start a new one
+void ScaleLogic_LoadLot(ScaleState_t *state); // Restore the lot (and accumulation mode) after LoadConfig
+void ScaleLogic_SaveLotIfChanged(const ScaleState_t *state); // Call from a low-priority task
+bool ScaleLogic_PeekUnsentLot(const ScaleState_t *state, LotRecord_t *lot); // Oldest closed lot to upload
+void ScaleLogic_MarkLotSent(ScaleState_t *state); // Drop it once the backend has it
+bool ScaleLogic_SetCheckTarget(ScaleState_t *state, const CheckTarget_t *target); // Remote band; the active SKU's starts check-weighing
+void ScaleLogic_LoadCheckweigh(ScaleState_t *state); // Resume check-weighing after LoadLot (needs Checkweigh_LoadTargets)
+const char *ScaleLogic_ModeName(ScaleMode_t mode); // Reading "mode" field
 
 #endif // SCALE_LOGIC_H
@@ -0,0 +1,33 @@
+#include "scale_core.h"
+#include <string.h>
+
+// roundf() rebuilt from operations every SIMD unit has: adding the largest
+// float below 0.5 and truncating rounds halves away from zero exactly like
+// roundf for any q >= 0 (adding 0.5 itself would round 0.49999997 up).
+#define SCALE_CORE_HALF_BELOW 0.49999997f
+#define SCALE_CORE_COUNT_MAX  2147483520.0f // Largest float below 2^31, keeps the conversion defined
+
+static inline int32_t count_items(float weight_g, float item_weight_g, float half_item_g) {
+    float q = weight_g / item_weight_g;
+    q = q > 0.0f ? q : 0.0f; // Also maps NaN to 0
+    q = q < SCALE_CORE_COUNT_MAX ? q : SCALE_CORE_COUNT_MAX;
+    int32_t count = (int32_t)(q + SCALE_CORE_HALF_BELOW);
+    return count & -(int32_t)(weight_g >= half_item_g); // Below half a piece: empty (mask, not a branch)
+}
+
+int32_t ScaleCore_CountItems(float weight_g, float item_weight_g) {
+    if (!(item_weight_g > SCALE_CORE_MIN_ITEM_WEIGHT_G)) return 0;
+    return count_items(weight_g, item_weight_g, item_weight_g / 2.0f);
+}
+
+void ScaleCore_CountItemsBatch(const float *restrict weights_g, size_t n, float item_weight_g,
+                               int32_t *restrict counts) {
+    if (!(item_weight_g > SCALE_CORE_MIN_ITEM_WEIGHT_G)) {
+        memset(counts, 0, n * sizeof(*counts));
+        return;
+    }
+    const float half_item_g = item_weight_g / 2.0f;
+    for (size_t i = 0; i < n; i++) {
+        counts[i] = count_items(weights_g[i], item_weight_g, half_item_g);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef SCALE_CORE_H
+#define SCALE_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Stateless counting math shared by the firmware (scale_logic.c) and the
+// backend, which recounts stored readings through a Python extension
+// (backend/native). Plain C99 with no SDK dependencies, so both sides run
+// the very same code and give bit-identical counts.
+
+// Item weights at or below this are "not set"; nothing is counted
+#define SCALE_CORE_MIN_ITEM_WEIGHT_G 0.001f
+
+// Pieces on the platform: weight / item weight rounded half away from zero
+// (as roundf), and 0 below half a piece or without a valid item weight.
+int32_t ScaleCore_CountItems(float weight_g, float item_weight_g);
+
+// ScaleCore_CountItems for n readings sharing one item weight (e.g. a
+// corrected piece weight applied to history). The loop is branch-free so
+// compilers vectorize it; counts may not overlap weights_g.
+void ScaleCore_CountItemsBatch(const float *weights_g, size_t n, float item_weight_g, int32_t *counts);
+
+#endif // SCALE_CORE_H
@@ -0,0 +1,505 @@
+// Fleet simulator: many virtual scales against one backend, for load tests
+// and capacity planning.
+//
+// Every virtual scale is a process running the real firmware modules
+// (scale_logic.c, calibration.c, comms_manager.c) on the host HAL in
+// hal_sim.c: a modelled load cell, RAM "NVS", and HTTP over POSIX sockets
+// with injected faults. Processes keep each scale's module state (the
+// firmware's file-scope statics) apart without touching the firmware code.
+// Results go to a shared memory block that the supervisor reports from.
+//
+//   make -C firmware/sim
+//   firmware/sim/fleet_sim --scales 2000 --duration-s 300 --interval-ms 5000
+//   firmware/sim/fleet_sim --scales 500 --drop-pct 2 --lost-reply-pct 2 --outage-every-s 600
+//
+// Run with --help for all options. Large fleets need enough process and
+// file descriptor limits (ulimit -u / -n) on the simulator host.
+
+#include "scale_config.h"
+#include "scale_logic.h"
+#include "calibration.h"
+#include "comms_manager.h"
+#include "health_monitor.h"
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "esp_log.h"
+
+static const char *TAG = "FLEET_SIM";
+
+// --- Shared Statistics ---
+// Latency histogram with 16 sub-buckets per power of two (about 6% resolution)
+#define LATENCY_SUB_BUCKETS 16
+#define LATENCY_BUCKETS     (LATENCY_SUB_BUCKETS * 28) // Up to ~268 s
+
+typedef struct {
+    uint64_t outcomes[SIM_KIND_COUNT][SIM_OUTCOME_COUNT];
+    uint64_t latency[SIM_KIND_COUNT][LATENCY_BUCKETS]; // Completed requests (2xx/4xx/5xx), us
+    uint64_t scales_running;
+} SimSharedStats_t;
+
+static SimSharedStats_t *stats;
+
+static const char *outcome_names[SIM_OUTCOME_COUNT] = {
+    [SIM_OUTCOME_STORED] = "stored",
+    [SIM_OUTCOME_DUPLICATE] = "duplicate",
+    [SIM_OUTCOME_HTTP_4XX] = "http_4xx",
+    [SIM_OUTCOME_HTTP_5XX] = "http_5xx",
+    [SIM_OUTCOME_CONNECT_ERROR] = "connect_error",
+    [SIM_OUTCOME_TIMEOUT] = "timeout",
+    [SIM_OUTCOME_OFFLINE] = "offline",
+    [SIM_OUTCOME_DROPPED] = "injected_drop",
+    [SIM_OUTCOME_LOST_REPLY] = "injected_lost_reply",
+};
+
+static int latency_bucket(uint64_t us) {
+    if (us < LATENCY_SUB_BUCKETS) return (int)us;
+    int exponent = 63 - __builtin_clzll(us); // >= 4
+    int bucket = (exponent - 3) * LATENCY_SUB_BUCKETS + (int)((us >> (exponent - 4)) & (LATENCY_SUB_BUCKETS - 1));
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+// Midpoint of a bucket, in us
+static double latency_bucket_value(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) return bucket;
+    int exponent = bucket / LATENCY_SUB_BUCKETS + 3;
+    double width = (double)(1ULL << (exponent - 4));
+    return (LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) * width + width / 2.0;
+}
+
+void SimStats_Record(SimRequestKind_t kind, SimOutcome_t outcome, uint64_t latency_us) {
+    __atomic_fetch_add(&stats->outcomes[kind][outcome], 1, __ATOMIC_RELAXED);
+    if (outcome == SIM_OUTCOME_STORED || outcome == SIM_OUTCOME_DUPLICATE ||
+        outcome == SIM_OUTCOME_HTTP_4XX || outcome == SIM_OUTCOME_HTTP_5XX) {
+        __atomic_fetch_add(&stats->latency[kind][latency_bucket(latency_us)], 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void snapshot_stats(SimSharedStats_t *out) {
+    uint64_t *dst = (uint64_t *)out;
+    const uint64_t *src = (const uint64_t *)stats;
+    for (size_t i = 0; i < sizeof(*out) / sizeof(uint64_t); i++) {
+        dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+}
+
+// Percentile (0..100) of the latency histogram difference now - before, in ms; 0 if empty
+static double latency_percentile_ms(const uint64_t *now, const uint64_t *before, double pct) {
+    uint64_t total = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) total += now[b] - (before ? before[b] : 0);
+    if (total == 0) return 0.0;
+    uint64_t rank = (uint64_t)(pct / 100.0 * (double)total + 0.999999); // Nearest rank
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += now[b] - (before ? before[b] : 0);
+        if (seen >= rank) return latency_bucket_value(b) / 1000.0;
+    }
+    return latency_bucket_value(LATENCY_BUCKETS - 1) / 1000.0;
+}
+
+static uint64_t count_attempts(const uint64_t *outcomes) {
+    uint64_t total = 0;
+    for (int o = 0; o < SIM_OUTCOME_COUNT; o++) total += outcomes[o];
+    return total;
+}
+
+// Requests the backend failed or never answered (injected faults and outages are counted apart)
+static uint64_t count_errors(const uint64_t *outcomes) {
+    return outcomes[SIM_OUTCOME_HTTP_4XX] + outcomes[SIM_OUTCOME_HTTP_5XX] +
+           outcomes[SIM_OUTCOME_CONNECT_ERROR] + outcomes[SIM_OUTCOME_TIMEOUT];
+}
+
+// --- Virtual Scale ---
+#define ON_CHANGE_POLL_MS 250 // How often an on-change scale looks at its count
+
+static volatile sig_atomic_t running = 1;
+
+static void on_terminate(int signum) {
+    (void)signum;
+    running = 0;
+}
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000U;
+}
+
+static void sleep_ms(uint64_t ms) {
+    struct timespec ts = { .tv_sec = (time_t)(ms / 1000U), .tv_nsec = (long)(ms % 1000U) * 1000000L };
+    nanosleep(&ts, NULL); // SIGTERM cuts it short
+}
+
+static uint32_t jittered(uint32_t interval_ms, uint32_t jitter_pct) {
+    double spread = (hal_Sim_Random() * 2.0 - 1.0) * jitter_pct / 100.0;
+    double value = interval_ms * (1.0 + spread);
+    return value < 1.0 ? 1U : (uint32_t)value;
+}
+
+// One sensor task iteration at uptime at_ms (see tasks/sensor_task.c)
+static void sensor_sample(ScaleState_t *state, uint64_t at_ms) {
+    hal_Sim_SetVirtualTime(at_ms ? at_ms : 1);
+    LoadCellReading_t reading = hal_LoadCell_Read(MAX_WEIGHT_CAPACITY_G, STABLE_READING_THRESHOLD_G, STABLE_READING_COUNT);
+    bool was_stable = state->is_stable;
+    ScaleLogic_Update(state, &reading);
+    state->sampled_ms = (uint32_t)at_ms;
+    if (state->is_stable && !was_stable) {
+        state->stable_since_ms = state->sampled_ms;
+    }
+    hal_Sim_SetVirtualTime(0);
+}
+
+// Plausible health numbers; what matters to the backend is the request, not the values
+static void fake_health(HealthRecord_t *record) {
+    memset(record, 0, sizeof(*record));
+    record->uptime_s = (uint32_t)(hal_Sim_RealUptimeMs() / 1000U);
+    record->task_cpu_pct[APP_TASK_SENSOR] = (uint8_t)(2 + hal_Sim_Random() * 2);
+    record->task_cpu_pct[APP_TASK_UI] = 1;
+    record->task_cpu_pct[APP_TASK_COMMS] = (uint8_t)(1 + hal_Sim_Random() * 3);
+    record->core_idle_pct[0] = 90;
+    record->core_idle_pct[1] = 95;
+    for (int i = 0; i < APP_TASK_COUNT; i++) record->stack_min_free[i] = 1200;
+    record->heap_free = 150000 + (uint32_t)(hal_Sim_Random() * 10000);
+    record->heap_min_free = 140000;
+    record->heap_fragmentation_pct = 5;
+    record->wifi_rssi = hal_Wifi_GetRssi();
+    record->wifi_reconnects = hal_Wifi_GetReconnectCount();
+}
+
+// Boot sequence of app_main and the task loops, single-threaded
+static int run_scale(const SimConfig_t *config, int index, uint64_t start_delay_ms) {
+    signal(SIGTERM, on_terminate);
+    signal(SIGINT, SIG_IGN); // The supervisor handles Ctrl-C and stops the fleet
+    hal_Sim_Init(config, index);
+    sleep_ms(start_delay_ms); // Staggered start: scales do not all report in the same instant
+    if (!running) return 0;
+
+    static ScaleState_t state;
+    hal_Storage_Init();
+    hal_LoadCell_Init(LOADCELL_CALIBRATION_FACTOR);
+    Calibration_Init();
+    ScaleLogic_Init(&state);
+    ScaleLogic_LoadConfig(&state);
+    if (config->piece_weight_g > 0.0f) {
+        ScaleLogic_SetItemWeight(&state, config->piece_weight_g); // Counting, as if set remotely
+    }
+    hal_Wifi_Init();
+    hal_Time_Init(SNTP_SERVER);
+    CommsManager_Init();
+    __atomic_fetch_add(&stats->scales_running, 1, __ATOMIC_RELAXED);
+
+    uint64_t next_sample_ms = hal_Sim_RealUptimeMs();
+    uint64_t next_report_ms = next_sample_ms;
+    uint64_t next_health_ms = next_sample_ms + config->health_interval_ms;
+    int32_t reported_count = -1;
+
+    while (running) {
+        // Sensor task: all samples due since the last wakeup, each at its own time
+        uint64_t now = hal_Sim_RealUptimeMs();
+        while (next_sample_ms <= now) {
+            sensor_sample(&state, next_sample_ms);
+            next_sample_ms += SENSOR_TASK_INTERVAL_MS;
+        }
+
+        bool due = now >= next_report_ms;
+        if (config->policy == SIM_POLICY_ON_CHANGE && state.is_stable && state.item_count != reported_count) {
+            due = true;
+        }
+        if (due) {
+            // Comms task iteration (see tasks/comms_task.c)
+            CommsManager_RunPeriodic();
+            if (CommsManager_GetCurrentState() == COMMS_STATE_CONNECTED) {
+                CommsManager_SendData(&state);
+                reported_count = state.item_count;
+                CommsManager_ApplyPendingCommands(&state);
+                if (config->health_interval_ms && hal_Sim_RealUptimeMs() >= next_health_ms) {
+                    HealthRecord_t health;
+                    fake_health(&health);
+                    CommsManager_SendHealth(&health);
+                    next_health_ms = hal_Sim_RealUptimeMs() + config->health_interval_ms;
+                }
+            }
+            ScaleLogic_SaveConfigIfTareChanged(&state);
+            uint32_t interval_ms = config->interval_ms ? config->interval_ms : CommsManager_GetReportIntervalMs();
+            next_report_ms = hal_Sim_RealUptimeMs() + jittered(interval_ms, config->jitter_pct);
+        }
+
+        uint64_t wake_ms = next_report_ms;
+        if (config->policy == SIM_POLICY_ON_CHANGE && now + ON_CHANGE_POLL_MS < wake_ms) {
+            wake_ms = now + ON_CHANGE_POLL_MS;
+        }
+        now = hal_Sim_RealUptimeMs();
+        if (wake_ms > now) sleep_ms(wake_ms - now);
+    }
+    return 0;
+}
+
+// --- Supervisor ---
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_interrupt(int signum) {
+    (void)signum;
+    stop_requested = 1;
+}
+
+static void print_progress(const SimSharedStats_t *now, const SimSharedStats_t *before, double elapsed_s, double window_s) {
+    const uint64_t *outcomes = now->outcomes[SIM_KIND_READING];
+    const uint64_t *previous = before->outcomes[SIM_KIND_READING];
+    uint64_t stored = outcomes[SIM_OUTCOME_STORED] - previous[SIM_OUTCOME_STORED];
+    uint64_t attempts = count_attempts(outcomes) - count_attempts(previous);
+    uint64_t errors = count_errors(outcomes) - count_errors(previous);
+    printf("%7.0f %7llu %11.1f %8.1f %8.1f %7.2f%%\n", elapsed_s, (unsigned long long)now->scales_running,
+           stored / window_s,
+           latency_percentile_ms(now->latency[SIM_KIND_READING], before->latency[SIM_KIND_READING], 50.0),
+           latency_percentile_ms(now->latency[SIM_KIND_READING], before->latency[SIM_KIND_READING], 99.0),
+           attempts ? 100.0 * errors / attempts : 0.0);
+    fflush(stdout);
+}
+
+static void print_summary(const char *label, const uint64_t *outcomes, const uint64_t *latency, double elapsed_s) {
+    uint64_t attempts = count_attempts(outcomes);
+    if (attempts == 0) {
+        printf("%s: no requests\n", label);
+        return;
+    }
+    uint64_t answered = outcomes[SIM_OUTCOME_STORED] + outcomes[SIM_OUTCOME_DUPLICATE];
+    printf("%s: %llu attempts, %llu accepted (%.1f/s), %llu of them duplicates\n", label,
+           (unsigned long long)attempts, (unsigned long long)answered, answered / elapsed_s,
+           (unsigned long long)outcomes[SIM_OUTCOME_DUPLICATE]);
+    printf("  latency ms: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+           latency_percentile_ms(latency, NULL, 50.0), latency_percentile_ms(latency, NULL, 90.0),
+           latency_percentile_ms(latency, NULL, 99.0), latency_percentile_ms(latency, NULL, 100.0));
+    printf("  error rate: %.2f%%", 100.0 * count_errors(outcomes) / attempts);
+    for (int o = SIM_OUTCOME_HTTP_4XX; o < SIM_OUTCOME_COUNT; o++) {
+        printf("%s%s %llu", o == SIM_OUTCOME_HTTP_4XX ? " (" : ", ", outcome_names[o], (unsigned long long)outcomes[o]);
+    }
+    printf(")\n");
+}
+
+static void usage(const char *program) {
+    printf("Usage: %s [options]\n"
+           "Fleet:\n"
+           "  --scales N            virtual scales, one process each (default 100)\n"
+           "  --duration-s S        run time (default 60)\n"
+           "  --ramp-s S            spread scale start-up over S seconds (default: one report interval)\n"
+           "  --backend HOST:PORT   backend to load (default 127.0.0.1:5000)\n"
+           "  --prefix P            device ids are P<index> (default SIM_)\n"
+           "  --seed N              random seed (default 1)\n"
+           "Load cell traffic:\n"
+           "  --piece-g G           piece weight set on every scale, 0 = weighing only (default 12.5)\n"
+           "  --max-items N         items on a platform at most (default 200)\n"
+           "  --change-ms MS        mean time between items added or removed (default 20000)\n"
+           "  --noise-g G           settled signal noise, standard deviation (default 0.05)\n"
+           "Reporting policy:\n"
+           "  --policy P            periodic | on-change (default periodic)\n"
+           "  --interval-ms MS      report interval / on-change heartbeat (default: firmware, %u)\n"
+           "  --jitter-pct P        +/- random spread per interval (default 10)\n"
+           "  --health-s S          health record interval, 0 = none (default %u)\n"
+           "Network faults:\n"
+           "  --drop-pct P          requests lost before reaching the backend\n"
+           "  --lost-reply-pct P    replies lost after the backend stored the reading (device retries)\n"
+           "  --delay-ms MS         extra latency per request\n"
+           "  --outage-every-s S    mean time between Wi-Fi outages, 0 = none\n"
+           "  --outage-ms MS        outage length (default 10000)\n"
+           "Output:\n"
+           "  --progress-s S        progress line interval (default 10)\n"
+           "  --log-level N         firmware log lines to stderr, 0 = none .. 5 = verbose (default 0)\n",
+           program, (unsigned)COMMS_TASK_INTERVAL_MS, (unsigned)(HEALTH_REPORT_INTERVAL_MS / 1000U));
+}
+
+int main(int argc, char **argv) {
+    SimConfig_t config = {
+        .backend_host = "127.0.0.1",
+        .backend_port = 5000,
+        .device_prefix = "SIM_",
+        .seed = 1,
+        .piece_weight_g = 12.5f,
+        .max_items = 200,
+        .item_change_ms = 20000,
+        .noise_g = 0.05f,
+        .policy = SIM_POLICY_PERIODIC,
+        .jitter_pct = 10,
+        .health_interval_ms = HEALTH_REPORT_INTERVAL_MS,
+        .outage_ms = 10000,
+        .log_level = ESP_LOG_NONE,
+    };
+    int scales = 100;
+    double duration_s = 60.0;
+    double ramp_s = -1.0;
+    double progress_s = 10.0;
+    static char backend[128];
+
+    enum {
+        OPT_SCALES = 1, OPT_DURATION, OPT_RAMP, OPT_BACKEND, OPT_PREFIX, OPT_SEED, OPT_PIECE, OPT_MAX_ITEMS,
+        OPT_CHANGE, OPT_NOISE, OPT_POLICY, OPT_INTERVAL, OPT_JITTER, OPT_HEALTH, OPT_DROP, OPT_LOST_REPLY,
+        OPT_DELAY, OPT_OUTAGE_EVERY, OPT_OUTAGE_MS, OPT_PROGRESS, OPT_LOG_LEVEL, OPT_HELP
+    };
+    static const struct option options[] = {
+        { "scales", required_argument, NULL, OPT_SCALES },
+        { "duration-s", required_argument, NULL, OPT_DURATION },
+        { "ramp-s", required_argument, NULL, OPT_RAMP },
+        { "backend", required_argument, NULL, OPT_BACKEND },
+        { "prefix", required_argument, NULL, OPT_PREFIX },
+        { "seed", required_argument, NULL, OPT_SEED },
+        { "piece-g", required_argument, NULL, OPT_PIECE },
+        { "max-items", required_argument, NULL, OPT_MAX_ITEMS },
+        { "change-ms", required_argument, NULL, OPT_CHANGE },
+        { "noise-g", required_argument, NULL, OPT_NOISE },
+        { "policy", required_argument, NULL, OPT_POLICY },
+        { "interval-ms", required_argument, NULL, OPT_INTERVAL },
+        { "jitter-pct", required_argument, NULL, OPT_JITTER },
+        { "health-s", required_argument, NULL, OPT_HEALTH },
+        { "drop-pct", required_argument, NULL, OPT_DROP },
+        { "lost-reply-pct", required_argument, NULL, OPT_LOST_REPLY },
+        { "delay-ms", required_argument, NULL, OPT_DELAY },
+        { "outage-every-s", required_argument, NULL, OPT_OUTAGE_EVERY },
+        { "outage-ms", required_argument, NULL, OPT_OUTAGE_MS },
+        { "progress-s", required_argument, NULL, OPT_PROGRESS },
+        { "log-level", required_argument, NULL, OPT_LOG_LEVEL },
+        { "help", no_argument, NULL, OPT_HELP },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch (opt) {
+            case OPT_SCALES: scales = atoi(optarg); break;
+            case OPT_DURATION: duration_s = atof(optarg); break;
+            case OPT_RAMP: ramp_s = atof(optarg); break;
+            case OPT_BACKEND: {
+                snprintf(backend, sizeof(backend), "%s", optarg);
+                char *colon = strrchr(backend, ':');
+                if (colon) {
+                    *colon = '\0';
+                    config.backend_port = (uint16_t)atoi(colon + 1);
+                }
+                config.backend_host = backend;
+                break;
+            }
+            case OPT_PREFIX: config.device_prefix = optarg; break;
+            case OPT_SEED: config.seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case OPT_PIECE: config.piece_weight_g = (float)atof(optarg); break;
+            case OPT_MAX_ITEMS: config.max_items = atoi(optarg); break;
+            case OPT_CHANGE: config.item_change_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case OPT_NOISE: config.noise_g = (float)atof(optarg); break;
+            case OPT_POLICY:
+                if (strcmp(optarg, "periodic") == 0) {
+                    config.policy = SIM_POLICY_PERIODIC;
+                } else if (strcmp(optarg, "on-change") == 0) {
+                    config.policy = SIM_POLICY_ON_CHANGE;
+                } else {
+                    fprintf(stderr, "Unknown policy '%s'\n", optarg);
+                    return 2;
+                }
+                break;
+            case OPT_INTERVAL: config.interval_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case OPT_JITTER: config.jitter_pct = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case OPT_HEALTH: config.health_interval_ms = (uint32_t)(atof(optarg) * 1000.0); break;
+            case OPT_DROP: config.drop_pct = atof(optarg); break;
+            case OPT_LOST_REPLY: config.lost_reply_pct = atof(optarg); break;
+            case OPT_DELAY: config.delay_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case OPT_OUTAGE_EVERY: config.outage_every_s = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case OPT_OUTAGE_MS: config.outage_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case OPT_PROGRESS: progress_s = atof(optarg); break;
+            case OPT_LOG_LEVEL: config.log_level = atoi(optarg); break;
+            case OPT_HELP: usage(argv[0]); return 0;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (scales <= 0 || duration_s <= 0.0 || config.max_items <= 0 || progress_s <= 0.0) {
+        fprintf(stderr, "--scales, --duration-s, --max-items and --progress-s must be positive\n");
+        return 2;
+    }
+    uint32_t interval_ms = config.interval_ms ? config.interval_ms : COMMS_TASK_INTERVAL_MS;
+    if (ramp_s < 0.0) ramp_s = interval_ms / 1000.0;
+
+    stats = mmap(NULL, sizeof(*stats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    pid_t *pids = calloc((size_t)scales, sizeof(pid_t));
+    if (stats == MAP_FAILED || !pids) {
+        perror("fleet_sim");
+        return 1;
+    }
+
+    printf("Fleet: %d scales -> %s:%u, %.0f s, %s every %lu ms (+/-%lu%%)",
+           scales, config.backend_host, (unsigned)config.backend_port, duration_s,
+           config.policy == SIM_POLICY_PERIODIC ? "periodic" : "on-change heartbeat",
+           (unsigned long)interval_ms, (unsigned long)config.jitter_pct);
+    if (config.drop_pct || config.lost_reply_pct || config.delay_ms || config.outage_every_s) {
+        printf(", faults: drop %.1f%% lost reply %.1f%% delay %lu ms outage every %lu s",
+               config.drop_pct, config.lost_reply_pct, (unsigned long)config.delay_ms,
+               (unsigned long)config.outage_every_s);
+    }
+    printf("\n");
+    fflush(stdout); // Children inherit unflushed stdio buffers otherwise
+
+    signal(SIGINT, on_interrupt);
+    signal(SIGTERM, on_interrupt);
+    uint64_t start_ms = monotonic_ms();
+    int launched = 0;
+    for (; launched < scales && !stop_requested; launched++) {
+        uint64_t start_delay_ms = (uint64_t)(ramp_s * 1000.0 * launched / scales);
+        uint64_t spent_ms = monotonic_ms() - start_ms;
+        pid_t pid = fork();
+        if (pid == 0) {
+            free(pids);
+            _exit(run_scale(&config, launched, start_delay_ms > spent_ms ? start_delay_ms - spent_ms : 0));
+        }
+        if (pid < 0) {
+            ESP_LOGE(TAG, "fork failed after %d scales: %s", launched, strerror(errno));
+            fprintf(stderr, "Could only start %d scales (fork: %s); check ulimit -u\n", launched, strerror(errno));
+            break;
+        }
+        pids[launched] = pid;
+    }
+
+    printf("%7s %7s %11s %8s %8s %8s\n", "t(s)", "scales", "readings/s", "p50 ms", "p99 ms", "errors");
+    SimSharedStats_t *before = calloc(2, sizeof(SimSharedStats_t));
+    SimSharedStats_t *now = before + 1;
+    if (!before) {
+        perror("fleet_sim");
+        stop_requested = 1;
+    }
+    uint64_t last_progress_ms = start_ms;
+    while (!stop_requested) {
+        uint64_t elapsed_ms = monotonic_ms() - start_ms;
+        if (elapsed_ms >= duration_s * 1000.0) break;
+        uint64_t next_ms = last_progress_ms + (uint64_t)(progress_s * 1000.0);
+        uint64_t end_ms = start_ms + (uint64_t)(duration_s * 1000.0);
+        uint64_t wake_ms = next_ms < end_ms ? next_ms : end_ms;
+        uint64_t current_ms = monotonic_ms();
+        if (wake_ms > current_ms) sleep_ms(wake_ms - current_ms);
+        current_ms = monotonic_ms();
+        if (current_ms >= next_ms && !stop_requested) {
+            snapshot_stats(now);
+            print_progress(now, before, (current_ms - start_ms) / 1000.0, (current_ms - last_progress_ms) / 1000.0);
+            *before = *now;
+            last_progress_ms = current_ms;
+        }
+    }
+
+    // Results are taken before the fleet is stopped, so shutdown does not count as errors
+    double elapsed_s = (monotonic_ms() - start_ms) / 1000.0;
+    SimSharedStats_t final;
+    snapshot_stats(&final);
+    for (int i = 0; i < launched; i++) {
+        if (pids[i] > 0) kill(pids[i], SIGTERM);
+    }
+    for (int i = 0; i < launched; i++) {
+        if (pids[i] > 0) waitpid(pids[i], NULL, 0);
+    }
+
+    printf("\nAfter %.1f s with %llu scales running:\n", elapsed_s, (unsigned long long)final.scales_running);
+    print_summary("Readings", final.outcomes[SIM_KIND_READING], final.latency[SIM_KIND_READING], elapsed_s);
+    print_summary("Health", final.outcomes[SIM_KIND_HEALTH], final.latency[SIM_KIND_HEALTH], elapsed_s);
+    free(before);
+    free(pids);
+    return 0;
+}
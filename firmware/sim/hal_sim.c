@@ -0,0 +1,660 @@
+#include "hal_interfaces.h"
+#include "scale_config.h"
+#include "diag_trace.h"
+#include "dlog.h"
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "esp_log.h"
+
+// Host HAL for the fleet simulator: a modelled load cell, RAM-backed
+// "NVS", the process clock, and Wi-Fi/HTTP over POSIX sockets with injected
+// faults. Everything above the HAL is the real firmware code.
+
+static const char *TAG = "HAL_SIM";
+
+#if COMMS_TRANSPORT != COMMS_TRANSPORT_HTTP
+#error "The fleet simulator drives the HTTP transport only"
+#endif
+
+static const SimConfig_t *sim;
+static char device_id[48];
+static uint64_t rng_state;
+
+const char *hal_Sim_DeviceId(void) {
+    return device_id;
+}
+
+// --- Random Numbers (xorshift64*, seeded per scale) ---
+double hal_Sim_Random(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double)((rng_state * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0; // 53 bits
+}
+
+bool hal_Sim_Chance(double pct) {
+    return pct > 0.0 && hal_Sim_Random() * 100.0 < pct;
+}
+
+static double random_exponential(double mean) {
+    return -mean * log(1.0 - hal_Sim_Random());
+}
+
+static double random_gaussian(void) {
+    double u = hal_Sim_Random();
+    double v = hal_Sim_Random();
+    return sqrt(-2.0 * log(1.0 - u)) * cos(2.0 * M_PI * v);
+}
+
+// --- Clock ---
+// Sensor samples are computed in batches, each at its own nominal time
+// (hal_Sim_SetVirtualTime); the network code runs on the real clock.
+static uint64_t boot_us;       // CLOCK_MONOTONIC at process start
+static uint64_t boot_epoch_ms; // Wall clock at process start ("SNTP" is always synced)
+static uint64_t virtual_uptime_ms = 0;
+
+static uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000U;
+}
+
+uint64_t hal_Sim_RealUptimeMs(void) {
+    return (monotonic_us() - boot_us) / 1000U;
+}
+
+void hal_Sim_SetVirtualTime(uint64_t uptime_ms) {
+    virtual_uptime_ms = uptime_ms;
+}
+
+void hal_System_DelayMs(uint32_t ms) {
+    struct timespec ts = { .tv_sec = ms / 1000U, .tv_nsec = (long)(ms % 1000U) * 1000000L };
+    nanosleep(&ts, NULL); // Cut short by SIGTERM at the end of a run
+}
+
+uint64_t hal_System_GetTickMs(void) {
+    return virtual_uptime_ms ? virtual_uptime_ms : hal_Sim_RealUptimeMs();
+}
+
+uint64_t hal_System_GetTimeUs(void) {
+    return monotonic_us() - boot_us;
+}
+
+void hal_Time_Init(const char* server) {
+    (void)server;
+}
+
+bool hal_Time_IsSynced(void) {
+    return true;
+}
+
+uint64_t hal_Time_UptimeToEpochMs(uint64_t uptime_ms) {
+    return boot_epoch_ms + uptime_ms;
+}
+
+// --- Logging (port/esp_log.h) ---
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    if (!sim || (int)level > sim->log_level) return;
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    fprintf(stderr, "%s %c (%llu) %s: %s\n", device_id, "?EWIDV"[level],
+            (unsigned long long)hal_System_GetTickMs(), tag, line);
+}
+
+// --- Load Cell Model ---
+// Items are put on and taken off the platform at random (exponential gaps,
+// mean item_change_ms). While they are handled the signal moves towards the
+// new weight with extra disturbance; settled, only noise_g remains.
+#define SIM_SETTLE_MS        600
+#define SIM_HANDLING_NOISE_G 2.0f
+
+static struct {
+    float calibration_factor;
+    float tare_g;           // Gross weight zeroed by the last tare
+    float gross_g;          // Last simulated gross weight
+    float target_g;         // Weight the platform settles to
+    float moving_from_g;
+    uint64_t moving_until_ms;
+    uint64_t next_change_ms;
+    int items;
+    float last_weight_g;
+    int stable_run;
+    uint32_t tare_count;
+} cell;
+
+void hal_LoadCell_Init(float calibration_factor) {
+    cell.calibration_factor = calibration_factor;
+    cell.next_change_ms = hal_System_GetTickMs() + (uint64_t)random_exponential(sim->item_change_ms);
+}
+
+LoadCellReading_t hal_LoadCell_Read(float max_weight, float stable_threshold, int stable_count) {
+    uint64_t now = hal_System_GetTickMs();
+    if (now >= cell.next_change_ms) {
+        int change = 1 + (int)(hal_Sim_Random() * 3.0);
+        bool add = cell.items == 0 || (cell.items < sim->max_items && hal_Sim_Random() < 0.5);
+        cell.items += add ? change : -change;
+        if (cell.items < 0) cell.items = 0;
+        if (cell.items > sim->max_items) cell.items = sim->max_items;
+        cell.moving_from_g = cell.gross_g;
+        cell.target_g = (float)cell.items * sim->piece_weight_g;
+        cell.moving_until_ms = now + SIM_SETTLE_MS;
+        cell.next_change_ms = now + 1 + (uint64_t)random_exponential(sim->item_change_ms);
+    }
+
+    if (now < cell.moving_until_ms) {
+        float progress = 1.0f - (float)(cell.moving_until_ms - now) / SIM_SETTLE_MS;
+        cell.gross_g = cell.moving_from_g + (cell.target_g - cell.moving_from_g) * progress +
+                       (float)random_gaussian() * SIM_HANDLING_NOISE_G;
+    } else {
+        cell.gross_g = cell.target_g + (float)random_gaussian() * sim->noise_g;
+    }
+
+    LoadCellReading_t reading;
+    reading.weight_grams = cell.gross_g - cell.tare_g;
+    reading.raw_value = lroundf(cell.gross_g * cell.calibration_factor);
+    reading.is_overload = reading.weight_grams > max_weight;
+    if (fabsf(reading.weight_grams - cell.last_weight_g) <= stable_threshold) {
+        if (cell.stable_run < stable_count) cell.stable_run++;
+    } else {
+        cell.stable_run = 0;
+    }
+    cell.last_weight_g = reading.weight_grams;
+    reading.is_stable = cell.stable_run >= stable_count;
+    reading.is_fresh = true; // One conversion per scale step
+    return reading;
+}
+
+void hal_LoadCell_Tare(void) {
+    cell.tare_g = cell.gross_g;
+    cell.tare_count++;
+}
+
+void hal_LoadCell_SetCalibrationFactor(float factor) {
+    cell.calibration_factor = factor;
+}
+
+float hal_LoadCell_GetCalibrationFactor(void) {
+    return cell.calibration_factor;
+}
+
+long hal_LoadCell_GetOffset(void) {
+    return lroundf(cell.tare_g * cell.calibration_factor);
+}
+
+// One modelled cell: its offset is channel 0, the others stay zero
+void hal_LoadCell_GetChannelOffsets(float *offsets, int max_channels) {
+    for (int ch = 0; ch < max_channels; ch++) {
+        offsets[ch] = ch == 0 ? cell.tare_g * cell.calibration_factor : 0.0f;
+    }
+}
+
+void hal_LoadCell_SetChannelOffsets(const float *offsets, int count) {
+    float sum = 0.0f;
+    for (int ch = 0; ch < count; ch++) sum += offsets[ch];
+    cell.tare_g = sum / cell.calibration_factor;
+}
+
+// The modelled tare is all in the channel 0 offset
+float hal_LoadCell_GetTareWeight(void) {
+    return 0.0f;
+}
+
+void hal_LoadCell_SetTareWeight(float weight_g) {
+    (void)weight_g;
+}
+
+uint32_t hal_LoadCell_GetTareCount(void) {
+    return cell.tare_count;
+}
+
+int hal_LoadCell_GetChannelCount(void) {
+    return LOADCELL_NUM_CHANNELS;
+}
+
+bool hal_LoadCell_SetChannelCorrection(int channel, float correction) {
+    (void)channel;
+    (void)correction; // The modelled cell has no corner error
+    return true;
+}
+
+float hal_LoadCell_GetChannelCorrection(int channel) {
+    (void)channel;
+    return 1.0f;
+}
+
+int hal_LoadCell_GetChannelRaw(long *raw, int max_channels) {
+    for (int ch = 0; ch < max_channels; ch++) {
+        raw[ch] = ch == 0 ? lroundf(cell.gross_g * cell.calibration_factor) : 0;
+    }
+    return max_channels;
+}
+
+void hal_LoadCell_SetLinearization(const LoadCellLinearization_t *table) {
+    (void)table; // The model is linear
+}
+
+float hal_LoadCell_GetLinearWeight(void) {
+    return cell.last_weight_g;
+}
+
+// --- Reject Gate (no output on the host) ---
+void hal_RejectGate_Init(void) {
+}
+
+void hal_RejectGate_Pulse(uint32_t duration_ms) {
+    (void)duration_ms;
+}
+
+// --- Storage (RAM, lives as long as the scale process) ---
+#define SIM_STORAGE_SLOTS 16
+
+typedef struct {
+    char name[40]; // namespace/key
+    void *data;
+    size_t size;
+} SimStorageSlot_t;
+
+static SimStorageSlot_t storage[SIM_STORAGE_SLOTS];
+
+static SimStorageSlot_t *storage_find(const char* namespace, const char* key, bool create) {
+    char name[sizeof(storage[0].name)];
+    snprintf(name, sizeof(name), "%s/%s", namespace, key);
+    SimStorageSlot_t *free_slot = NULL;
+    for (int i = 0; i < SIM_STORAGE_SLOTS; i++) {
+        if (storage[i].data && strcmp(storage[i].name, name) == 0) return &storage[i];
+        if (!storage[i].data && !free_slot) free_slot = &storage[i];
+    }
+    if (!create || !free_slot) return NULL;
+    strcpy(free_slot->name, name);
+    return free_slot;
+}
+
+static bool storage_put(const char* namespace, const char* key, const void* data, size_t size) {
+    SimStorageSlot_t *slot = storage_find(namespace, key, true);
+    void *copy = malloc(size ? size : 1);
+    if (!slot || !copy) {
+        free(copy);
+        ESP_LOGE(TAG, "Storage full, cannot save '%s'", key);
+        return false;
+    }
+    memcpy(copy, data, size);
+    free(slot->data);
+    slot->data = copy;
+    slot->size = size;
+    return true;
+}
+
+static bool storage_get(const char* namespace, const char* key, void* data, size_t* size) {
+    SimStorageSlot_t *slot = storage_find(namespace, key, false);
+    if (!slot || slot->size > *size) return false;
+    memcpy(data, slot->data, slot->size);
+    *size = slot->size;
+    return true;
+}
+
+// NVS lives only as long as the run. A real scale keeps its reading sequence
+// across reboots, so each run continues from a wall-clock based number
+// (tenths of a second since 2025, enough for ten readings a second) instead
+// of 0; otherwise re-running against the same database would have the
+// backend count every reading as a duplicate.
+#define SIM_SEQ_EPOCH_S 1735689600ULL
+
+void hal_Storage_Init(void) {
+    uint32_t seq_next = (uint32_t)(boot_epoch_ms / 100U - SIM_SEQ_EPOCH_S * 10U);
+    hal_Storage_Save_U32(NVS_NAMESPACE, NVS_KEY_SEQ_NEXT, seq_next);
+}
+
+bool hal_Storage_Save_Float(const char* namespace, const char* key, float value) {
+    return storage_put(namespace, key, &value, sizeof(value));
+}
+
+bool hal_Storage_Load_Float(const char* namespace, const char* key, float* value) {
+    size_t size = sizeof(*value);
+    return storage_get(namespace, key, value, &size) && size == sizeof(*value);
+}
+
+bool hal_Storage_Save_U32(const char* namespace, const char* key, uint32_t value) {
+    return storage_put(namespace, key, &value, sizeof(value));
+}
+
+bool hal_Storage_Load_U32(const char* namespace, const char* key, uint32_t* value) {
+    size_t size = sizeof(*value);
+    return storage_get(namespace, key, value, &size) && size == sizeof(*value);
+}
+
+bool hal_Storage_Save_String(const char* namespace, const char* key, const char* value) {
+    return storage_put(namespace, key, value, strlen(value) + 1);
+}
+
+bool hal_Storage_Load_String(const char* namespace, const char* key, char* buffer, size_t buffer_size) {
+    return storage_get(namespace, key, buffer, &buffer_size);
+}
+
+bool hal_Storage_Save_Blob(const char* namespace, const char* key, const void* data, size_t size) {
+    return storage_put(namespace, key, data, size);
+}
+
+bool hal_Storage_Load_Blob(const char* namespace, const char* key, void* data, size_t* size) {
+    return storage_get(namespace, key, data, size);
+}
+
+bool hal_Storage_Erase_Key(const char* namespace, const char* key) {
+    SimStorageSlot_t *slot = storage_find(namespace, key, false);
+    if (!slot) return false;
+    free(slot->data);
+    memset(slot, 0, sizeof(*slot));
+    return true;
+}
+
+bool hal_Storage_Erase_Namespace(const char* namespace) {
+    size_t len = strlen(namespace);
+    for (int i = 0; i < SIM_STORAGE_SLOTS; i++) {
+        if (storage[i].data && strncmp(storage[i].name, namespace, len) == 0 && storage[i].name[len] == '/') {
+            free(storage[i].data);
+            memset(&storage[i], 0, sizeof(storage[i]));
+        }
+    }
+    return true;
+}
+
+// --- Wi-Fi ---
+// Associated as soon as a connection is requested, except during simulated
+// outages (exponential gaps, mean outage_every_s, each lasting outage_ms).
+static bool wifi_wanted = false;
+static bool wifi_in_outage = false;
+static uint32_t wifi_reconnects = 0;
+static uint64_t outage_until_ms = 0;
+static uint64_t next_outage_ms = UINT64_MAX;
+static int http_fd = -1;
+
+static void http_close(void) {
+    if (http_fd >= 0) {
+        close(http_fd);
+        http_fd = -1;
+    }
+}
+
+void hal_Wifi_Init(void) {
+    if (sim->outage_every_s) {
+        next_outage_ms = hal_Sim_RealUptimeMs() + (uint64_t)random_exponential(sim->outage_every_s * 1000.0);
+    }
+}
+
+void hal_Wifi_Connect(const char* ssid, const char* password) {
+    (void)ssid; (void)password;
+    wifi_wanted = true;
+}
+
+bool hal_Wifi_IsConnected(void) {
+    if (!wifi_wanted) return false;
+    uint64_t now = hal_Sim_RealUptimeMs();
+    if (now >= next_outage_ms) {
+        outage_until_ms = now + sim->outage_ms;
+        next_outage_ms = outage_until_ms + (uint64_t)random_exponential(sim->outage_every_s * 1000.0);
+        wifi_in_outage = true;
+        http_close(); // The TCP connection does not survive the outage
+        ESP_LOGW(TAG, "Simulated Wi-Fi outage for %lu ms.", (unsigned long)sim->outage_ms);
+    }
+    if (now < outage_until_ms) return false;
+    if (wifi_in_outage) {
+        wifi_in_outage = false;
+        wifi_reconnects++;
+    }
+    return true;
+}
+
+void hal_Wifi_Disconnect(void) {
+    wifi_wanted = false;
+    http_close();
+}
+
+int8_t hal_Wifi_GetRssi(void) {
+    return hal_Wifi_IsConnected() ? (int8_t)(-50 - (int)(hal_Sim_Random() * 30.0)) : 0;
+}
+
+uint32_t hal_Wifi_GetReconnectCount(void) {
+    return wifi_reconnects;
+}
+
+// --- HTTP Client (one keep-alive connection, like esp_http_client) ---
+#define SIM_HTTP_RX_BYTES 8192
+
+// Waits until fd is ready for events or the deadline passes: 1 ready, 0 timeout, -1 error
+static int wait_fd(int fd, short events, uint64_t deadline_us) {
+    while (1) {
+        uint64_t now = monotonic_us();
+        if (now >= deadline_us) return 0;
+        struct pollfd pfd = { .fd = fd, .events = events };
+        int ready = poll(&pfd, 1, (int)((deadline_us - now + 999U) / 1000U));
+        if (ready > 0) return 1;
+        if (ready < 0) return -1; // Error, or interrupted because the run is ending
+    }
+}
+
+static int http_connect(uint64_t deadline_us, SimOutcome_t *failure) {
+    char port[8];
+    snprintf(port, sizeof(port), "%u", (unsigned)sim->backend_port);
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *addr = NULL;
+    *failure = SIM_OUTCOME_CONNECT_ERROR;
+    if (getaddrinfo(sim->backend_host, port, &hints, &addr) != 0 || !addr) {
+        return -1;
+    }
+
+    int fd = socket(addr->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(fd, addr->ai_addr, addr->ai_addrlen) != 0) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            int ready = errno == EINPROGRESS ? wait_fd(fd, POLLOUT, deadline_us) : -1;
+            if (ready == 0) *failure = SIM_OUTCOME_TIMEOUT;
+            if (ready <= 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0) {
+                close(fd);
+                fd = -1;
+            }
+        }
+    }
+    freeaddrinfo(addr);
+    return fd;
+}
+
+static bool send_all(int fd, const char *data, size_t length, uint64_t deadline_us) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent > 0) {
+            data += sent;
+            length -= (size_t)sent;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (wait_fd(fd, POLLOUT, deadline_us) != 1) return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// One request/response on http_fd. Returns the HTTP status, or -1 with *failure set.
+// *keep_open is false if the server will close the connection.
+static int http_exchange(const char *head, size_t head_len, const char *body, size_t body_len,
+                         char *response, size_t response_size, uint64_t deadline_us,
+                         SimOutcome_t *failure, bool *keep_open, bool *got_bytes) {
+    static char rx[SIM_HTTP_RX_BYTES];
+    size_t rx_len = 0;
+    size_t header_len = 0;
+    long content_length = -1;
+    int status = -1;
+    *got_bytes = false;
+    *failure = SIM_OUTCOME_CONNECT_ERROR;
+
+    if (!send_all(http_fd, head, head_len, deadline_us) || !send_all(http_fd, body, body_len, deadline_us)) {
+        if (monotonic_us() >= deadline_us) *failure = SIM_OUTCOME_TIMEOUT;
+        return -1;
+    }
+
+    while (header_len == 0 || content_length < 0 || rx_len < header_len + (size_t)content_length) {
+        if (rx_len == sizeof(rx) - 1) {
+            *keep_open = false; // Reply larger than we keep: drop the rest with the connection
+            break;
+        }
+        ssize_t received = recv(http_fd, rx + rx_len, sizeof(rx) - 1 - rx_len, 0);
+        if (received > 0) {
+            *got_bytes = true;
+            rx_len += (size_t)received;
+            rx[rx_len] = '\0';
+        } else if (received == 0) {
+            if (header_len && content_length < 0) break; // Body delimited by close
+            return -1;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            int ready = wait_fd(http_fd, POLLIN, deadline_us);
+            if (ready == 0) *failure = SIM_OUTCOME_TIMEOUT;
+            if (ready != 1) return -1;
+            continue;
+        } else {
+            return -1;
+        }
+
+        if (header_len == 0) {
+            char *end = strstr(rx, "\r\n\r\n");
+            if (!end) continue;
+            header_len = (size_t)(end - rx) + 4;
+            *end = '\0'; // Headers as one string while parsing
+            int minor = 1;
+            if (sscanf(rx, "HTTP/1.%d %d", &minor, &status) != 2) return -1;
+            *keep_open = minor >= 1 && !strcasestr(rx, "\r\nConnection: close");
+            const char *length = strcasestr(rx, "\r\nContent-Length:");
+            if (length) content_length = strtol(length + 17, NULL, 10);
+            *end = '\r';
+        }
+    }
+
+    size_t body_received = rx_len - header_len;
+    if (response && response_size) {
+        size_t copy = body_received < response_size - 1 ? body_received : response_size - 1;
+        memcpy(response, rx + header_len, copy);
+        response[copy] = '\0';
+    }
+    if (content_length < 0) *keep_open = false;
+    return status;
+}
+
+static int http_post(const char *path, const char *payload, char *response, size_t response_size,
+                     uint64_t deadline_us, SimOutcome_t *failure) {
+    char head[256];
+    size_t body_len = strlen(payload);
+    int head_len = snprintf(head, sizeof(head),
+                            "POST %s HTTP/1.1\r\nHost: %s:%u\r\nContent-Type: application/json\r\n"
+                            "Content-Length: %zu\r\n\r\n", path, sim->backend_host, (unsigned)sim->backend_port, body_len);
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = http_fd >= 0;
+        if (!reused && (http_fd = http_connect(deadline_us, failure)) < 0) {
+            return -1;
+        }
+        bool keep_open = false;
+        bool got_bytes = false;
+        int status = http_exchange(head, (size_t)head_len, payload, body_len, response, response_size,
+                                   deadline_us, failure, &keep_open, &got_bytes);
+        if (status > 0) {
+            if (!keep_open) http_close();
+            return status;
+        }
+        http_close();
+        // An idle keep-alive connection the server already closed: one fresh attempt
+        if (!reused || got_bytes || *failure == SIM_OUTCOME_TIMEOUT) break;
+    }
+    return -1;
+}
+
+int hal_Wifi_HttpPost(const char* url, const char* payload, char* response_buffer, size_t buffer_size, uint32_t timeout_ms) {
+    SimRequestKind_t kind = strstr(url, "/device_health") ? SIM_KIND_HEALTH : SIM_KIND_READING;
+    if (response_buffer && buffer_size) response_buffer[0] = '\0';
+    if (!hal_Wifi_IsConnected()) {
+        SimStats_Record(kind, SIM_OUTCOME_OFFLINE, 0);
+        return -1;
+    }
+
+    // Only the path of the firmware URL is used; the host is the simulator's backend
+    const char *path = strstr(url, "://");
+    path = path ? strchr(path + 3, '/') : url;
+    if (!path) path = "/";
+
+    // Injected request loss: nothing reaches the backend, the device waits out its timeout
+    if (hal_Sim_Chance(sim->drop_pct)) {
+        hal_System_DelayMs(timeout_ms);
+        SimStats_Record(kind, SIM_OUTCOME_DROPPED, 0);
+        return -1;
+    }
+
+    uint64_t start_us = monotonic_us();
+    uint64_t deadline_us = start_us + (uint64_t)timeout_ms * 1000U;
+    if (sim->delay_ms) {
+        hal_System_DelayMs(sim->delay_ms);
+    }
+    SimOutcome_t outcome = SIM_OUTCOME_CONNECT_ERROR;
+    int status = http_post(path, payload, response_buffer, buffer_size, deadline_us, &outcome);
+    uint64_t latency_us = monotonic_us() - start_us;
+    if (status < 0) {
+        SimStats_Record(kind, outcome, 0);
+        return -1;
+    }
+
+    // Injected reply loss: the backend has handled the request, the device times out and retries
+    if (hal_Sim_Chance(sim->lost_reply_pct)) {
+        uint64_t now = monotonic_us();
+        if (now < deadline_us) hal_System_DelayMs((uint32_t)((deadline_us - now) / 1000U));
+        if (response_buffer && buffer_size) response_buffer[0] = '\0';
+        SimStats_Record(kind, SIM_OUTCOME_LOST_REPLY, 0);
+        return -1;
+    }
+
+    if (status >= 200 && status < 300) {
+        bool duplicate = response_buffer && (strstr(response_buffer, "\"duplicate\":true") ||
+                                             strstr(response_buffer, "\"duplicate\": true"));
+        outcome = duplicate ? SIM_OUTCOME_DUPLICATE : SIM_OUTCOME_STORED;
+    } else {
+        outcome = status >= 500 ? SIM_OUTCOME_HTTP_5XX : SIM_OUTCOME_HTTP_4XX;
+    }
+    SimStats_Record(kind, outcome, latency_us);
+    return status;
+}
+
+// --- Firmware Modules Not Simulated ---
+bool DiagTrace_Start(const char *host, uint16_t port, uint32_t seconds) {
+    (void)host; (void)port; (void)seconds;
+    ESP_LOGW(TAG, "start_trace is not simulated.");
+    return false; // Rejected, like a device that cannot open the stream
+}
+
+void DLog_Write(DLogId_t id, int nargs, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    (void)id; (void)nargs; (void)a0; (void)a1; (void)a2; (void)a3; // Hot-path records are dropped
+}
+
+void hal_Sim_Init(const SimConfig_t *config, int index) {
+    sim = config;
+    snprintf(device_id, sizeof(device_id), "%s%d", config->device_prefix, index);
+    rng_state = ((uint64_t)config->seed << 32) ^ ((uint64_t)index * 0x9E3779B97F4A7C15ULL) ^ 0x5DEECE66DULL;
+    if (rng_state == 0) rng_state = 1;
+    for (int i = 0; i < 8; i++) hal_Sim_Random(); // Decorrelate neighbouring seeds
+
+    boot_us = monotonic_us();
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    boot_epoch_ms = (uint64_t)ts.tv_sec * 1000ULL + (uint64_t)ts.tv_nsec / 1000000U;
+}
@@ -0,0 +1,7 @@
+#ifndef SIM_CJSON_H
+#define SIM_CJSON_H
+
+// The ESP-IDF json component is cJSON; on the host the system library is used
+#include <cjson/cJSON.h>
+
+#endif // SIM_CJSON_H
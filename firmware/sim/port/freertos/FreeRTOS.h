@@ -0,0 +1,25 @@
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+// Fleet simulator stand-in for the FreeRTOS types the shared firmware headers
+// mention. A virtual scale is one single-threaded process, so critical
+// sections are no-ops.
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint8_t StackType_t;
+typedef struct { uint8_t opaque[128]; } StaticTask_t;
+typedef void *TaskHandle_t;
+
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux)  ((void)(mux))
+
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portTICK_PERIOD_MS 1
+
+#endif // SIM_FREERTOS_H
@@ -0,0 +1,9 @@
+#ifndef SIM_FREERTOS_TASK_H
+#define SIM_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+#endif // SIM_FREERTOS_TASK_H
@@ -0,0 +1,79 @@
+#ifndef SIM_H
+#define SIM_H
+
+// Fleet simulator (see fleet_sim.c). Force-included into every translation
+// unit of the simulator build (Makefile), so the unmodified firmware sources
+// pick up a per-process device id.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+const char *hal_Sim_DeviceId(void);
+#define DEVICE_ID hal_Sim_DeviceId()
+
+typedef enum {
+    SIM_POLICY_PERIODIC,  // Upload every interval, like comms_task
+    SIM_POLICY_ON_CHANGE  // Upload when the settled count changes, interval = heartbeat
+} SimReportPolicy_t;
+
+// Fleet-wide settings, parsed once by the supervisor and inherited by every scale process
+typedef struct {
+    // Backend
+    const char *backend_host;   // Every upload goes here, whatever host the firmware URL names
+    uint16_t backend_port;
+    const char *device_prefix;  // Device ids are <prefix><index>
+    uint32_t seed;              // Random streams are derived from seed and scale index
+
+    // Simulated load cell traffic
+    float piece_weight_g;
+    int max_items;
+    uint32_t item_change_ms;    // Mean time between items being added or removed
+    float noise_g;              // Standard deviation of the settled signal
+
+    // Reporting policy
+    SimReportPolicy_t policy;
+    uint32_t interval_ms;       // 0 = firmware interval (COMMS_TASK_INTERVAL_MS, follows set_report_interval)
+    uint32_t jitter_pct;        // +/- random spread of every interval
+    uint32_t health_interval_ms;
+
+    // Network faults (percentages per upload attempt)
+    double drop_pct;            // Request lost on the way: the backend never sees it, the device times out
+    double lost_reply_pct;      // Reply lost: the backend stored the reading, the device times out and retries
+    uint32_t delay_ms;          // Extra latency added to every request
+    uint32_t outage_every_s;    // Mean time between Wi-Fi outages, 0 = none
+    uint32_t outage_ms;
+
+    int log_level;              // esp_log_level_t for firmware log lines (stderr)
+} SimConfig_t;
+
+// --- Per-Process HAL Control (hal_sim.c) ---
+void hal_Sim_Init(const SimConfig_t *config, int index); // Call first in every scale process
+void hal_Sim_SetVirtualTime(uint64_t uptime_ms); // Uptime reported to the firmware; 0 = real clock
+uint64_t hal_Sim_RealUptimeMs(void);
+double hal_Sim_Random(void); // Uniform [0, 1)
+bool hal_Sim_Chance(double pct);
+
+// --- Shared Statistics (fleet_sim.c) ---
+typedef enum {
+    SIM_KIND_READING,
+    SIM_KIND_HEALTH,
+    SIM_KIND_COUNT
+} SimRequestKind_t;
+
+typedef enum {
+    SIM_OUTCOME_STORED,        // 2xx
+    SIM_OUTCOME_DUPLICATE,     // 2xx, backend recognized a retransmission
+    SIM_OUTCOME_HTTP_4XX,
+    SIM_OUTCOME_HTTP_5XX,
+    SIM_OUTCOME_CONNECT_ERROR, // Refused / unreachable / reset
+    SIM_OUTCOME_TIMEOUT,       // No complete reply within the firmware timeout
+    SIM_OUTCOME_OFFLINE,       // Wi-Fi down (simulated outage), nothing sent
+    SIM_OUTCOME_DROPPED,       // Injected: request lost
+    SIM_OUTCOME_LOST_REPLY,    // Injected: reply lost after the backend handled the request
+    SIM_OUTCOME_COUNT
+} SimOutcome_t;
+
+// Records one upload attempt; latency_us is the request round trip (0 if there was none)
+void SimStats_Record(SimRequestKind_t kind, SimOutcome_t outcome, uint64_t latency_us);
+
+#endif // SIM_H
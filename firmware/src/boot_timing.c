@@ -0,0 +1,43 @@
+#include "boot_timing.h"
+#include "hal_interfaces.h"
+#include "esp_log.h"
+
+static const char *TAG = "BOOT_TIMING";
+
+static const char *const phase_names[BOOT_PHASE_COUNT] = {
+    [BOOT_PHASE_APP_START]      = "app_start",
+    [BOOT_PHASE_STORAGE]        = "storage",
+    [BOOT_PHASE_LOADCELL]       = "loadcell",
+    [BOOT_PHASE_CONFIG]         = "config",
+    [BOOT_PHASE_TASKS]          = "tasks",
+    [BOOT_PHASE_FIRST_READING]  = "first_reading",
+    [BOOT_PHASE_FIRST_STABLE]   = "first_stable",
+    [BOOT_PHASE_DISPLAY]        = "display",
+    [BOOT_PHASE_WIFI_INIT]      = "wifi_init",
+    [BOOT_PHASE_WIFI_CONNECTED] = "wifi_connected",
+};
+
+// Written once per phase; a 32-bit store is atomic, so no lock is needed
+static volatile uint32_t phase_us[BOOT_PHASE_COUNT];
+
+void BootTiming_Mark(BootPhase_t phase) {
+    if (phase >= BOOT_PHASE_COUNT || phase_us[phase] != 0) {
+        return;
+    }
+    uint32_t now_us = (uint32_t)hal_System_GetTimeUs();
+    phase_us[phase] = now_us ? now_us : 1; // 0 means "not reached"
+}
+
+uint32_t BootTiming_GetUs(BootPhase_t phase) {
+    return (phase < BOOT_PHASE_COUNT) ? phase_us[phase] : 0;
+}
+
+void BootTiming_Log(void) {
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        if (phase_us[i] == 0) {
+            ESP_LOGI(TAG, "%-15s: not reached", phase_names[i]);
+        } else {
+            ESP_LOGI(TAG, "%-15s: %7lu us", phase_names[i], (unsigned long)phase_us[i]);
+        }
+    }
+}
@@ -0,0 +1,315 @@
+#include "calibration.h"
+#include "hal_interfaces.h"
+#include <string.h> // For memset, memcpy
+#include <math.h>   // For fabsf
+#include "esp_log.h"
+
+static const char *TAG = "CALIBRATION";
+
+#define CAL_BLOB_VERSION   1
+#define CAL_MAX_CORRECTION 0.2f // Reject points more than 20% off the scalar calibration (wrong weight?)
+#define CORNER_BLOB_VERSION   1
+#define CORNER_MAX_CORRECTION 0.2f // Reject corner corrections more than 20% off nominal (load moved? faulty cell?)
+
+typedef struct {
+    float counts;      // Net counts: scalar-calibrated weight * calibration factor at capture
+    float reference_g; // Known reference weight
+} CalPoint_t;
+
+// Stored as-is in NVS; points sorted by counts
+typedef struct {
+    uint8_t version;
+    uint8_t count;
+    CalPoint_t points[CAL_MAX_POINTS];
+} CalBlob_t;
+
+static CalBlob_t active_cal; // Points behind the installed table
+static CalBlob_t draft_cal;  // Points captured since the last save
+
+typedef struct {
+    uint8_t version;
+    uint8_t num_channels;
+    float correction[LOADCELL_NUM_CHANNELS];
+} CornerBlob_t;
+
+// Net counts of each channel with the test weight on each corner, [corner][channel]
+static float corner_counts[LOADCELL_NUM_CHANNELS][LOADCELL_NUM_CHANNELS];
+static uint32_t corners_captured; // Bit per captured corner
+
+// Two tables: the sensor task reads one while the other is rebuilt
+static float lut_base[2][CAL_LUT_SEGMENTS];
+static float lut_delta[2][CAL_LUT_SEGMENTS];
+static LoadCellLinearization_t lut[2];
+static int active_lut = -1;
+
+// Corrected weight at scalar-calibrated weight x
+static float evaluate(const CalBlob_t *cal, float factor, float x) {
+    float x0 = 0.0f, y0 = 0.0f;
+    for (int k = 0; k < cal->count; k++) {
+        float x1 = cal->points[k].counts / factor;
+        float y1 = cal->points[k].reference_g;
+        if (x <= x1 || k == cal->count - 1) {
+            return y0 + (x - x0) * (y1 - y0) / (x1 - x0);
+        }
+        x0 = x1;
+        y0 = y1;
+    }
+    return x; // No points: identity
+}
+
+static void sort_points(CalBlob_t *cal) {
+    for (int i = 1; i < cal->count; i++) {
+        CalPoint_t point = cal->points[i];
+        int j = i - 1;
+        while (j >= 0 && cal->points[j].counts > point.counts) {
+            cal->points[j + 1] = cal->points[j];
+            j--;
+        }
+        cal->points[j + 1] = point;
+    }
+}
+
+// Points must describe a strictly increasing curve through the origin
+static bool validate(const CalBlob_t *cal) {
+    if (cal->version != CAL_BLOB_VERSION || cal->count == 0 || cal->count > CAL_MAX_POINTS) {
+        return false;
+    }
+    float prev_counts = 0.0f, prev_ref = 0.0f;
+    for (int k = 0; k < cal->count; k++) {
+        const CalPoint_t *p = &cal->points[k];
+        if (p->counts <= prev_counts || p->reference_g <= prev_ref) {
+            ESP_LOGW(TAG, "Point %d (%.2f g) is not increasing.", k, p->reference_g);
+            return false;
+        }
+        prev_counts = p->counts;
+        prev_ref = p->reference_g;
+    }
+    return true;
+}
+
+static void install_table(const CalBlob_t *cal) {
+    int slot = (active_lut == 0) ? 1 : 0;
+    float factor = hal_LoadCell_GetCalibrationFactor();
+    float step_g = OVERLOAD_THRESHOLD_G / CAL_LUT_SEGMENTS;
+
+    float start = evaluate(cal, factor, 0.0f);
+    for (int i = 0; i < CAL_LUT_SEGMENTS; i++) {
+        float end = evaluate(cal, factor, (float)(i + 1) * step_g);
+        lut_base[slot][i] = start;
+        lut_delta[slot][i] = end - start;
+        start = end;
+    }
+    lut[slot] = (LoadCellLinearization_t){
+        .inv_step_g = 1.0f / step_g,
+        .segments = CAL_LUT_SEGMENTS,
+        .base = lut_base[slot],
+        .delta = lut_delta[slot],
+    };
+    hal_LoadCell_SetLinearization(&lut[slot]);
+    active_lut = slot;
+}
+
+static void apply_corners(const CornerBlob_t *corners) {
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        hal_LoadCell_SetChannelCorrection(ch, corners->correction[ch]);
+    }
+}
+
+static void load_corners(void) {
+    CornerBlob_t stored;
+    size_t size = sizeof(stored);
+    if (!hal_Storage_Load_Blob(NVS_NAMESPACE, NVS_KEY_CAL_CORNERS, &stored, &size)) {
+        return; // Never corner-calibrated: nominal corrections
+    }
+    if (size != sizeof(stored) || stored.version != CORNER_BLOB_VERSION ||
+        stored.num_channels != LOADCELL_NUM_CHANNELS) {
+        ESP_LOGW(TAG, "Stored corner corrections do not match this platform, ignoring them.");
+        return;
+    }
+    apply_corners(&stored);
+    ESP_LOGI(TAG, "Loaded corner corrections for %d channel(s).", LOADCELL_NUM_CHANNELS);
+}
+
+// Solves counts * correction = target (the same reading on every corner)
+// by Gaussian elimination with partial pivoting. False if singular.
+static bool solve_corners(float target, float *correction) {
+    float a[LOADCELL_NUM_CHANNELS][LOADCELL_NUM_CHANNELS + 1];
+    for (int k = 0; k < LOADCELL_NUM_CHANNELS; k++) {
+        memcpy(a[k], corner_counts[k], sizeof(corner_counts[k]));
+        a[k][LOADCELL_NUM_CHANNELS] = target;
+    }
+    for (int col = 0; col < LOADCELL_NUM_CHANNELS; col++) {
+        int pivot = col;
+        for (int k = col + 1; k < LOADCELL_NUM_CHANNELS; k++) {
+            if (fabsf(a[k][col]) > fabsf(a[pivot][col])) pivot = k;
+        }
+        if (fabsf(a[pivot][col]) < 1e-6f * fabsf(target)) {
+            return false; // Two corners loaded the channels alike
+        }
+        for (int j = col; pivot != col && j <= LOADCELL_NUM_CHANNELS; j++) {
+            float swap = a[col][j];
+            a[col][j] = a[pivot][j];
+            a[pivot][j] = swap;
+        }
+        for (int k = col + 1; k < LOADCELL_NUM_CHANNELS; k++) {
+            float f = a[k][col] / a[col][col];
+            for (int j = col; j <= LOADCELL_NUM_CHANNELS; j++) {
+                a[k][j] -= f * a[col][j];
+            }
+        }
+    }
+    for (int col = LOADCELL_NUM_CHANNELS - 1; col >= 0; col--) {
+        float sum = a[col][LOADCELL_NUM_CHANNELS];
+        for (int j = col + 1; j < LOADCELL_NUM_CHANNELS; j++) {
+            sum -= a[col][j] * correction[j];
+        }
+        correction[col] = sum / a[col][col];
+    }
+    return true;
+}
+
+void Calibration_Init(void) {
+    memset(&active_cal, 0, sizeof(active_cal));
+    memset(&draft_cal, 0, sizeof(draft_cal));
+    draft_cal.version = CAL_BLOB_VERSION;
+    corners_captured = 0;
+    load_corners(); // Before the table: its points were taken through the corrected sum
+
+    CalBlob_t stored;
+    size_t size = sizeof(stored);
+    if (!hal_Storage_Load_Blob(NVS_NAMESPACE, NVS_KEY_CAL_POINTS, &stored, &size)) {
+        ESP_LOGI(TAG, "No multi-point calibration stored, using scalar factor only.");
+        return;
+    }
+    if (size != sizeof(stored) || !validate(&stored)) {
+        ESP_LOGW(TAG, "Stored calibration is invalid, ignoring it.");
+        return;
+    }
+    active_cal = stored;
+    install_table(&active_cal);
+    ESP_LOGI(TAG, "Loaded %d-point calibration.", active_cal.count);
+}
+
+bool Calibration_AddPoint(float reference_g) {
+    float linear_g = hal_LoadCell_GetLinearWeight();
+    if (reference_g < MIN_SAMPLE_WEIGHT_G || linear_g <= 0.0f) {
+        ESP_LOGW(TAG, "Rejected point: reference %.2f g at %.2f g", reference_g, linear_g);
+        return false;
+    }
+    if (fabsf(linear_g - reference_g) > reference_g * CAL_MAX_CORRECTION) {
+        ESP_LOGW(TAG, "Rejected point: %.2f g reads as %.2f g (wrong reference?)", reference_g, linear_g);
+        return false;
+    }
+
+    CalPoint_t point = { .counts = linear_g * hal_LoadCell_GetCalibrationFactor(), .reference_g = reference_g };
+    for (int k = 0; k < draft_cal.count; k++) {
+        if (fabsf(draft_cal.points[k].reference_g - reference_g) < 0.001f * reference_g) {
+            draft_cal.points[k] = point; // Re-capture of the same reference replaces it
+            ESP_LOGI(TAG, "Replaced point %.2f g (reads %.2f g)", reference_g, linear_g);
+            return true;
+        }
+    }
+    if (draft_cal.count >= CAL_MAX_POINTS) {
+        ESP_LOGW(TAG, "Calibration already has %d points.", CAL_MAX_POINTS);
+        return false;
+    }
+    draft_cal.points[draft_cal.count++] = point;
+    ESP_LOGI(TAG, "Captured point %d: %.2f g (reads %.2f g)", draft_cal.count, reference_g, linear_g);
+    return true;
+}
+
+bool Calibration_Save(void) {
+    sort_points(&draft_cal);
+    if (!validate(&draft_cal)) {
+        ESP_LOGW(TAG, "Captured points do not form a valid calibration.");
+        return false;
+    }
+    if (!hal_Storage_Save_Blob(NVS_NAMESPACE, NVS_KEY_CAL_POINTS, &draft_cal, sizeof(draft_cal))) {
+        ESP_LOGE(TAG, "Failed to save calibration to NVS!");
+        return false;
+    }
+    active_cal = draft_cal;
+    install_table(&active_cal);
+    ESP_LOGI(TAG, "Saved %d-point calibration.", active_cal.count);
+
+    memset(&draft_cal, 0, sizeof(draft_cal));
+    draft_cal.version = CAL_BLOB_VERSION;
+    return true;
+}
+
+void Calibration_Clear(void) {
+    hal_LoadCell_SetLinearization(NULL);
+    hal_Storage_Erase_Key(NVS_NAMESPACE, NVS_KEY_CAL_POINTS);
+    memset(&active_cal, 0, sizeof(active_cal));
+    memset(&draft_cal, 0, sizeof(draft_cal));
+    draft_cal.version = CAL_BLOB_VERSION;
+    ESP_LOGI(TAG, "Multi-point calibration cleared.");
+}
+
+int Calibration_GetPointCount(void) {
+    return active_cal.count;
+}
+
+bool Calibration_AddCorner(int corner) {
+    if (corner < 0 || corner >= LOADCELL_NUM_CHANNELS) {
+        ESP_LOGW(TAG, "Rejected corner %d: the platform has %d.", corner, LOADCELL_NUM_CHANNELS);
+        return false;
+    }
+    long raw[LOADCELL_NUM_CHANNELS];
+    float offsets[LOADCELL_NUM_CHANNELS];
+    hal_LoadCell_GetChannelRaw(raw, LOADCELL_NUM_CHANNELS);
+    hal_LoadCell_GetChannelOffsets(offsets, LOADCELL_NUM_CHANNELS);
+
+    float total = 0.0f;
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        corner_counts[corner][ch] = (float)raw[ch] - offsets[ch];
+        total += corner_counts[corner][ch];
+    }
+    float factor = hal_LoadCell_GetCalibrationFactor();
+    if (total / factor < MIN_SAMPLE_WEIGHT_G) {
+        ESP_LOGW(TAG, "Rejected corner %d: %.2f g is too light (is the platform tared?)", corner, total / factor);
+        return false;
+    }
+    corners_captured |= 1U << corner;
+    ESP_LOGI(TAG, "Captured corner %d: %.2f g", corner, total / factor);
+    return true;
+}
+
+bool Calibration_SaveCorners(void) {
+    const uint32_t all_corners = (1U << LOADCELL_NUM_CHANNELS) - 1U;
+    if (corners_captured != all_corners) {
+        ESP_LOGW(TAG, "Corner calibration needs every corner (captured mask 0x%lx).", (unsigned long)corners_captured);
+        return false;
+    }
+    // Aim for the mean corner reading, so the span calibration stays about right
+    float target = 0.0f;
+    for (int k = 0; k < LOADCELL_NUM_CHANNELS; k++) {
+        for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+            target += corner_counts[k][ch];
+        }
+    }
+    target /= LOADCELL_NUM_CHANNELS;
+
+    CornerBlob_t corners = { .version = CORNER_BLOB_VERSION, .num_channels = LOADCELL_NUM_CHANNELS };
+    if (!solve_corners(target, corners.correction)) {
+        ESP_LOGW(TAG, "Corner captures are degenerate (same corner loaded twice?)");
+        return false;
+    }
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        if (fabsf(corners.correction[ch] - 1.0f) > CORNER_MAX_CORRECTION) {
+            ESP_LOGW(TAG, "Channel %d correction %.4f is implausible.", ch, corners.correction[ch]);
+            return false;
+        }
+    }
+    if (!hal_Storage_Save_Blob(NVS_NAMESPACE, NVS_KEY_CAL_CORNERS, &corners, sizeof(corners))) {
+        ESP_LOGE(TAG, "Failed to save corner corrections to NVS!");
+        return false;
+    }
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        ESP_LOGI(TAG, "Channel %d correction %.4f -> %.4f", ch, hal_LoadCell_GetChannelCorrection(ch),
+                 corners.correction[ch]);
+    }
+    apply_corners(&corners);
+    corners_captured = 0;
+    return true;
+}
@@ -0,0 +1,227 @@
+#include "checkweigh.h"
+#include "hal_interfaces.h"
+#include <string.h> // For memset, memmove, strncmp
+#include <math.h>   // For fabsf, fminf
+#include "esp_log.h"
+
+static const char *TAG = "CHECKWEIGH";
+
+// --- Target Table ---
+// One NVS blob: the per-SKU bands, least recently set first, and whether
+// check-weighing was selected (resumed after a reboot).
+#define CHECK_TARGETS_VERSION 1
+typedef struct {
+    uint8_t version;
+    uint8_t active;
+    uint8_t count;
+    CheckTarget_t targets[CHECK_MAX_TARGETS];
+} CheckTargetsBlob_t;
+
+static CheckTargetsBlob_t table;
+
+static bool save_table(void) {
+    if (!hal_Storage_Save_Blob(NVS_NAMESPACE, NVS_KEY_CHECK_TARGETS, &table, sizeof(table))) {
+        ESP_LOGE(TAG, "Failed to save check targets to NVS!");
+        return false;
+    }
+    return true;
+}
+
+void Checkweigh_LoadTargets(void) {
+    size_t size = sizeof(table);
+    if (!hal_Storage_Load_Blob(NVS_NAMESPACE, NVS_KEY_CHECK_TARGETS, &table, &size) ||
+        size != sizeof(table) || table.version != CHECK_TARGETS_VERSION || table.count > CHECK_MAX_TARGETS) {
+        memset(&table, 0, sizeof(table));
+        table.version = CHECK_TARGETS_VERSION;
+        return;
+    }
+    for (int i = 0; i < table.count; i++) {
+        table.targets[i].sku[SKU_MAX_LEN - 1] = '\0';
+    }
+    ESP_LOGI(TAG, "Loaded %u check target(s).", table.count);
+}
+
+static int find_index(const char *sku) {
+    for (int i = 0; i < table.count; i++) {
+        if (strncmp(table.targets[i].sku, sku, SKU_MAX_LEN) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool Checkweigh_SetTarget(const CheckTarget_t *target) {
+    if (target->sku[0] == '\0') {
+        return false;
+    }
+
+    int index = find_index(target->sku);
+    if (index < 0 && table.count == CHECK_MAX_TARGETS) {
+        ESP_LOGW(TAG, "Target table full, dropping %s.", table.targets[0].sku);
+        index = 0; // Least recently set
+    }
+    if (index >= 0) {
+        table.count--;
+        memmove(&table.targets[index], &table.targets[index + 1], (table.count - index) * sizeof(CheckTarget_t));
+    }
+    CheckTarget_t *slot = &table.targets[table.count++];
+    *slot = *target;
+    slot->sku[SKU_MAX_LEN - 1] = '\0';
+    table.version = CHECK_TARGETS_VERSION;
+    ESP_LOGI(TAG, "Target for %s: %.3f -%.3f/+%.3f %s", slot->sku, slot->target, slot->under, slot->over,
+             slot->unit == CHECK_UNIT_COUNT ? "items" : "g");
+    return save_table();
+}
+
+bool Checkweigh_FindTarget(const char *sku, CheckTarget_t *target) {
+    int index = (sku && sku[0]) ? find_index(sku) : -1;
+    if (index < 0) {
+        return false;
+    }
+    *target = table.targets[index];
+    return true;
+}
+
+void Checkweigh_SaveActive(bool active) {
+    if (table.active == active) {
+        return;
+    }
+    table.active = active;
+    table.version = CHECK_TARGETS_VERSION;
+    save_table();
+}
+
+bool Checkweigh_WasActive(void) {
+    return table.active;
+}
+
+// --- Decision Engine ---
+
+bool Checkweigh_ResolveBand(const CheckTarget_t *target, float item_weight_g, float *lower_g, float *upper_g) {
+    if (!(target->target > 0.0f) || !(target->under >= 0.0f) || !(target->over >= 0.0f) ||
+        target->under >= target->target) {
+        return false;
+    }
+
+    float lower = target->target - target->under;
+    float upper = target->target + target->over;
+    if (target->unit == CHECK_UNIT_COUNT) {
+        if (!(item_weight_g > 0.001f)) {
+            return false;
+        }
+        // A count of n covers n - 0.5 to n + 0.5 pieces (ScaleCore_CountItems rounding)
+        lower = (lower - 0.5f) * item_weight_g;
+        upper = (upper + 0.5f) * item_weight_g;
+    }
+    *lower_g = lower;
+    *upper_g = upper;
+    return true;
+}
+
+void Checkweigh_Arm(CheckweighState_t *check, float lower_g, float upper_g) {
+    check->lower_g = lower_g;
+    check->upper_g = upper_g;
+    check->present_g = lower_g * CHECK_PRESENT_FRACTION;
+    check->clear_g = check->present_g * CHECK_CLEAR_FRACTION;
+    check->phase = CHECK_PHASE_CLEARING; // A pack already on the pan may have been judged under another band
+    check->candidate = CHECK_RESULT_NONE;
+    check->candidate_samples = 0;
+}
+
+// Result for the pack on the pan, CHECK_RESULT_NONE while it is not clear yet
+static CheckResult_t classify(CheckweighState_t *check, bool is_overload, bool is_stable) {
+    if (is_overload) {
+        return CHECK_RESULT_OVER; // Past capacity is past any band
+    }
+
+    CheckResult_t zone;
+    float distance; // To the nearest limit of the zone
+    float projected = check->projected_g;
+    if (projected < check->lower_g) {
+        zone = CHECK_RESULT_UNDER;
+        distance = check->lower_g - projected;
+    } else if (projected > check->upper_g) {
+        zone = CHECK_RESULT_OVER;
+        distance = projected - check->upper_g;
+    } else {
+        zone = CHECK_RESULT_PASS;
+        distance = fminf(projected - check->lower_g, check->upper_g - projected);
+    }
+    if (is_stable) {
+        return zone; // Settled: waiting longer would not make a pack at the limit any clearer
+    }
+
+    float margin = CHECK_HYSTERESIS_G + CHECK_SLOPE_GUARD * fabsf(check->slope_g);
+    if (distance <= margin) {
+        check->candidate_samples = 0;
+        return CHECK_RESULT_NONE;
+    }
+    if (zone != check->candidate) {
+        check->candidate = zone;
+        check->candidate_samples = 0;
+    }
+    if (++check->candidate_samples < CHECK_CONFIRM_SAMPLES) {
+        return CHECK_RESULT_NONE;
+    }
+    return zone;
+}
+
+static CheckResult_t decide(CheckweighState_t *check, CheckResult_t result, bool is_stable, uint32_t now_ms) {
+    check->phase = CHECK_PHASE_CLEARING;
+    check->last_result = result;
+    check->last_weight_g = check->projected_g;
+    check->last_latency_ms = now_ms - check->arrived_ms;
+    check->last_early = !is_stable;
+    check->results[result]++;
+    check->decisions++;
+    return result;
+}
+
+CheckResult_t Checkweigh_Process(CheckweighState_t *check, float weight_g, bool is_overload, bool is_stable, uint32_t now_ms) {
+    // Single-pole low-pass. For a step it closes (1 - alpha) of the remaining
+    // gap per sample, so the value it settles at follows from the last change.
+    float previous = check->filtered_g;
+    check->filtered_g += CHECK_FILTER_ALPHA * (weight_g - check->filtered_g);
+    check->slope_g = check->filtered_g - previous;
+    check->projected_g = check->filtered_g + check->slope_g * (1.0f - CHECK_FILTER_ALPHA) / CHECK_FILTER_ALPHA;
+
+    bool gone = !is_overload && weight_g < check->clear_g && check->filtered_g < check->clear_g;
+    switch (check->phase) {
+        case CHECK_PHASE_EMPTY:
+            if (!is_overload && weight_g < check->present_g) {
+                return CHECK_RESULT_NONE;
+            }
+            check->phase = CHECK_PHASE_MEASURING;
+            check->arrived_ms = now_ms;
+            check->candidate = CHECK_RESULT_NONE;
+            check->candidate_samples = 0;
+            // fall through: the arrival sample may already decide (overload)
+
+        case CHECK_PHASE_MEASURING: {
+            if (gone) {
+                decide(check, CHECK_RESULT_UNDECIDED, is_stable, now_ms);
+                check->phase = CHECK_PHASE_EMPTY;
+                return CHECK_RESULT_UNDECIDED;
+            }
+            CheckResult_t result = classify(check, is_overload, is_stable);
+            return (result == CHECK_RESULT_NONE) ? CHECK_RESULT_NONE : decide(check, result, is_stable, now_ms);
+        }
+
+        case CHECK_PHASE_CLEARING:
+        default:
+            if (gone) {
+                check->phase = CHECK_PHASE_EMPTY;
+            }
+            return CHECK_RESULT_NONE;
+    }
+}
+
+const char *Checkweigh_ResultName(CheckResult_t result) {
+    switch (result) {
+        case CHECK_RESULT_PASS:      return "PASS";
+        case CHECK_RESULT_UNDER:     return "UNDER";
+        case CHECK_RESULT_OVER:      return "OVER";
+        case CHECK_RESULT_UNDECIDED: return "UNDECIDED";
+        default:                     return "NONE";
+    }
+}
@@ -1,17 +1,183 @@
 #include "comms_manager.h"
 #include "hal_interfaces.h"
 #include "scale_config.h"
+#include "calibration.h"
+#include "checkweigh.h"
+#include "diag_trace.h"
+#include "dlog.h"
 #include <stdio.h> // For snprintf
 #include <string.h>
+#include <stdlib.h> // For strtoul
 #include "esp_log.h"
+#include "cJSON.h" // ESP-IDF json component
+#if COMMS_TRANSPORT == COMMS_TRANSPORT_MQTT
+#include "freertos/FreeRTOS.h" // portMUX for the command hand-off
+#endif
 
 static const char *TAG = "COMMS_MANAGER";
 static CommsState_t current_comms_state = COMMS_STATE_DISCONNECTED;
 static uint64_t last_connect_attempt_ms = 0;
+static uint32_t report_interval_ms = COMMS_TASK_INTERVAL_MS;
+static uint32_t reported_stable_since_ms = 0; // Settle stamp already uploaded (sent once per settle)
+
+// --- Reading Sequence Numbers ---
+// Every reading carries "seq", a per-device counter that keeps increasing
+// across reboots, so the backend can drop retransmitted duplicates and
+// report gaps (backend services/sequence_tracker.py). Writing NVS for every
+// reading would wear the flash, so numbers are reserved SEQ_RESERVE_BLOCK at
+// a time: the stored value is the first unreserved number and a reboot
+// continues from there. Uploads also carry "boot_seq", the first number of
+// this boot, so the numbers a reboot skips are not reported as lost.
+static uint32_t seq_next = 0;
+static uint32_t seq_reserved_until = 0; // Exclusive end of the block stored in NVS
+static uint32_t seq_boot = 0;
+
+// --- Remote Command Downlink ---
+// Commands arrive in the reply to an upload, are applied by the comms task
+// and acknowledged in the next upload. The backend re-delivers a command
+// until it sees the ack, so recently applied ids are remembered to keep a
+// re-delivered tare from being applied twice.
+typedef enum {
+    REMOTE_CMD_TARE,
+    REMOTE_CMD_SET_PIECE_WEIGHT,
+    REMOTE_CMD_SET_SKU,
+    REMOTE_CMD_SET_REPORT_INTERVAL,
+    REMOTE_CMD_START_TRACE,
+    REMOTE_CMD_CALIBRATE_POINT,
+    REMOTE_CMD_CALIBRATE_SAVE,
+    REMOTE_CMD_CALIBRATE_CLEAR,
+    REMOTE_CMD_SET_CHECK_TARGET,
+    REMOTE_CMD_CALIBRATE_CORNER,
+    REMOTE_CMD_CALIBRATE_CORNER_SAVE,
+    REMOTE_CMD_UNKNOWN
+} RemoteCommandType_t;
+
+typedef struct {
+    uint32_t id;
+    RemoteCommandType_t type;
+    float grams;
+    uint32_t seconds;
+    char sku[SKU_MAX_LEN];
+    char host[16];  // start_trace collector (IPv4), empty = TRACE_COLLECTOR_HOST
+    uint16_t port;  // start_trace collector port, 0 = TRACE_COLLECTOR_PORT
+    float target;   // set_check_target band (grams, or items with unit "count")
+    float under;
+    float over;
+    uint8_t unit;   // CheckUnit_t
+    int corner;     // calibrate_corner: channel of the loaded corner
+} RemoteCommand_t;
+
+#define APPLIED_HISTORY_LEN 8
+#define MAX_PENDING_ACKS    (COMMS_MAX_PENDING_COMMANDS * 2)
+
+static RemoteCommand_t pending_commands[COMMS_MAX_PENDING_COMMANDS];
+static int pending_command_count = 0;
+static uint32_t acked_ids[MAX_PENDING_ACKS];
+static int acked_count = 0;
+static uint32_t rejected_ids[MAX_PENDING_ACKS];
+static int rejected_count = 0;
+static uint32_t applied_history[APPLIED_HISTORY_LEN];
+static int applied_history_idx = 0;
+
+// cJSON allocations for reply parsing come from a fixed arena that is reset
+// for every reply, so parsing never allocates from (or fragments) the heap.
+#define JSON_ARENA_SIZE 3072
+static uint8_t json_arena[JSON_ARENA_SIZE] __attribute__((aligned(8)));
+static size_t json_arena_used = 0;
+
+static void *json_arena_alloc(size_t size) {
+    size = (size + 7U) & ~(size_t)7U;
+    if (json_arena_used + size > JSON_ARENA_SIZE) {
+        return NULL; // cJSON_Parse fails cleanly; the commands are re-delivered
+    }
+    void *ptr = &json_arena[json_arena_used];
+    json_arena_used += size;
+    return ptr;
+}
+
+static void json_arena_free(void *ptr) {
+    (void)ptr; // Whole arena is released at once by resetting json_arena_used
+}
+
+#if COMMS_TRANSPORT == COMMS_TRANSPORT_MQTT
+// --- MQTT Transport ---
+// Readings are batched and published at QoS 1; acks ride once per batch.
+// Commands arrive on the command topic in the same {"commands":[...]} form
+// as an HTTP upload reply. The MQTT task only copies the message into a
+// single slot; the comms task parses it, so the command state above is
+// never touched from two tasks. A message arriving while the slot is full
+// is dropped: the backend re-publishes pending commands after every batch.
+static char topic_readings[64];
+static char topic_health[64];
+static char topic_lots[64];
+static char topic_commands[64];
+
+static char mqtt_batch[MQTT_BATCH_BUFFER_SIZE];
+static size_t mqtt_batch_len = 0;
+static int mqtt_batch_count = 0;
+static uint64_t mqtt_batch_started_ms = 0;
+#define MQTT_BATCH_TAIL_RESERVE 320 // Room kept for "]", the ack lists, the sent stamp, boot_seq and "}"
+
+static char mqtt_command_msg[API_RESPONSE_BUFFER_SIZE];
+static bool mqtt_command_ready = false;
+static portMUX_TYPE mqtt_command_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void on_mqtt_message(const char *topic, int topic_len, const char *data, int data_len) {
+    (void)topic; (void)topic_len; // Only the command topic is subscribed
+    bool stored = false;
+    portENTER_CRITICAL(&mqtt_command_lock);
+    if (!mqtt_command_ready && data_len < (int)sizeof(mqtt_command_msg)) {
+        memcpy(mqtt_command_msg, data, data_len);
+        mqtt_command_msg[data_len] = '\0';
+        mqtt_command_ready = true;
+        stored = true;
+    }
+    portEXIT_CRITICAL(&mqtt_command_lock);
+    if (!stored) {
+        ESP_LOGW(TAG, "Command message (%d bytes) dropped, will be re-delivered.", data_len);
+    }
+}
+#endif
+
+static void sequence_init(void) {
+    uint32_t stored = 0;
+    hal_Storage_Load_U32(NVS_NAMESPACE, NVS_KEY_SEQ_NEXT, &stored); // Not found: first boot, start at 0
+    seq_next = stored;
+    seq_boot = stored;
+    seq_reserved_until = stored; // First sequence_take reserves a block
+    ESP_LOGI(TAG, "Reading sequence continues at %lu.", (unsigned long)seq_next);
+}
+
+static uint32_t sequence_take(void) {
+    if (seq_next >= seq_reserved_until) {
+        uint32_t until = seq_next + SEQ_RESERVE_BLOCK;
+        if (!hal_Storage_Save_U32(NVS_NAMESPACE, NVS_KEY_SEQ_NEXT, until)) {
+            // Keep numbering; after a reboot the backend sees the counter go back and starts over
+            ESP_LOGE(TAG, "Could not reserve sequence numbers in NVS.");
+        }
+        seq_reserved_until = until;
+    }
+    return seq_next++;
+}
+
+static bool transport_is_connected(void) {
+#if COMMS_TRANSPORT == COMMS_TRANSPORT_MQTT
+    return hal_Wifi_IsConnected() && hal_Mqtt_IsConnected();
+#else
+    return hal_Wifi_IsConnected();
+#endif
+}
 
 void CommsManager_Init(void) {
     // HAL WiFi Init is usually done in main.c
     current_comms_state = COMMS_STATE_DISCONNECTED;
+#if COMMS_TRANSPORT == COMMS_TRANSPORT_MQTT
+    snprintf(topic_readings, sizeof(topic_readings), "%s/%s/readings", MQTT_TOPIC_PREFIX, DEVICE_ID);
+    snprintf(topic_health, sizeof(topic_health), "%s/%s/health", MQTT_TOPIC_PREFIX, DEVICE_ID);
+    snprintf(topic_lots, sizeof(topic_lots), "%s/%s/lots", MQTT_TOPIC_PREFIX, DEVICE_ID);
+    snprintf(topic_commands, sizeof(topic_commands), "%s/%s/cmd", MQTT_TOPIC_PREFIX, DEVICE_ID);
+#endif
+    sequence_init();
     ESP_LOGI(TAG, "Comms Manager Initialized.");
     // Immediately try to connect on startup
     CommsManager_Connect();
@@ -21,6 +187,10 @@ CommsState_t CommsManager_GetCurrentState(void) {
     return current_comms_state;
 }
 
+uint32_t CommsManager_GetReportIntervalMs(void) {
+    return report_interval_ms;
+}
+
 void CommsManager_Connect(void) {
     if (current_comms_state == COMMS_STATE_CONNECTING || current_comms_state == COMMS_STATE_CONNECTED) {
         return; // Already connected or connecting
@@ -29,17 +199,8 @@ void CommsManager_Connect(void) {
     ESP_LOGI(TAG, "Attempting WiFi connection...");
     current_comms_state = COMMS_STATE_CONNECTING;
     last_connect_attempt_ms = hal_System_GetTickMs();
-
-    // Asynchronous connect call (if HAL supports it) or blocking call here
-    // This example uses a blocking call for simplicity within RunPeriodic
-    // bool connected = hal_Wifi_Connect(WIFI_SSID, WIFI_PASSWORD, WIFI_CONNECT_TIMEOUT_MS);
-    // if (connected) {
-    //     current_comms_state = COMMS_STATE_CONNECTED;
-    //     ESP_LOGI(TAG, "WiFi Connected.");
-    // } else {
-    //     current_comms_state = COMMS_STATE_ERROR; // Or DISCONNECTED to retry
-    //     ESP_LOGE(TAG, "WiFi Connection Failed.");
-    // }
+    // Non-blocking: the WiFi HAL retries (with backoff) from its event handler
+    hal_Wifi_Connect(WIFI_SSID, WIFI_PASSWORD);
 }
 
 void CommsManager_RunPeriodic(void) {
@@ -47,37 +208,30 @@ void CommsManager_RunPeriodic(void) {
 
     switch (current_comms_state) {
         case COMMS_STATE_DISCONNECTED:
-            // Retry connection periodically
-            if (now - last_connect_attempt_ms > 30000) { // Retry every 30 seconds
-                 CommsManager_Connect(); // Initiate connection attempt
-            }
+        case COMMS_STATE_ERROR:
+            CommsManager_Connect(); // Initiate connection attempt
             break;
 
         case COMMS_STATE_CONNECTING:
-             // If connect was blocking, this state might be short.
-             // If it was async, check status here.
-             // For simplicity, assume connect is handled within this periodic check
-             if (now - last_connect_attempt_ms > WIFI_CONNECT_TIMEOUT_MS) {
-                  ESP_LOGE(TAG, "WiFi connection timed out.");
-                  hal_Wifi_Disconnect(); // Ensure cleanup
-                  current_comms_state = COMMS_STATE_DISCONNECTED; // Go back to disconnected to retry later
-                  last_connect_attempt_ms = now; // Reset timer
-             } else {
-                 // Re-check connection status explicitly
-                 if (hal_Wifi_IsConnected()) {
-                      ESP_LOGI(TAG, "WiFi Connected.");
-                      current_comms_state = COMMS_STATE_CONNECTED;
-                 }
-                 // else, remain in CONNECTING state
-             }
+#if COMMS_TRANSPORT == COMMS_TRANSPORT_MQTT
+            // Start the broker session once there is a network; esp-mqtt reconnects after that
+            if (hal_Wifi_IsConnected()) {
+                hal_Mqtt_Start(MQTT_BROKER_URI, DEVICE_ID, topic_commands, on_mqtt_message);
+            }
+#endif
+            // The HAL reconnects on its own; just observe the result
+            if (transport_is_connected()) {
+                ESP_LOGI(TAG, "Connected after %llu ms.", (unsigned long long)(now - last_connect_attempt_ms));
+                current_comms_state = COMMS_STATE_CONNECTED;
+            }
             break;
 
         case COMMS_STATE_CONNECTED:
             // Check if still connected
-            if (!hal_Wifi_IsConnected()) {
-                ESP_LOGW(TAG, "WiFi connection lost.");
-                current_comms_state = COMMS_STATE_DISCONNECTED;
-                last_connect_attempt_ms = now; // Reset timer for retry
+            if (!transport_is_connected()) {
+                ESP_LOGW(TAG, "Connection lost.");
+                current_comms_state = COMMS_STATE_CONNECTING; // HAL is already reconnecting
+                last_connect_attempt_ms = now;
             }
             // Data sending is handled by the comms_task calling CommsManager_SendData
             break;
@@ -88,53 +242,391 @@ void CommsManager_RunPeriodic(void) {
             // Transition back to CONNECTED or ERROR
              ESP_LOGD(TAG, "Currently sending data..."); // Placeholder log
             break;
+    }
+}
 
-        case COMMS_STATE_ERROR:
-            // Error state, maybe try reconnecting after a longer delay
-             if (now - last_connect_attempt_ms > 60000) { // Retry every 60 seconds from error
-                 ESP_LOGI(TAG, "Retrying connection after error...");
-                 current_comms_state = COMMS_STATE_DISCONNECTED; // Go back to disconnected
-                 CommsManager_Connect();
-            }
-            break;
+
+// --- Command Parsing / Acknowledgement Helpers ---
+static RemoteCommandType_t parse_command_type(const char *name) {
+    if (strcmp(name, "tare") == 0) return REMOTE_CMD_TARE;
+    if (strcmp(name, "set_piece_weight") == 0) return REMOTE_CMD_SET_PIECE_WEIGHT;
+    if (strcmp(name, "set_sku") == 0) return REMOTE_CMD_SET_SKU;
+    if (strcmp(name, "set_report_interval") == 0) return REMOTE_CMD_SET_REPORT_INTERVAL;
+    if (strcmp(name, "start_trace") == 0) return REMOTE_CMD_START_TRACE;
+    if (strcmp(name, "calibrate_point") == 0) return REMOTE_CMD_CALIBRATE_POINT;
+    if (strcmp(name, "calibrate_save") == 0) return REMOTE_CMD_CALIBRATE_SAVE;
+    if (strcmp(name, "calibrate_clear") == 0) return REMOTE_CMD_CALIBRATE_CLEAR;
+    if (strcmp(name, "set_check_target") == 0) return REMOTE_CMD_SET_CHECK_TARGET;
+    if (strcmp(name, "calibrate_corner") == 0) return REMOTE_CMD_CALIBRATE_CORNER;
+    if (strcmp(name, "calibrate_corner_save") == 0) return REMOTE_CMD_CALIBRATE_CORNER_SAVE;
+    return REMOTE_CMD_UNKNOWN;
+}
+
+static void record_ack(uint32_t id, bool accepted) {
+    uint32_t *ids = accepted ? acked_ids : rejected_ids;
+    int *count = accepted ? &acked_count : &rejected_count;
+    for (int i = 0; i < *count; i++) {
+        if (ids[i] == id) return; // Already queued for acknowledgement
+    }
+    if (*count < MAX_PENDING_ACKS) {
+        ids[(*count)++] = id;
+    } else {
+        ESP_LOGW(TAG, "Ack list full, command %lu will be re-delivered", (unsigned long)id);
     }
 }
 
+static bool was_recently_applied(uint32_t id) {
+    for (int i = 0; i < APPLIED_HISTORY_LEN; i++) {
+        if (applied_history[i] == id) return true;
+    }
+    return false;
+}
 
-void CommsManager_SendData(const ScaleState_t *state) {
-    if (current_comms_state != COMMS_STATE_CONNECTED) {
-        ESP_LOGW(TAG, "Cannot send data, not connected.");
+// Parses {"commands":[{"id":1,"cmd":"tare","args":{}}...]} from an upload reply
+static void parse_response_commands(const char *response) {
+    cJSON_Hooks arena_hooks = { .malloc_fn = json_arena_alloc, .free_fn = json_arena_free };
+    json_arena_used = 0;
+    cJSON_InitHooks(&arena_hooks);
+
+    cJSON *root = cJSON_Parse(response);
+    if (!root) {
+        ESP_LOGW(TAG, "Upload reply is not valid JSON (or too large), ignoring.");
+        cJSON_InitHooks(NULL); // Restore default allocator
         return;
     }
 
-    char payload[256]; // Adjust size as needed
-    char response_buffer[128]; // Adjust size
+    const cJSON *commands = cJSON_GetObjectItemCaseSensitive(root, "commands");
+    const cJSON *item = NULL;
+    cJSON_ArrayForEach(item, commands) {
+        const cJSON *id = cJSON_GetObjectItemCaseSensitive(item, "id");
+        const cJSON *cmd = cJSON_GetObjectItemCaseSensitive(item, "cmd");
+        const cJSON *args = cJSON_GetObjectItemCaseSensitive(item, "args");
+        if (!cJSON_IsNumber(id) || !cJSON_IsString(cmd)) {
+            continue; // Malformed entry
+        }
+        if (pending_command_count >= COMMS_MAX_PENDING_COMMANDS) {
+            break; // Remaining commands are re-delivered next time
+        }
+
+        RemoteCommand_t *command = &pending_commands[pending_command_count];
+        memset(command, 0, sizeof(*command));
+        command->id = (uint32_t)id->valuedouble;
+        command->type = parse_command_type(cmd->valuestring);
 
-    // Format data as JSON payload
+        const cJSON *grams = cJSON_GetObjectItemCaseSensitive(args, "grams");
+        const cJSON *seconds = cJSON_GetObjectItemCaseSensitive(args, "seconds");
+        const cJSON *sku = cJSON_GetObjectItemCaseSensitive(args, "sku");
+        const cJSON *host = cJSON_GetObjectItemCaseSensitive(args, "host");
+        const cJSON *port = cJSON_GetObjectItemCaseSensitive(args, "port");
+        const cJSON *target = cJSON_GetObjectItemCaseSensitive(args, "target");
+        const cJSON *under = cJSON_GetObjectItemCaseSensitive(args, "under");
+        const cJSON *over = cJSON_GetObjectItemCaseSensitive(args, "over");
+        const cJSON *unit = cJSON_GetObjectItemCaseSensitive(args, "unit");
+        const cJSON *corner = cJSON_GetObjectItemCaseSensitive(args, "corner");
+        if (cJSON_IsNumber(grams)) command->grams = (float)grams->valuedouble;
+        if (cJSON_IsNumber(seconds)) command->seconds = (uint32_t)seconds->valuedouble;
+        if (cJSON_IsString(sku)) {
+            strncpy(command->sku, sku->valuestring, sizeof(command->sku) - 1);
+        }
+        if (cJSON_IsString(host)) {
+            strncpy(command->host, host->valuestring, sizeof(command->host) - 1);
+        }
+        if (cJSON_IsNumber(port)) command->port = (uint16_t)port->valuedouble;
+        if (cJSON_IsNumber(target)) command->target = (float)target->valuedouble;
+        if (cJSON_IsNumber(under)) command->under = (float)under->valuedouble;
+        if (cJSON_IsNumber(over)) command->over = (float)over->valuedouble;
+        if (cJSON_IsString(unit) && strcmp(unit->valuestring, "count") == 0) command->unit = CHECK_UNIT_COUNT;
+        command->corner = cJSON_IsNumber(corner) ? (int)corner->valuedouble : -1;
+
+        // Skip duplicates of commands already waiting in this batch
+        bool duplicate = false;
+        for (int i = 0; i < pending_command_count; i++) {
+            if (pending_commands[i].id == command->id) duplicate = true;
+        }
+        if (!duplicate) {
+            pending_command_count++;
+        }
+    }
+    cJSON_Delete(root);
+    cJSON_InitHooks(NULL); // Restore default allocator
+
+    if (pending_command_count > 0) {
+        ESP_LOGI(TAG, "Received %d command(s) from backend.", pending_command_count);
+    }
+}
+
+static bool apply_command(ScaleState_t *state, const RemoteCommand_t *command) {
+    switch (command->type) {
+        case REMOTE_CMD_TARE:
+            ScaleLogic_RequestTare(state);
+            return state->current_mode != MODE_ERROR; // Tare is refused while overloaded
+
+        case REMOTE_CMD_SET_PIECE_WEIGHT:
+            return ScaleLogic_SetItemWeight(state, command->grams);
+
+        case REMOTE_CMD_SET_SKU:
+            return ScaleLogic_SetProduct(state, command->sku, command->grams);
+
+        case REMOTE_CMD_SET_REPORT_INTERVAL: {
+            uint32_t interval_ms = command->seconds * 1000U;
+            if (interval_ms < COMMS_MIN_REPORT_INTERVAL_MS) return false;
+            report_interval_ms = interval_ms;
+            ESP_LOGI(TAG, "Report interval set to %lu ms", (unsigned long)report_interval_ms);
+            return true;
+        }
+
+        case REMOTE_CMD_START_TRACE:
+            return DiagTrace_Start(command->host[0] ? command->host : TRACE_COLLECTOR_HOST,
+                                   command->port ? command->port : TRACE_COLLECTOR_PORT, command->seconds);
+
+        case REMOTE_CMD_CALIBRATE_POINT:
+            // Reference weight alone on the zeroed platform, settled
+            return state->is_stable && !state->is_overload && Calibration_AddPoint(command->grams);
+
+        case REMOTE_CMD_CALIBRATE_SAVE:
+            return Calibration_Save();
+
+        case REMOTE_CMD_CALIBRATE_CLEAR:
+            Calibration_Clear();
+            return true;
+
+        case REMOTE_CMD_SET_CHECK_TARGET: {
+            CheckTarget_t target = { .target = command->target, .under = command->under,
+                                     .over = command->over, .unit = command->unit };
+            memcpy(target.sku, command->sku, sizeof(target.sku));
+            return ScaleLogic_SetCheckTarget(state, &target);
+        }
+
+        case REMOTE_CMD_CALIBRATE_CORNER:
+            // Test weight on this corner of the (tared) platform, settled
+            return state->is_stable && !state->is_overload && Calibration_AddCorner(command->corner);
+
+        case REMOTE_CMD_CALIBRATE_CORNER_SAVE:
+            return Calibration_SaveCorners();
+
+        case REMOTE_CMD_UNKNOWN:
+        default:
+            return false;
+    }
+}
+
+void CommsManager_ApplyPendingCommands(ScaleState_t *state) {
+#if COMMS_TRANSPORT == COMMS_TRANSPORT_MQTT
+    if (mqtt_command_ready) {
+        parse_response_commands(mqtt_command_msg);
+        portENTER_CRITICAL(&mqtt_command_lock);
+        mqtt_command_ready = false; // Slot free for the next command message
+        portEXIT_CRITICAL(&mqtt_command_lock);
+    }
+#endif
+    for (int i = 0; i < pending_command_count; i++) {
+        const RemoteCommand_t *command = &pending_commands[i];
+        if (was_recently_applied(command->id)) {
+            // Re-delivered because our ack was lost: acknowledge again, don't re-apply
+            record_ack(command->id, true);
+            continue;
+        }
+
+        bool accepted = apply_command(state, command);
+        ESP_LOGI(TAG, "Command %lu (type %d) %s.", (unsigned long)command->id, command->type,
+                 accepted ? "applied" : "rejected");
+        record_ack(command->id, accepted);
+        applied_history[applied_history_idx] = command->id;
+        applied_history_idx = (applied_history_idx + 1) % APPLIED_HISTORY_LEN;
+    }
+    pending_command_count = 0;
+}
+
+// Appends ,"key":[1,2,3] to the payload. Returns false if it did not fit.
+static bool append_id_list(char *buf, size_t size, size_t *len, const char *key, const uint32_t *ids, int count) {
+    if (count == 0) return true;
+    int written = snprintf(buf + *len, size - *len, ", \"%s\":[", key);
+    for (int i = 0; written > 0 && *len + written < size && i < count; i++) {
+        written += snprintf(buf + *len + written, size - *len - written, i ? ",%lu" : "%lu", (unsigned long)ids[i]);
+    }
+    if (written <= 0 || *len + written + 3 > size) { // Room for "]}" and terminator
+        buf[*len] = '\0'; // Roll back partial list
+        return false;
+    }
+    *len += written;
+    *len += snprintf(buf + *len, size - *len, "]");
+    return true;
+}
+
+// Uptime stamp (32-bit ms, wraps after ~49 days) -> epoch ms; 0 before the first SNTP sync
+static uint64_t stamp_to_epoch_ms(uint32_t stamp_ms) {
+    uint64_t now_ms = hal_System_GetTickMs();
+    return hal_Time_UptimeToEpochMs(now_ms - (uint32_t)((uint32_t)now_ms - stamp_ms));
+}
+
+// Settle stamp to report with this reading, 0 if unstable or already reported
+static uint32_t unreported_stable_since(const ScaleState_t *state) {
+    uint32_t stable_since_ms = state->stable_since_ms;
+    return (state->is_stable && stable_since_ms != reported_stable_since_ms) ? stable_since_ms : 0;
+}
+
+// Formats the reading fields (without braces or device id). Returns the length, or -1 if it did not fit.
+// Once the clock is synced the reading carries wall-clock latency trace stamps
+// (backend services/latency.py); the upload-level "sent" and "boot_seq" fields are added by the caller.
+static int format_reading(const ScaleState_t *state, uint32_t seq, uint32_t stable_since_ms, char *buf, size_t size) {
     // Note: Using snprintf is basic. A dedicated JSON library (like cJSON) is better for complex data.
-    snprintf(payload, sizeof(payload),
-             "{\"device_id\":\"%s\", \"timestamp\":\"%llu\", \"weight_grams\":%.2f, "
+    int len = snprintf(buf, size,
+             "\"seq\":%lu, \"weight_grams\":%.2f, "
              "\"item_count\":%ld, \"is_stable\":%s, \"is_overload\":%s, "
-             "\"average_item_weight\":%.3f, \"mode\":\"%s\"}",
-             DEVICE_ID,
-             hal_System_GetTickMs(), // Use system ticks as a simple timestamp proxy
+             "\"average_item_weight\":%.3f, \"mode\":\"%s\", \"sku\":\"%s\"",
+             (unsigned long)seq,
              state->current_weight_g,
              state->item_count,
              state->is_stable ? "true" : "false",
              state->is_overload ? "true" : "false",
              state->average_item_weight_g,
-             (state->current_mode == MODE_COUNTING) ? "COUNTING" : ((state->current_mode == MODE_WEIGHING) ? "WEIGHING" : "ERROR")
+             ScaleLogic_ModeName(state->current_mode),
+             state->sku
     );
 
-    ESP_LOGI(TAG, "Sending data: %s", payload);
+    uint64_t sampled = stamp_to_epoch_ms(state->sampled_ms);
+    if (sampled != 0 && len > 0 && (size_t)len < size) {
+        len += snprintf(buf + len, size - len, ", \"timestamp\":%llu, \"trace\":{\"sampled\":%llu,\"enqueued\":%llu",
+                        (unsigned long long)sampled, (unsigned long long)sampled,
+                        (unsigned long long)hal_Time_UptimeToEpochMs(hal_System_GetTickMs()));
+        if (stable_since_ms != 0 && (size_t)len < size) {
+            len += snprintf(buf + len, size - len, ",\"stable\":%llu", (unsigned long long)stamp_to_epoch_ms(stable_since_ms));
+        }
+        if ((size_t)len < size) {
+            len += snprintf(buf + len, size - len, "}");
+        }
+    }
+    return (len < 0 || (size_t)len >= size) ? -1 : len;
+}
+
+// Appends ,"sent":<epoch ms> (upload handed to the transport) if the clock is synced
+static void append_sent_stamp(char *buf, size_t size, size_t *len) {
+    uint64_t sent = hal_Time_UptimeToEpochMs(hal_System_GetTickMs());
+    if (sent != 0 && *len < size) {
+        int written = snprintf(buf + *len, size - *len, ", \"sent\":%llu", (unsigned long long)sent);
+        if (written > 0 && *len + written + 2 <= size) { // Keep room for the closing brace
+            *len += written;
+        } else {
+            buf[*len] = '\0';
+        }
+    }
+}
+
+// Appends ,"boot_seq":<first sequence number of this boot>
+static void append_boot_seq(char *buf, size_t size, size_t *len) {
+    if (*len < size) {
+        int written = snprintf(buf + *len, size - *len, ", \"boot_seq\":%lu", (unsigned long)seq_boot);
+        if (written > 0 && *len + written + 2 <= size) { // Keep room for the closing brace
+            *len += written;
+        } else {
+            buf[*len] = '\0';
+        }
+    }
+}
+
+#if COMMS_TRANSPORT == COMMS_TRANSPORT_MQTT
+// Closes the batch as {"readings":[...],"acked_commands":[...]} and queues it at QoS 1
+static void mqtt_publish_batch(void) {
+    size_t len = mqtt_batch_len;
+    len += snprintf(mqtt_batch + len, sizeof(mqtt_batch) - len, "]");
+    append_sent_stamp(mqtt_batch, sizeof(mqtt_batch), &len);
+    append_boot_seq(mqtt_batch, sizeof(mqtt_batch), &len);
+    bool acks_included = append_id_list(mqtt_batch, sizeof(mqtt_batch), &len, "acked_commands", acked_ids, acked_count) &&
+                         append_id_list(mqtt_batch, sizeof(mqtt_batch), &len, "rejected_commands", rejected_ids, rejected_count);
+    len += snprintf(mqtt_batch + len, sizeof(mqtt_batch) - len, "}");
+
+    int msg_id = hal_Mqtt_Publish(topic_readings, mqtt_batch, len, 1);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "MQTT outbox full, batch of %d reading(s) dropped.", mqtt_batch_count);
+    } else {
+        DLOG(DLOG_COMMS_MQTT_BATCH, mqtt_batch_count, len, msg_id);
+        if (acks_included) {
+            acked_count = 0; // QoS 1: the outbox retransmits until the broker has them
+            rejected_count = 0;
+        }
+    }
+    mqtt_batch_len = 0;
+    mqtt_batch_count = 0;
+}
+
+static void mqtt_send_reading(const ScaleState_t *state) {
+    char reading[320];
+    uint32_t stable_since_ms = unreported_stable_since(state);
+    int len = format_reading(state, sequence_take(), stable_since_ms, reading, sizeof(reading));
+    if (len < 0) {
+        ESP_LOGE(TAG, "Reading buffer too small.");
+        return;
+    }
+
+    if (mqtt_batch_count > 0 && mqtt_batch_len + len + 3 + MQTT_BATCH_TAIL_RESERVE > sizeof(mqtt_batch)) {
+        mqtt_publish_batch(); // No room left for this reading
+    }
+    uint64_t now = hal_System_GetTickMs();
+    if (mqtt_batch_count == 0) {
+        mqtt_batch_len = (size_t)snprintf(mqtt_batch, sizeof(mqtt_batch), "{\"readings\":[");
+        mqtt_batch_started_ms = now;
+    }
+    mqtt_batch_len += snprintf(mqtt_batch + mqtt_batch_len, sizeof(mqtt_batch) - mqtt_batch_len,
+                               mqtt_batch_count ? ",{%s}" : "{%s}", reading);
+    mqtt_batch_count++;
+    if (stable_since_ms != 0) {
+        reported_stable_since_ms = stable_since_ms; // Batch is delivered by the outbox from here on
+    }
+
+    // Publish when full, when acks are waiting (so the backend stops re-delivering), or
+    // when holding the batch for another report interval would exceed the age limit.
+    if (mqtt_batch_count >= MQTT_BATCH_MAX_READINGS || acked_count > 0 || rejected_count > 0 ||
+        now - mqtt_batch_started_ms + report_interval_ms > MQTT_BATCH_MAX_AGE_MS) {
+        mqtt_publish_batch();
+    }
+}
+#else
+static void http_send_reading(const ScaleState_t *state) {
+    char payload[640]; // Reading, trace stamps and up to MAX_PENDING_ACKS ids per ack list
+    char response_buffer[API_RESPONSE_BUFFER_SIZE];
+
+    // Format data as JSON payload
+    int len = snprintf(payload, sizeof(payload), "{\"device_id\":\"%s\", ", DEVICE_ID);
+    uint32_t stable_since_ms = unreported_stable_since(state);
+    int fields_len = format_reading(state, sequence_take(), stable_since_ms, payload + len, sizeof(payload) - len);
+    if (fields_len < 0) {
+        ESP_LOGE(TAG, "Payload buffer too small.");
+        return;
+    }
+    len += fields_len;
+
+    // Acknowledge commands applied since the last successful upload
+    size_t payload_len = (size_t)len;
+    bool acks_included = append_id_list(payload, sizeof(payload), &payload_len, "acked_commands", acked_ids, acked_count) &&
+                         append_id_list(payload, sizeof(payload), &payload_len, "rejected_commands", rejected_ids, rejected_count);
+    append_sent_stamp(payload, sizeof(payload), &payload_len);
+    append_boot_seq(payload, sizeof(payload), &payload_len);
+    snprintf(payload + payload_len, sizeof(payload) - payload_len, "}");
+
+    DLOG(DLOG_COMMS_SEND, (int)payload_len + 1, state->current_weight_g, state->item_count, acked_count + rejected_count);
     current_comms_state = COMMS_STATE_SENDING; // Indicate sending started
 
-    // Make the HTTP POST request via HAL
+    // Make the HTTP POST request via HAL. A timeout or server error is retried
+    // right away with the identical payload: if the first attempt was stored
+    // after all, the backend recognizes the seq and stores nothing twice.
     int http_status = hal_Wifi_HttpPost(API_ENDPOINT_URL, payload, response_buffer, sizeof(response_buffer), API_REQUEST_TIMEOUT_MS);
+    for (int retry = 0; retry < COMMS_SEND_RETRIES && (http_status < 0 || http_status >= 500) && hal_Wifi_IsConnected(); retry++) {
+        ESP_LOGW(TAG, "Upload failed (HTTP Status: %d), retrying.", http_status);
+        hal_System_DelayMs(COMMS_RETRY_DELAY_MS);
+        http_status = hal_Wifi_HttpPost(API_ENDPOINT_URL, payload, response_buffer, sizeof(response_buffer), API_REQUEST_TIMEOUT_MS);
+    }
 
     if (http_status >= 200 && http_status < 300) {
-        ESP_LOGI(TAG, "Data sent successfully. Status: %d. Response: %s", http_status, response_buffer);
+        DLOG(DLOG_COMMS_SENT, http_status, strlen(response_buffer));
         current_comms_state = COMMS_STATE_CONNECTED; // Return to connected state
+        if (stable_since_ms != 0) {
+            reported_stable_since_ms = stable_since_ms;
+        }
+        if (acks_included) {
+            acked_count = 0; // Backend has the acks now
+            rejected_count = 0;
+        }
+        parse_response_commands(response_buffer);
     } else {
         ESP_LOGE(TAG, "Failed to send data. HTTP Status: %d", http_status);
         current_comms_state = COMMS_STATE_CONNECTED; // Could go to ERROR, but maybe just retry next time
@@ -146,3 +638,98 @@ void CommsManager_SendData(const ScaleState_t *state) {
         }
     }
 }
+#endif
+
+void CommsManager_SendData(const ScaleState_t *state) {
+    if (current_comms_state != COMMS_STATE_CONNECTED) {
+        ESP_LOGW(TAG, "Cannot send data, not connected.");
+        return;
+    }
+#if COMMS_TRANSPORT == COMMS_TRANSPORT_MQTT
+    mqtt_send_reading(state);
+#else
+    http_send_reading(state);
+#endif
+}
+
+void CommsManager_SendHealth(const HealthRecord_t *record) {
+    if (current_comms_state != COMMS_STATE_CONNECTED) {
+        return; // Next interval will try again
+    }
+
+    char payload[384];
+
+    // Compact keys: task arrays are ordered sensor, ui, comms (see AppTaskId_t);
+    // chk is check-weighing decisions, rejects, early decisions, mean and max latency (ms)
+    int len = snprintf(payload, sizeof(payload),
+             "{\"device_id\":\"%s\",\"fw\":\"%s\",\"up\":%lu,"
+             "\"cpu\":[%u,%u,%u],\"idle\":[%u,%u],\"stk\":[%lu,%lu,%lu],"
+             "\"heap\":%lu,\"heap_min\":%lu,\"frag\":%u,"
+             "\"miss\":%lu,\"jit\":%lu,\"rssi\":%d,\"recon\":%lu,"
+             "\"chk\":[%lu,%lu,%lu,%lu,%lu]}",
+             DEVICE_ID, FIRMWARE_VERSION, (unsigned long)record->uptime_s,
+             record->task_cpu_pct[APP_TASK_SENSOR], record->task_cpu_pct[APP_TASK_UI], record->task_cpu_pct[APP_TASK_COMMS],
+             record->core_idle_pct[0], record->core_idle_pct[1],
+             (unsigned long)record->stack_min_free[APP_TASK_SENSOR], (unsigned long)record->stack_min_free[APP_TASK_UI],
+             (unsigned long)record->stack_min_free[APP_TASK_COMMS],
+             (unsigned long)record->heap_free, (unsigned long)record->heap_min_free, record->heap_fragmentation_pct,
+             (unsigned long)record->sensor_deadline_misses, (unsigned long)record->sensor_jitter_max_us,
+             record->wifi_rssi, (unsigned long)record->wifi_reconnects,
+             (unsigned long)record->check_decisions, (unsigned long)record->check_rejects,
+             (unsigned long)record->check_early, (unsigned long)record->check_latency_mean_ms,
+             (unsigned long)record->check_latency_max_ms);
+    if (len < 0 || (size_t)len >= sizeof(payload)) {
+        ESP_LOGE(TAG, "Health payload buffer too small.");
+        return;
+    }
+
+#if COMMS_TRANSPORT == COMMS_TRANSPORT_MQTT
+    // QoS 0: a lost record is superseded by the next interval's
+    if (hal_Mqtt_Publish(topic_health, payload, (size_t)len, 0) < 0) {
+        ESP_LOGW(TAG, "Failed to queue health record.");
+    }
+#else
+    char response_buffer[128];
+    int http_status = hal_Wifi_HttpPost(HEALTH_ENDPOINT_URL, payload, response_buffer, sizeof(response_buffer), API_REQUEST_TIMEOUT_MS);
+    if (http_status >= 200 && http_status < 300) {
+        ESP_LOGD(TAG, "Health record sent.");
+    } else {
+        ESP_LOGW(TAG, "Failed to send health record. HTTP Status: %d", http_status);
+    }
+#endif
+}
+
+bool CommsManager_SendLot(const LotRecord_t *lot) {
+    if (current_comms_state != COMMS_STATE_CONNECTED) {
+        return false;
+    }
+
+    char payload[224];
+    int len = snprintf(payload, sizeof(payload),
+             "{\"device_id\":\"%s\",\"lot_id\":%lu,\"sku\":\"%s\",\"item_weight\":%.3f,"
+             "\"total\":%ld,\"loads\":%u,\"closed\":%llu}",
+             DEVICE_ID, (unsigned long)lot->lot_id, lot->sku, lot->item_weight_g,
+             (long)lot->total, lot->loads, (unsigned long long)lot->closed_epoch_ms);
+    if (len < 0 || (size_t)len >= sizeof(payload)) {
+        ESP_LOGE(TAG, "Lot payload buffer too small.");
+        return false;
+    }
+
+#if COMMS_TRANSPORT == COMMS_TRANSPORT_MQTT
+    // QoS 1: the client retransmits until the broker has it; redeliveries are dropped by lot_id
+    if (hal_Mqtt_Publish(topic_lots, payload, (size_t)len, 1) < 0) {
+        ESP_LOGW(TAG, "Failed to queue lot %lu.", (unsigned long)lot->lot_id);
+        return false;
+    }
+    return true;
+#else
+    char response_buffer[128];
+    int http_status = hal_Wifi_HttpPost(LOT_ENDPOINT_URL, payload, response_buffer, sizeof(response_buffer), API_REQUEST_TIMEOUT_MS);
+    if (http_status >= 200 && http_status < 300) {
+        ESP_LOGI(TAG, "Lot %lu reported (%ld items).", (unsigned long)lot->lot_id, (long)lot->total);
+        return true;
+    }
+    ESP_LOGW(TAG, "Failed to report lot %lu. HTTP Status: %d", (unsigned long)lot->lot_id, http_status);
+    return false;
+#endif
+}
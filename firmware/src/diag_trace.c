@@ -0,0 +1,244 @@
+#include "diag_trace.h"
+#include "hal_interfaces.h"
+#include "app_tasks.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+static const char *TAG = "DIAG_TRACE";
+
+#if (TRACE_RING_SAMPLES & (TRACE_RING_SAMPLES - 1)) != 0
+#error "TRACE_RING_SAMPLES must be a power of two"
+#endif
+#if TRACE_MAX_BYTES_PER_S < TRACE_BLOCK_MAX_BYTES
+#error "TRACE_MAX_BYTES_PER_S must allow at least one block per second"
+#endif
+
+// --- Sample Ring ---
+// One producer (sensor task, through the HAL sample hook) and one consumer
+// (trace task). Each side writes only its own index, so no lock is taken on
+// the acquisition core; the release/acquire pair publishes the slot contents
+// together with the index. Indices run freely and count samples since start.
+static DiagTraceSample_t ring[TRACE_RING_SAMPLES];
+static uint32_t ring_head = 0; // Written by the sensor task
+static uint32_t ring_tail = 0; // Written by the trace task
+static volatile uint32_t samples_dropped = 0; // Ring full (trace task or network behind)
+
+// --- Trace Session ---
+static StackType_t trace_task_stack[TRACE_TASK_STACK_BYTES];
+static StaticTask_t trace_task_tcb;
+static TaskHandle_t trace_task_handle = NULL;
+static uint8_t block_buf[TRACE_BLOCK_MAX_BYTES];
+static char dest_host[16]; // IPv4 literal
+static uint16_t dest_port = 0;
+static volatile bool active = false; // Samples are being captured
+static volatile bool busy = false;   // Trace task owns the ring (includes the final flush)
+static volatile uint32_t end_ms = 0;
+
+// --- Block Encoder ---
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static size_t put_varint(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80U) {
+        p[n++] = (uint8_t)(v | 0x80U);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+// Small deltas of either sign become small unsigned values: 0,-1,1,-2 -> 0,1,2,3
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+void DiagTrace_BlockBegin(DiagTraceBlock_t *block, uint8_t *buf, size_t size,
+                          uint32_t seq, uint32_t first_sample, uint32_t dropped) {
+    memset(block, 0, sizeof(*block));
+    block->buf = buf;
+    block->size = size;
+    block->len = DIAG_TRACE_HEADER_BYTES;
+    put_u16(buf, DIAG_TRACE_MAGIC);
+    buf[2] = DIAG_TRACE_VERSION;
+    buf[3] = LOADCELL_NUM_CHANNELS;
+    put_u32(buf + 4, seq);
+    put_u32(buf + 8, first_sample);
+    put_u32(buf + 12, dropped);
+    put_u32(buf + 16, 0);
+}
+
+bool DiagTrace_BlockAdd(DiagTraceBlock_t *block, const DiagTraceSample_t *sample) {
+    if (block->len + DIAG_TRACE_SAMPLE_MAX_BYTES > block->size || block->count == UINT16_MAX) {
+        return false;
+    }
+    if (block->count == 0) {
+        put_u32(block->buf + 16, sample->t_ms);
+        block->prev_t_ms = sample->t_ms;
+    }
+    block->len += put_varint(block->buf + block->len, sample->t_ms - block->prev_t_ms);
+    block->prev_t_ms = sample->t_ms;
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        int32_t delta = (int32_t)((uint32_t)sample->raw[ch] - (uint32_t)block->prev_raw[ch]);
+        block->len += put_varint(block->buf + block->len, zigzag(delta));
+        block->prev_raw[ch] = sample->raw[ch];
+    }
+    block->count++;
+    return true;
+}
+
+size_t DiagTrace_BlockEnd(DiagTraceBlock_t *block) {
+    put_u16(block->buf + 20, block->count);
+    put_u16(block->buf + 22, (uint16_t)(block->len - DIAG_TRACE_HEADER_BYTES));
+    return block->len;
+}
+
+// --- Capture (sensor task) ---
+static void trace_sample_hook(const int32_t *raw, int channels) {
+    (void)channels; // Always LOADCELL_NUM_CHANNELS
+    uint32_t head = ring_head;
+    if (head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) >= TRACE_RING_SAMPLES) {
+        samples_dropped++;
+        return;
+    }
+    DiagTraceSample_t *slot = &ring[head & (TRACE_RING_SAMPLES - 1)];
+    slot->t_ms = (uint32_t)hal_System_GetTickMs();
+    memcpy(slot->raw, raw, sizeof(slot->raw));
+    __atomic_store_n(&ring_head, head + 1, __ATOMIC_RELEASE);
+}
+
+// --- Transmit (trace task) ---
+typedef struct {
+    uint32_t seq;
+    uint32_t bytes;
+    uint32_t send_errors;
+} TraceTxStats_t;
+
+// Encodes the oldest buffered samples into one block and sends it.
+// Returns the datagram length, 0 if the ring was empty.
+static size_t send_block(int sock, TraceTxStats_t *tx) {
+    uint32_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    uint32_t tail = ring_tail;
+    if (head == tail) {
+        return 0;
+    }
+
+    DiagTraceBlock_t block;
+    DiagTrace_BlockBegin(&block, block_buf, sizeof(block_buf), tx->seq, tail, samples_dropped);
+    while (tail != head && DiagTrace_BlockAdd(&block, &ring[tail & (TRACE_RING_SAMPLES - 1)])) {
+        tail++;
+    }
+    __atomic_store_n(&ring_tail, tail, __ATOMIC_RELEASE); // Slots are free once encoded
+    size_t len = DiagTrace_BlockEnd(&block);
+
+    // A failed send still consumes the sequence number: the receiver sees the gap
+    if (hal_Wifi_UdpSend(sock, block_buf, len) < 0) {
+        tx->send_errors++;
+    } else {
+        tx->bytes += len;
+    }
+    tx->seq++;
+    return len;
+}
+
+static bool trace_expired(void) {
+    return (int32_t)((uint32_t)hal_System_GetTickMs() - end_ms) >= 0;
+}
+
+static void trace_task(void *pvParameters) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // Released by DiagTrace_Start
+
+        int sock = hal_Wifi_UdpOpen(dest_host, dest_port);
+        TraceTxStats_t tx = {0};
+        if (sock >= 0) {
+            ESP_LOGI(TAG, "Streaming raw samples to %s:%u.", dest_host, (unsigned)dest_port);
+            // Token bucket in bytes: refilled each wake-up, at most one second of burst
+            uint32_t budget = TRACE_BLOCK_MAX_BYTES;
+            TickType_t last_wake = xTaskGetTickCount();
+            while (active && !trace_expired()) {
+                vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(TRACE_FLUSH_INTERVAL_MS));
+                budget += TRACE_MAX_BYTES_PER_S * TRACE_FLUSH_INTERVAL_MS / 1000;
+                if (budget > TRACE_MAX_BYTES_PER_S) {
+                    budget = TRACE_MAX_BYTES_PER_S;
+                }
+                // Only whole worst-case blocks are sent against the budget; the rest waits in the ring
+                while (budget >= TRACE_BLOCK_MAX_BYTES) {
+                    size_t len = send_block(sock, &tx);
+                    if (len == 0) break;
+                    budget -= len;
+                }
+            }
+        }
+
+        hal_LoadCell_SetSampleHook(NULL);
+        active = false;
+        if (sock >= 0) {
+            while (send_block(sock, &tx) > 0) {
+                // Final flush: at most TRACE_RING_SAMPLES samples
+            }
+            hal_Wifi_UdpClose(sock);
+        }
+        ESP_LOGI(TAG, "Trace finished: %lu blocks, %lu bytes, %lu samples dropped, %lu send errors.",
+                 (unsigned long)tx.seq, (unsigned long)tx.bytes,
+                 (unsigned long)samples_dropped, (unsigned long)tx.send_errors);
+        busy = false;
+    }
+}
+
+bool DiagTrace_Start(const char *host, uint16_t port, uint32_t seconds) {
+    if (seconds == 0 || seconds > TRACE_MAX_SECONDS || !host || strlen(host) >= sizeof(dest_host)) {
+        return false;
+    }
+    uint32_t new_end_ms = (uint32_t)hal_System_GetTickMs() + seconds * 1000U;
+    if (active) {
+        end_ms = new_end_ms; // Keep streaming to the current collector
+        ESP_LOGI(TAG, "Trace extended by %lu s.", (unsigned long)seconds);
+        return true;
+    }
+    if (busy) {
+        return false; // Previous trace is still flushing
+    }
+
+    strcpy(dest_host, host);
+    dest_port = port;
+    ring_head = 0;
+    ring_tail = 0;
+    samples_dropped = 0;
+    end_ms = new_end_ms;
+
+    if (!trace_task_handle) {
+        // Created on first use and then parked between traces, so the static TCB is never recycled
+        trace_task_handle = xTaskCreateStaticPinnedToCore(trace_task, "TraceTask", TRACE_TASK_STACK_BYTES, NULL,
+                                                          TRACE_TASK_PRIORITY, trace_task_stack, &trace_task_tcb,
+                                                          APP_CORE_NETWORK_UI);
+        if (!trace_task_handle) {
+            ESP_LOGE(TAG, "Failed to create trace task.");
+            return false;
+        }
+    }
+
+    busy = true;
+    active = true;
+    hal_LoadCell_SetSampleHook(trace_sample_hook);
+    xTaskNotifyGive(trace_task_handle);
+    ESP_LOGI(TAG, "Trace started for %lu s.", (unsigned long)seconds);
+    return true;
+}
+
+void DiagTrace_Stop(void) {
+    active = false; // Trace task flushes and closes on its next wake-up
+}
+
+bool DiagTrace_IsActive(void) {
+    return active;
+}
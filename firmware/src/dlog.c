@@ -0,0 +1,186 @@
+#include "dlog.h"
+#include "hal_interfaces.h"
+#include "app_tasks.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+static const char *TAG = "DLOG";
+
+#if (DLOG_RING_RECORDS & (DLOG_RING_RECORDS - 1)) != 0
+#error "DLOG_RING_RECORDS must be a power of two"
+#endif
+
+typedef struct {
+    uint8_t level;
+    const char *tag;
+    const char *format;
+} DLogFormat_t;
+
+static const DLogFormat_t formats[DLOG_FORMAT_COUNT] = {
+#define DLOG_TABLE_ENTRY(id, level, tag, format) [id] = { level, tag, format },
+    DLOG_FORMATS(DLOG_TABLE_ENTRY)
+#undef DLOG_TABLE_ENTRY
+};
+
+// --- Record Ring ---
+// Many producers, one consumer. A writer claims a slot by advancing
+// ring_head with compare-and-swap (never past a full ring), fills it and
+// publishes it by storing its sequence number last. The log task only
+// reads a slot once that number matches, so a writer preempted between
+// claim and commit just delays the reader; nobody ever blocks.
+static DLogRecord_t ring[DLOG_RING_RECORDS];
+static uint32_t ring_head = 0; // Next slot to claim (all writers)
+static uint32_t ring_tail = 0; // Next slot to read (log task)
+static uint32_t dropped = 0;
+
+static StackType_t log_task_stack[DLOG_TASK_STACK_BYTES];
+static StaticTask_t log_task_tcb;
+static TaskHandle_t log_task_handle = NULL;
+
+void DLog_Write(DLogId_t id, int nargs, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+    uint32_t head = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    do {
+        if (head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) >= DLOG_RING_RECORDS) {
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&ring_head, &head, head + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    DLogRecord_t *record = &ring[head & (DLOG_RING_RECORDS - 1)];
+    record->timestamp_ms = (uint32_t)hal_System_GetTickMs();
+    record->id = (uint16_t)id;
+    record->nargs = (uint8_t)nargs;
+    record->args[0] = a0;
+    record->args[1] = a1;
+    record->args[2] = a2;
+    record->args[3] = a3;
+    __atomic_store_n(&record->seq, head + 1, __ATOMIC_RELEASE); // Commit
+}
+
+bool DLog_Read(DLogRecord_t *record) {
+    uint32_t tail = ring_tail;
+    const DLogRecord_t *slot = &ring[tail & (DLOG_RING_RECORDS - 1)];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != tail + 1) {
+        return false; // Empty, or the next record is not committed yet
+    }
+    *record = *slot;
+    __atomic_store_n(&ring_tail, tail + 1, __ATOMIC_RELEASE); // Slot may be reused now
+    return true;
+}
+
+uint32_t DLog_GetDropped(void) {
+    return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+// printf-style formatting from recorded 32-bit arguments. Each conversion is
+// rebuilt without its length modifier and passed the matching C type.
+int DLog_Format(const DLogRecord_t *record, char *buf, size_t size) {
+    if (size == 0) return 0;
+    if (record->id >= DLOG_FORMAT_COUNT) {
+        return snprintf(buf, size, "<unknown dlog id %u>", (unsigned)record->id);
+    }
+
+    const char *p = formats[record->id].format;
+    size_t len = 0;
+    int arg = 0;
+    while (*p && len + 1 < size) {
+        if (*p != '%') {
+            buf[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            buf[len++] = '%';
+            p += 2;
+            continue;
+        }
+
+        char spec[16];
+        size_t n = 0;
+        spec[n++] = *p++;
+        while (*p && strchr("-+ #0123456789.", *p) && n < sizeof(spec) - 3) {
+            spec[n++] = *p++;
+        }
+        while (*p == 'l' || *p == 'h' || *p == 'z') {
+            p++;
+        }
+        char conversion = *p ? *p++ : 'd';
+        uint32_t value = (arg < record->nargs) ? record->args[arg] : 0;
+        arg++;
+
+        int written;
+        if (strchr("fFeEgG", conversion)) {
+            union { uint32_t u; float f; } bits = { .u = value };
+            spec[n++] = conversion;
+            spec[n] = '\0';
+            written = snprintf(buf + len, size - len, spec, (double)bits.f);
+        } else if (conversion == 'c') {
+            spec[n++] = 'c';
+            spec[n] = '\0';
+            written = snprintf(buf + len, size - len, spec, (int)value);
+        } else if (conversion == 'd' || conversion == 'i') {
+            spec[n++] = 'l';
+            spec[n++] = 'd';
+            spec[n] = '\0';
+            written = snprintf(buf + len, size - len, spec, (long)(int32_t)value);
+        } else {
+            spec[n++] = 'l';
+            spec[n++] = strchr("uxXo", conversion) ? conversion : 'u';
+            spec[n] = '\0';
+            written = snprintf(buf + len, size - len, spec, (unsigned long)value);
+        }
+        if (written < 0) break;
+        len += ((size_t)written < size - len) ? (size_t)written : size - len - 1;
+    }
+    buf[len] = '\0';
+    return (int)len;
+}
+
+static void log_task(void *pvParameters) {
+    DLogRecord_t record;
+    uint32_t reported_dropped = 0;
+#if !DLOG_OUTPUT_BINARY
+    char line[DLOG_LINE_MAX];
+#endif
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(DLOG_FLUSH_INTERVAL_MS));
+
+        while (DLog_Read(&record)) {
+#if DLOG_OUTPUT_BINARY
+            // One hex line per record: timestamp, id, argument count, arguments
+            printf("DLOG:%08lx%04x%02x", (unsigned long)record.timestamp_ms, record.id, record.nargs);
+            for (int i = 0; i < record.nargs && i < DLOG_MAX_ARGS; i++) {
+                printf("%08lx", (unsigned long)record.args[i]);
+            }
+            printf("\n");
+#else
+            if (record.id >= DLOG_FORMAT_COUNT) continue;
+            const DLogFormat_t *format = &formats[record.id];
+            DLog_Format(&record, line, sizeof(line));
+            esp_log_write((esp_log_level_t)format->level, format->tag, "%c (%lu) %s: %s\n",
+                          "?EWIDV"[format->level], (unsigned long)record.timestamp_ms, format->tag, line);
+#endif
+        }
+
+        uint32_t now_dropped = DLog_GetDropped();
+        if (now_dropped != reported_dropped) {
+            ESP_LOGW(TAG, "%lu deferred log record(s) dropped (ring full).",
+                     (unsigned long)(now_dropped - reported_dropped));
+            reported_dropped = now_dropped;
+        }
+    }
+}
+
+void DLog_Init(void) {
+    if (log_task_handle) return;
+    // Just above idle: formatting and UART output only use otherwise idle time on the network core
+    log_task_handle = xTaskCreateStaticPinnedToCore(log_task, "LogTask", DLOG_TASK_STACK_BYTES, NULL,
+                                                    DLOG_TASK_PRIORITY, log_task_stack, &log_task_tcb,
+                                                    APP_CORE_NETWORK_UI);
+    if (!log_task_handle) {
+        ESP_LOGE(TAG, "Failed to create log task, deferred records will be dropped.");
+    }
+}
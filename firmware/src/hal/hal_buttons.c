@@ -2,79 +2,174 @@
 #include "scale_config.h"
 #include "driver/gpio.h" // ESP-IDF GPIO driver
 #include "freertos/FreeRTOS.h" // For ticks
-#include "freertos/timers.h"   // For debounce if using timers
+#include "freertos/queue.h"    // Event queue consumed by the UI task
+#include "freertos/timers.h"   // Debounce lockout and hold detection
+#include "esp_timer.h"         // Event timestamps (ISR-safe)
 #include "esp_log.h"
 
 static const char *TAG = "HAL_BUTTONS";
 
-// Simple debounce state
+// Edge interrupts report a press or release immediately (leading-edge
+// debounce); the pin interrupt is then masked for BUTTON_DEBOUNCE_MS while
+// the contacts bounce. When the lockout timer expires the pin is re-read,
+// so a change that happened during the lockout is not lost.
+// PRESS and RELEASE are the raw edges. A release before BUTTON_HOLD_MS also
+// reports SHORT; a longer press reports HOLD when the hold timer fires and
+// no SHORT on release, so each press ends in exactly one of SHORT or HOLD.
 typedef struct {
     gpio_num_t pin;
-    uint32_t last_press_time;
-    bool last_state; // true = pressed (LOW for pull-up)
+    ButtonEvent_t press_event;
+    ButtonEvent_t hold_event;
+    ButtonEvent_t release_event;
+    ButtonEvent_t short_event;
+    volatile bool pressed;   // Debounced state
+    bool held;               // HOLD reported for the current press (under buttons_mux)
+    uint32_t press_ms;       // Time of the current press edge
+    TimerHandle_t debounce_timer;
+    TimerHandle_t hold_timer;
+    StaticTimer_t debounce_timer_buf;
+    StaticTimer_t hold_timer_buf;
 } ButtonInfo_t;
 
-static ButtonInfo_t tare_button = { .pin = BUTTON_TARE_PIN, .last_press_time = 0, .last_state = false };
-static ButtonInfo_t sample_button = { .pin = BUTTON_SAMPLE_PIN, .last_press_time = 0, .last_state = false };
-static ButtonInfo_t mode_button = { .pin = BUTTON_MODE_PIN, .last_press_time = 0, .last_state = false };
+static ButtonInfo_t buttons[] = {
+    { .pin = BUTTON_TARE_PIN,   .press_event = BUTTON_TARE_PRESS,   .hold_event = BUTTON_TARE_HOLD,
+      .release_event = BUTTON_TARE_RELEASE,   .short_event = BUTTON_TARE_SHORT },
+    { .pin = BUTTON_SAMPLE_PIN, .press_event = BUTTON_SAMPLE_PRESS, .hold_event = BUTTON_SAMPLE_HOLD,
+      .release_event = BUTTON_SAMPLE_RELEASE, .short_event = BUTTON_SAMPLE_SHORT },
+    { .pin = BUTTON_MODE_PIN,   .press_event = BUTTON_MODE_PRESS,   .hold_event = BUTTON_MODE_HOLD,
+      .release_event = BUTTON_MODE_RELEASE,   .short_event = BUTTON_MODE_SHORT },
+};
+#define NUM_BUTTONS (sizeof(buttons) / sizeof(buttons[0]))
 
-#define DEBOUNCE_DELAY_MS 50
+static QueueHandle_t event_queue = NULL;
+static StaticQueue_t event_queue_buf;
+static uint8_t event_queue_storage[BUTTON_EVENT_QUEUE_LEN * sizeof(ButtonEventRecord_t)];
+
+// A release (edge ISR) and the hold timer (timer task) can race on the other core
+static portMUX_TYPE buttons_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// Buttons assumed active LOW (pressed = 0) due to internal pull-up
+static inline bool is_pressed(const ButtonInfo_t *button) {
+    return gpio_get_level(button->pin) == 0;
+}
+
+// Records the new debounced state and fills in the events it produces
+// (the edge, plus SHORT for a release that no HOLD claimed). Returns the count.
+static int IRAM_ATTR take_edge(ButtonInfo_t *button, bool pressed, ButtonEventRecord_t records[2]) {
+    uint32_t now = now_ms();
+    int count = 0;
+    portENTER_CRITICAL_SAFE(&buttons_mux);
+    button->pressed = pressed;
+    if (pressed) {
+        button->held = false;
+        button->press_ms = now;
+        records[count++] = (ButtonEventRecord_t){ .event = button->press_event, .timestamp_ms = now };
+    } else {
+        records[count++] = (ButtonEventRecord_t){ .event = button->release_event, .timestamp_ms = now };
+        if (!button->held) {
+            records[count++] = (ButtonEventRecord_t){ .event = button->short_event, .timestamp_ms = button->press_ms };
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&buttons_mux);
+    return count;
+}
+
+static void IRAM_ATTR button_isr(void *arg) {
+    ButtonInfo_t *button = (ButtonInfo_t *)arg;
+    BaseType_t woken = pdFALSE;
+
+    gpio_intr_disable(button->pin); // Ignore bounce until the lockout timer re-arms us
+    bool pressed = is_pressed(button);
+    if (pressed != button->pressed) {
+        ButtonEventRecord_t records[2];
+        int count = take_edge(button, pressed, records);
+        for (int i = 0; i < count; i++) {
+            xQueueSendFromISR(event_queue, &records[i], &woken); // Dropped if the UI is far behind
+        }
+        if (pressed) {
+            xTimerResetFromISR(button->hold_timer, &woken);
+        } else {
+            xTimerStopFromISR(button->hold_timer, &woken);
+        }
+    }
+    xTimerResetFromISR(button->debounce_timer, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// Timer service task context
+static void debounce_timer_cb(TimerHandle_t timer) {
+    ButtonInfo_t *button = (ButtonInfo_t *)pvTimerGetTimerID(timer);
+    bool pressed = is_pressed(button);
+    if (pressed != button->pressed) {
+        // Settled into a different state during the lockout: report it and lock out again
+        ButtonEventRecord_t records[2];
+        int count = take_edge(button, pressed, records);
+        for (int i = 0; i < count; i++) {
+            xQueueSend(event_queue, &records[i], 0);
+        }
+        if (pressed) {
+            xTimerReset(button->hold_timer, 0);
+        } else {
+            xTimerStop(button->hold_timer, 0);
+        }
+        xTimerReset(button->debounce_timer, 0);
+        return;
+    }
+    gpio_intr_enable(button->pin);
+}
+
+static void hold_timer_cb(TimerHandle_t timer) {
+    ButtonInfo_t *button = (ButtonInfo_t *)pvTimerGetTimerID(timer);
+    portENTER_CRITICAL(&buttons_mux);
+    bool hold = button->pressed && !button->held; // Released meanwhile: that release reported SHORT
+    button->held = button->held || hold;
+    portEXIT_CRITICAL(&buttons_mux);
+    if (hold) {
+        ButtonEventRecord_t record = { .event = button->hold_event, .timestamp_ms = now_ms() };
+        xQueueSend(event_queue, &record, 0);
+    }
+}
 
 void hal_Buttons_Init(void) {
     ESP_LOGI(TAG, "Initializing Button GPIOs...");
-    // TODO: Configure GPIO pins for buttons as inputs with pull-ups
-    // Example ESP-IDF:
+    event_queue = xQueueCreateStatic(BUTTON_EVENT_QUEUE_LEN, sizeof(ButtonEventRecord_t),
+                                     event_queue_storage, &event_queue_buf);
+
     gpio_config_t io_conf = {};
     io_conf.pin_bit_mask = (1ULL << BUTTON_TARE_PIN) | (1ULL << BUTTON_SAMPLE_PIN) | (1ULL << BUTTON_MODE_PIN);
     io_conf.mode = GPIO_MODE_INPUT;
     io_conf.pull_up_en = GPIO_PULLUP_ENABLE; // Assuming buttons connect pin to GND when pressed
     io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
-    io_conf.intr_type = GPIO_INTR_DISABLE; // Using polling here
+    io_conf.intr_type = GPIO_INTR_ANYEDGE; // Press and release
     gpio_config(&io_conf);
+
+    gpio_install_isr_service(0);
+    for (size_t i = 0; i < NUM_BUTTONS; i++) {
+        ButtonInfo_t *button = &buttons[i];
+        button->pressed = is_pressed(button);
+        button->debounce_timer = xTimerCreateStatic("btn_debounce", pdMS_TO_TICKS(BUTTON_DEBOUNCE_MS), pdFALSE,
+                                                    button, debounce_timer_cb, &button->debounce_timer_buf);
+        button->hold_timer = xTimerCreateStatic("btn_hold", pdMS_TO_TICKS(BUTTON_HOLD_MS), pdFALSE,
+                                                button, hold_timer_cb, &button->hold_timer_buf);
+        gpio_isr_handler_add(button->pin, button_isr, button);
+    }
     ESP_LOGI(TAG, "Button GPIOs Initialized.");
 }
 
-// Simple polling debounce check
-static bool check_button(ButtonInfo_t *button) {
-    bool pressed_event = false;
-    // Buttons assumed active LOW (pressed = 0) due to internal pull-up
-    bool current_physical_state = (gpio_get_level(button->pin) == 0);
-    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-
-    if (current_physical_state != button->last_state) {
-        // State changed, potential press/release
-        if (now - button->last_press_time > DEBOUNCE_DELAY_MS) {
-            if (current_physical_state) { // Went from released to pressed
-                pressed_event = true; // Register the press event
-                ESP_LOGD(TAG, "Button %d Pressed Event", button->pin);
-            } else {
-                 // Went from pressed to released - do nothing on release for this simple logic
-                 ESP_LOGD(TAG, "Button %d Released", button->pin);
-            }
-            button->last_state = current_physical_state;
-            button->last_press_time = now; // Update time only after debounce period confirms change
-        }
-        // Else: state changed within debounce period, ignore as noise
+bool hal_Buttons_WaitEvent(ButtonEventRecord_t *record, uint32_t timeout_ms) {
+    if (!event_queue) {
+        return false;
     }
-    // else: state hasn't changed, do nothing
-
-    return pressed_event; // Return true only on a debounced press event
+    return xQueueReceive(event_queue, record, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
 }
 
-
 ButtonEvent_t hal_Buttons_Read(void) {
-    if (check_button(&tare_button)) {
-        return BUTTON_TARE_PRESS;
-    }
-    if (check_button(&sample_button)) {
-        return BUTTON_SAMPLE_PRESS;
-    }
-    if (check_button(&mode_button)) {
-        return BUTTON_MODE_PRESS;
-    }
-
-    // TODO: Add logic for HOLD events if needed
-    // (Check if button->last_state is still true and now - button->last_press_time > HOLD_DURATION_MS)
-
-    return BUTTON_NONE;
+    ButtonEventRecord_t record;
+    return hal_Buttons_WaitEvent(&record, 0) ? record.event : BUTTON_NONE;
 }
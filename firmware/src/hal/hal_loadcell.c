@@ -1,48 +1,266 @@
 #include "hal_interfaces.h"
 #include "scale_config.h"
 #include "driver/gpio.h" // Example ESP-IDF peripheral header
+#include "freertos/FreeRTOS.h" // portMUX critical section around the shift-out
+#include "freertos/task.h"
+#include "soc/gpio_reg.h" // GPIO_IN_REG: one read samples every DOUT line
+#include "esp_rom_sys.h"  // esp_rom_delay_us
 #include "esp_log.h"
-// #include "HX711.h" // Example: If using an HX711 library
+#include "dlog.h" // Deferred logging for per-sample messages
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
 static const char *TAG = "HAL_LOADCELL";
 
+#define HX711_DATA_BITS 24
+#define HX711_GAIN_PULSES 1 // 25th pulse selects channel A, gain 128 for the next conversion
+
 // --- Variables specific to the HAL ---
-// HX711 scale; // Example library object
+static const gpio_num_t dout_pins[LOADCELL_NUM_CHANNELS] = LOADCELL_DOUT_PINS;
+static uint32_t dout_mask = 0; // All DOUT pins in GPIO_IN_REG
+static portMUX_TYPE hx711_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Per-channel state as parallel arrays so combining is one multiply-accumulate
+// pass over contiguous memory, independent of how the channels were read.
+static int32_t channel_raw[LOADCELL_NUM_CHANNELS];      // Last conversion per channel
+static float channel_offset[LOADCELL_NUM_CHANNELS];     // Zero per channel (fractional: auto-zero moves it slowly)
+static float channel_correction[LOADCELL_NUM_CHANNELS]; // Corner correction (relative gain)
+static float channel_coef[LOADCELL_NUM_CHANNELS];       // correction / calibration factor (grams per count)
+
 static float current_calibration_factor = 1.0f; // Default, should be set
-static long current_offset = 0L; // Tare offset
+static const LoadCellLinearization_t *volatile linearization = NULL; // Owned by the calibration module
+static float last_linear_weight = 0.0f;
+static float tare_g = 0.0f;   // Linearized gross weight of the container tared off (0: none)
+static bool have_zero = false; // Set by the first tare or restored offsets
+static uint64_t last_conversion_ms = 0;
+static volatile float azt_band_limit_g = 0.0f; // Caller's cap on the auto-zero band (0: none)
 static bool is_initialized = false;
 
+// Acquisition history for tare: the last LOADCELL_TARE_SAMPLES fresh conversions
+static int32_t tare_history[LOADCELL_TARE_SAMPLES][LOADCELL_NUM_CHANNELS];
+static int tare_history_idx = 0;
+static int tare_history_count = 0;
+static volatile bool tare_pending = false; // Set by any task, applied by the sensor task in Read
+static volatile uint32_t tare_count = 0;   // Tares applied since boot (config snapshot trigger)
+static volatile hal_LoadCell_SampleHook_t sample_hook = NULL; // Diagnostic tap on fresh conversions
+
 // For stability tracking within HAL
 static float weight_buffer[STABLE_READING_COUNT];
 static int buffer_idx = 0;
 static int readings_count = 0;
+static LoadCellReading_t last_reading; // Repeated until the next conversion
+
+#if LOADCELL_SIMULATED
+static float dummy_weight = 50.0f; // Simulated load on the platform
+#endif
+
+// Recompute the per-channel coefficients; called whenever a factor changes
+// so the per-sample path does no divisions.
+static void update_coefficients(void) {
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        channel_coef[ch] = channel_correction[ch] / current_calibration_factor;
+    }
+}
+
+// Corrected sum of all channels in grams: the gross weight above the zero.
+static float combine_channels(const int32_t *raw) {
+    float sum = 0.0f;
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        sum += ((float)raw[ch] - channel_offset[ch]) * channel_coef[ch];
+    }
+    return sum;
+}
+
+// Piecewise-linear correction: one table lookup and two multiplies per sample.
+static float linearize(float linear_g) {
+    const LoadCellLinearization_t *table = linearization; // Single read: the table may be swapped
+    if (!table) {
+        return linear_g;
+    }
+    float x = linear_g * table->inv_step_g;
+    int i = (int)x;
+    if (i < 0) {
+        i = 0; // Below zero: extrapolate the first segment
+    } else if (i >= table->segments) {
+        i = table->segments - 1; // Above the table: extrapolate the last segment
+    }
+    return table->base[i] + (x - (float)i) * table->delta[i];
+}
+
+// Reads one conversion from every channel. All HX711s share SCK, so each clock
+// pulse shifts one bit out of every chip and a single input register read
+// captures them all: latency is 25 pulses regardless of the channel count.
+// With wait = false, returns false immediately if a conversion is not ready.
+static bool read_all_channels(int32_t *raw, bool wait) {
+#if LOADCELL_SIMULATED
+    (void)wait;
+    // --- Placeholder Data (REMOVE THIS IN REAL IMPLEMENTATION) ---
+    dummy_weight += (float)(rand() % 11 - 5) / 10.0f; // Simulate small fluctuations
+    if (dummy_weight < 0) dummy_weight = 0;
+    if (dummy_weight > MAX_WEIGHT_CAPACITY_G * 1.1f) dummy_weight = MAX_WEIGHT_CAPACITY_G * 1.1f; // Simulate overload slightly above threshold
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        // Load shared evenly; each cell's own sensitivity is what the correction undoes
+        raw[ch] = LOADCELL_OFFSET + (int32_t)(dummy_weight * current_calibration_factor /
+                                              (LOADCELL_NUM_CHANNELS * channel_correction[ch]));
+    }
+    return true;
+    // --- End Placeholder Data ---
+#else
+    // A conversion is ready once every DOUT has gone low
+    uint64_t start_ms = hal_System_GetTickMs();
+    while (REG_READ(GPIO_IN_REG) & dout_mask) {
+        if (!wait || hal_System_GetTickMs() - start_ms > LOADCELL_READY_TIMEOUT_MS) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+
+    uint32_t samples[HX711_DATA_BITS]; // One register snapshot per bit, demuxed below
+    // SCK high for more than 60 us powers the HX711 down, so no preemption here
+    portENTER_CRITICAL(&hx711_mux);
+    for (int bit = 0; bit < HX711_DATA_BITS; bit++) {
+        gpio_set_level(LOADCELL_SCK_PIN, 1);
+        esp_rom_delay_us(1);
+        gpio_set_level(LOADCELL_SCK_PIN, 0);
+        esp_rom_delay_us(1);
+        samples[bit] = REG_READ(GPIO_IN_REG);
+    }
+    for (int i = 0; i < HX711_GAIN_PULSES; i++) {
+        gpio_set_level(LOADCELL_SCK_PIN, 1);
+        esp_rom_delay_us(1);
+        gpio_set_level(LOADCELL_SCK_PIN, 0);
+        esp_rom_delay_us(1);
+    }
+    portEXIT_CRITICAL(&hx711_mux);
+
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        uint32_t value = 0;
+        for (int bit = 0; bit < HX711_DATA_BITS; bit++) {
+            value = (value << 1) | ((samples[bit] >> dout_pins[ch]) & 1U); // MSB first
+        }
+        if (value & 0x800000U) {
+            value |= 0xFF000000U; // Sign-extend 24-bit two's complement
+        }
+        raw[ch] = (int32_t)value;
+    }
+    return true;
+#endif
+}
+
+static void record_history(const int32_t *raw) {
+    memcpy(tare_history[tare_history_idx], raw, sizeof(tare_history[0]));
+    tare_history_idx = (tare_history_idx + 1) % LOADCELL_TARE_SAMPLES;
+    if (tare_history_count < LOADCELL_TARE_SAMPLES) {
+        tare_history_count++;
+    }
+}
+
+// Tare on the average of the buffered conversions. Within the zero range
+// (or with no zero yet) this re-zeroes; a heavier load is a container, whose
+// linearized weight is subtracted while the zero stays put, so the table is
+// always indexed by the gross weight it was calibrated against. The
+// stability window is shifted by the same amount instead of being cleared,
+// so a tare of a settled load reports stable zero on the very next sample.
+static void apply_tare(void) {
+    if (tare_history_count == 0) {
+        ESP_LOGE(TAG, "Tare failed: no conversions from the load cell(s).");
+        return;
+    }
+    int32_t average[LOADCELL_NUM_CHANNELS];
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        int64_t sum = 0;
+        for (int i = 0; i < tare_history_count; i++) {
+            sum += tare_history[i][ch];
+        }
+        average[ch] = (int32_t)(sum / tare_history_count);
+    }
+
+    float gross_g = combine_channels(average);
+    float removed_g = linearize(gross_g) - tare_g;
+    if (!have_zero || fabsf(gross_g) <= LOADCELL_ZERO_RANGE_G) {
+        for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+            channel_offset[ch] = (float)average[ch];
+        }
+        tare_g = 0.0f;
+        have_zero = true;
+    } else {
+        tare_g = linearize(gross_g);
+    }
+    for (int i = 0; i < STABLE_READING_COUNT; i++) {
+        weight_buffer[i] -= removed_g;
+    }
+    tare_count++;
+    ESP_LOGI(TAG, "Tare complete (%d samples). Offset: %ld, container %.2f g", tare_history_count,
+             hal_LoadCell_GetOffset(), tare_g);
+}
+
+// Auto-zero tracking: while a stable reading still shows zero (within a
+// fraction of a division, and of the caller's limit), move the zero toward
+// it at no more than LOADCELL_AZT_RATE_D_PER_S. Slow drift is absorbed; a
+// light piece is outside the band, and even a very slow load outruns the
+// rate limit before it reaches the display.
+static void track_zero(float weight_g, uint32_t elapsed_ms) {
+    float band_g = LOADCELL_AZT_BAND_D * SCALE_DIVISION_G;
+    float limit_g = azt_band_limit_g;
+    if (limit_g > 0.0f && limit_g < band_g) {
+        band_g = limit_g;
+    }
+    if (LOADCELL_AZT_RATE_D_PER_S <= 0.0f || fabsf(weight_g) > band_g) {
+        return;
+    }
+    float max_step_g = LOADCELL_AZT_RATE_D_PER_S * SCALE_DIVISION_G * (float)elapsed_ms / 1000.0f;
+    float step_g = fminf(fmaxf(weight_g, -max_step_g), max_step_g) / LOADCELL_NUM_CHANNELS; // Shared by the channels
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        channel_offset[ch] += step_g / channel_coef[ch];
+    }
+}
 
 void hal_LoadCell_Init(float calibration_factor) {
-    ESP_LOGI(TAG, "Initializing Load Cell Driver...");
-    // TODO: Initialize GPIO pins for DOUT and SCK
-    // Example GPIO setup (ESP-IDF):
-    // gpio_config_t io_conf = {};
-    // io_conf.pin_bit_mask = (1ULL << LOADCELL_DOUT_PIN) | (1ULL << LOADCELL_SCK_PIN);
-    // io_conf.mode = GPIO_MODE_INPUT; // Adjust modes based on HX711 or sensor needs
-    // io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
-    // io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
-    // gpio_config(&io_conf);
-
-    // TODO: Initialize the sensor library (e.g., HX711)
-    // scale.begin(LOADCELL_DOUT_PIN, LOADCELL_SCK_PIN);
-    // scale.set_scale(calibration_factor);
-    // scale.tare(); // Initial tare
-    // current_offset = scale.get_offset();
+    ESP_LOGI(TAG, "Initializing Load Cell Driver (%d channel(s))...", LOADCELL_NUM_CHANNELS);
+
+    gpio_config_t io_conf = {};
+    io_conf.pin_bit_mask = 1ULL << LOADCELL_SCK_PIN;
+    io_conf.mode = GPIO_MODE_OUTPUT;
+    io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
+    io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+    io_conf.intr_type = GPIO_INTR_DISABLE;
+    gpio_config(&io_conf);
+    gpio_set_level(LOADCELL_SCK_PIN, 0); // Low keeps the HX711s powered up
+
+    dout_mask = 0;
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        if (dout_pins[ch] >= 32) {
+            ESP_LOGE(TAG, "DOUT pin %d of channel %d is not in GPIO_IN_REG (must be < 32)", dout_pins[ch], ch);
+            return;
+        }
+        dout_mask |= 1U << dout_pins[ch];
+        channel_raw[ch] = LOADCELL_OFFSET;
+        channel_offset[ch] = (float)LOADCELL_OFFSET; // Restored from the config snapshot, or tared
+        channel_correction[ch] = 1.0f;
+    }
+    io_conf.pin_bit_mask = dout_mask;
+    io_conf.mode = GPIO_MODE_INPUT;
+    gpio_config(&io_conf);
+
     current_calibration_factor = calibration_factor;
-    current_offset = LOADCELL_OFFSET; // Or get from initial tare
+    update_coefficients();
 
     memset(weight_buffer, 0, sizeof(weight_buffer));
     buffer_idx = 0;
     readings_count = 0;
+    tare_history_idx = 0;
+    tare_history_count = 0;
+    tare_g = 0.0f;
+    have_zero = false;
+    last_conversion_ms = 0;
+    memset(&last_reading, 0, sizeof(last_reading)); // Nothing measured yet: zero, not stable
 
+    // No initial tare here: boot must not wait on conversions. The caller
+    // restores saved offsets (hal_LoadCell_SetChannelOffsets) or requests a
+    // tare, which is applied once the sensor task has a conversion.
     is_initialized = true;
-    ESP_LOGI(TAG, "Load Cell Initialized. Cal Factor: %.2f, Offset: %ld", current_calibration_factor, current_offset);
-    hal_LoadCell_Tare(); // Perform initial tare
+    ESP_LOGI(TAG, "Load Cell Initialized. Cal Factor: %.2f", current_calibration_factor);
 }
 
 LoadCellReading_t hal_LoadCell_Read(float max_weight, float stable_threshold, int stable_count_needed) {
@@ -50,30 +268,43 @@ LoadCellReading_t hal_LoadCell_Read(float max_weight, float stable_threshold, in
     if (!is_initialized) {
         ESP_LOGE(TAG, "HAL LoadCell not initialized!");
         result.is_overload = true; // Indicate error
+        result.is_fresh = true;    // ...and have the logic show it
         return result;
     }
 
-    // TODO: Implement actual reading from sensor/library
-    // Placeholder implementation:
-    // if (scale.is_ready()) {
-    //    result.raw_value = scale.read(); // Read raw value
-    //    result.weight_grams = scale.get_units(1); // Read average of 1 reading with current scale factor
-    // } else {
-    //    ESP_LOGW(TAG,"Scale not ready");
-    //    result.weight_grams = 0; // Or last known good value?
-    //    result.raw_value = 0;
-    // }
-
-    // --- Placeholder Data (REMOVE THIS IN REAL IMPLEMENTATION) ---
-    static float dummy_weight = 50.0f;
-    static int stable_sim_count = 0;
-    dummy_weight += (float)(rand() % 11 - 5) / 10.0f; // Simulate small fluctuations
-    if (dummy_weight < 0) dummy_weight = 0;
-    if (dummy_weight > max_weight * 1.1f) dummy_weight = max_weight * 1.1f; // Simulate overload slightly above threshold
-    result.weight_grams = dummy_weight;
-    result.raw_value = (long)((result.weight_grams * current_calibration_factor) + current_offset);
-    // --- End Placeholder Data ---
+    // Non-blocking: the sensor task runs faster than the HX711 converts, so
+    // most periods have no new conversion. Those repeat the last reading,
+    // marked stale, and leave the stability window and auto-zero alone:
+    // every conversion is counted exactly once.
+    if (!read_all_channels(channel_raw, false)) {
+        result = last_reading;
+        result.is_fresh = false;
+        return result;
+    }
+    result.is_fresh = true;
+    uint64_t now_ms = hal_System_GetTickMs();
+    uint32_t elapsed_ms = last_conversion_ms ? (uint32_t)(now_ms - last_conversion_ms) : 0;
+    if (elapsed_ms > LOADCELL_READY_TIMEOUT_MS) {
+        elapsed_ms = LOADCELL_READY_TIMEOUT_MS; // After a gap, no more than one late conversion's worth
+    }
+    last_conversion_ms = now_ms;
+    record_history(channel_raw);
+    hal_LoadCell_SampleHook_t hook = sample_hook;
+    if (hook) {
+        hook(channel_raw, LOADCELL_NUM_CHANNELS);
+    }
+    if (tare_pending) {
+        tare_pending = false;
+        apply_tare();
+    }
 
+    last_linear_weight = combine_channels(channel_raw);
+    result.weight_grams = linearize(last_linear_weight) - tare_g;
+    long raw_sum = 0;
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        raw_sum += channel_raw[ch];
+    }
+    result.raw_value = raw_sum;
 
     // --- Overload Check ---
     // Usually check based on weight, but raw might be better if scale factor changes
@@ -81,7 +312,8 @@ LoadCellReading_t hal_LoadCell_Read(float max_weight, float stable_threshold, in
          result.is_overload = true;
          result.is_stable = false; // Not stable if overloaded
          readings_count = 0; // Reset stability count
-         ESP_LOGW(TAG, "Overload detected: %.2f g", result.weight_grams);
+         DLOG(DLOG_LC_OVERLOAD, result.weight_grams); // Every sample while overloaded: deferred
+         last_reading = result;
          return result; // Return early if overloaded
     } else {
          result.is_overload = false;
@@ -109,31 +341,27 @@ LoadCellReading_t hal_LoadCell_Read(float max_weight, float stable_threshold, in
         }
     }
 
+    if (result.is_stable) {
+        track_zero(result.weight_grams, elapsed_ms);
+    }
+
      // ESP_LOGD(TAG, "Read: %.2fg, Stable: %d", result.weight_grams, result.is_stable);
+    last_reading = result;
     return result;
 }
 
 void hal_LoadCell_Tare(void) {
      if (!is_initialized) return;
-     ESP_LOGI(TAG, "Performing Tare...");
-     // TODO: Implement Tare using sensor library
-     // scale.tare(10); // Example: average 10 readings for tare
-     // current_offset = scale.get_offset();
-
-     // --- Placeholder ---
-     current_offset += (long)(dummy_weight * current_calibration_factor); // Simulate offset change
-     dummy_weight = 0.0f; // Reset dummy weight after tare
-     // --- End Placeholder ---
-
-     readings_count = 0; // Reset stability buffer after tare
-     ESP_LOGI(TAG, "Tare complete. New Offset: %ld", current_offset);
+     // Applied by the sensor task on its next read from conversions it has
+     // already buffered, so the caller never waits on the ADC.
+     tare_pending = true;
+     ESP_LOGI(TAG, "Tare requested.");
 }
 
 void hal_LoadCell_SetCalibrationFactor(float factor) {
      if (!is_initialized || factor == 0) return;
      current_calibration_factor = factor;
-     // TODO: Update scale factor in sensor library
-     // scale.set_scale(factor);
+     update_coefficients();
      ESP_LOGI(TAG, "Calibration factor set to: %.2f", factor);
 }
 
@@ -142,7 +370,77 @@ float hal_LoadCell_GetCalibrationFactor(void){
 }
 
 long hal_LoadCell_GetOffset(void){
-     // TODO: Get offset from library if possible
-     // return scale.get_offset();
-     return current_offset; // Return HAL's tracked offset
+     long offset = 0;
+     for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+         offset += (long)channel_offset[ch];
+     }
+     return offset; // Return HAL's tracked offset
+}
+
+void hal_LoadCell_SetZeroTrackingLimit(float band_g) {
+     azt_band_limit_g = band_g;
+}
+
+void hal_LoadCell_SetLinearization(const LoadCellLinearization_t *table) {
+     linearization = table;
+     ESP_LOGI(TAG, "Linearization %s.", table ? "enabled" : "disabled");
+}
+
+float hal_LoadCell_GetLinearWeight(void) {
+     return last_linear_weight;
+}
+
+void hal_LoadCell_SetSampleHook(hal_LoadCell_SampleHook_t hook) {
+     sample_hook = hook;
+}
+
+void hal_LoadCell_GetChannelOffsets(float *offsets, int max_channels) {
+     for (int ch = 0; ch < max_channels && ch < LOADCELL_NUM_CHANNELS; ch++) {
+         offsets[ch] = channel_offset[ch];
+     }
+}
+
+void hal_LoadCell_SetChannelOffsets(const float *offsets, int count) {
+     for (int ch = 0; ch < count && ch < LOADCELL_NUM_CHANNELS; ch++) {
+         channel_offset[ch] = offsets[ch];
+     }
+     have_zero = true;
+     ESP_LOGI(TAG, "Offsets restored. Offset: %ld", hal_LoadCell_GetOffset());
+}
+
+float hal_LoadCell_GetTareWeight(void) {
+     return tare_g;
+}
+
+void hal_LoadCell_SetTareWeight(float weight_g) {
+     tare_g = weight_g;
+}
+
+uint32_t hal_LoadCell_GetTareCount(void) {
+     return tare_count;
+}
+
+int hal_LoadCell_GetChannelCount(void) {
+     return LOADCELL_NUM_CHANNELS;
+}
+
+bool hal_LoadCell_SetChannelCorrection(int channel, float correction) {
+     if (channel < 0 || channel >= LOADCELL_NUM_CHANNELS || correction <= 0.0f) return false;
+     channel_correction[channel] = correction;
+     update_coefficients();
+     ESP_LOGI(TAG, "Channel %d correction set to: %.4f", channel, correction);
+     return true;
+}
+
+float hal_LoadCell_GetChannelCorrection(int channel) {
+     if (channel < 0 || channel >= LOADCELL_NUM_CHANNELS) return 0.0f;
+     return channel_correction[channel];
+}
+
+int hal_LoadCell_GetChannelRaw(long *raw, int max_channels) {
+     int count = max_channels < LOADCELL_NUM_CHANNELS ? max_channels : LOADCELL_NUM_CHANNELS;
+     for (int ch = 0; ch < count; ch++) {
+         raw[ch] = channel_raw[ch];
+     }
+     return count;
 }
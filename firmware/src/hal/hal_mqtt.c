@@ -0,0 +1,101 @@
+#include "hal_interfaces.h"
+#include "scale_config.h"
+#include <string.h>
+// --- ESP-IDF Includes ---
+#include "esp_log.h"
+#include "mqtt_client.h" // esp-mqtt component
+
+static const char *TAG = "HAL_MQTT";
+
+// --- Persistent Session ---
+// One client for the lifetime of the firmware. clean_session is off and the
+// client id is fixed, so the broker keeps the command subscription (and any
+// QoS 1 commands published while the scale was offline) across reconnects.
+// Outgoing QoS 1 messages stay in the esp-mqtt outbox until the broker's
+// PUBACK and are retransmitted after a reconnect; publishing only enqueues,
+// so the caller never waits on the network.
+static esp_mqtt_client_handle_t client = NULL;
+static volatile bool connected = false;
+static char subscribe_topic[64];
+static hal_Mqtt_MessageHandler_t message_handler = NULL;
+
+static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+
+    switch ((esp_mqtt_event_id_t)event_id) {
+        case MQTT_EVENT_CONNECTED:
+            connected = true;
+            ESP_LOGI(TAG, "Connected to broker (%s session).", event->session_present ? "resumed" : "new");
+            if (!event->session_present && subscribe_topic[0]) {
+                // Broker has no stored subscription for us (first connect or session expired)
+                esp_mqtt_client_subscribe(client, subscribe_topic, 1);
+            }
+            break;
+
+        case MQTT_EVENT_DISCONNECTED:
+            connected = false;
+            ESP_LOGW(TAG, "Disconnected from broker, reconnecting.");
+            break;
+
+        case MQTT_EVENT_DATA:
+            // Messages larger than the client buffer arrive in fragments; commands never should
+            if (event->current_data_offset != 0 || event->data_len != event->total_data_len) {
+                ESP_LOGW(TAG, "Fragmented message (%d bytes) dropped.", event->total_data_len);
+            } else if (message_handler) {
+                message_handler(event->topic, event->topic_len, event->data, event->data_len);
+            }
+            break;
+
+        case MQTT_EVENT_ERROR:
+            ESP_LOGW(TAG, "MQTT error (type %d).", event->error_handle ? (int)event->error_handle->error_type : -1);
+            break;
+
+        default:
+            break;
+    }
+}
+
+bool hal_Mqtt_Start(const char* broker_uri, const char* client_id, const char* topic, hal_Mqtt_MessageHandler_t handler) {
+    if (client) {
+        return true; // Already running; the client reconnects by itself
+    }
+
+    strncpy(subscribe_topic, topic ? topic : "", sizeof(subscribe_topic) - 1);
+    message_handler = handler;
+
+    const esp_mqtt_client_config_t mqtt_cfg = {
+        .broker.address.uri = broker_uri,
+        .credentials.client_id = client_id,
+        .session.disable_clean_session = true, // Persistent session
+        .session.keepalive = MQTT_KEEPALIVE_S,
+        .outbox.limit = MQTT_OUTBOX_LIMIT_BYTES,
+    };
+    client = esp_mqtt_client_init(&mqtt_cfg);
+    if (!client) {
+        ESP_LOGE(TAG, "Failed to create MQTT client.");
+        return false;
+    }
+    esp_mqtt_client_register_event(client, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+
+    esp_err_t err = esp_mqtt_client_start(client);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start MQTT client: %s", esp_err_to_name(err));
+        esp_mqtt_client_destroy(client);
+        client = NULL;
+        return false;
+    }
+    ESP_LOGI(TAG, "MQTT client started (%s as %s).", broker_uri, client_id);
+    return true;
+}
+
+bool hal_Mqtt_IsConnected(void) {
+    return connected;
+}
+
+int hal_Mqtt_Publish(const char* topic, const char* payload, size_t length, int qos) {
+    if (!client) {
+        return -1;
+    }
+    // store=true: QoS 0 messages are queued too instead of failing while disconnected
+    return esp_mqtt_client_enqueue(client, topic, payload, (int)length, qos, 0, true);
+}
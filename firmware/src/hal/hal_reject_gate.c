@@ -0,0 +1,43 @@
+#include "hal_interfaces.h"
+#include "scale_config.h"
+// --- ESP-IDF Includes ---
+#include "driver/gpio.h"
+#include "esp_err.h"   // ESP_ERROR_CHECK
+#include "esp_timer.h" // Pulse end
+#include "esp_log.h"
+
+static const char *TAG = "HAL_REJECT";
+
+// The gate is raised by the sensor task the moment a pack is rejected and
+// dropped by a one-shot esp_timer, so the acquisition loop never waits for
+// the actuation time.
+static esp_timer_handle_t release_timer = NULL;
+
+static void release_timer_cb(void *arg) {
+    gpio_set_level(REJECT_GATE_PIN, !REJECT_GATE_ACTIVE_LEVEL);
+}
+
+void hal_RejectGate_Init(void) {
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << REJECT_GATE_PIN,
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    gpio_set_level(REJECT_GATE_PIN, !REJECT_GATE_ACTIVE_LEVEL); // Inactive before it becomes an output
+    ESP_ERROR_CHECK(gpio_config(&io_conf));
+
+    const esp_timer_create_args_t release_timer_args = { .callback = release_timer_cb, .name = "reject_gate" };
+    ESP_ERROR_CHECK(esp_timer_create(&release_timer_args, &release_timer));
+    ESP_LOGI(TAG, "Reject gate on GPIO %d.", (int)REJECT_GATE_PIN);
+}
+
+void hal_RejectGate_Pulse(uint32_t duration_ms) {
+    if (!release_timer) {
+        return;
+    }
+    esp_timer_stop(release_timer); // Not running is fine
+    gpio_set_level(REJECT_GATE_PIN, REJECT_GATE_ACTIVE_LEVEL);
+    esp_timer_start_once(release_timer, (uint64_t)duration_ms * 1000ULL);
+}
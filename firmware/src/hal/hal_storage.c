@@ -2,6 +2,7 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
+#include "esp_timer.h" // For hal_System_GetTimeUs
 
 static const char *TAG = "HAL_STORAGE";
 static bool nvs_initialized = false;
@@ -85,7 +86,162 @@ bool hal_Storage_Load_Float(const char* namespace, const char* key, float* value
     }
 }
 
-// Implement Save/Load for other types (u8, i32, string, blob) similarly using nvs_set/get functions
+bool hal_Storage_Save_U32(const char* namespace, const char* key, uint32_t value) {
+    if (!nvs_initialized) {
+        ESP_LOGE(TAG, "NVS not initialized.");
+        return false;
+    }
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(namespace, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error (%s) opening NVS handle!", esp_err_to_name(err));
+        return false;
+    }
+
+    err = nvs_set_u32(nvs_handle, key, value);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error (%s) saving u32 for key '%s'", esp_err_to_name(err), key);
+        return false;
+    }
+    ESP_LOGD(TAG, "Saved u32 for key '%s' = %lu", key, (unsigned long)value);
+    return true;
+}
+
+bool hal_Storage_Load_U32(const char* namespace, const char* key, uint32_t* value) {
+    if (!nvs_initialized || !value) {
+        ESP_LOGE(TAG, "NVS not initialized or null value pointer.");
+        return false;
+    }
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(namespace, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Error (%s) opening NVS handle for reading. Assuming key '%s' not found.", esp_err_to_name(err), key);
+        return false;
+    }
+
+    err = nvs_get_u32(nvs_handle, key, value);
+    nvs_close(nvs_handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGI(TAG, "Key '%s' not found in NVS namespace '%s'.", key, namespace);
+        return false;
+    } else if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error (%s) reading u32 for key '%s'", esp_err_to_name(err), key);
+        return false;
+    }
+    return true;
+}
+
+bool hal_Storage_Save_String(const char* namespace, const char* key, const char* value) {
+    if (!nvs_initialized || !value) {
+        ESP_LOGE(TAG, "NVS not initialized or null value pointer.");
+        return false;
+    }
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(namespace, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error (%s) opening NVS handle!", esp_err_to_name(err));
+        return false;
+    }
+
+    err = nvs_set_str(nvs_handle, key, value);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error (%s) writing string for key '%s'", esp_err_to_name(err), key);
+        return false;
+    }
+    ESP_LOGD(TAG, "Saved string for key '%s' = %s", key, value);
+    return true;
+}
+
+bool hal_Storage_Load_String(const char* namespace, const char* key, char* buffer, size_t buffer_size) {
+    if (!nvs_initialized || !buffer || buffer_size == 0) {
+        ESP_LOGE(TAG, "NVS not initialized or invalid buffer.");
+        return false;
+    }
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(namespace, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Error (%s) opening NVS handle for reading. Assuming key '%s' not found.", esp_err_to_name(err), key);
+        return false;
+    }
+
+    size_t length = buffer_size; // In: buffer size, Out: bytes written incl. terminator
+    err = nvs_get_str(nvs_handle, key, buffer, &length);
+    nvs_close(nvs_handle);
+
+    if (err == ESP_OK) {
+        ESP_LOGD(TAG, "Loaded string for key '%s' = %s", key, buffer);
+        return true;
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGI(TAG, "Key '%s' not found in NVS namespace '%s'.", key, namespace);
+    } else {
+        ESP_LOGE(TAG, "Error (%s) reading string for key '%s'", esp_err_to_name(err), key);
+    }
+    buffer[0] = '\0';
+    return false;
+}
+
+bool hal_Storage_Save_Blob(const char* namespace, const char* key, const void* data, size_t size) {
+    if (!nvs_initialized || !data) {
+        ESP_LOGE(TAG, "NVS not initialized or null data pointer.");
+        return false;
+    }
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(namespace, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error (%s) opening NVS handle!", esp_err_to_name(err));
+        return false;
+    }
+
+    err = nvs_set_blob(nvs_handle, key, data, size);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error (%s) writing blob for key '%s'", esp_err_to_name(err), key);
+        return false;
+    }
+    ESP_LOGD(TAG, "Saved blob for key '%s' (%u bytes)", key, (unsigned)size);
+    return true;
+}
+
+bool hal_Storage_Load_Blob(const char* namespace, const char* key, void* data, size_t* size) {
+    if (!nvs_initialized || !data || !size) {
+        ESP_LOGE(TAG, "NVS not initialized or invalid buffer.");
+        return false;
+    }
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(namespace, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Error (%s) opening NVS handle for reading. Assuming key '%s' not found.", esp_err_to_name(err), key);
+        return false;
+    }
+
+    err = nvs_get_blob(nvs_handle, key, data, size);
+    nvs_close(nvs_handle);
+
+    if (err == ESP_OK) {
+        ESP_LOGD(TAG, "Loaded blob for key '%s' (%u bytes)", key, (unsigned)*size);
+        return true;
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGI(TAG, "Key '%s' not found in NVS namespace '%s'.", key, namespace);
+    } else {
+        ESP_LOGE(TAG, "Error (%s) reading blob for key '%s'", esp_err_to_name(err), key);
+    }
+    return false;
+}
+
+// Implement Save/Load for other types (u8, i32) similarly using nvs_set/get functions
 
 bool hal_Storage_Erase_Key(const char* namespace, const char* key){
      if (!nvs_initialized) return false;
@@ -122,6 +278,10 @@ uint64_t hal_System_GetTickMs(void) {
     return (uint64_t)xTaskGetTickCount() * portTICK_PERIOD_MS;
 }
 
+uint64_t hal_System_GetTimeUs(void) {
+    return (uint64_t)esp_timer_get_time();
+}
+
 void hal_System_Reboot(void) {
     ESP_LOGW(TAG,"Rebooting system...");
     esp_restart();
@@ -0,0 +1,48 @@
+#include "hal_interfaces.h"
+#include <sys/time.h>
+// --- ESP-IDF Includes ---
+#include "esp_log.h"
+#include "esp_sntp.h"
+
+static const char *TAG = "HAL_TIME";
+
+// --- Wall Clock ---
+// lwIP SNTP sets the system time (gettimeofday) on the first response and
+// re-syncs every CONFIG_LWIP_SNTP_UPDATE_DELAY. Trace stamps are taken as
+// uptime in the hot paths and converted here when a payload is built, so
+// the sensor task never reads the wall clock and a later re-sync does not
+// reorder stamps that were already taken.
+static volatile bool synced = false;
+
+static void time_sync_cb(struct timeval *tv) {
+    if (!synced) {
+        ESP_LOGI(TAG, "Wall clock synchronized (epoch %lld s).", (long long)tv->tv_sec);
+    }
+    synced = true;
+}
+
+void hal_Time_Init(const char *server) {
+    if (esp_sntp_enabled()) {
+        return;
+    }
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, server);
+    sntp_set_time_sync_notification_cb(time_sync_cb);
+    esp_sntp_init(); // Requests go out once the station has an IP
+    ESP_LOGI(TAG, "SNTP started (%s).", server);
+}
+
+bool hal_Time_IsSynced(void) {
+    return synced;
+}
+
+uint64_t hal_Time_UptimeToEpochMs(uint64_t uptime_ms) {
+    if (!synced) {
+        return 0;
+    }
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t now_epoch_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    int64_t age_ms = (int64_t)(hal_System_GetTickMs() - uptime_ms);
+    return (uint64_t)(now_epoch_ms - age_ms);
+}
@@ -9,53 +9,137 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
-#include "nvs_flash.h"
+#include "esp_timer.h"  // Reconnect backoff timer
+#include "esp_random.h" // Backoff jitter
 #include "esp_http_client.h"
+#include "lwip/sockets.h" // UDP diagnostic stream
+#include "dlog.h"
 
 static const char *TAG = "HAL_WIFI";
 
-// --- ESP-IDF WiFi Event Handling ---
+// --- Connection Manager ---
+// Fully event-driven: hal_Wifi_Connect only records the credentials and
+// starts an attempt; retries are scheduled from wifi_event_handler with a
+// one-shot timer (exponential backoff with jitter), so no task ever blocks
+// on the connection. The AP's BSSID and channel are cached in NVS so a
+// reconnect (or a reboot) can skip the full scan; the IP lease is kept by
+// lwIP (CONFIG_LWIP_DHCP_RESTORE_LAST_IP) so DHCP is a single request.
 static EventGroupHandle_t wifi_event_group;
 const int WIFI_CONNECTED_BIT = BIT0;
-const int WIFI_FAIL_BIT      = BIT1;
-static int s_retry_num = 0;
-#define WIFI_MAXIMUM_RETRY  5
+static bool s_ever_connected = false;
+static uint32_t s_reconnect_count = 0; // Health telemetry
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t valid;
+} WifiApCache_t;
+
+static WifiApCache_t ap_cache;
+static wifi_config_t sta_config;
+static bool connect_wanted = false;  // Between hal_Wifi_Connect and hal_Wifi_Disconnect
+static bool sta_started = false;
+static uint32_t attempt = 0;         // Failed attempts since the last success
+static esp_timer_handle_t retry_timer = NULL;
+
+static void start_attempt(void) {
+    // The first attempts after a loss go straight to the cached AP; after
+    // that the cache is presumed stale and a full scan picks the best AP.
+    bool use_cache = ap_cache.valid && attempt < WIFI_CACHED_ATTEMPTS;
+    sta_config.sta.bssid_set = use_cache;
+    sta_config.sta.channel = use_cache ? ap_cache.channel : 0;
+    if (use_cache) {
+        memcpy(sta_config.sta.bssid, ap_cache.bssid, sizeof(ap_cache.bssid));
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &sta_config);
+    ESP_LOGI(TAG, "Connecting (attempt %lu, %s)...", (unsigned long)attempt + 1,
+             use_cache ? "cached AP" : "full scan");
+    esp_wifi_connect();
+}
+
+static uint32_t backoff_ms(void) {
+    uint32_t delay_ms = WIFI_BACKOFF_MAX_MS;
+    if (attempt < 16 && (WIFI_BACKOFF_MIN_MS << attempt) < WIFI_BACKOFF_MAX_MS) {
+        delay_ms = WIFI_BACKOFF_MIN_MS << attempt;
+    }
+    // +/-50% jitter so a line of scales does not hammer the AP in lockstep after an outage
+    return delay_ms / 2 + esp_random() % (delay_ms + 1);
+}
+
+static void retry_timer_cb(void *arg) {
+    if (connect_wanted && !(xEventGroupGetBits(wifi_event_group) & WIFI_CONNECTED_BIT)) {
+        start_attempt();
+    }
+}
+
+static void save_ap_cache(const uint8_t *bssid, uint8_t channel) {
+    if (ap_cache.valid && ap_cache.channel == channel && memcmp(ap_cache.bssid, bssid, 6) == 0) {
+        return; // Unchanged: no flash write
+    }
+    memcpy(ap_cache.bssid, bssid, sizeof(ap_cache.bssid));
+    ap_cache.channel = channel;
+    ap_cache.valid = 1;
+    hal_Storage_Save_Blob(NVS_NAMESPACE, NVS_KEY_WIFI_CACHE, &ap_cache, sizeof(ap_cache));
+}
 
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
-        ESP_LOGI(TAG, "WiFi STA Started, connecting...");
+        sta_started = true;
+        ESP_LOGI(TAG, "WiFi STA Started.");
+        if (connect_wanted) {
+            start_attempt();
+        }
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *)event_data;
+        ESP_LOGI(TAG, "Associated (channel %d), waiting for IP...", event->channel);
+        save_ap_cache(event->bssid, event->channel);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < WIFI_MAXIMUM_RETRY) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "Retry WiFi connection (%d/%d)...", s_retry_num, WIFI_MAXIMUM_RETRY);
+        wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
+        xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT);
+        if (!connect_wanted) {
+            return; // Requested disconnect
+        }
+        if (attempt == 0) {
+            // First loss after a good connection: reconnect to the same AP immediately
+            ESP_LOGW(TAG, "Disconnected (reason %d), reconnecting...", event->reason);
+            attempt++;
+            start_attempt();
         } else {
-            xEventGroupSetBits(wifi_event_group, WIFI_FAIL_BIT);
-            ESP_LOGE(TAG, "WiFi connection failed after maximum retries.");
+            uint32_t delay_ms = backoff_ms();
+            ESP_LOGW(TAG, "Connect failed (reason %d), retry %lu in %lu ms", event->reason,
+                     (unsigned long)attempt, (unsigned long)delay_ms);
+            attempt++;
+            esp_timer_stop(retry_timer); // Not running is fine
+            esp_timer_start_once(retry_timer, (uint64_t)delay_ms * 1000ULL);
         }
-        ESP_LOGI(TAG,"connect to the AP fail");
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0; // Reset retry counter on successful connection
+        attempt = 0; // Next loss starts with an immediate cached reconnect
+        if (s_ever_connected) {
+            s_reconnect_count++;
+        }
+        s_ever_connected = true;
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
     }
 }
 
 void hal_Wifi_Init(void) {
     ESP_LOGI(TAG, "Initializing WiFi HAL...");
-    // Initialize NVS (needed for WiFi config storage) - often done once in main
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-      ESP_ERROR_CHECK(nvs_flash_erase());
-      ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
+    // NVS (used by the WiFi driver for its config) is initialized by hal_Storage_Init
 
     wifi_event_group = xEventGroupCreate();
 
+    size_t cache_size = sizeof(ap_cache);
+    if (!hal_Storage_Load_Blob(NVS_NAMESPACE, NVS_KEY_WIFI_CACHE, &ap_cache, &cache_size) ||
+        cache_size != sizeof(ap_cache)) {
+        memset(&ap_cache, 0, sizeof(ap_cache));
+    }
+
+    const esp_timer_create_args_t retry_timer_args = { .callback = retry_timer_cb, .name = "wifi_retry" };
+    ESP_ERROR_CHECK(esp_timer_create(&retry_timer_args, &retry_timer));
+
     ESP_ERROR_CHECK(esp_netif_init()); // Initialize TCP/IP stack
 
     ESP_ERROR_CHECK(esp_event_loop_create_default()); // Create default event loop
@@ -63,6 +147,7 @@ void hal_Wifi_Init(void) {
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg)); // Initialize WiFi driver
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM)); // Config comes from us; avoid NVS writes per connect
 
     // Register event handlers
     esp_event_handler_instance_t instance_any_id;
@@ -81,62 +166,65 @@ void hal_Wifi_Init(void) {
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
     ESP_ERROR_CHECK(esp_wifi_start());
 
-    ESP_LOGI(TAG, "WiFi HAL Initialized.");
+    ESP_LOGI(TAG, "WiFi HAL Initialized%s.", ap_cache.valid ? " (cached AP available)" : "");
 }
 
-bool hal_Wifi_Connect(const char* ssid, const char* password, uint32_t timeout_ms) {
-     ESP_LOGI(TAG, "Connecting to SSID: %s", ssid);
-    s_retry_num = 0; // Reset retry counter for this attempt
-    xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT); // Clear previous results
-
-
-    wifi_config_t wifi_config = {0}; // Important to zero initialize
-     strncpy((char*)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
-     strncpy((char*)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
-     wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK; // Adjust as needed
-     wifi_config.sta.pmf_cfg.capable = true;
-     wifi_config.sta.pmf_cfg.required = false;
-
-
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-    // esp_wifi_connect() is called by the event handler on WIFI_EVENT_STA_START
-
-    // Wait for connection or failure event
-    EventBits_t bits = xEventGroupWaitBits(wifi_event_group,
-            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-            pdFALSE, // Clear bits on exit = false
-            pdFALSE, // Wait for ANY bit = false (wait for either connect OR fail)
-            pdMS_TO_TICKS(timeout_ms));
-
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "Connected to AP SSID:%s", ssid);
-        return true;
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGE(TAG, "Failed to connect to SSID:%s", ssid);
-        return false;
-    } else {
-        ESP_LOGE(TAG, "Connection timed out to SSID:%s", ssid);
-        // Should we stop the connection attempt explicitly?
-        // esp_wifi_disconnect(); // Maybe? Or let retry handler manage?
-        return false;
+void hal_Wifi_Connect(const char* ssid, const char* password) {
+    ESP_LOGI(TAG, "Connecting to SSID: %s", ssid);
+
+    memset(&sta_config, 0, sizeof(sta_config)); // Important to zero initialize
+    strncpy((char*)sta_config.sta.ssid, ssid, sizeof(sta_config.sta.ssid) - 1);
+    strncpy((char*)sta_config.sta.password, password, sizeof(sta_config.sta.password) - 1);
+    sta_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK; // Adjust as needed
+    sta_config.sta.pmf_cfg.capable = true;
+    sta_config.sta.pmf_cfg.required = false;
+    sta_config.sta.scan_method = WIFI_FAST_SCAN; // Stop at the first match when scanning
+
+    connect_wanted = true;
+    attempt = 0;
+    if (sta_started) {
+        start_attempt();
     }
+    // Otherwise WIFI_EVENT_STA_START starts the first attempt
 }
 
 bool hal_Wifi_IsConnected(void) {
     if (!wifi_event_group) return false;
-    // Check the event group bit OR query the interface status
-     wifi_ap_record_t ap_info;
-     esp_err_t err = esp_wifi_sta_get_ap_info(&ap_info);
-     return (err == ESP_OK); // Returns ESP_OK if associated
-    // return (xEventGroupGetBits(wifi_event_group) & WIFI_CONNECTED_BIT) != 0; // Alternative check
+    // Set on GOT_IP and cleared on disconnect, i.e. associated *and* addressed
+    return (xEventGroupGetBits(wifi_event_group) & WIFI_CONNECTED_BIT) != 0;
 }
 
 void hal_Wifi_Disconnect(void) {
     ESP_LOGI(TAG,"Disconnecting WiFi...");
+    connect_wanted = false;
+    esp_timer_stop(retry_timer);
     esp_wifi_disconnect();
     xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT); // Manually clear bit on disconnect request
 }
 
+int8_t hal_Wifi_GetRssi(void) {
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+        return 0; // Not associated
+    }
+    return ap_info.rssi;
+}
+
+uint32_t hal_Wifi_GetReconnectCount(void) {
+    return s_reconnect_count;
+}
+
+// Helper struct to pass response buffer details to HTTP event handler
+typedef struct {
+    char* buffer;
+    size_t buffer_size;
+    size_t current_len;
+} HttpUserData;
+
+// The HTTP client is created once and reused for every request (keep-alive),
+// so uploads do not allocate and free a client (and its buffers) each time.
+static esp_http_client_handle_t http_client = NULL;
+static HttpUserData http_user_data;
 
 // --- HTTP Client Event Handler ---
 esp_err_t _http_event_handler(esp_http_client_event_t *evt) {
@@ -158,7 +246,7 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt) {
         case HTTP_EVENT_ON_DATA:
             ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
             // Collect data into response buffer passed to hal_Wifi_HttpPost
-             if (evt->user_data) { // Check if user_data (response buffer struct) is provided
+             if (evt->user_data && ((HttpUserData*)evt->user_data)->buffer) { // Check if a response buffer is attached
                  char* resp_buf = ((HttpUserData*)evt->user_data)->buffer;
                  size_t resp_buf_size = ((HttpUserData*)evt->user_data)->buffer_size;
                  size_t* resp_len = &(((HttpUserData*)evt->user_data)->current_len);
@@ -188,13 +276,6 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt) {
     return ESP_OK;
 }
 
-// Helper struct to pass response buffer details to HTTP event handler
-typedef struct {
-    char* buffer;
-    size_t buffer_size;
-    size_t current_len;
-} HttpUserData;
-
 
 int hal_Wifi_HttpPost(const char* url, const char* payload, char* response_buffer, size_t buffer_size, uint32_t timeout_ms) {
      if (!hal_Wifi_IsConnected()) {
@@ -207,52 +288,89 @@ int hal_Wifi_HttpPost(const char* url, const char* payload, char* response_buffe
           return -2;
      }
 
-    esp_http_client_handle_t client = NULL;
     esp_err_t err;
     int http_status = -1; // Default to error
 
-    // Prepare user data for event handler
-    HttpUserData user_data = {
-        .buffer = response_buffer,
-        .buffer_size = buffer_size,
-        .current_len = 0
-    };
+    // Point the persistent handler context at this request's buffer
+    http_user_data.buffer = response_buffer;
+    http_user_data.buffer_size = buffer_size;
+    http_user_data.current_len = 0;
     response_buffer[0] = '\0'; // Ensure buffer is initially empty
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .method = HTTP_METHOD_POST,
-        .timeout_ms = (int)timeout_ms,
-        .event_handler = _http_event_handler,
-        .user_data = &user_data, // Pass buffer info to handler
-        // .crt_bundle_attach = esp_crt_bundle_attach, // For HTTPS
-    };
-
-    client = esp_http_client_init(&config);
-    if (!client) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return -3;
+    if (!http_client) {
+        esp_http_client_config_t config = {
+            .url = url,
+            .method = HTTP_METHOD_POST,
+            .timeout_ms = (int)timeout_ms,
+            .event_handler = _http_event_handler,
+            .user_data = &http_user_data, // Pass buffer info to handler
+            .keep_alive_enable = true,
+            // .crt_bundle_attach = esp_crt_bundle_attach, // For HTTPS
+        };
+
+        http_client = esp_http_client_init(&config);
+        if (!http_client) {
+            ESP_LOGE(TAG, "Failed to initialize HTTP client");
+            return -3;
+        }
+        // Header is kept by the client across requests
+        esp_http_client_set_header(http_client, "Content-Type", "application/json");
+    } else {
+        esp_http_client_set_url(http_client, url);
+        esp_http_client_set_method(http_client, HTTP_METHOD_POST);
+        esp_http_client_set_timeout_ms(http_client, (int)timeout_ms);
     }
 
-    // Set headers and payload
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, payload, strlen(payload));
+    // Payload is sent straight from the caller's buffer (no copy)
+    esp_http_client_set_post_field(http_client, payload, strlen(payload));
 
     ESP_LOGD(TAG, "Performing HTTP POST to %s", url);
-    err = esp_http_client_perform(client);
+    err = esp_http_client_perform(http_client);
 
     if (err == ESP_OK) {
-        http_status = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "HTTP POST Status = %d, content_length = %lld",
-                http_status,
-                esp_http_client_get_content_length(client));
+        http_status = esp_http_client_get_status_code(http_client);
+        DLOG(DLOG_HTTP_STATUS, http_status, esp_http_client_get_content_length(http_client));
         // Response data should have been collected in response_buffer by the event handler
         ESP_LOGD(TAG, "Response Body: %s", response_buffer);
     } else {
         ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
         http_status = -4; // Indicate perform error
+        // Drop the (possibly half-open) connection; the handle itself is reused
+        esp_http_client_close(http_client);
     }
 
-    esp_http_client_cleanup(client);
+    http_user_data.buffer = NULL; // Caller's buffer is only valid for this call
     return http_status;
 }
+
+// --- UDP (diagnostic streams) ---
+int hal_Wifi_UdpOpen(const char* host, uint16_t port) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        ESP_LOGE(TAG, "UDP destination '%s' is not an IPv4 address.", host);
+        return -1;
+    }
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create UDP socket (errno %d).", errno);
+        return -1;
+    }
+    // Connected socket: the destination is resolved once, not per datagram
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "UDP connect to %s:%u failed (errno %d).", host, (unsigned)port, errno);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int hal_Wifi_UdpSend(int handle, const void* data, size_t length) {
+    // Non-blocking: when lwIP is out of buffers the datagram is refused, not queued
+    return (int)send(handle, data, length, MSG_DONTWAIT);
+}
+
+void hal_Wifi_UdpClose(int handle) {
+    if (handle >= 0) {
+        close(handle);
+    }
+}
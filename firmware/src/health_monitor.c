@@ -0,0 +1,80 @@
+#include "health_monitor.h"
+#include "hal_interfaces.h"
+#include "mem_report.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+static const char *TAG = "HEALTH";
+
+// Run-time stats need CONFIG_FREERTOS_USE_TRACE_FACILITY and
+// CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS (see sdkconfig.defaults).
+#define HEALTH_MAX_TASKS 32
+
+static TaskStatus_t task_status[HEALTH_MAX_TASKS]; // Static: sampled from the comms task stack otherwise
+static uint32_t prev_task_runtime[APP_TASK_COUNT];
+static uint32_t prev_idle_runtime[HEALTH_NUM_CORES];
+static uint32_t prev_total_runtime = 0;
+
+static uint8_t percent(uint32_t part, uint32_t whole) {
+    if (whole == 0) return 0;
+    uint32_t pct = (uint32_t)((100ULL * part) / whole);
+    return (uint8_t)(pct > 100 ? 100 : pct);
+}
+
+static void sample_cpu(HealthRecord_t *record) {
+    uint32_t total_runtime = 0;
+    UBaseType_t count = uxTaskGetSystemState(task_status, HEALTH_MAX_TASKS, &total_runtime);
+    if (count == 0) {
+        ESP_LOGW(TAG, "Task table too small for run-time stats.");
+        return;
+    }
+
+    // Elapsed run-time counter ticks; total is per core, so both cores = 2x
+    uint32_t elapsed = total_runtime - prev_total_runtime;
+    prev_total_runtime = total_runtime;
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *status = &task_status[i];
+        for (int t = 0; t < APP_TASK_COUNT; t++) {
+            if (status->xHandle == app_task_handles[t]) {
+                record->task_cpu_pct[t] = percent(status->ulRunTimeCounter - prev_task_runtime[t], elapsed * HEALTH_NUM_CORES);
+                prev_task_runtime[t] = status->ulRunTimeCounter;
+            }
+        }
+        if (strncmp(status->pcTaskName, "IDLE", 4) == 0 &&
+            status->xCoreID >= 0 && status->xCoreID < HEALTH_NUM_CORES) {
+            int core = (int)status->xCoreID;
+            record->core_idle_pct[core] = percent(status->ulRunTimeCounter - prev_idle_runtime[core], elapsed);
+            prev_idle_runtime[core] = status->ulRunTimeCounter;
+        }
+    }
+}
+
+void HealthMonitor_Sample(HealthRecord_t *record) {
+    memset(record, 0, sizeof(*record));
+    record->uptime_s = (uint32_t)(hal_System_GetTickMs() / 1000U);
+
+    sample_cpu(record);
+
+    MemReport_t mem;
+    MemReport_Get(&mem);
+    memcpy(record->stack_min_free, mem.stack_min_free, sizeof(record->stack_min_free));
+    record->heap_free = mem.heap_free;
+    record->heap_min_free = mem.heap_min_free;
+    record->heap_fragmentation_pct = mem.heap_fragmentation_pct;
+
+    SensorTimingStats_t timing;
+    SensorTask_GetTimingStats(&timing);
+    record->sensor_deadline_misses = timing.deadline_misses;
+    record->sensor_jitter_max_us = timing.jitter_max_us;
+    record->check_decisions = timing.decisions;
+    record->check_rejects = timing.decisions_rejected;
+    record->check_early = timing.decisions_early;
+    record->check_latency_mean_ms = timing.decisions ? (uint32_t)(timing.decision_latency_sum_ms / timing.decisions) : 0;
+    record->check_latency_max_ms = timing.decision_latency_max_ms;
+
+    record->wifi_rssi = hal_Wifi_GetRssi();
+    record->wifi_reconnects = hal_Wifi_GetReconnectCount();
+}
@@ -8,11 +8,31 @@
 #include "scale_logic.h"
 #include "ui_manager.h"
 #include "comms_manager.h"
-
-// Task Function Prototypes
-void sensor_task(void *pvParameters);
-void ui_task(void *pvParameters);
-void comms_task(void *pvParameters);
+#include "app_tasks.h"
+#include "mem_report.h"
+#include "calibration.h"
+#include "checkweigh.h"
+#include "boot_timing.h"
+#include "dlog.h"
+
+// --- Task Table ---
+// Placement plan: see app_tasks.h. Stacks and TCBs are static so no task
+// memory comes from the heap.
+static StackType_t sensor_task_stack[SENSOR_TASK_STACK_BYTES];
+static StackType_t ui_task_stack[UI_TASK_STACK_BYTES];
+static StackType_t comms_task_stack[COMMS_TASK_STACK_BYTES];
+static StaticTask_t task_tcbs[APP_TASK_COUNT];
+
+const AppTaskConfig_t app_task_table[APP_TASK_COUNT] = {
+    [APP_TASK_SENSOR] = { sensor_task, "SensorTask", SENSOR_TASK_STACK_BYTES, 20, APP_CORE_ACQUISITION,
+                          sensor_task_stack, &task_tcbs[APP_TASK_SENSOR] }, // Top priority, alone on its core
+    [APP_TASK_UI]     = { ui_task,     "UITask",     UI_TASK_STACK_BYTES,      5, APP_CORE_NETWORK_UI,
+                          ui_task_stack,     &task_tcbs[APP_TASK_UI] },
+    [APP_TASK_COMMS]  = { comms_task,  "CommsTask",  COMMS_TASK_STACK_BYTES,   4, APP_CORE_NETWORK_UI,
+                          comms_task_stack,  &task_tcbs[APP_TASK_COMMS] }, // Shares core with Wi-Fi/lwIP
+};
+
+TaskHandle_t app_task_handles[APP_TASK_COUNT];
 
 // Shared scale state
 static ScaleState_t scale_state;
@@ -22,126 +42,50 @@ static const char *TAG = "MAIN";
 
 // --- Main Application Entry Point ---
 void app_main(void) {
+    BootTiming_Mark(BOOT_PHASE_APP_START);
     ESP_LOGI(TAG, "Starting Counting Scale System Firmware");
+    DLog_Init(); // Deferred log formatter, before anything records
 
-    // --- Initialize HAL ---
-    ESP_LOGI(TAG, "Initializing Hardware Abstraction Layer...");
+    // --- Sensor Pipeline First ---
+    // Only what the sensor task needs is initialized here; the display is
+    // brought up by the UI task and Wi-Fi by the comms task, in parallel
+    // with acquisition, so the first count does not wait for either.
+    ESP_LOGI(TAG, "Initializing sensor pipeline...");
     hal_Storage_Init();     // Init storage first to load config early
+    BootTiming_Mark(BOOT_PHASE_STORAGE);
     hal_LoadCell_Init(LOADCELL_CALIBRATION_FACTOR); // Pass initial calibration factor
-    hal_Display_Init();
-    hal_Buttons_Init();
-    hal_Wifi_Init();        // Initialize WiFi hardware/stack
+    Calibration_Init();     // Multi-point linearization on top of the scalar factor
+    BootTiming_Mark(BOOT_PHASE_LOADCELL);
+    hal_Buttons_Init();     // Event queue must exist before the UI task
+    hal_RejectGate_Init();  // Check-weighing rejects are fired by the sensor task
+    Checkweigh_LoadTargets();
 
-    // --- Initialize Core Logic & Modules ---
-    ESP_LOGI(TAG, "Initializing Logic and Managers...");
     ScaleLogic_Init(&scale_state);
-    ScaleLogic_LoadConfig(&scale_state); // Attempt to load saved avg item weight
-    UIManager_Init(&scale_state);
-    CommsManager_Init();
-
-    // Display initial message
-    hal_Display_Clear();
-    hal_Display_SetCursor(0, 0);
-    hal_Display_Print("Initializing...");
-    hal_Display_Update();
-    hal_System_DelayMs(1000); // Brief pause
+    ScaleLogic_LoadConfig(&scale_state); // Piece weight, SKU and tare offsets from one snapshot
+    ScaleLogic_LoadLot(&scale_state);    // Open accumulation lot survives reboots
+    ScaleLogic_LoadCheckweigh(&scale_state); // Back to check-weighing if it was selected
+    BootTiming_Mark(BOOT_PHASE_CONFIG);
 
     // --- Create RTOS Tasks ---
-    // Note: Adjust stack sizes based on actual usage and complexity
+    // Stack, priority and core affinity come from app_task_table; the sensor task is created first
     ESP_LOGI(TAG, "Creating RTOS Tasks...");
-    xTaskCreate(sensor_task,        // Task function
-                "SensorTask",       // Task name
-                4096,               // Stack size (bytes)
-                (void*)&scale_state,// Parameter to pass
-                5,                  // Priority (higher number = higher priority)
-                NULL);              // Task handle (optional)
-
-    xTaskCreate(ui_task, "UITask", 2048, (void*)&scale_state, 4, NULL);
-
-    xTaskCreate(comms_task, "CommsTask", 4096, (void*)&scale_state, 3, NULL);
-
-
-    ESP_LOGI(TAG, "Initialization Complete. Tasks Started.");
-    // The ESP-IDF `app_main` function returns, and the FreeRTOS scheduler runs the created tasks.
-}
-
-
-// --- Task Implementations (could be in separate files) ---
-
-// Sensor Task: Reads load cell and updates shared state
-void sensor_task(void *pvParameters) {
-    ScaleState_t *state = (ScaleState_t *)pvParameters;
-    LoadCellReading_t current_reading;
-    ESP_LOGI(TAG, "Sensor Task Started.");
-
-    while (1) {
-        // Read from HAL
-        current_reading = hal_LoadCell_Read(MAX_WEIGHT_CAPACITY_G,
-                                            STABLE_READING_THRESHOLD_G,
-                                            STABLE_READING_COUNT);
-
-        // --- Critical Section (Example using simple approach, consider mutex for complex state) ---
-        // If using mutex: xSemaphoreTake(state->mutex, portMAX_DELAY);
-        ScaleLogic_Update(state, ¤t_reading);
-        // If using mutex: xSemaphoreGive(state->mutex);
-        // --- End Critical Section ---
-
-        // Log raw value occasionally for debugging (optional)
-        // ESP_LOGD(TAG, "Raw Sensor: %ld, Weight: %.2fg, Stable: %d",
-        //         current_reading.raw_value, state->current_weight_g, state->is_stable);
-
-        vTaskDelay(pdMS_TO_TICKS(SENSOR_TASK_INTERVAL_MS));
-    }
-}
-
-// UI Task: Handles button input and updates the display
-void ui_task(void *pvParameters) {
-    ScaleState_t *state = (ScaleState_t *)pvParameters;
-    ButtonEvent_t event;
-    ESP_LOGI(TAG, "UI Task Started.");
-
-    while (1) {
-        // Check for button input
-        event = hal_Buttons_Read();
-        if (event != BUTTON_NONE) {
-             ESP_LOGD(TAG, "Button Event: %d", event);
-            // --- Critical Section (Example) ---
-            // xSemaphoreTake(state->mutex, portMAX_DELAY);
-            UIManager_HandleInput(state, event); // HandleInput modifies state
-            // xSemaphoreGive(state->mutex);
-            // --- End Critical Section ---
+    for (int i = 0; i < APP_TASK_COUNT; i++) {
+        const AppTaskConfig_t *cfg = &app_task_table[i];
+        app_task_handles[i] = xTaskCreateStaticPinnedToCore(cfg->function,
+                                                            cfg->name,
+                                                            cfg->stack_size,
+                                                            (void*)&scale_state, // Parameter to pass
+                                                            cfg->priority,
+                                                            cfg->stack,
+                                                            cfg->tcb,
+                                                            cfg->core);
+        if (app_task_handles[i] == NULL) {
+            ESP_LOGE(TAG, "Failed to create task %s!", cfg->name);
         }
-
-        // Update the display based on the current state
-        // --- Critical Section (Example - Read Only) ---
-        // xSemaphoreTake(state->mutex, portMAX_DELAY);
-        UIManager_UpdateDisplay(state);
-        // xSemaphoreGive(state->mutex);
-        // --- End Critical Section ---
-
-
-        vTaskDelay(pdMS_TO_TICKS(UI_TASK_INTERVAL_MS));
     }
-}
+    BootTiming_Mark(BOOT_PHASE_TASKS);
+    MemReport_Log(); // Baseline: heap left after static tasks and HAL init
 
-// Comms Task: Manages WiFi connection and sends data periodically
-void comms_task(void *pvParameters) {
-    ScaleState_t *state = (ScaleState_t *)pvParameters;
-     ESP_LOGI(TAG, "Comms Task Started.");
-
-    while (1) {
-        // Run the communications state machine / periodic checks
-        CommsManager_RunPeriodic(); // Handles connection logic
-
-        // If connected, try sending data
-        if (CommsManager_GetCurrentState() == COMMS_STATE_CONNECTED) {
-            // --- Critical Section (Example - Read Only) ---
-            // xSemaphoreTake(state->mutex, portMAX_DELAY);
-            CommsManager_SendData(state);
-            // xSemaphoreGive(state->mutex);
-            // --- End Critical Section ---
-        }
-
-        vTaskDelay(pdMS_TO_TICKS(COMMS_TASK_INTERVAL_MS)); // Run less frequently
-    }
+    ESP_LOGI(TAG, "Initialization Complete. Tasks Started.");
+    // The ESP-IDF `app_main` function returns, and the FreeRTOS scheduler runs the created tasks.
 }
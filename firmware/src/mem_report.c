@@ -0,0 +1,35 @@
+#include "mem_report.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+static const char *TAG = "MEM_REPORT";
+
+void MemReport_Get(MemReport_t *report) {
+    for (int i = 0; i < APP_TASK_COUNT; i++) {
+        report->stack_size[i] = app_task_table[i].stack_size;
+        // On ESP-IDF the high-water mark is reported in bytes
+        report->stack_min_free[i] = app_task_handles[i] ? (uint32_t)uxTaskGetStackHighWaterMark(app_task_handles[i]) : 0;
+    }
+
+    report->heap_free = (uint32_t)heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    report->heap_min_free = (uint32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    report->heap_largest_block = (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    report->heap_fragmentation_pct = report->heap_free ?
+        (uint8_t)(100U - (uint32_t)((100ULL * report->heap_largest_block) / report->heap_free)) : 0;
+}
+
+void MemReport_Log(void) {
+    MemReport_t report;
+    MemReport_Get(&report);
+
+    for (int i = 0; i < APP_TASK_COUNT; i++) {
+        if (!app_task_handles[i]) continue;
+        ESP_LOGI(TAG, "Stack %-10s: %5lu / %5lu bytes free (min)", app_task_table[i].name,
+                 (unsigned long)report.stack_min_free[i], (unsigned long)report.stack_size[i]);
+    }
+    ESP_LOGI(TAG, "Heap: %lu free, %lu min free, %lu largest block (%u%% fragmented)",
+             (unsigned long)report.heap_free, (unsigned long)report.heap_min_free,
+             (unsigned long)report.heap_largest_block, report.heap_fragmentation_pct);
+}
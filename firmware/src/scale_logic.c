@@ -1,13 +1,80 @@
 #include "scale_logic.h"
 #include "scale_config.h"
 #include "hal_interfaces.h"
+#include "scale_core.h"
+#include "freertos/FreeRTOS.h" // portMUX critical section around lot changes
 #include <stdio.h> // For snprintf
 #include <string.h> // For strcpy, memset
-#include <math.h>   // For roundf, fabsf
 #include "esp_log.h"
 
 static const char *TAG = "SCALE_LOGIC";
 
+// --- Config Snapshot ---
+// Everything needed to show a correct count right after power-up, read
+// with a single NVS access. Restoring the tare offsets means boot does not
+// have to wait for (or trust) a tare of whatever is on the pan.
+#define CONFIG_SNAPSHOT_VERSION 2
+typedef struct {
+    uint8_t version;
+    uint8_t num_channels;
+    float average_item_weight_g;
+    char sku[SKU_MAX_LEN];
+    float tare_offsets[LOADCELL_NUM_CHANNELS]; // Zero
+    float tare_g;                              // Container tared off above the zero
+} ConfigSnapshot_t;
+
+static uint32_t saved_tare_count = 0; // hal_LoadCell_GetTareCount() at the last snapshot
+
+// SKUs go into every reading and lot payload unescaped, so they are limited
+// to characters that are safe inside a JSON string (same set as the backend).
+static bool sku_is_valid(const char *sku) {
+    size_t len = strnlen(sku, SKU_MAX_LEN);
+    if (len == 0 || len >= SKU_MAX_LEN) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = sku[i];
+        if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+              c == '.' || c == '_' || c == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Stored by older firmware that accepted any SKU: forget it rather than break every upload
+static void drop_unsafe_sku(char *sku) {
+    if (sku[0] != '\0' && !sku_is_valid(sku)) {
+        ESP_LOGW(TAG, "Dropping stored SKU with unsupported characters.");
+        sku[0] = '\0';
+    }
+}
+
+// --- Lot Accumulation ---
+// MODE_ACCUMULATE counts lots larger than one pan load. Loads are told
+// apart by the stable count alone: a settled non-zero count is added once,
+// and only a settled empty pan (count 0) arms the next addition. A load that
+// settles again higher (topped up before removal) raises its addition;
+// lower settles are ignored, since they are pauses while unloading. A load
+// that must not be added (on the pan at boot or on mode entry, or undone)
+// is held until the pan has been emptied. The sensor task only changes RAM;
+// the UI task persists the lot, so flash writes stay off the acquisition core.
+// Loads are added by the sensor task while undo, close, upload and mode
+// changes come from the UI and comms tasks on the other core, so every
+// change to the lot is made under lot_mux (no logging inside).
+#define LOT_SNAPSHOT_VERSION 1
+typedef struct {
+    uint8_t version;
+    uint8_t accumulating; // Resume MODE_ACCUMULATE after boot
+    uint8_t unsent_count;
+    int32_t last_added;
+    LotRecord_t open;
+    LotRecord_t unsent[LOT_UNSENT_MAX];
+} LotSnapshot_t;
+
+static uint32_t saved_lot_changes = 0; // state->lot_changes at the last lot save
+static portMUX_TYPE lot_mux = portMUX_INITIALIZER_UNLOCKED;
+
 // Helper to update status message safely
 static void set_status(ScaleState_t *state, const char *message) {
     strncpy(state->status_message, message, sizeof(state->status_message) - 1);
@@ -22,11 +89,49 @@ void ScaleLogic_Init(ScaleState_t *state) {
     // Initialize stability tracking
     state->stable_counter = 0;
     state->weight_history_index = 0;
+    state->lot.lot_id = 1;
+    state->lot_phase = LOT_PHASE_OFF;
     // If using mutex: state->mutex = xSemaphoreCreateMutex();
     ESP_LOGI(TAG, "Scale Logic Initialized.");
 }
 
+static bool load_snapshot(ScaleState_t *state) {
+    ConfigSnapshot_t snapshot;
+    size_t size = sizeof(snapshot);
+    if (!hal_Storage_Load_Blob(NVS_NAMESPACE, NVS_KEY_CONFIG_SNAPSHOT, &snapshot, &size)) {
+        return false;
+    }
+    if (size != sizeof(snapshot) || snapshot.version != CONFIG_SNAPSHOT_VERSION ||
+        snapshot.num_channels != hal_LoadCell_GetChannelCount()) {
+        ESP_LOGW(TAG, "Config snapshot does not match this build, ignoring it.");
+        return false;
+    }
+
+    snapshot.sku[sizeof(snapshot.sku) - 1] = '\0';
+    memcpy(state->sku, snapshot.sku, sizeof(state->sku));
+    drop_unsafe_sku(state->sku);
+    hal_LoadCell_SetChannelOffsets(snapshot.tare_offsets, LOADCELL_NUM_CHANNELS);
+    hal_LoadCell_SetTareWeight(snapshot.tare_g);
+    saved_tare_count = hal_LoadCell_GetTareCount();
+    if (snapshot.average_item_weight_g > 0.001f) {
+        state->average_item_weight_g = snapshot.average_item_weight_g;
+        state->current_mode = MODE_COUNTING;
+        ESP_LOGI(TAG, "Restored config: item weight %.3f g, SKU '%s'", state->average_item_weight_g, state->sku);
+    } else {
+        state->current_mode = MODE_WEIGHING;
+        ESP_LOGI(TAG, "Restored config: no item weight, weighing mode.");
+    }
+    return true;
+}
+
 void ScaleLogic_LoadConfig(ScaleState_t *state) {
+    if (load_snapshot(state)) {
+        set_status(state, state->current_mode == MODE_COUNTING ? "Ready (Count)" : "Ready (Weigh)");
+        return;
+    }
+
+    // No snapshot (first boot or older firmware): legacy keys, and zero on the current load
+    hal_LoadCell_Tare();
     float loaded_weight = 0.0f;
     if (hal_Storage_Load_Float(NVS_NAMESPACE, NVS_KEY_SAMPLE_WT, &loaded_weight)) {
         if (loaded_weight > 0.001f) { // Basic validity check
@@ -42,20 +147,207 @@ void ScaleLogic_LoadConfig(ScaleState_t *state) {
         ESP_LOGW(TAG, "Could not load average item weight from NVS. Starting in weighing mode.");
         state->current_mode = MODE_WEIGHING; // Ensure weighing mode
     }
+    if (!hal_Storage_Load_String(NVS_NAMESPACE, NVS_KEY_SKU, state->sku, sizeof(state->sku))) {
+        state->sku[0] = '\0'; // No product assigned
+    }
+    drop_unsafe_sku(state->sku);
      set_status(state, state->current_mode == MODE_COUNTING ? "Ready (Count)" : "Ready (Weigh)");
 }
 
 void ScaleLogic_SaveConfig(const ScaleState_t *state) {
-    if (state->average_item_weight_g > 0.001f) {
-        if (hal_Storage_Save_Float(NVS_NAMESPACE, NVS_KEY_SAMPLE_WT, state->average_item_weight_g)) {
-            ESP_LOGI(TAG, "Saved average item weight: %.3f g", state->average_item_weight_g);
-        } else {
-            ESP_LOGE(TAG, "Failed to save average item weight to NVS!");
-        }
+    ConfigSnapshot_t snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.version = CONFIG_SNAPSHOT_VERSION;
+    snapshot.num_channels = LOADCELL_NUM_CHANNELS;
+    snapshot.average_item_weight_g = state->average_item_weight_g;
+    memcpy(snapshot.sku, state->sku, sizeof(snapshot.sku));
+    uint32_t tare_count = hal_LoadCell_GetTareCount();
+    hal_LoadCell_GetChannelOffsets(snapshot.tare_offsets, LOADCELL_NUM_CHANNELS);
+    snapshot.tare_g = hal_LoadCell_GetTareWeight();
+
+    if (hal_Storage_Save_Blob(NVS_NAMESPACE, NVS_KEY_CONFIG_SNAPSHOT, &snapshot, sizeof(snapshot))) {
+        saved_tare_count = tare_count;
+        ESP_LOGI(TAG, "Saved config snapshot (item weight %.3f g)", state->average_item_weight_g);
+    } else {
+        ESP_LOGE(TAG, "Failed to save config snapshot to NVS!");
+    }
+}
+
+void ScaleLogic_LoadLot(ScaleState_t *state) {
+    LotSnapshot_t snapshot;
+    size_t size = sizeof(snapshot);
+    if (!hal_Storage_Load_Blob(NVS_NAMESPACE, NVS_KEY_LOT, &snapshot, &size)) {
+        return; // No lot yet
+    }
+    if (size != sizeof(snapshot) || snapshot.version != LOT_SNAPSHOT_VERSION || snapshot.unsent_count > LOT_UNSENT_MAX) {
+        ESP_LOGW(TAG, "Saved lot does not match this build, ignoring it.");
+        return;
+    }
+
+    state->lot = snapshot.open;
+    state->lot_last_added = snapshot.last_added;
+    memcpy(state->lots_unsent, snapshot.unsent, sizeof(state->lots_unsent));
+    state->lots_unsent_count = snapshot.unsent_count;
+    drop_unsafe_sku(state->lot.sku);
+    for (int i = 0; i < state->lots_unsent_count; i++) {
+        drop_unsafe_sku(state->lots_unsent[i].sku);
+    }
+    saved_lot_changes = state->lot_changes;
+    if (snapshot.accumulating && state->average_item_weight_g > 0.001f) {
+        state->current_mode = MODE_ACCUMULATE;
+        state->lot_phase = LOT_PHASE_HOLD; // Whatever is on the pan may already be in the lot
+        set_status(state, "Ready (Accum)");
+    }
+    ESP_LOGI(TAG, "Restored lot %lu: %ld items in %u loads, %u closed lot(s) unsent",
+             (unsigned long)state->lot.lot_id, (long)state->lot.total, state->lot.loads, state->lots_unsent_count);
+}
+
+void ScaleLogic_SaveLotIfChanged(const ScaleState_t *state) {
+    uint32_t changes = state->lot_changes;
+    if (changes == saved_lot_changes) {
+        return;
+    }
+
+    LotSnapshot_t snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.version = LOT_SNAPSHOT_VERSION;
+    portENTER_CRITICAL(&lot_mux);
+    changes = state->lot_changes; // Consistent with the copy
+    snapshot.accumulating = state->lot_phase != LOT_PHASE_OFF;
+    snapshot.unsent_count = state->lots_unsent_count;
+    snapshot.last_added = state->lot_last_added;
+    snapshot.open = state->lot;
+    memcpy(snapshot.unsent, state->lots_unsent, sizeof(snapshot.unsent));
+    portEXIT_CRITICAL(&lot_mux);
+    if (hal_Storage_Save_Blob(NVS_NAMESPACE, NVS_KEY_LOT, &snapshot, sizeof(snapshot))) {
+        saved_lot_changes = changes;
     } else {
-         // Optionally erase the key if the weight is zero/invalid
-         // hal_Storage_Erase_Key(NVS_NAMESPACE, NVS_KEY_SAMPLE_WT);
-         ESP_LOGI(TAG, "Average item weight is zero, not saving.");
+        ESP_LOGE(TAG, "Failed to save lot to NVS!");
+    }
+}
+
+// Lot phase change from the UI or comms task
+static void set_lot_phase(ScaleState_t *state, LotPhase_t phase) {
+    portENTER_CRITICAL(&lot_mux);
+    state->lot_phase = phase;
+    state->lot_changes++;
+    portEXIT_CRITICAL(&lot_mux);
+}
+
+// One stable reading in MODE_ACCUMULATE (state->item_count is the load's count); caller holds lot_mux
+static void accumulate_load(ScaleState_t *state) {
+    int32_t count = state->item_count;
+    switch (state->lot_phase) {
+        case LOT_PHASE_EMPTY:
+            if (count > 0) {
+                if (state->lot.loads == 0) {
+                    state->lot.item_weight_g = state->average_item_weight_g;
+                    memcpy(state->lot.sku, state->sku, sizeof(state->lot.sku));
+                }
+                state->lot.total += count;
+                state->lot.loads++;
+                state->lot_last_added = count;
+                state->lot_phase = LOT_PHASE_LOADED;
+                state->lot_changes++;
+            }
+            break;
+
+        case LOT_PHASE_LOADED:
+            if (count == 0) {
+                state->lot_phase = LOT_PHASE_EMPTY;
+            } else if (count > state->lot_last_added) {
+                state->lot.total += count - state->lot_last_added; // Topped up before removal
+                state->lot_last_added = count;
+                state->lot_changes++;
+            }
+            break;
+
+        case LOT_PHASE_HOLD:
+            if (count == 0) {
+                state->lot_phase = LOT_PHASE_EMPTY;
+            }
+            break;
+
+        case LOT_PHASE_OFF:
+        default:
+            break;
+    }
+}
+
+// --- Check-Weighing ---
+// Decisions are made by the sensor task on every sample (checkweigh.c) and
+// a reject fires the gate right there, so the line only waits for the
+// decision itself. Bands are looked up per SKU and (re-)armed from the UI
+// and comms tasks, which also persist whether the mode is selected. The
+// band is resolved outside and armed (with enabled) under check_mux, which
+// the sensor task holds for each sample, so a sample never sees half a band.
+static portMUX_TYPE check_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Enters MODE_CHECKWEIGH with the active SKU's band. False if it has none (or a count band and no piece weight).
+static bool start_checkweigh(ScaleState_t *state) {
+    CheckTarget_t target;
+    float lower_g, upper_g;
+    if (!Checkweigh_FindTarget(state->sku, &target) ||
+        !Checkweigh_ResolveBand(&target, state->average_item_weight_g, &lower_g, &upper_g)) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&check_mux);
+    Checkweigh_Arm(&state->check, lower_g, upper_g);
+    state->check.enabled = true;
+    portEXIT_CRITICAL(&check_mux);
+    Checkweigh_SaveActive(true);
+    if (state->current_mode != MODE_ERROR) {
+        state->current_mode = MODE_CHECKWEIGH;
+    }
+    ESP_LOGI(TAG, "Check-weighing %s: pass %.2f .. %.2f g", state->sku, lower_g, upper_g);
+    return true;
+}
+
+static void stop_checkweigh(ScaleState_t *state) {
+    if (state->check.enabled) {
+        portENTER_CRITICAL(&check_mux);
+        state->check.enabled = false;
+        portEXIT_CRITICAL(&check_mux);
+        Checkweigh_SaveActive(false);
+    }
+}
+
+// Re-resolves the band after a piece weight or product change. False (and
+// check-weighing left) if the product has no usable band.
+static bool keep_checkweigh(ScaleState_t *state) {
+    if (!state->check.enabled) {
+        return false;
+    }
+    if (start_checkweigh(state)) {
+        return true;
+    }
+    ESP_LOGW(TAG, "No check target for %s, leaving check-weighing.", state->sku[0] ? state->sku : "(no SKU)");
+    stop_checkweigh(state);
+    return false;
+}
+
+// One sample while check-weighing (any mode, an overload is judged too)
+static void checkweigh_sample(ScaleState_t *state, const LoadCellReading_t *reading) {
+    uint32_t now_ms = (uint32_t)hal_System_GetTickMs();
+    CheckResult_t result = CHECK_RESULT_NONE;
+    portENTER_CRITICAL(&check_mux);
+    if (state->check.enabled) { // Re-checked: stopped from the other core meanwhile
+        result = Checkweigh_Process(&state->check, reading->weight_grams, reading->is_overload,
+                                    reading->is_stable, now_ms);
+    }
+    portEXIT_CRITICAL(&check_mux);
+    if (result != CHECK_RESULT_NONE && result != CHECK_RESULT_PASS) {
+        hal_RejectGate_Pulse(REJECT_GATE_PULSE_MS);
+    }
+}
+
+void ScaleLogic_SaveConfigIfTareChanged(const ScaleState_t *state) {
+    // Tares are applied asynchronously by the sensor task; persisting from
+    // here keeps flash writes off the acquisition core. Auto-zero drift is
+    // not saved (it is re-tracked after boot), which bounds flash wear.
+    if (hal_LoadCell_GetTareCount() != saved_tare_count) {
+        ScaleLogic_SaveConfig(state);
     }
 }
 
@@ -66,6 +358,10 @@ void ScaleLogic_Update(ScaleState_t *state, const LoadCellReading_t* reading) {
     state->is_stable = reading->is_stable; // Assume HAL provides stability state now
     state->is_overload = reading->is_overload;
 
+    if (state->check.enabled) {
+        checkweigh_sample(state, reading);
+    }
+
     // Handle Overload Condition
     if (state->is_overload) {
         state->current_mode = MODE_ERROR;
@@ -73,25 +369,34 @@ void ScaleLogic_Update(ScaleState_t *state, const LoadCellReading_t* reading) {
         set_status(state, "OVERLOAD!");
         return; // Skip further processing in overload state
     } else if (state->current_mode == MODE_ERROR && !state->is_overload) {
-        // Recover from overload if weight is back in range
-        state->current_mode = (state->average_item_weight_g > 0.001f) ? MODE_COUNTING : MODE_WEIGHING;
+        // Recover from overload if weight is back in range (the lot cycle carries on)
+        if (state->lot_phase != LOT_PHASE_OFF) {
+            state->current_mode = MODE_ACCUMULATE;
+        } else if (state->check.enabled) {
+            state->current_mode = MODE_CHECKWEIGH;
+        } else {
+            state->current_mode = (state->average_item_weight_g > 0.001f) ? MODE_COUNTING : MODE_WEIGHING;
+        }
     }
 
-    // Update Item Count (only in Counting mode and if stable)
-    if (state->current_mode == MODE_COUNTING && state->is_stable) {
+    // Update Item Count (only in Counting/Accumulate mode and if stable)
+    if ((state->current_mode == MODE_COUNTING || state->current_mode == MODE_ACCUMULATE) && state->is_stable) {
         if (state->average_item_weight_g > 0.001f) {
-            // Ensure weight is positive and significant enough
-            if (state->current_weight_g >= state->average_item_weight_g / 2.0f) {
-                 // Calculate count using rounding
-                state->item_count = (int32_t)roundf(state->current_weight_g / state->average_item_weight_g);
-            } else {
-                state->item_count = 0; // Treat small weights as zero items
+            // Rounded count, zero below half a piece (shared with the backend recount)
+            state->item_count = ScaleCore_CountItems(state->current_weight_g, state->average_item_weight_g);
+            if (state->current_mode == MODE_ACCUMULATE) {
+                portENTER_CRITICAL(&lot_mux);
+                accumulate_load(state);
+                portEXIT_CRITICAL(&lot_mux);
             }
         } else {
             // Average weight not set or invalid
             state->item_count = 0;
             set_status(state, "Set Sample Wt");
         }
+    } else if (state->current_mode == MODE_CHECKWEIGH && state->is_stable) {
+        // Shown only; the decision is made on the weight (0 without a piece weight)
+        state->item_count = ScaleCore_CountItems(state->current_weight_g, state->average_item_weight_g);
     } else if (state->current_mode == MODE_WEIGHING) {
         state->item_count = 0; // No counting in weighing mode
     }
@@ -99,13 +404,23 @@ void ScaleLogic_Update(ScaleState_t *state, const LoadCellReading_t* reading) {
 
     // Update Status Message based on current state (if not already set by specific actions)
     if (state->current_mode != MODE_ERROR && state->current_mode != MODE_SET_SAMPLE) {
-         if (!state->is_stable) {
+         if (state->current_mode == MODE_CHECKWEIGH) {
+             // The result stays up until the next pack arrives
+             if (state->check.phase == CHECK_PHASE_MEASURING) {
+                 set_status(state, "Checking...");
+             } else {
+                 set_status(state, state->check.last_result == CHECK_RESULT_NONE ? "Ready (Check)"
+                                                                                 : Checkweigh_ResultName(state->check.last_result));
+             }
+         } else if (!state->is_stable) {
              set_status(state, "..."); // Indicate instability
          } else if (state->current_mode == MODE_COUNTING && state->average_item_weight_g < 0.001f) {
              set_status(state, "Set Sample Wt");
          }
           else if (state->current_mode == MODE_COUNTING) {
              set_status(state, "Stable (Count)");
+         } else if (state->current_mode == MODE_ACCUMULATE) {
+             set_status(state, state->lot_phase == LOT_PHASE_HOLD ? "Empty Pan" : "Stable (Accum)");
          } else {
              set_status(state, "Stable (Weigh)");
          }
@@ -127,7 +442,14 @@ void ScaleLogic_RequestSetSample(ScaleState_t *state) {
 
     if (state->is_stable && state->current_weight_g >= MIN_SAMPLE_WEIGHT_G) {
         state->average_item_weight_g = state->current_weight_g;
-        state->current_mode = MODE_COUNTING; // Switch to counting mode
+        if (state->lot_phase != LOT_PHASE_OFF) {
+            set_lot_phase(state, LOT_PHASE_HOLD); // The sample is not a load
+            state->current_mode = MODE_ACCUMULATE;
+        } else if (keep_checkweigh(state)) {
+            // Count bands follow the new piece weight
+        } else {
+            state->current_mode = MODE_COUNTING; // Switch to counting mode
+        }
         ESP_LOGI(TAG, "Sample weight set: %.3f g", state->average_item_weight_g);
         set_status(state, "Sample Set");
         ScaleLogic_SaveConfig(state); // Save the new average weight
@@ -150,9 +472,27 @@ void ScaleLogic_RequestSetSample(ScaleState_t *state) {
 void ScaleLogic_RequestToggleMode(ScaleState_t *state) {
     if (state->current_mode == MODE_ERROR) return; // Cannot change mode if overloaded
 
+    // Weighing -> Counting -> Accumulate -> Check (if the SKU has a band) -> Weighing
     if (state->current_mode == MODE_COUNTING) {
+        set_lot_phase(state, LOT_PHASE_HOLD); // Start with an empty pan
+        state->current_mode = MODE_ACCUMULATE;
+        ESP_LOGI(TAG, "Switched to Accumulate Mode (lot %lu, %ld items).",
+                 (unsigned long)state->lot.lot_id, (long)state->lot.total);
+        set_status(state, "Accum Mode");
+    } else if (state->current_mode == MODE_ACCUMULATE) {
+        set_lot_phase(state, LOT_PHASE_OFF); // The open lot is kept for the next time
+        if (start_checkweigh(state)) {
+            set_status(state, "Check Mode");
+        } else {
+            state->current_mode = MODE_WEIGHING;
+            state->item_count = 0; // Reset count when switching to weighing
+            ESP_LOGI(TAG, "Switched to Weighing Mode.");
+            set_status(state, "Weigh Mode");
+        }
+    } else if (state->current_mode == MODE_CHECKWEIGH) {
+        stop_checkweigh(state);
         state->current_mode = MODE_WEIGHING;
-        state->item_count = 0; // Reset count when switching to weighing
+        state->item_count = 0;
         ESP_LOGI(TAG, "Switched to Weighing Mode.");
         set_status(state, "Weigh Mode");
     } else if (state->current_mode == MODE_WEIGHING) {
@@ -167,9 +507,195 @@ void ScaleLogic_RequestToggleMode(ScaleState_t *state) {
                 .is_overload = false,
                 .raw_value = 0
              });
+        } else if (start_checkweigh(state)) {
+            set_status(state, "Check Mode"); // Weight band, no piece weight needed
         } else {
             ESP_LOGW(TAG, "Cannot switch to Counting Mode: Sample weight not set.");
             set_status(state, "Set Sample Wt");
         }
     }
 }
+
+void ScaleLogic_RequestClearSample(ScaleState_t *state) {
+    state->average_item_weight_g = 0.0f;
+    state->item_count = 0;
+    bool checking = keep_checkweigh(state); // Weight bands carry on
+    if (state->current_mode != MODE_ERROR && !checking) {
+        state->current_mode = MODE_WEIGHING;
+    }
+    if (state->lot_phase != LOT_PHASE_OFF) {
+        set_lot_phase(state, LOT_PHASE_OFF); // No counting without a piece weight
+    }
+    ScaleLogic_SaveConfig(state);
+    ESP_LOGI(TAG, "Sample weight cleared.");
+    set_status(state, "Sample Cleared");
+}
+
+bool ScaleLogic_SetItemWeight(ScaleState_t *state, float item_weight_g) {
+    if (item_weight_g < 0.001f) {
+        ESP_LOGW(TAG, "Rejected item weight %.4f g", item_weight_g);
+        return false;
+    }
+
+    state->average_item_weight_g = item_weight_g;
+    bool checking = keep_checkweigh(state); // Also picks up a product switch (SetProduct)
+    if (state->current_mode != MODE_ERROR && state->current_mode != MODE_ACCUMULATE && !checking) {
+        state->current_mode = MODE_COUNTING;
+    }
+    ESP_LOGI(TAG, "Item weight set remotely: %.3f g", item_weight_g);
+    set_status(state, "Item Wt Updated");
+    ScaleLogic_SaveConfig(state);
+    // Count is refreshed by the next sensor update
+    return true;
+}
+
+bool ScaleLogic_SetProduct(ScaleState_t *state, const char *sku, float item_weight_g) {
+    if (!sku || !sku_is_valid(sku) || item_weight_g < 0.001f) {
+        ESP_LOGW(TAG, "Rejected product switch (sku/item weight invalid)");
+        return false;
+    }
+
+    if (state->lot.loads > 0 && strncmp(state->lot.sku, sku, sizeof(state->lot.sku) - 1) != 0) {
+        ScaleLogic_RequestCloseLot(state); // A lot is one product
+    }
+    portENTER_CRITICAL(&lot_mux); // A first load copies the SKU into the lot
+    strncpy(state->sku, sku, sizeof(state->sku) - 1);
+    state->sku[sizeof(state->sku) - 1] = '\0';
+    portEXIT_CRITICAL(&lot_mux);
+    ESP_LOGI(TAG, "Product switched to %s", state->sku);
+    return ScaleLogic_SetItemWeight(state, item_weight_g); // Also persists the SKU
+}
+
+void ScaleLogic_RequestUndoLoad(ScaleState_t *state) {
+    int32_t undone = 0;
+    LotRecord_t lot;
+    portENTER_CRITICAL(&lot_mux);
+    if (state->current_mode == MODE_ACCUMULATE && state->lot_last_added != 0) {
+        undone = state->lot_last_added;
+        state->lot.total -= undone;
+        state->lot.loads--;
+        state->lot_last_added = 0;
+        if (state->lot_phase == LOT_PHASE_LOADED) {
+            state->lot_phase = LOT_PHASE_HOLD; // Not added again until it has been taken off
+        }
+        state->lot_changes++;
+    }
+    lot = state->lot;
+    portEXIT_CRITICAL(&lot_mux);
+
+    if (undone == 0) {
+        set_status(state, "Nothing To Undo");
+        return;
+    }
+    ESP_LOGI(TAG, "Load of %ld items undone, lot %lu at %ld items.", (long)undone,
+             (unsigned long)lot.lot_id, (long)lot.total);
+    set_status(state, "Load Undone");
+}
+
+bool ScaleLogic_RequestCloseLot(ScaleState_t *state) {
+    uint64_t closed_epoch_ms = hal_Time_UptimeToEpochMs(hal_System_GetTickMs());
+    bool empty = false, full = false;
+    LotRecord_t closed;
+    portENTER_CRITICAL(&lot_mux);
+    closed = state->lot;
+    if (state->lot.loads == 0) {
+        empty = true;
+    } else if (state->lots_unsent_count >= LOT_UNSENT_MAX) {
+        full = true;
+    } else {
+        closed.closed_epoch_ms = closed_epoch_ms;
+        state->lots_unsent[state->lots_unsent_count++] = closed;
+        memset(&state->lot, 0, sizeof(state->lot));
+        state->lot.lot_id = closed.lot_id + 1;
+        state->lot_last_added = 0;
+        if (state->lot_phase == LOT_PHASE_LOADED) {
+            state->lot_phase = LOT_PHASE_HOLD; // The last load belongs to the closed lot
+        }
+        state->lot_changes++;
+    }
+    portEXIT_CRITICAL(&lot_mux);
+
+    if (empty) {
+        set_status(state, "Lot Empty");
+        return false;
+    }
+    if (full) {
+        ESP_LOGW(TAG, "Cannot close lot %lu: %d closed lots not uploaded yet.",
+                 (unsigned long)closed.lot_id, LOT_UNSENT_MAX);
+        set_status(state, "Lots Unsent!");
+        return false;
+    }
+    ESP_LOGI(TAG, "Lot %lu closed: %ld items in %u loads.", (unsigned long)closed.lot_id,
+             (long)closed.total, closed.loads);
+    set_status(state, "Lot Closed");
+    return true;
+}
+
+bool ScaleLogic_PeekUnsentLot(const ScaleState_t *state, LotRecord_t *lot) {
+    bool found = false;
+    portENTER_CRITICAL(&lot_mux);
+    if (state->lots_unsent_count > 0) {
+        *lot = state->lots_unsent[0];
+        found = true;
+    }
+    portEXIT_CRITICAL(&lot_mux);
+    return found;
+}
+
+void ScaleLogic_MarkLotSent(ScaleState_t *state) {
+    portENTER_CRITICAL(&lot_mux);
+    if (state->lots_unsent_count > 0) {
+        state->lots_unsent_count--;
+        memmove(&state->lots_unsent[0], &state->lots_unsent[1], state->lots_unsent_count * sizeof(LotRecord_t));
+        state->lot_changes++;
+    }
+    portEXIT_CRITICAL(&lot_mux);
+}
+
+bool ScaleLogic_SetCheckTarget(ScaleState_t *state, const CheckTarget_t *target) {
+    float lower_g, upper_g;
+    // Count bands resolve against any piece weight; this only checks the numbers
+    if (!sku_is_valid(target->sku) || !Checkweigh_ResolveBand(target, 1.0f, &lower_g, &upper_g)) {
+        ESP_LOGW(TAG, "Rejected check target (sku/band invalid)");
+        return false;
+    }
+    if (!Checkweigh_SetTarget(target)) {
+        return false;
+    }
+    if (strncmp(target->sku, state->sku, sizeof(state->sku)) != 0) {
+        return true; // Used once that product is selected
+    }
+
+    if (!start_checkweigh(state)) {
+        stop_checkweigh(state); // Count band without a piece weight: stored until one is set
+        if (state->current_mode == MODE_CHECKWEIGH) {
+            state->current_mode = MODE_WEIGHING;
+        }
+        set_status(state, "Set Sample Wt");
+        return true;
+    }
+    if (state->lot_phase != LOT_PHASE_OFF) {
+        set_lot_phase(state, LOT_PHASE_OFF); // The open lot is kept for the next time
+    }
+    set_status(state, "Check Target Set");
+    return true;
+}
+
+void ScaleLogic_LoadCheckweigh(ScaleState_t *state) {
+    if (!Checkweigh_WasActive() || state->lot_phase != LOT_PHASE_OFF) {
+        return;
+    }
+    if (start_checkweigh(state)) {
+        set_status(state, "Ready (Check)");
+    }
+}
+
+const char *ScaleLogic_ModeName(ScaleMode_t mode) {
+    switch (mode) {
+        case MODE_WEIGHING:   return "WEIGHING";
+        case MODE_COUNTING:   return "COUNTING";
+        case MODE_ACCUMULATE: return "ACCUMULATE";
+        case MODE_CHECKWEIGH: return "CHECKWEIGH";
+        default:              return "ERROR";
+    }
+}
@@ -0,0 +1,85 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "scale_config.h"
+#include "scale_logic.h"
+#include "comms_manager.h"
+#include "app_tasks.h"
+#include "mem_report.h"
+#include "health_monitor.h"
+#include "hal_interfaces.h"
+#include "boot_timing.h"
+
+static const char *TAG = "COMMS_TASK";
+
+// Comms Task: Manages WiFi connection and sends data periodically
+void comms_task(void *pvParameters) {
+    ScaleState_t *state = (ScaleState_t *)pvParameters;
+     ESP_LOGI(TAG, "Comms Task Started on core %d.", (int)xPortGetCoreID());
+
+    // Wi-Fi bring-up runs here, off the boot path
+    hal_Wifi_Init();
+    hal_Time_Init(SNTP_SERVER);
+    BootTiming_Mark(BOOT_PHASE_WIFI_INIT);
+    CommsManager_Init();
+    bool boot_timing_logged = false;
+
+    uint64_t last_mem_report_ms = hal_System_GetTickMs();
+    uint64_t last_health_report_ms = hal_System_GetTickMs();
+    HealthRecord_t health; // Baseline sample so the first report covers a full interval
+    HealthMonitor_Sample(&health);
+
+    while (1) {
+        // Run the communications state machine / periodic checks
+        CommsManager_RunPeriodic(); // Handles connection logic
+
+        // If connected, try sending data
+        if (CommsManager_GetCurrentState() == COMMS_STATE_CONNECTED) {
+            if (!boot_timing_logged) {
+                BootTiming_Mark(BOOT_PHASE_WIFI_CONNECTED);
+                BootTiming_Log();
+                boot_timing_logged = true;
+            }
+
+            // --- Critical Section (Example - Read Only) ---
+            // xSemaphoreTake(state->mutex, portMAX_DELAY);
+            CommsManager_SendData(state);
+            // xSemaphoreGive(state->mutex);
+            // --- End Critical Section ---
+
+            // Apply commands from the upload reply / MQTT command topic (acked in the next upload)
+            CommsManager_ApplyPendingCommands(state);
+
+            if (hal_System_GetTickMs() - last_health_report_ms >= HEALTH_REPORT_INTERVAL_MS) {
+                HealthMonitor_Sample(&health);
+                CommsManager_SendHealth(&health);
+                last_health_report_ms = hal_System_GetTickMs();
+            }
+
+            // Closed accumulation lots, oldest first; kept (in NVS) until the backend has them
+            LotRecord_t lot;
+            while (ScaleLogic_PeekUnsentLot(state, &lot) && CommsManager_SendLot(&lot)) {
+                ScaleLogic_MarkLotSent(state);
+            }
+        }
+
+        // Persist a new tare (applied asynchronously by the sensor task)
+        ScaleLogic_SaveConfigIfTareChanged(state);
+
+        // Sensor period stats, so upload load vs. acquisition jitter can be compared
+        SensorTask_LogTimingStats();
+
+        if (hal_System_GetTickMs() - last_mem_report_ms >= MEM_REPORT_INTERVAL_MS) {
+            MemReport_Log();
+            last_mem_report_ms = hal_System_GetTickMs();
+        }
+
+#if JITTER_STRESS_TEST
+        // Stress mode: upload back-to-back to load the network core as hard as possible
+        vTaskDelay(1);
+#else
+        vTaskDelay(pdMS_TO_TICKS(CommsManager_GetReportIntervalMs())); // Run less frequently
+#endif
+    }
+}
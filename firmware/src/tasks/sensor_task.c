@@ -0,0 +1,138 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "scale_config.h"
+#include "hal_interfaces.h"
+#include "scale_logic.h"
+#include "app_tasks.h"
+#include "boot_timing.h"
+#include "dlog.h"
+
+static const char *TAG = "SENSOR_TASK";
+
+// Period statistics, written by the sensor task and read by other tasks
+static SensorTimingStats_t timing_stats;
+static portMUX_TYPE timing_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void reset_stats_locked(void) {
+    timing_stats = (SensorTimingStats_t){ .period_min_us = UINT32_MAX, .decision_latency_min_ms = UINT32_MAX };
+}
+
+static void record_period(uint32_t period_us) {
+    const uint32_t nominal_us = SENSOR_TASK_INTERVAL_MS * 1000U;
+    uint32_t jitter_us = (period_us > nominal_us) ? (period_us - nominal_us) : (nominal_us - period_us);
+
+    portENTER_CRITICAL(&timing_mux);
+    timing_stats.periods++;
+    timing_stats.period_sum_us += period_us;
+    if (period_us < timing_stats.period_min_us) timing_stats.period_min_us = period_us;
+    if (period_us > timing_stats.period_max_us) timing_stats.period_max_us = period_us;
+    if (jitter_us > timing_stats.jitter_max_us) timing_stats.jitter_max_us = jitter_us;
+    if (period_us > nominal_us + SENSOR_DEADLINE_SLACK_US) timing_stats.deadline_misses++;
+    portEXIT_CRITICAL(&timing_mux);
+}
+
+static void record_decision(const CheckweighState_t *check) {
+    uint32_t latency_ms = check->last_latency_ms;
+
+    portENTER_CRITICAL(&timing_mux);
+    timing_stats.decisions++;
+    if (check->last_result != CHECK_RESULT_PASS) timing_stats.decisions_rejected++;
+    if (check->last_early) timing_stats.decisions_early++;
+    timing_stats.decision_latency_sum_ms += latency_ms;
+    if (latency_ms < timing_stats.decision_latency_min_ms) timing_stats.decision_latency_min_ms = latency_ms;
+    if (latency_ms > timing_stats.decision_latency_max_ms) timing_stats.decision_latency_max_ms = latency_ms;
+    portEXIT_CRITICAL(&timing_mux);
+}
+
+void SensorTask_GetTimingStats(SensorTimingStats_t *out) {
+    portENTER_CRITICAL(&timing_mux);
+    *out = timing_stats;
+    portEXIT_CRITICAL(&timing_mux);
+}
+
+void SensorTask_ResetTimingStats(void) {
+    portENTER_CRITICAL(&timing_mux);
+    reset_stats_locked();
+    portEXIT_CRITICAL(&timing_mux);
+}
+
+void SensorTask_LogTimingStats(void) {
+    SensorTimingStats_t stats;
+    SensorTask_GetTimingStats(&stats);
+    if (stats.periods == 0) return;
+    ESP_LOGI(TAG, "Sensor period over %lu samples: min %lu us, mean %llu us, max %lu us, max jitter %lu us, misses %lu",
+             (unsigned long)stats.periods, (unsigned long)stats.period_min_us,
+             (unsigned long long)(stats.period_sum_us / stats.periods), (unsigned long)stats.period_max_us,
+             (unsigned long)stats.jitter_max_us, (unsigned long)stats.deadline_misses);
+    if (stats.decisions > 0) {
+        ESP_LOGI(TAG, "Check decisions: %lu (%lu rejected, %lu before stability), latency min %lu ms, mean %llu ms, max %lu ms",
+                 (unsigned long)stats.decisions, (unsigned long)stats.decisions_rejected,
+                 (unsigned long)stats.decisions_early, (unsigned long)stats.decision_latency_min_ms,
+                 (unsigned long long)(stats.decision_latency_sum_ms / stats.decisions),
+                 (unsigned long)stats.decision_latency_max_ms);
+    }
+}
+
+// Sensor Task: Reads load cell and updates shared state
+// Runs alone on the acquisition core. Released on an absolute schedule
+// (vTaskDelayUntil) so read/processing time does not accumulate as drift.
+void sensor_task(void *pvParameters) {
+    ScaleState_t *state = (ScaleState_t *)pvParameters;
+    LoadCellReading_t current_reading;
+    ESP_LOGI(TAG, "Sensor Task Started on core %d.", (int)xPortGetCoreID());
+
+    SensorTask_ResetTimingStats();
+    TickType_t last_wake = xTaskGetTickCount();
+    uint64_t last_release_us = 0;
+
+    while (1) {
+        uint64_t release_us = hal_System_GetTimeUs();
+        if (last_release_us != 0) {
+            record_period((uint32_t)(release_us - last_release_us));
+        }
+        last_release_us = release_us;
+
+        // Auto-zero must never absorb part of a piece: a count of zero stays zero
+        hal_LoadCell_SetZeroTrackingLimit(state->average_item_weight_g * 0.5f);
+
+        // Read from HAL
+        current_reading = hal_LoadCell_Read(MAX_WEIGHT_CAPACITY_G,
+                                            STABLE_READING_THRESHOLD_G,
+                                            STABLE_READING_COUNT);
+
+        // Periods without a new conversion repeat the last reading; the logic
+        // only sees fresh ones, so check confirmations count each conversion once.
+        if (current_reading.is_fresh) {
+            // --- Critical Section (Example using simple approach, consider mutex for complex state) ---
+            // If using mutex: xSemaphoreTake(state->mutex, portMAX_DELAY);
+            bool was_stable = state->is_stable;
+            uint32_t decisions = state->check.decisions;
+            ScaleLogic_Update(state, &current_reading);
+            state->sampled_ms = (uint32_t)hal_System_GetTickMs();
+            if (state->is_stable && !was_stable) {
+                state->stable_since_ms = state->sampled_ms;
+            }
+            // If using mutex: xSemaphoreGive(state->mutex);
+            // --- End Critical Section ---
+
+            // Per-sample trace: a ring write here, formatted later by the log task
+            // (enable with esp_log_level_set("SENSOR_TASK", ESP_LOG_DEBUG))
+            DLOG(DLOG_SENSOR_SAMPLE, current_reading.raw_value, state->current_weight_g, state->is_stable);
+            if (state->check.decisions != decisions) {
+                record_decision(&state->check);
+                DLOG(DLOG_CHECK_DECISION, (int)state->check.last_result, state->check.last_weight_g,
+                     state->check.last_latency_ms, (int)state->check.last_early);
+            }
+
+            // Only a real conversion counts, not the zero reported before one
+            BootTiming_Mark(BOOT_PHASE_FIRST_READING);
+            if (state->is_stable) {
+                BootTiming_Mark(BOOT_PHASE_FIRST_STABLE);
+            }
+        }
+
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(SENSOR_TASK_INTERVAL_MS));
+    }
+}
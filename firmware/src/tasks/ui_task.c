@@ -0,0 +1,56 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "scale_config.h"
+#include "hal_interfaces.h"
+#include "scale_logic.h"
+#include "ui_manager.h"
+#include "app_tasks.h"
+#include "boot_timing.h"
+
+static const char *TAG = "UI_TASK";
+
+// UI Task: Handles button input and updates the display
+void ui_task(void *pvParameters) {
+    ScaleState_t *state = (ScaleState_t *)pvParameters;
+    ButtonEventRecord_t record;
+    ESP_LOGI(TAG, "UI Task Started on core %d.", (int)xPortGetCoreID());
+
+    // Display bring-up runs here, off the boot path
+    hal_Display_Init();
+    UIManager_Init(state);
+    BootTiming_Mark(BOOT_PHASE_DISPLAY);
+
+    TickType_t last_refresh = xTaskGetTickCount();
+    while (1) {
+        // Block on button input until the next display refresh is due
+        TickType_t elapsed = xTaskGetTickCount() - last_refresh;
+        TickType_t interval = pdMS_TO_TICKS(UI_TASK_INTERVAL_MS);
+        uint32_t wait_ms = elapsed < interval ? (uint32_t)((interval - elapsed) * portTICK_PERIOD_MS) : 0;
+
+        bool handled = false;
+        if (hal_Buttons_WaitEvent(&record, wait_ms)) {
+            ESP_LOGD(TAG, "Button Event: %d (t=%lu ms)", record.event, (unsigned long)record.timestamp_ms);
+            // --- Critical Section (Example) ---
+            // xSemaphoreTake(state->mutex, portMAX_DELAY);
+            UIManager_HandleInput(state, record.event); // HandleInput modifies state
+            // xSemaphoreGive(state->mutex);
+            // --- End Critical Section ---
+            handled = true;
+        }
+
+        // Update the display based on the current state (right away after input)
+        if (handled || xTaskGetTickCount() - last_refresh >= interval) {
+            // --- Critical Section (Example - Read Only) ---
+            // xSemaphoreTake(state->mutex, portMAX_DELAY);
+            UIManager_UpdateDisplay(state);
+            // xSemaphoreGive(state->mutex);
+            // --- End Critical Section ---
+            last_refresh = xTaskGetTickCount();
+        }
+
+        // Persist lot additions / undo / close (made by the sensor task and buttons)
+        ScaleLogic_SaveLotIfChanged(state);
+    }
+}
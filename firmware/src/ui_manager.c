@@ -42,6 +42,12 @@ void UIManager_UpdateDisplay(const ScaleState_t *state) {
             snprintf(buffer, sizeof(buffer), "Count: %ld", state->item_count);
             hal_Display_Print(buffer);
          }
+    } else if (state->current_mode == MODE_ACCUMULATE) {
+        snprintf(buffer, sizeof(buffer), "Lot: %ld (%u)", (long)state->lot.total, state->lot.loads);
+        hal_Display_Print(buffer);
+    } else if (state->current_mode == MODE_CHECKWEIGH) {
+        snprintf(buffer, sizeof(buffer), "Check: %s", Checkweigh_ResultName(state->check.last_result));
+        hal_Display_Print(buffer);
     } else if (state->current_mode == MODE_WEIGHING) {
         hal_Display_Print("Mode: Weigh");
     } else if (state->current_mode == MODE_ERROR) {
@@ -64,6 +70,12 @@ void UIManager_UpdateDisplay(const ScaleState_t *state) {
     if (state->current_mode == MODE_COUNTING && state->average_item_weight_g > 0.001f) {
          snprintf(buffer, sizeof(buffer), "Avg: %.3fg", state->average_item_weight_g);
          hal_Display_Print(buffer);
+    } else if (state->current_mode == MODE_ACCUMULATE) {
+         snprintf(buffer, sizeof(buffer), "Load: %ld", (long)state->item_count);
+         hal_Display_Print(buffer);
+    } else if (state->current_mode == MODE_CHECKWEIGH) {
+         snprintf(buffer, sizeof(buffer), "%.1f-%.1fg", state->check.lower_g, state->check.upper_g);
+         hal_Display_Print(buffer);
     } else {
          // Optionally show WiFi status from CommsManager state? Requires access.
          // CommsState_t comms_state = CommsManager_GetCurrentState(); // Need getter
@@ -79,25 +91,39 @@ void UIManager_UpdateDisplay(const ScaleState_t *state) {
 
 void UIManager_HandleInput(ScaleState_t *state, ButtonEvent_t event) {
     switch (event) {
-        case BUTTON_TARE_PRESS:
+        case BUTTON_TARE_SHORT:
             ESP_LOGI(TAG, "Tare button pressed.");
             ScaleLogic_RequestTare(state);
             break;
 
-        case BUTTON_SAMPLE_PRESS:
+        case BUTTON_SAMPLE_SHORT:
              ESP_LOGI(TAG, "Sample button pressed.");
             ScaleLogic_RequestSetSample(state);
             break;
 
-        case BUTTON_MODE_PRESS:
+        case BUTTON_MODE_SHORT:
             ESP_LOGI(TAG, "Mode button pressed.");
             ScaleLogic_RequestToggleMode(state);
             break;
 
-        // Handle HOLD events if implemented in HAL and needed
-        // case BUTTON_TARE_HOLD:
-        //    // e.g., Enter calibration mode?
-        //    break;
+        case BUTTON_SAMPLE_HOLD:
+            ESP_LOGI(TAG, "Sample button held.");
+            ScaleLogic_RequestClearSample(state);
+            break;
+
+        case BUTTON_TARE_HOLD:
+            ESP_LOGI(TAG, "Tare button held.");
+            ScaleLogic_RequestUndoLoad(state); // Accumulate mode: take the last load back out
+            break;
+
+        case BUTTON_MODE_HOLD:
+            ESP_LOGI(TAG, "Mode button held.");
+            if (state->current_mode == MODE_ACCUMULATE) {
+                ScaleLogic_RequestCloseLot(state);
+            }
+            break;
+
+        // Raw press/release edges are not used: a press ends in either SHORT or HOLD
 
         case BUTTON_NONE:
         default:
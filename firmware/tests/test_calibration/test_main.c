@@ -0,0 +1,173 @@
+#include "unity.h"
+#include "calibration.h" // Include the header for the module being tested
+#include "hal_interfaces.h"
+#include <string.h>      // For memcpy
+
+// --- Mock HAL Functions ---
+// The mock load cell reports a scalar-calibrated weight; the installed
+// linearization table is evaluated with the same formula the HAL uses.
+static float mock_linear_weight;
+static const LoadCellLinearization_t *mock_table;
+// NVS: one blob per key (cal points, corners)
+typedef struct {
+    char key[16];
+    unsigned char data[256];
+    size_t size; // 0 = not stored
+} MockBlob_t;
+static MockBlob_t mock_blobs[2];
+
+static MockBlob_t *find_blob(const char *key, bool create) {
+    for (size_t i = 0; i < sizeof(mock_blobs) / sizeof(mock_blobs[0]); i++) {
+        if (mock_blobs[i].size > 0 && strcmp(mock_blobs[i].key, key) == 0) return &mock_blobs[i];
+    }
+    for (size_t i = 0; create && i < sizeof(mock_blobs) / sizeof(mock_blobs[0]); i++) {
+        if (mock_blobs[i].size == 0) {
+            strncpy(mock_blobs[i].key, key, sizeof(mock_blobs[i].key) - 1);
+            return &mock_blobs[i];
+        }
+    }
+    return NULL;
+}
+
+float hal_LoadCell_GetLinearWeight(void) { return mock_linear_weight; }
+float hal_LoadCell_GetCalibrationFactor(void) { return 425.0f; }
+void hal_LoadCell_SetLinearization(const LoadCellLinearization_t *table) { mock_table = table; }
+// Channel 0 carries the corner captures; other channels read their offset
+static long mock_raw[LOADCELL_NUM_CHANNELS];
+static float mock_correction[LOADCELL_NUM_CHANNELS];
+int hal_LoadCell_GetChannelRaw(long *raw, int max_channels) {
+    memcpy(raw, mock_raw, sizeof(long) * max_channels);
+    return max_channels;
+}
+void hal_LoadCell_GetChannelOffsets(float *offsets, int max_channels) {
+    for (int ch = 0; ch < max_channels; ch++) offsets[ch] = 1000.0f;
+}
+bool hal_LoadCell_SetChannelCorrection(int channel, float correction) { mock_correction[channel] = correction; return true; }
+float hal_LoadCell_GetChannelCorrection(int channel) { return mock_correction[channel]; }
+bool hal_Storage_Save_Blob(const char* ns, const char* key, const void* data, size_t size) {
+    MockBlob_t *blob = find_blob(key, true);
+    TEST_ASSERT_NOT_NULL(blob);
+    TEST_ASSERT_TRUE(size > 0 && size <= sizeof(blob->data));
+    memcpy(blob->data, data, size);
+    blob->size = size;
+    return true;
+}
+bool hal_Storage_Load_Blob(const char* ns, const char* key, void* data, size_t* size) {
+    MockBlob_t *blob = find_blob(key, false);
+    if (!blob) return false;             // Mock not found
+    if (blob->size > *size) return false; // Like nvs_get_blob: ESP_ERR_NVS_INVALID_LENGTH
+    memcpy(data, blob->data, blob->size);
+    *size = blob->size;
+    return true;
+}
+bool hal_Storage_Erase_Key(const char* ns, const char* key) {
+    MockBlob_t *blob = find_blob(key, false);
+    if (blob) blob->size = 0;
+    return true;
+}
+
+static float corrected(float linear_g) {
+    float x = linear_g * mock_table->inv_step_g;
+    int i = (int)x;
+    if (i < 0) i = 0;
+    if (i >= mock_table->segments) i = mock_table->segments - 1;
+    return mock_table->base[i] + (x - (float)i) * mock_table->delta[i];
+}
+
+static void capture(float reads_g, float reference_g) {
+    mock_linear_weight = reads_g;
+    TEST_ASSERT_TRUE(Calibration_AddPoint(reference_g));
+}
+
+// --- Test Setup/Teardown ---
+void setUp(void) {
+    mock_table = NULL;
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        mock_raw[ch] = 1000;
+        mock_correction[ch] = 1.0f;
+    }
+    memset(mock_blobs, 0, sizeof(mock_blobs));
+    Calibration_Init();
+}
+
+void tearDown(void) {
+}
+
+// --- Test Cases ---
+void test_Calibration_PiecewiseCorrection(void) {
+    // Cell reads 1% low at 2 kg and 3% low at 5 kg
+    capture(4850.0f, 5000.0f);
+    capture(1980.0f, 2000.0f);
+    TEST_ASSERT_TRUE(Calibration_Save());
+    TEST_ASSERT_NOT_NULL(mock_table);
+    TEST_ASSERT_EQUAL_INT(2, Calibration_GetPointCount());
+
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 0.0f, corrected(0.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 2000.0f, corrected(1980.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 5000.0f, corrected(4850.0f));
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 1000.0f, corrected(990.0f)); // First segment passes through the origin
+}
+
+void test_Calibration_ReloadsFromStorage(void) {
+    capture(990.0f, 1000.0f);
+    TEST_ASSERT_TRUE(Calibration_Save());
+
+    mock_table = NULL;
+    Calibration_Init(); // Reboot
+    TEST_ASSERT_NOT_NULL(mock_table);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 1000.0f, corrected(990.0f));
+}
+
+void test_Calibration_RejectsBadPoints(void) {
+    mock_linear_weight = 1500.0f;
+    TEST_ASSERT_FALSE(Calibration_AddPoint(2000.0f)); // Beyond the plausible correction
+    TEST_ASSERT_FALSE(Calibration_Save());            // Nothing captured
+    TEST_ASSERT_NULL(mock_table);
+
+    capture(1000.0f, 1000.0f);
+    capture(1500.0f, 1520.0f);
+    capture(1600.0f, 1510.0f);                        // Heavier reading, lighter reference
+    TEST_ASSERT_FALSE(Calibration_Save());            // Not monotonic
+}
+
+void test_Calibration_Clear(void) {
+    capture(990.0f, 1000.0f);
+    TEST_ASSERT_TRUE(Calibration_Save());
+    Calibration_Clear();
+    TEST_ASSERT_NULL(mock_table);
+    TEST_ASSERT_EQUAL_INT(0, Calibration_GetPointCount());
+}
+
+void test_Calibration_Corners(void) {
+    TEST_ASSERT_FALSE(Calibration_AddCorner(0));                     // Empty platform
+    TEST_ASSERT_FALSE(Calibration_AddCorner(LOADCELL_NUM_CHANNELS)); // No such corner
+    TEST_ASSERT_FALSE(Calibration_SaveCorners());                    // Nothing captured
+
+    for (int corner = 0; corner < LOADCELL_NUM_CHANNELS; corner++) {
+        mock_raw[corner] = 1000 + 425 * 500; // 500 g on this corner
+        TEST_ASSERT_TRUE(Calibration_AddCorner(corner));
+        mock_raw[corner] = 1000;
+    }
+    TEST_ASSERT_TRUE(Calibration_SaveCorners());
+    for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+        TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.0f, mock_correction[ch]); // Identical cells
+        mock_correction[ch] = 0.0f;
+    }
+
+    Calibration_Init(); // Reboot restores the stored corrections
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 1.0f, mock_correction[0]);
+}
+
+// --- Main Test Runner ---
+// See test_scale_logic/test_main.c; if running standalone:
+/*
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_Calibration_PiecewiseCorrection);
+    RUN_TEST(test_Calibration_ReloadsFromStorage);
+    RUN_TEST(test_Calibration_RejectsBadPoints);
+    RUN_TEST(test_Calibration_Clear);
+    RUN_TEST(test_Calibration_Corners);
+    return UNITY_END();
+}
+*/
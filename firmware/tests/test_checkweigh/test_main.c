@@ -0,0 +1,143 @@
+#include "unity.h"
+#include "checkweigh.h" // Include the header for the module being tested
+#include "hal_interfaces.h"
+#include <string.h>      // For memset, memcpy
+#include <stdio.h>       // For snprintf
+
+// --- Mock HAL Functions ---
+static unsigned char mock_blob[512];
+static size_t mock_blob_size;
+
+bool hal_Storage_Save_Blob(const char* ns, const char* key, const void* data, size_t size) {
+    memcpy(mock_blob, data, size);
+    mock_blob_size = size;
+    return true;
+}
+bool hal_Storage_Load_Blob(const char* ns, const char* key, void* data, size_t* size) {
+    if (mock_blob_size == 0) return false; // Mock not found
+    memcpy(data, mock_blob, mock_blob_size);
+    *size = mock_blob_size;
+    return true;
+}
+
+static CheckweighState_t check;
+static uint32_t now_ms;
+
+// One sensor period (50 ms) with the given reading
+static CheckResult_t feed(float weight_g, bool stable) {
+    now_ms += 50;
+    return Checkweigh_Process(&check, weight_g, false, stable, now_ms);
+}
+
+// Empties the pan until the next pack is armed
+static void clear_pan(void) {
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_EQUAL(CHECK_RESULT_NONE, feed(0.0f, true));
+    }
+    TEST_ASSERT_EQUAL(CHECK_PHASE_EMPTY, check.phase);
+}
+
+// --- Test Setup/Teardown ---
+void setUp(void) {
+    memset(&check, 0, sizeof(check));
+    now_ms = 1000;
+    mock_blob_size = 0;
+    Checkweigh_LoadTargets();
+    Checkweigh_Arm(&check, 95.0f, 105.0f); // 100 g -5/+5
+}
+
+void tearDown(void) {
+}
+
+// --- Test Cases ---
+void test_Checkweigh_ClearResultsBeforeStability(void) {
+    clear_pan();
+    TEST_ASSERT_EQUAL(CHECK_RESULT_NONE, feed(80.0f, false));
+    TEST_ASSERT_EQUAL(CHECK_RESULT_UNDER, feed(80.0f, false)); // 15 g short: clear on the second sample
+    TEST_ASSERT_TRUE(check.last_early);
+    TEST_ASSERT_EQUAL_UINT32(50, check.last_latency_ms);
+    TEST_ASSERT_EQUAL(CHECK_RESULT_NONE, feed(80.0f, true)); // Judged once per pack
+
+    clear_pan();
+    // Pack drops on with an overshoot; the stability window would need 5 quiet samples after 101 g
+    TEST_ASSERT_EQUAL(CHECK_RESULT_NONE, feed(112.0f, false));
+    TEST_ASSERT_EQUAL(CHECK_RESULT_NONE, feed(98.0f, false));
+    TEST_ASSERT_EQUAL(CHECK_RESULT_NONE, feed(101.0f, false));
+    TEST_ASSERT_EQUAL(CHECK_RESULT_PASS, feed(100.0f, false));
+    TEST_ASSERT_EQUAL_UINT32(150, check.last_latency_ms);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, 100.0f, check.last_weight_g);
+
+    clear_pan();
+    TEST_ASSERT_EQUAL(CHECK_RESULT_NONE, feed(130.0f, false));
+    TEST_ASSERT_EQUAL(CHECK_RESULT_OVER, feed(130.0f, false));
+    TEST_ASSERT_EQUAL_UINT32(1, check.results[CHECK_RESULT_PASS]);
+    TEST_ASSERT_EQUAL_UINT32(3, check.decisions);
+}
+
+void test_Checkweigh_NearLimitWaitsForStability(void) {
+    clear_pan();
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL(CHECK_RESULT_NONE, feed(104.8f, false)); // Inside the band by less than the hysteresis
+    }
+    TEST_ASSERT_EQUAL(CHECK_PHASE_MEASURING, check.phase);
+    TEST_ASSERT_EQUAL(CHECK_RESULT_PASS, feed(104.8f, true));
+    TEST_ASSERT_FALSE(check.last_early);
+    TEST_ASSERT_EQUAL_UINT32(500, check.last_latency_ms);
+}
+
+void test_Checkweigh_UndecidedAndOverload(void) {
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_EQUAL(CHECK_RESULT_NONE, feed(60.0f, true)); // On the pan when armed: not judged
+    }
+    clear_pan();
+
+    TEST_ASSERT_EQUAL(CHECK_RESULT_NONE, feed(100.0f, false));
+    TEST_ASSERT_EQUAL(CHECK_RESULT_NONE, feed(0.0f, false));
+    TEST_ASSERT_EQUAL(CHECK_RESULT_UNDECIDED, feed(0.0f, false)); // Taken off before the result was clear
+    TEST_ASSERT_EQUAL(CHECK_PHASE_EMPTY, check.phase);
+
+    now_ms += 50;
+    TEST_ASSERT_EQUAL(CHECK_RESULT_OVER, Checkweigh_Process(&check, 6000.0f, true, false, now_ms));
+    TEST_ASSERT_EQUAL_UINT32(0, check.last_latency_ms);
+}
+
+void test_Checkweigh_CountBandAndTargets(void) {
+    CheckTarget_t target = { .sku = "SKU-1", .target = 10.0f, .under = 0.0f, .over = 1.0f, .unit = CHECK_UNIT_COUNT };
+    float lower_g, upper_g;
+    TEST_ASSERT_TRUE(Checkweigh_ResolveBand(&target, 2.5f, &lower_g, &upper_g));
+    TEST_ASSERT_EQUAL_FLOAT(23.75f, lower_g); // 9.5 pieces still count as 10
+    TEST_ASSERT_EQUAL_FLOAT(28.75f, upper_g);
+    TEST_ASSERT_FALSE(Checkweigh_ResolveBand(&target, 0.0f, &lower_g, &upper_g)); // No piece weight
+    target.under = 10.0f;
+    TEST_ASSERT_FALSE(Checkweigh_ResolveBand(&target, 2.5f, &lower_g, &upper_g));
+
+    CheckTarget_t found;
+    target.under = 0.0f;
+    for (int i = 0; i <= CHECK_MAX_TARGETS; i++) {
+        snprintf(target.sku, sizeof(target.sku), "SKU-%d", i + 1);
+        target.target = 10.0f + (float)i;
+        TEST_ASSERT_TRUE(Checkweigh_SetTarget(&target));
+    }
+    TEST_ASSERT_FALSE(Checkweigh_FindTarget("SKU-1", &found)); // Least recently set was dropped
+    TEST_ASSERT_FALSE(Checkweigh_FindTarget("", &found));
+
+    Checkweigh_SaveActive(true);
+    Checkweigh_LoadTargets(); // Reboot
+    TEST_ASSERT_TRUE(Checkweigh_WasActive());
+    TEST_ASSERT_TRUE(Checkweigh_FindTarget("SKU-2", &found));
+    TEST_ASSERT_EQUAL_FLOAT(11.0f, found.target);
+    TEST_ASSERT_EQUAL(CHECK_UNIT_COUNT, found.unit);
+}
+
+// --- Main Test Runner ---
+// See test_scale_logic/test_main.c; if running standalone:
+/*
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_Checkweigh_ClearResultsBeforeStability);
+    RUN_TEST(test_Checkweigh_NearLimitWaitsForStability);
+    RUN_TEST(test_Checkweigh_UndecidedAndOverload);
+    RUN_TEST(test_Checkweigh_CountBandAndTargets);
+    return UNITY_END();
+}
+*/
@@ -0,0 +1,127 @@
+#include "unity.h"
+#include "diag_trace.h" // Include the header for the module being tested
+#include "hal_interfaces.h"
+#include <string.h>
+
+// --- Mock HAL Functions ---
+// Only the block encoder is exercised here; the trace task never runs.
+uint64_t hal_System_GetTickMs(void) { return 0; }
+void hal_LoadCell_SetSampleHook(hal_LoadCell_SampleHook_t hook) { (void)hook; }
+int hal_Wifi_UdpOpen(const char* host, uint16_t port) { return -1; }
+int hal_Wifi_UdpSend(int handle, const void* data, size_t length) { return (int)length; }
+void hal_Wifi_UdpClose(int handle) { (void)handle; }
+
+static uint8_t buf[TRACE_BLOCK_MAX_BYTES];
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_varint(const uint8_t **p) {
+    uint32_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+        uint8_t byte = *(*p)++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// --- Test Setup/Teardown ---
+void setUp(void) {
+    memset(buf, 0, sizeof(buf));
+}
+
+void tearDown(void) {
+}
+
+// --- Test Cases ---
+void test_DiagTrace_BlockRoundTrip(void) {
+    DiagTraceSample_t samples[3];
+    const int32_t values[3] = { 8388607, 8388600, -8388608 }; // 24-bit extremes
+    for (int i = 0; i < 3; i++) {
+        samples[i].t_ms = 1000 + 50 * i;
+        for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+            samples[i].raw[ch] = values[i] - ch;
+        }
+    }
+
+    DiagTraceBlock_t block;
+    DiagTrace_BlockBegin(&block, buf, sizeof(buf), 7, 123, 4);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(DiagTrace_BlockAdd(&block, &samples[i]));
+    }
+    size_t len = DiagTrace_BlockEnd(&block);
+
+    TEST_ASSERT_EQUAL_HEX16(DIAG_TRACE_MAGIC, get_u16(buf));
+    TEST_ASSERT_EQUAL_UINT8(DIAG_TRACE_VERSION, buf[2]);
+    TEST_ASSERT_EQUAL_UINT8(LOADCELL_NUM_CHANNELS, buf[3]);
+    TEST_ASSERT_EQUAL_UINT32(7, get_u32(buf + 4));
+    TEST_ASSERT_EQUAL_UINT32(123, get_u32(buf + 8));
+    TEST_ASSERT_EQUAL_UINT32(4, get_u32(buf + 12));
+    TEST_ASSERT_EQUAL_UINT32(1000, get_u32(buf + 16));
+    TEST_ASSERT_EQUAL_UINT16(3, get_u16(buf + 20));
+    TEST_ASSERT_EQUAL_UINT16(len - DIAG_TRACE_HEADER_BYTES, get_u16(buf + 22));
+
+    const uint8_t *p = buf + DIAG_TRACE_HEADER_BYTES;
+    uint32_t t_ms = get_u32(buf + 16);
+    int32_t prev[LOADCELL_NUM_CHANNELS] = {0};
+    for (int i = 0; i < 3; i++) {
+        t_ms += get_varint(&p);
+        TEST_ASSERT_EQUAL_UINT32(samples[i].t_ms, t_ms);
+        for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+            prev[ch] = (int32_t)((uint32_t)prev[ch] + (uint32_t)unzigzag(get_varint(&p)));
+            TEST_ASSERT_EQUAL_INT32(samples[i].raw[ch], prev[ch]);
+        }
+    }
+    TEST_ASSERT_EQUAL_PTR(buf + len, p);
+}
+
+void test_DiagTrace_SmallDeltasStayCompact(void) {
+    DiagTraceBlock_t block;
+    DiagTraceSample_t sample = { .t_ms = 0 };
+    DiagTrace_BlockBegin(&block, buf, sizeof(buf), 0, 0, 0);
+    for (int i = 0; i < 10; i++) {
+        sample.t_ms = 50U * i;
+        for (int ch = 0; ch < LOADCELL_NUM_CHANNELS; ch++) {
+            sample.raw[ch] = 100000 + ((i & 1) ? 20 : -20); // Noise around a settled load
+        }
+        TEST_ASSERT_TRUE(DiagTrace_BlockAdd(&block, &sample));
+    }
+    size_t len = DiagTrace_BlockEnd(&block);
+    // First sample carries the absolute value (3 bytes); after that 1 byte per delta
+    TEST_ASSERT_EQUAL_UINT32(DIAG_TRACE_HEADER_BYTES + 1 + 3 * LOADCELL_NUM_CHANNELS + 9 * (1 + LOADCELL_NUM_CHANNELS), len);
+}
+
+void test_DiagTrace_BlockFull(void) {
+    DiagTraceBlock_t block;
+    DiagTraceSample_t sample = { .t_ms = 0 };
+    uint8_t small[DIAG_TRACE_HEADER_BYTES + 2 * DIAG_TRACE_SAMPLE_MAX_BYTES];
+    DiagTrace_BlockBegin(&block, small, sizeof(small), 0, 0, 0);
+    int added = 0;
+    while (DiagTrace_BlockAdd(&block, &sample)) {
+        added++;
+    }
+    // Capacity is judged on the worst case, so a full block never overruns the buffer
+    TEST_ASSERT_TRUE(added >= 2);
+    TEST_ASSERT_TRUE(DiagTrace_BlockEnd(&block) <= sizeof(small));
+}
+
+// --- Main Test Runner ---
+// See test_scale_logic/test_main.c; if running standalone:
+/*
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_DiagTrace_BlockRoundTrip);
+    RUN_TEST(test_DiagTrace_SmallDeltasStayCompact);
+    RUN_TEST(test_DiagTrace_BlockFull);
+    return UNITY_END();
+}
+*/
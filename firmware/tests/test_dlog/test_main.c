@@ -0,0 +1,83 @@
+#include "unity.h"
+#include "dlog.h" // Include the header for the module being tested
+#include "hal_interfaces.h"
+#include <string.h>
+
+// --- Mock HAL Functions ---
+static uint64_t mock_tick_ms;
+uint64_t hal_System_GetTickMs(void) { return mock_tick_ms; }
+
+static void drain(void) {
+    DLogRecord_t record;
+    while (DLog_Read(&record)) {
+    }
+}
+
+// --- Test Setup/Teardown ---
+void setUp(void) {
+    mock_tick_ms = 1000;
+    drain(); // The ring is static: start every test empty
+}
+
+void tearDown(void) {
+}
+
+// --- Test Cases ---
+void test_DLog_RecordsAndFormatsLater(void) {
+    long raw = -123456;
+    float weight = 42.5f;
+    DLOG(DLOG_SENSOR_SAMPLE, raw, weight, true);
+
+    DLogRecord_t record;
+    TEST_ASSERT_TRUE(DLog_Read(&record));
+    TEST_ASSERT_EQUAL_INT(DLOG_SENSOR_SAMPLE, record.id);
+    TEST_ASSERT_EQUAL_INT(3, record.nargs);
+    TEST_ASSERT_EQUAL_UINT32(1000, record.timestamp_ms);
+    TEST_ASSERT_FALSE(DLog_Read(&record)); // Consumed
+
+    char line[DLOG_LINE_MAX];
+    DLog_Write(DLOG_SENSOR_SAMPLE, 3, DLOG_ARG(raw), DLOG_ARG(weight), DLOG_ARG(1), 0);
+    TEST_ASSERT_TRUE(DLog_Read(&record));
+    DLog_Format(&record, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("Raw Sensor: -123456, Weight: 42.50g, Stable: 1", line);
+}
+
+void test_DLog_FormatUnsignedAndTruncation(void) {
+    DLogRecord_t record = { .id = DLOG_COMMS_MQTT_BATCH, .nargs = 3, .args = { 8, 4000000000U, (uint32_t)-1 } };
+    char line[DLOG_LINE_MAX];
+    DLog_Format(&record, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("Queued batch of 8 reading(s), 4000000000 bytes (msg -1).", line);
+
+    char small[10];
+    TEST_ASSERT_EQUAL_INT(9, DLog_Format(&record, small, sizeof(small)));
+    TEST_ASSERT_EQUAL_STRING("Queued ba", small);
+}
+
+void test_DLog_DropsWhenFullWithoutBlocking(void) {
+    uint32_t dropped_before = DLog_GetDropped();
+    for (int i = 0; i < DLOG_RING_RECORDS + 5; i++) {
+        mock_tick_ms = (uint64_t)i;
+        DLOG(DLOG_LC_OVERLOAD, (float)i);
+    }
+    TEST_ASSERT_EQUAL_UINT32(dropped_before + 5, DLog_GetDropped());
+
+    // Oldest records are kept, in order
+    DLogRecord_t record;
+    for (int i = 0; i < DLOG_RING_RECORDS; i++) {
+        TEST_ASSERT_TRUE(DLog_Read(&record));
+        TEST_ASSERT_EQUAL_UINT32(i, record.timestamp_ms);
+    }
+    TEST_ASSERT_FALSE(DLog_Read(&record));
+}
+
+// --- Main Test Runner ---
+// See test_scale_logic/test_main.c; if running standalone:
+/*
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_DLog_RecordsAndFormatsLater);
+    RUN_TEST(test_DLog_FormatUnsignedAndTruncation);
+    RUN_TEST(test_DLog_DropsWhenFullWithoutBlocking);
+    return UNITY_END();
+}
+*/
@@ -0,0 +1,75 @@
+#include "unity.h"
+#include "scale_core.h"
+#include <math.h>
+
+// The firmware used roundf() with a half-piece cutoff; the shared library
+// must give the same counts, scalar and batch alike.
+static int32_t reference_count(float weight_g, float item_weight_g) {
+    if (item_weight_g <= SCALE_CORE_MIN_ITEM_WEIGHT_G) return 0;
+    if (weight_g < item_weight_g / 2.0f) return 0;
+    return (int32_t)roundf(weight_g / item_weight_g);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_ScaleCore_CountItems_Rounding(void) {
+    TEST_ASSERT_EQUAL_INT(5, ScaleCore_CountItems(52.6f, 10.5f));
+    TEST_ASSERT_EQUAL_INT(3, ScaleCore_CountItems(7.5f, 2.5f));
+    TEST_ASSERT_EQUAL_INT(4, ScaleCore_CountItems(8.75f, 2.5f)); // 3.5 rounds away from zero
+    TEST_ASSERT_EQUAL_INT(3, ScaleCore_CountItems(nextafterf(8.75f, 0.0f), 2.5f));
+    TEST_ASSERT_EQUAL_INT(1, ScaleCore_CountItems(1.25f, 2.5f)); // Exactly half a piece
+}
+
+void test_ScaleCore_CountItems_Empty(void) {
+    TEST_ASSERT_EQUAL_INT(0, ScaleCore_CountItems(nextafterf(1.25f, 0.0f), 2.5f)); // Below half a piece
+    TEST_ASSERT_EQUAL_INT(0, ScaleCore_CountItems(-12.0f, 2.5f));
+    TEST_ASSERT_EQUAL_INT(0, ScaleCore_CountItems(100.0f, 0.0f)); // Item weight not set
+    TEST_ASSERT_EQUAL_INT(0, ScaleCore_CountItems(100.0f, SCALE_CORE_MIN_ITEM_WEIGHT_G));
+    TEST_ASSERT_EQUAL_INT(0, ScaleCore_CountItems(NAN, 2.5f));
+}
+
+void test_ScaleCore_CountItems_MatchesRoundf(void) {
+    // Halves and their float neighbours, where a naive +0.5 rounding goes wrong
+    for (int k = 0; k < 5000; k++) {
+        float half = (float)k + 0.5f;
+        float candidates[3] = { nextafterf(half, 0.0f), half, nextafterf(half, INFINITY) };
+        for (int i = 0; i < 3; i++) {
+            TEST_ASSERT_EQUAL_INT(reference_count(candidates[i], 1.0f), ScaleCore_CountItems(candidates[i], 1.0f));
+            TEST_ASSERT_EQUAL_INT(reference_count(candidates[i] * 2.5f, 2.5f), ScaleCore_CountItems(candidates[i] * 2.5f, 2.5f));
+        }
+    }
+}
+
+void test_ScaleCore_CountItemsBatch_MatchesScalar(void) {
+    float weights[257];
+    int32_t counts[257];
+    for (int i = 0; i < 257; i++) {
+        weights[i] = (float)i * 0.37f - 3.0f; // Negative, below half, halves and larger counts
+    }
+    ScaleCore_CountItemsBatch(weights, 257, 1.85f, counts);
+    for (int i = 0; i < 257; i++) {
+        TEST_ASSERT_EQUAL_INT(reference_count(weights[i], 1.85f), counts[i]);
+        TEST_ASSERT_EQUAL_INT(ScaleCore_CountItems(weights[i], 1.85f), counts[i]);
+    }
+
+    counts[0] = 7;
+    ScaleCore_CountItemsBatch(weights, 257, 0.0f, counts);
+    TEST_ASSERT_EQUAL_INT(0, counts[0]);
+}
+
+// --- Main Test Runner ---
+// See test_scale_logic/test_main.c; if running standalone:
+/*
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_ScaleCore_CountItems_Rounding);
+    RUN_TEST(test_ScaleCore_CountItems_Empty);
+    RUN_TEST(test_ScaleCore_CountItems_MatchesRoundf);
+    RUN_TEST(test_ScaleCore_CountItemsBatch_MatchesScalar);
+    return UNITY_END();
+}
+*/
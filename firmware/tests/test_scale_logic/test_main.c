@@ -11,6 +11,24 @@ static LoadCellReading_t mock_reading;
 void hal_LoadCell_Tare(void) { /* Mock does nothing */ }
 bool hal_Storage_Save_Float(const char* ns, const char* key, float val) { return true; } // Mock success
 bool hal_Storage_Load_Float(const char* ns, const char* key, float* val) { *val = 0.0f; return false; } // Mock not found
+bool hal_Storage_Save_String(const char* ns, const char* key, const char* val) { return true; } // Mock success
+bool hal_Storage_Load_String(const char* ns, const char* key, char* buf, size_t size) { buf[0] = '\0'; return false; } // Mock not found
+bool hal_Storage_Erase_Key(const char* ns, const char* key) { return true; } // Mock success
+bool hal_Storage_Save_Blob(const char* ns, const char* key, const void* data, size_t size) { return true; } // Mock success
+bool hal_Storage_Load_Blob(const char* ns, const char* key, void* data, size_t* size) { return false; } // Mock not found
+void hal_LoadCell_GetChannelOffsets(float *offsets, int max_channels) { for (int i = 0; i < max_channels; i++) offsets[i] = 0.0f; }
+void hal_LoadCell_SetChannelOffsets(const float *offsets, int count) { /* Mock does nothing */ }
+float hal_LoadCell_GetTareWeight(void) { return 0.0f; }
+void hal_LoadCell_SetTareWeight(float weight_g) { /* Mock does nothing */ }
+uint32_t hal_LoadCell_GetTareCount(void) { return 0; }
+int hal_LoadCell_GetChannelCount(void) { return LOADCELL_NUM_CHANNELS; }
+// Controllable uptime; the wall clock is "synced" once mock_epoch_offset_ms is set
+static uint64_t mock_tick_ms;
+static uint64_t mock_epoch_offset_ms;
+uint64_t hal_System_GetTickMs(void) { return mock_tick_ms; }
+uint64_t hal_Time_UptimeToEpochMs(uint64_t uptime_ms) { return mock_epoch_offset_ms ? uptime_ms + mock_epoch_offset_ms : 0; }
+static int mock_gate_pulses;
+void hal_RejectGate_Pulse(uint32_t duration_ms) { mock_gate_pulses++; }
 
 
 // --- Test Globals ---
@@ -21,6 +39,8 @@ void setUp(void) {
     // Ran before each test function
     ScaleLogic_Init(&test_state); // Initialize state before each test
     mock_reading = (LoadCellReading_t){0}; // Reset mock reading
+    mock_tick_ms = 1000;
+    mock_epoch_offset_ms = 0;
 }
 
 void tearDown(void) {
@@ -122,6 +142,196 @@ void test_ScaleLogic_SetSampleWeight_FailUnstable(void) {
     TEST_ASSERT_EQUAL_STRING("Unstable!", test_state.status_message);
 }
 
+void test_ScaleLogic_SetProduct_Remote(void) {
+    test_state.current_mode = MODE_WEIGHING;
+
+    TEST_ASSERT_TRUE(ScaleLogic_SetProduct(&test_state, "SKU-42", 2.5f));
+
+    TEST_ASSERT_EQUAL(MODE_COUNTING, test_state.current_mode);
+    TEST_ASSERT_EQUAL_FLOAT(2.5f, test_state.average_item_weight_g);
+    TEST_ASSERT_EQUAL_STRING("SKU-42", test_state.sku);
+    TEST_ASSERT_FALSE(ScaleLogic_SetItemWeight(&test_state, 0.0f)); // Invalid weight rejected
+    TEST_ASSERT_EQUAL_FLOAT(2.5f, test_state.average_item_weight_g);
+
+    TEST_ASSERT_FALSE(ScaleLogic_SetProduct(&test_state, "SKU\"42", 3.0f)); // Would break the JSON payloads
+    TEST_ASSERT_FALSE(ScaleLogic_SetProduct(&test_state, "SKU\\42", 3.0f));
+    TEST_ASSERT_FALSE(ScaleLogic_SetProduct(&test_state, "SKU 42", 3.0f));
+    TEST_ASSERT_EQUAL_STRING("SKU-42", test_state.sku);
+    TEST_ASSERT_TRUE(ScaleLogic_SetProduct(&test_state, "a.b_C-9", 3.0f));
+}
+
+void test_ScaleLogic_ClearSample_Hold(void) {
+    TEST_ASSERT_TRUE(ScaleLogic_SetItemWeight(&test_state, 2.5f));
+
+    ScaleLogic_RequestClearSample(&test_state);
+
+    TEST_ASSERT_EQUAL(MODE_WEIGHING, test_state.current_mode);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, test_state.average_item_weight_g);
+    TEST_ASSERT_EQUAL_STRING("Sample Cleared", test_state.status_message);
+}
+
+// Feeds one stable (or settling) reading, one sensor period after the last
+static void settle(float weight_g, bool stable) {
+    mock_tick_ms += SENSOR_TASK_INTERVAL_MS;
+    mock_reading = (LoadCellReading_t){ .weight_grams = weight_g, .is_stable = stable };
+    ScaleLogic_Update(&test_state, &mock_reading);
+}
+
+void test_ScaleLogic_Accumulate_LoadCycles(void) {
+    TEST_ASSERT_TRUE(ScaleLogic_SetItemWeight(&test_state, 2.5f));
+    ScaleLogic_RequestToggleMode(&test_state); // Counting -> Accumulate
+    TEST_ASSERT_EQUAL(MODE_ACCUMULATE, test_state.current_mode);
+
+    settle(10.0f, true);  // Already on the pan when the mode was entered: not added
+    TEST_ASSERT_EQUAL(0, test_state.lot.total);
+    settle(0.0f, true);   // Pan emptied: armed
+    settle(25.0f, true);  // Load 1: 10 items
+    settle(25.0f, true);  // Same load, still 10
+    settle(40.0f, false); // Topping up (settling)
+    settle(30.0f, true);  // Re-settled at 12: addition raised
+    settle(12.5f, true);  // Pause while unloading: ignored
+    settle(0.0f, true);
+    settle(50.0f, true);  // Load 2: 20 items
+    TEST_ASSERT_EQUAL(32, test_state.lot.total);
+    TEST_ASSERT_EQUAL(2, test_state.lot.loads);
+
+    ScaleLogic_RequestUndoLoad(&test_state);
+    TEST_ASSERT_EQUAL(12, test_state.lot.total);
+    TEST_ASSERT_EQUAL(1, test_state.lot.loads);
+    settle(50.0f, true);  // Undone load stays out until taken off
+    TEST_ASSERT_EQUAL(12, test_state.lot.total);
+
+    mock_reading = (LoadCellReading_t){ .weight_grams = 6000.0f, .is_overload = true };
+    ScaleLogic_Update(&test_state, &mock_reading); // Overload keeps the lot and resumes accumulating
+    TEST_ASSERT_EQUAL(MODE_ERROR, test_state.current_mode);
+    settle(0.0f, true);
+    TEST_ASSERT_EQUAL(MODE_ACCUMULATE, test_state.current_mode);
+    settle(5.0f, true);   // Load 3: 2 items
+    TEST_ASSERT_EQUAL(14, test_state.lot.total);
+}
+
+void test_ScaleLogic_Accumulate_CloseLot(void) {
+    TEST_ASSERT_TRUE(ScaleLogic_SetProduct(&test_state, "SKU-7", 2.5f));
+    ScaleLogic_RequestToggleMode(&test_state);
+    TEST_ASSERT_FALSE(ScaleLogic_RequestCloseLot(&test_state)); // Nothing in the lot yet
+    settle(0.0f, true);
+    settle(25.0f, true);
+
+    uint32_t lot_id = test_state.lot.lot_id;
+    TEST_ASSERT_TRUE(ScaleLogic_RequestCloseLot(&test_state));
+    TEST_ASSERT_EQUAL(0, test_state.lot.total);
+    TEST_ASSERT_EQUAL(lot_id + 1, test_state.lot.lot_id);
+    settle(25.0f, true);  // The closed lot's last load is not added to the new lot
+    TEST_ASSERT_EQUAL(0, test_state.lot.total);
+
+    LotRecord_t lot;
+    TEST_ASSERT_TRUE(ScaleLogic_PeekUnsentLot(&test_state, &lot));
+    TEST_ASSERT_EQUAL(lot_id, lot.lot_id);
+    TEST_ASSERT_EQUAL(10, lot.total);
+    TEST_ASSERT_EQUAL(1, lot.loads);
+    TEST_ASSERT_EQUAL_STRING("SKU-7", lot.sku);
+    ScaleLogic_MarkLotSent(&test_state);
+    TEST_ASSERT_FALSE(ScaleLogic_PeekUnsentLot(&test_state, &lot));
+    TEST_ASSERT_EQUAL_STRING("ACCUMULATE", ScaleLogic_ModeName(test_state.current_mode));
+}
+
+void test_ScaleLogic_Accumulate_OnOffUndoClose(void) {
+    TEST_ASSERT_TRUE(ScaleLogic_SetProduct(&test_state, "SKU-3", 4.0f));
+    ScaleLogic_RequestToggleMode(&test_state);
+    mock_epoch_offset_ms = 1700000000000ULL;
+
+    for (int load = 1; load <= 3; load++) {
+        for (int i = 0; i < 3; i++) settle(0.0f, true);  // Pan empty
+        for (int i = 0; i < 2; i++) settle(40.0f, false); // Load going on: nothing added while settling
+        TEST_ASSERT_EQUAL(10 * (load - 1), test_state.lot.total);
+        for (int i = 0; i < 3; i++) settle(40.0f, true);  // Settled: added once
+        TEST_ASSERT_EQUAL(10 * load, test_state.lot.total);
+        TEST_ASSERT_EQUAL(load, test_state.lot.loads);
+    }
+
+    ScaleLogic_RequestUndoLoad(&test_state); // Load 3 was miscounted
+    ScaleLogic_RequestUndoLoad(&test_state); // Only the newest load can be undone
+    TEST_ASSERT_EQUAL(20, test_state.lot.total);
+    TEST_ASSERT_EQUAL(2, test_state.lot.loads);
+    settle(0.0f, true);
+    settle(48.0f, true);  // Recounted load goes back on
+    TEST_ASSERT_EQUAL(32, test_state.lot.total);
+
+    mock_tick_ms = 90000;
+    TEST_ASSERT_TRUE(ScaleLogic_RequestCloseLot(&test_state));
+    LotRecord_t lot;
+    TEST_ASSERT_TRUE(ScaleLogic_PeekUnsentLot(&test_state, &lot));
+    TEST_ASSERT_EQUAL(32, lot.total);
+    TEST_ASSERT_EQUAL(3, lot.loads);
+    TEST_ASSERT_TRUE(lot.closed_epoch_ms == 1700000090000ULL);
+}
+
+void test_ScaleLogic_Checkweigh_RejectGate(void) {
+    TEST_ASSERT_TRUE(ScaleLogic_SetProduct(&test_state, "SKU-9", 2.5f));
+    CheckTarget_t target = { .sku = "SKU-9", .target = 10.0f, .under = 0.0f, .over = 1.0f, .unit = CHECK_UNIT_COUNT };
+    mock_gate_pulses = 0;
+    TEST_ASSERT_TRUE(ScaleLogic_SetCheckTarget(&test_state, &target)); // Active SKU: starts check-weighing
+    TEST_ASSERT_EQUAL(MODE_CHECKWEIGH, test_state.current_mode);
+    TEST_ASSERT_EQUAL_STRING("CHECKWEIGH", ScaleLogic_ModeName(test_state.current_mode));
+
+    settle(0.0f, true);
+    settle(20.0f, false);
+    settle(20.0f, false); // 8 items: rejected while still settling
+    TEST_ASSERT_EQUAL(CHECK_RESULT_UNDER, test_state.check.last_result);
+    TEST_ASSERT_EQUAL(1, mock_gate_pulses);
+    TEST_ASSERT_EQUAL_STRING("UNDER", test_state.status_message);
+
+    for (int i = 0; i < 4; i++) settle(0.0f, true);
+    for (int i = 0; i < 4; i++) settle(26.0f, false);
+    TEST_ASSERT_EQUAL(CHECK_RESULT_PASS, test_state.check.last_result);
+    TEST_ASSERT_EQUAL(1, mock_gate_pulses);
+
+    for (int i = 0; i < 4; i++) settle(0.0f, true);
+    mock_reading = (LoadCellReading_t){ .weight_grams = 6000.0f, .is_overload = true };
+    ScaleLogic_Update(&test_state, &mock_reading); // An overloaded pack is an over
+    TEST_ASSERT_EQUAL(CHECK_RESULT_OVER, test_state.check.last_result);
+    TEST_ASSERT_EQUAL(2, mock_gate_pulses);
+    TEST_ASSERT_EQUAL(MODE_ERROR, test_state.current_mode);
+    settle(0.0f, true);
+    TEST_ASSERT_EQUAL(MODE_CHECKWEIGH, test_state.current_mode);
+
+    ScaleLogic_RequestToggleMode(&test_state);
+    TEST_ASSERT_EQUAL(MODE_WEIGHING, test_state.current_mode);
+    TEST_ASSERT_FALSE(test_state.check.enabled);
+}
+
+void test_ScaleLogic_Checkweigh_DecidesBeforeStable(void) {
+    TEST_ASSERT_TRUE(ScaleLogic_SetProduct(&test_state, "SKU-5", 2.5f));
+    CheckTarget_t target = { .sku = "SKU-5", .target = 100.0f, .under = 2.0f, .over = 2.0f, .unit = CHECK_UNIT_GRAMS };
+    mock_gate_pulses = 0;
+    TEST_ASSERT_TRUE(ScaleLogic_SetCheckTarget(&test_state, &target));
+    settle(0.0f, true);
+
+    // Overweight pack dropped on the belt: the load cell never reports stable
+    uint64_t arrived_ms = mock_tick_ms + SENSOR_TASK_INTERVAL_MS;
+    const float ramp[] = { 70.0f, 104.0f, 108.0f, 108.0f, 108.0f, 108.0f };
+    for (size_t i = 0; i < sizeof(ramp) / sizeof(ramp[0]) && test_state.check.decisions == 0; i++) {
+        settle(ramp[i], false);
+    }
+    TEST_ASSERT_EQUAL(1, test_state.check.decisions);
+    TEST_ASSERT_EQUAL(CHECK_RESULT_OVER, test_state.check.last_result);
+    TEST_ASSERT_TRUE(test_state.check.last_early);
+    TEST_ASSERT_FALSE(test_state.is_stable);
+    TEST_ASSERT_EQUAL(1, mock_gate_pulses);
+    TEST_ASSERT_EQUAL(mock_tick_ms - arrived_ms, test_state.check.last_latency_ms);
+    TEST_ASSERT_TRUE(test_state.check.last_latency_ms < STABLE_READING_COUNT * SENSOR_TASK_INTERVAL_MS);
+
+    for (int i = 0; i < 4; i++) settle(108.0f, true); // Settling later does not decide again
+    TEST_ASSERT_EQUAL(1, test_state.check.decisions);
+    TEST_ASSERT_EQUAL(1, mock_gate_pulses);
+
+    for (int i = 0; i < 4; i++) settle(0.0f, true);
+    for (int i = 0; i < 8 && test_state.check.decisions == 1; i++) settle(100.5f, false);
+    TEST_ASSERT_EQUAL(2, test_state.check.decisions);
+    TEST_ASSERT_EQUAL(CHECK_RESULT_PASS, test_state.check.last_result); // Passes don't pulse the gate
+    TEST_ASSERT_EQUAL(1, mock_gate_pulses);
+}
+
 // --- Main Test Runner ---
 // This part depends on how Unity is integrated (e.g., with PlatformIO)
 // Usually, you just define the tests, and the framework calls them.
@@ -135,6 +345,13 @@ int main(void) {
     RUN_TEST(test_ScaleLogic_Counting_Simple);
     RUN_TEST(test_ScaleLogic_SetSampleWeight_Success);
     RUN_TEST(test_ScaleLogic_SetSampleWeight_FailUnstable);
+    RUN_TEST(test_ScaleLogic_SetProduct_Remote);
+    RUN_TEST(test_ScaleLogic_ClearSample_Hold);
+    RUN_TEST(test_ScaleLogic_Accumulate_LoadCycles);
+    RUN_TEST(test_ScaleLogic_Accumulate_CloseLot);
+    RUN_TEST(test_ScaleLogic_Accumulate_OnOffUndoClose);
+    RUN_TEST(test_ScaleLogic_Checkweigh_RejectGate);
+    RUN_TEST(test_ScaleLogic_Checkweigh_DecidesBeforeStable);
     // Add RUN_TEST for all other test functions
     return UNITY_END();
 }
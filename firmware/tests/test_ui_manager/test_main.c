@@ -0,0 +1,120 @@
+#include "unity.h"
+#include "ui_manager.h"  // Include the header for the module being tested
+#include "scale_logic.h"
+#include <string.h>
+
+// --- Mock HAL Functions ---
+// Button events are fed to UIManager_HandleInput in the order hal_buttons
+// queues them; the real scale logic runs underneath.
+static int mock_tare_calls;
+static int mock_config_saves;
+void hal_LoadCell_Tare(void) { mock_tare_calls++; }
+bool hal_Storage_Save_Float(const char* ns, const char* key, float val) { return true; }
+bool hal_Storage_Load_Float(const char* ns, const char* key, float* val) { *val = 0.0f; return false; }
+bool hal_Storage_Save_String(const char* ns, const char* key, const char* val) { return true; }
+bool hal_Storage_Load_String(const char* ns, const char* key, char* buf, size_t size) { buf[0] = '\0'; return false; }
+bool hal_Storage_Erase_Key(const char* ns, const char* key) { return true; }
+bool hal_Storage_Save_Blob(const char* ns, const char* key, const void* data, size_t size) {
+    if (strcmp(key, NVS_KEY_CONFIG_SNAPSHOT) == 0) mock_config_saves++;
+    return true;
+}
+bool hal_Storage_Load_Blob(const char* ns, const char* key, void* data, size_t* size) { return false; }
+void hal_LoadCell_GetChannelOffsets(float *offsets, int max_channels) { for (int i = 0; i < max_channels; i++) offsets[i] = 0.0f; }
+void hal_LoadCell_SetChannelOffsets(const float *offsets, int count) { }
+float hal_LoadCell_GetTareWeight(void) { return 0.0f; }
+void hal_LoadCell_SetTareWeight(float weight_g) { }
+uint32_t hal_LoadCell_GetTareCount(void) { return 0; }
+int hal_LoadCell_GetChannelCount(void) { return LOADCELL_NUM_CHANNELS; }
+uint64_t hal_System_GetTickMs(void) { return 0; }
+uint64_t hal_Time_UptimeToEpochMs(uint64_t uptime_ms) { return 0; } // Mock clock not synced
+void hal_RejectGate_Pulse(uint32_t duration_ms) { }
+void hal_Display_Clear(void) { }
+void hal_Display_SetCursor(int x, int y) { }
+void hal_Display_Print(const char* text) { }
+void hal_Display_Printf(const char* format, ...) { }
+void hal_Display_Update(void) { }
+
+// --- Test Globals ---
+static ScaleState_t test_state;
+
+static void settle(float weight_g) {
+    LoadCellReading_t reading = { .weight_grams = weight_g, .is_stable = true };
+    ScaleLogic_Update(&test_state, &reading);
+}
+
+// What hal_buttons queues for a short press and for a long one
+static void short_press(ButtonEvent_t press, ButtonEvent_t release, ButtonEvent_t short_event) {
+    UIManager_HandleInput(&test_state, press);
+    UIManager_HandleInput(&test_state, release);
+    UIManager_HandleInput(&test_state, short_event);
+}
+
+static void hold(ButtonEvent_t press, ButtonEvent_t hold_event, ButtonEvent_t release) {
+    UIManager_HandleInput(&test_state, press);
+    UIManager_HandleInput(&test_state, hold_event);
+    UIManager_HandleInput(&test_state, release);
+}
+
+// --- Test Setup/Teardown ---
+void setUp(void) {
+    ScaleLogic_Init(&test_state);
+    TEST_ASSERT_TRUE(ScaleLogic_SetProduct(&test_state, "SKU-1", 2.5f));
+    short_press(BUTTON_MODE_PRESS, BUTTON_MODE_RELEASE, BUTTON_MODE_SHORT); // Counting -> Accumulate
+    TEST_ASSERT_EQUAL(MODE_ACCUMULATE, test_state.current_mode);
+    settle(0.0f);
+    settle(25.0f); // One load of 10 items, still on the pan
+    TEST_ASSERT_EQUAL(10, test_state.lot.total);
+    mock_tare_calls = 0;
+    mock_config_saves = 0;
+}
+
+void tearDown(void) {
+}
+
+// --- Test Cases ---
+void test_UIManager_ModeHold_ClosesLot(void) {
+    hold(BUTTON_MODE_PRESS, BUTTON_MODE_HOLD, BUTTON_MODE_RELEASE);
+
+    TEST_ASSERT_EQUAL(MODE_ACCUMULATE, test_state.current_mode); // Not toggled on the way
+    TEST_ASSERT_EQUAL(1, test_state.lots_unsent_count);
+    TEST_ASSERT_EQUAL(0, test_state.lot.total);
+}
+
+void test_UIManager_TareHold_UndoesLoadWithoutTaring(void) {
+    hold(BUTTON_TARE_PRESS, BUTTON_TARE_HOLD, BUTTON_TARE_RELEASE);
+
+    TEST_ASSERT_EQUAL(0, mock_tare_calls); // The load on the pan is not a container
+    TEST_ASSERT_EQUAL(0, test_state.lot.total);
+    TEST_ASSERT_EQUAL(0, test_state.lot.loads);
+}
+
+void test_UIManager_SampleHold_ClearsWithoutSetting(void) {
+    hold(BUTTON_SAMPLE_PRESS, BUTTON_SAMPLE_HOLD, BUTTON_SAMPLE_RELEASE);
+
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, test_state.average_item_weight_g);
+    TEST_ASSERT_EQUAL(1, mock_config_saves); // Only the clear is persisted
+    TEST_ASSERT_EQUAL_STRING("Sample Cleared", test_state.status_message);
+}
+
+void test_UIManager_ShortPresses_Act(void) {
+    short_press(BUTTON_TARE_PRESS, BUTTON_TARE_RELEASE, BUTTON_TARE_SHORT);
+    TEST_ASSERT_EQUAL(1, mock_tare_calls);
+    TEST_ASSERT_EQUAL(10, test_state.lot.total);
+
+    short_press(BUTTON_MODE_PRESS, BUTTON_MODE_RELEASE, BUTTON_MODE_SHORT); // Accumulate -> Weighing (no check band)
+    TEST_ASSERT_EQUAL(MODE_WEIGHING, test_state.current_mode);
+    TEST_ASSERT_EQUAL(0, test_state.lots_unsent_count);
+}
+
+// --- Main Test Runner ---
+// See test_scale_logic/test_main.c; if running standalone:
+/*
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_UIManager_ModeHold_ClosesLot);
+    RUN_TEST(test_UIManager_TareHold_UndoesLoadWithoutTaring);
+    RUN_TEST(test_UIManager_SampleHold_ClearsWithoutSetting);
+    RUN_TEST(test_UIManager_ShortPresses_Act);
+    return UNITY_END();
+}
+*/
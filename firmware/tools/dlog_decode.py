@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""
+Decoder for the scale's binary deferred-log output (DLOG_OUTPUT_BINARY = 1).
+
+With binary output the log task prints each record as one hex line
+    DLOG:<timestamp u32><id u16><nargs u8><arg u32>...
+instead of formatting it on the device. This tool reads a captured console
+(file or stdin), formats those lines with the table in include/dlog_formats.h
+and passes every other line through unchanged.
+
+Usage:
+    idf.py monitor | python tools/dlog_decode.py
+    python tools/dlog_decode.py console.log --formats include/dlog_formats.h
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+DEFAULT_FORMATS = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'include', 'dlog_formats.h')
+ENTRY_RE = re.compile(r'X\(\s*(\w+)\s*,\s*DLOG_(\w+)\s*,\s*"([^"]*)"\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+RECORD_RE = re.compile(r'DLOG:([0-9a-fA-F]{14,})')
+SPEC_RE = re.compile(r'%([-+ #0-9.]*)[lhz]*([a-zA-Z%])')
+LEVEL_LETTERS = {'ERROR': 'E', 'WARN': 'W', 'INFO': 'I', 'DEBUG': 'D', 'VERBOSE': 'V'}
+
+
+def load_formats(path):
+    """Returns [(level letter, tag, format)], indexed by record id (table order)."""
+    with open(path) as f:
+        text = f.read()
+    formats = []
+    for _id, level, tag, fmt in ENTRY_RE.findall(text):
+        formats.append((LEVEL_LETTERS.get(level, '?'), tag, bytes(fmt, 'utf-8').decode('unicode_escape')))
+    if not formats:
+        raise ValueError(f"no DLOG_FORMATS entries found in {path}")
+    return formats
+
+
+def format_record(fmt, args):
+    """Applies a C format string to raw 32-bit arguments, as DLog_Format does on the device."""
+    values = iter(args)
+
+    def convert(match):
+        flags, conversion = match.groups()
+        if conversion == '%':
+            return '%'
+        raw = next(values, 0)
+        if conversion in 'fFeEgG':
+            return ('%' + flags + conversion) % struct.unpack('<f', struct.pack('<I', raw))[0]
+        if conversion == 'c':
+            return chr(raw & 0xFF)
+        if conversion in 'di':
+            return ('%' + flags + 'd') % (raw - (1 << 32) if raw & 0x80000000 else raw)
+        return ('%' + flags + (conversion if conversion in 'xXo' else 'd')) % raw
+
+    return SPEC_RE.sub(convert, fmt)
+
+
+def decode_line(line, formats):
+    """Returns the ESP_LOG-style text for a DLOG line, or None if the line is not one."""
+    match = RECORD_RE.search(line)
+    if not match:
+        return None
+    data = match.group(1)
+    timestamp = int(data[0:8], 16)
+    record_id = int(data[8:12], 16)
+    nargs = int(data[12:14], 16)
+    args = [int(data[14 + 8 * i:22 + 8 * i], 16) for i in range(nargs) if len(data) >= 22 + 8 * i]
+    if record_id >= len(formats):
+        return f"? ({timestamp}) DLOG: unknown record id {record_id} (formats table out of date?)"
+    letter, tag, fmt = formats[record_id]
+    return f"{letter} ({timestamp}) {tag}: {format_record(fmt, args)}"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('input', nargs='?', help='Captured console output (default: stdin)')
+    parser.add_argument('--formats', default=DEFAULT_FORMATS, help='Path to include/dlog_formats.h')
+    args = parser.parse_args()
+
+    try:
+        formats = load_formats(args.formats)
+    except (OSError, ValueError) as e:
+        print(f"Error: {e}", file=sys.stderr)
+        return 1
+
+    source = open(args.input, errors='replace') if args.input else sys.stdin
+    try:
+        for line in source:
+            decoded = decode_line(line, formats)
+            sys.stdout.write(line if decoded is None else decoded + '\n')
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if args.input:
+            source.close()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+Build-time RAM budget report for the scale firmware.
+
+Reads the GNU ld map file produced by the ESP-IDF / PlatformIO build and
+sums the static RAM (.data + .bss in DRAM) contributed by each module,
+i.e. each object file of our own code and each library archive.
+
+Usage:
+    python tools/mem_budget.py .pio/build/<env>/firmware.map
+    python tools/mem_budget.py firmware.map --top 20 --max-total 120000
+
+Runtime figures (stack headroom per task, heap low-water mark) are logged
+by the firmware itself, see src/mem_report.c.
+"""
+import argparse
+import re
+import sys
+from collections import defaultdict
+
+# Output sections that occupy RAM at runtime (ESP32 linker script names)
+RAM_OUTPUT_SECTIONS = ('.dram0.data', '.dram0.bss', '.noinit', '.data', '.bss')
+
+OUTPUT_SECTION_RE = re.compile(r'^(\.\S+)\s+0x[0-9a-f]+\s+0x[0-9a-f]+', re.IGNORECASE)
+INPUT_SECTION_RE = re.compile(r'^\s+(\.\S+|COMMON)?\s*(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S.*)$', re.IGNORECASE)
+PENDING_NAME_RE = re.compile(r'^\s+(\.\S+|COMMON)\s*$')
+
+
+def module_name(obj_path):
+    """libmain.a(main.c.obj) -> main.c ; .../libfreertos.a(tasks.c.obj) -> libfreertos.a"""
+    match = re.search(r'([^/\\]+)\.a\(([^)]+)\)$', obj_path)
+    if match:
+        archive, member = match.groups()
+        # Our own sources are linked from the app archive; report them per file
+        if archive in ('libmain', 'libsrc', 'libapp'):
+            return member.replace('.obj', '').replace('.o', '')
+        return archive + '.a'
+    return re.split(r'[/\\]', obj_path)[-1].replace('.obj', '').replace('.o', '')
+
+
+def parse_map(lines):
+    usage = defaultdict(lambda: {'data': 0, 'bss': 0})
+    current_output = None
+    pending_name = None
+    in_memory_map = False
+
+    for line in lines:
+        line = line.rstrip('\r\n')
+        if line.startswith('Linker script and memory map'):
+            in_memory_map = True
+            continue
+        if not in_memory_map:
+            continue
+
+        out_match = OUTPUT_SECTION_RE.match(line)
+        if out_match and not line.startswith(' '):
+            current_output = out_match.group(1)
+            continue
+        if line and not line.startswith(' '):
+            current_output = line.split()[0] if line.startswith('.') else None
+            continue
+        if current_output not in RAM_OUTPUT_SECTIONS:
+            continue
+
+        # Long section names wrap onto the next line in ld map files
+        pending_match = PENDING_NAME_RE.match(line)
+        if pending_match:
+            pending_name = pending_match.group(1)
+            continue
+
+        in_match = INPUT_SECTION_RE.match(line)
+        if not in_match:
+            continue
+        name = in_match.group(1) or pending_name or ''
+        pending_name = None
+        size = int(in_match.group(3), 16)
+        obj = in_match.group(4).strip()
+        if size == 0 or obj.startswith('*') or '(' not in obj and not obj.endswith(('.o', '.obj')):
+            continue
+
+        kind = 'bss' if ('bss' in name or name == 'COMMON' or 'bss' in current_output or 'noinit' in current_output) else 'data'
+        usage[module_name(obj)][kind] += size
+
+    return usage
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Static RAM usage per module from a linker map file.')
+    parser.add_argument('map_file')
+    parser.add_argument('--top', type=int, default=0, help='Only show the N largest modules')
+    parser.add_argument('--max-total', type=int, default=0, help='Exit non-zero if total static RAM exceeds this (bytes)')
+    args = parser.parse_args()
+
+    with open(args.map_file, encoding='utf-8', errors='replace') as f:
+        usage = parse_map(f)
+
+    rows = sorted(usage.items(), key=lambda item: item[1]['data'] + item[1]['bss'], reverse=True)
+    if args.top:
+        rows = rows[:args.top]
+
+    print(f"{'Module':<40} {'.data':>8} {'.bss':>8} {'Total':>8}")
+    print('-' * 67)
+    for module, sizes in rows:
+        print(f"{module:<40} {sizes['data']:>8} {sizes['bss']:>8} {sizes['data'] + sizes['bss']:>8}")
+
+    total_data = sum(s['data'] for s in usage.values())
+    total_bss = sum(s['bss'] for s in usage.values())
+    total = total_data + total_bss
+    print('-' * 67)
+    print(f"{'TOTAL':<40} {total_data:>8} {total_bss:>8} {total:>8}")
+
+    if args.max_total and total > args.max_total:
+        print(f"Static RAM budget exceeded: {total} > {args.max_total} bytes", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
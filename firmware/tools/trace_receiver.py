@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""
+Host collector for the scale's raw diagnostic stream.
+
+Start it, then send the scale a start_trace command pointing at this host:
+    POST /api/v1/command/<device_id>
+    {"command": "start_trace", "args": {"seconds": 60, "host": "192.168.1.50", "port": 5005}}
+
+Every UDP datagram is one block (format: include/diag_trace.h). Decoded
+samples are written as CSV (t_ms, sample, ch0..chN-1); the optional raw file
+keeps the datagrams, length-prefixed, for re-decoding later.
+
+Usage:
+    python tools/trace_receiver.py --out trace.csv
+    python tools/trace_receiver.py --port 5005 --out trace.csv --raw trace.bin --idle 10
+
+Loss accounting at the end distinguishes blocks lost on the network
+(sequence gaps) from samples the device dropped itself (ring overflow while
+the network or the bandwidth cap fell behind).
+"""
+import argparse
+import csv
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0x5354
+VERSION = 1
+HEADER = struct.Struct('<HBBIIIIHH')  # magic, version, channels, seq, first_sample, dropped, t0_ms, count, length
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+        shift += 7
+
+
+def unzigzag(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def decode_block(data):
+    """Returns (header dict, [(t_ms, [raw per channel]), ...]). Raises ValueError if malformed."""
+    if len(data) < HEADER.size:
+        raise ValueError(f"short datagram ({len(data)} bytes)")
+    magic, version, channels, seq, first_sample, dropped, t0_ms, count, length = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError(f"bad magic/version {magic:#06x}/{version}")
+    if HEADER.size + length != len(data):
+        raise ValueError(f"length field {length} does not match datagram ({len(data)} bytes)")
+
+    header = {'seq': seq, 'first_sample': first_sample, 'dropped': dropped,
+              'channels': channels, 't0_ms': t0_ms, 'count': count}
+    samples = []
+    pos = HEADER.size
+    t_ms = t0_ms
+    prev = [0] * channels
+    try:
+        for _ in range(count):
+            dt, pos = read_varint(data, pos)
+            t_ms = (t_ms + dt) & 0xFFFFFFFF
+            for ch in range(channels):
+                delta, pos = read_varint(data, pos)
+                prev[ch] += unzigzag(delta)
+            samples.append((t_ms, list(prev)))
+    except IndexError:
+        raise ValueError("payload truncated")
+    return header, samples
+
+
+class LossTracker:
+    def __init__(self):
+        self.blocks = 0
+        self.samples = 0
+        self.lost_blocks = 0
+        self.lost_samples = 0
+        self.device_dropped = 0
+        self.bad_datagrams = 0
+        self._next_seq = None
+        self._next_sample = None
+
+    def update(self, header):
+        if self._next_seq is not None and header['seq'] != self._next_seq:
+            self.lost_blocks += (header['seq'] - self._next_seq) & 0xFFFFFFFF
+            self.lost_samples += max(0, header['first_sample'] - self._next_sample)
+        self._next_seq = (header['seq'] + 1) & 0xFFFFFFFF
+        self._next_sample = header['first_sample'] + header['count']
+        self.device_dropped = max(self.device_dropped, header['dropped'])
+        self.blocks += 1
+        self.samples += header['count']
+
+    def summary(self):
+        return (f"{self.blocks} blocks, {self.samples} samples received; "
+                f"network lost {self.lost_blocks} blocks ({self.lost_samples} samples); "
+                f"device dropped {self.device_dropped} samples; {self.bad_datagrams} bad datagrams")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--bind', default='0.0.0.0', help='Local address to listen on')
+    parser.add_argument('--port', type=int, default=5005, help='UDP port (TRACE_COLLECTOR_PORT)')
+    parser.add_argument('--out', default='trace.csv', help='CSV file for decoded samples')
+    parser.add_argument('--raw', help='Also keep the raw datagrams (u16 length + block) in this file')
+    parser.add_argument('--idle', type=float, default=5.0,
+                        help='Stop after this many seconds without data, once the first block arrived')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    sock.settimeout(0.5)
+    print(f"Listening on {args.bind}:{args.port}, writing {args.out}", file=sys.stderr)
+
+    tracker = LossTracker()
+    raw_file = open(args.raw, 'wb') if args.raw else None
+    last_data = None
+    try:
+        with open(args.out, 'w', newline='') as out:
+            writer = None
+            while True:
+                try:
+                    data, sender = sock.recvfrom(2048)
+                except socket.timeout:
+                    if last_data is not None and time.monotonic() - last_data > args.idle:
+                        break
+                    continue
+                last_data = time.monotonic()
+                try:
+                    header, samples = decode_block(data)
+                except ValueError as e:
+                    tracker.bad_datagrams += 1
+                    print(f"Ignoring datagram from {sender[0]}: {e}", file=sys.stderr)
+                    continue
+
+                if raw_file:
+                    raw_file.write(struct.pack('<H', len(data)) + data)
+                if writer is None:
+                    writer = csv.writer(out)
+                    writer.writerow(['t_ms', 'sample'] + [f'ch{ch}' for ch in range(header['channels'])])
+                for index, (t_ms, raw) in enumerate(samples):
+                    writer.writerow([t_ms, header['first_sample'] + index] + raw)
+                tracker.update(header)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if raw_file:
+            raw_file.close()
+        sock.close()
+
+    print(tracker.summary(), file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())